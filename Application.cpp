@@ -7,6 +7,7 @@
 #include "classes/Connect4.h"
 #include "classes/Chess.h"
 #include "classes/Tournament.h"
+#include "classes/Trace.h"
 
 namespace ClassGame
 {
@@ -24,6 +25,7 @@ namespace ClassGame
     //
     void GameStartUp()
     {
+        TRACE_THREAD("main");
         game = nullptr;
     }
 
@@ -107,6 +109,55 @@ namespace ClassGame
         }
         ImGui::End();
 
+        // what the chess AI's last search did, all threads summed
+        if (Chess *chess = dynamic_cast<Chess *>(game))
+        {
+            const SearchStats &stats = chess->lastSearchStats();
+            ImGui::Begin("Search Stats");
+#ifdef CHESS_SEARCH_STATS
+            ImGui::Text("Nodes: %llu (+%llu quiescence)", (unsigned long long)stats.nodes, (unsigned long long)stats.qnodes);
+            ImGui::Text("NPS: %.0f in %.0f ms", stats.nps(), stats.elapsedMs);
+            ImGui::Text("Seldepth: %d", stats.seldepth);
+            ImGui::Text("TT: %.1f%% of %llu probes hit, %llu evictions", stats.ttHitRate() * 100, (unsigned long long)stats.ttProbes,
+                        (unsigned long long)stats.ttCollisions);
+            ImGui::Text("First move cutoffs: %.1f%% of %llu", stats.firstMoveCutoffRate() * 100, (unsigned long long)stats.betaCutoffs);
+            ImGui::Text("Eval cache: %.1f%% hits", stats.evalCacheHitRate() * 100);
+            ImGui::Text("Network evals: %.1f%% (%llu network, %llu material)", stats.networkEvalShare() * 100,
+                        (unsigned long long)stats.networkEvals, (unsigned long long)stats.materialEvals);
+            if (ImGui::TreeNode("Nodes per ply"))
+            {
+                for (int ply = 0; ply <= MAX_SEARCH_DEPTH && ply <= stats.seldepth; ply++)
+                {
+                    ImGui::Text("%2d: %llu + %llu", ply, (unsigned long long)stats.nodesAtPly[ply], (unsigned long long)stats.qnodesAtPly[ply]);
+                }
+                ImGui::TreePop();
+            }
+#else
+            ImGui::Text("Built without CHESS_SEARCH_STATS, %.0f ms", stats.elapsedMs);
+#endif
+            ImGui::End();
+        }
+
+        // what the AI is thinking while it searches, and the last search once it has moved
+        if (game && game->gameHasAI())
+        {
+            const AIProgress progress = game->aiProgress();
+            ImGui::Begin("AI");
+            ImGui::Text("%s, %.0f ms", progress.thinking ? "Thinking" : "Idle", progress.elapsedMs);
+            ImGui::Text("Depth: %d", progress.depth);
+            ImGui::Text("Score: %d", progress.score);
+            ImGui::Text("Best move: %s", progress.bestMove.c_str());
+            ImGui::TextWrapped("PV: %s", progress.pv.c_str());
+            ImGui::Text("Nodes: %llu", (unsigned long long)progress.nodes);
+            ImGui::BeginDisabled(!progress.thinking);
+            if (ImGui::Button("Move now"))
+            {
+                game->stopAI();
+            }
+            ImGui::EndDisabled();
+            ImGui::End();
+        }
+
         ImGui::Begin("GameWindow");
         if (client)
         {
@@ -114,13 +165,33 @@ namespace ClassGame
         }
         else if (game)
         {
-            if (game->gameHasAI() && (game->getCurrentPlayer()->isAIPlayer() || game->_gameOptions.AIvsAI))
+            if (!gameOver && game->gameHasAI() && (game->getCurrentPlayer()->isAIPlayer() || game->_gameOptions.AIvsAI))
             {
                 game->updateAI();
             }
             game->drawFrame();
         }
         ImGui::End();
+
+#ifdef CHESS_TRACE
+        // the rings are only read between searches, while nothing is writing to them
+        ImGui::Begin("Trace");
+        ImGui::Text("Zones: %llu held, %llu overwritten", (unsigned long long)Trace::recorded(), (unsigned long long)Trace::overwritten());
+        const bool searching = game && game->aiProgress().thinking;
+        ImGui::BeginDisabled(searching);
+        if (ImGui::Button("Write trace.json"))
+        {
+            Trace::writeChromeTrace("trace.json");
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear"))
+        {
+            Trace::clear();
+        }
+        ImGui::EndDisabled();
+        ImGui::End();
+#endif
+        TRACE_FRAME();
     }
 
     //
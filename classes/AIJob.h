@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+
+//
+// An AI move computed off the render thread
+// the frame loop starts a job and polls it once a frame; the search runs on its own thread against a
+// copy of the position and never touches the board. What it found comes back as a closure that collect()
+// runs on the frame's thread, where playing the move through the Grid is safe. While it runs the search
+// publishes how far it has got (depth, score, best move, principal variation) for the UI to show.
+//
+
+struct AIProgress {
+    bool thinking = false;
+    int depth = 0;          // deepest completed iteration
+    int score = 0;          // side to move's point of view, on the game's own scale
+    uint64_t nodes = 0;
+    double elapsedMs = 0;
+    std::string bestMove;   // in the game's own notation, empty before the first iteration
+    std::string pv;
+};
+
+// progress written by a search thread and read by the UI, whole reports at a time
+class AIProgressReport {
+public:
+    void begin() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _progress = AIProgress();
+        _progress.thinking = true;
+        _start = std::chrono::steady_clock::now();
+    }
+    void update(int depth, int score, uint64_t nodes, std::string bestMove, std::string pv) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _progress.depth = depth;
+        _progress.score = score;
+        _progress.nodes = nodes;
+        _progress.bestMove = std::move(bestMove);
+        _progress.pv = std::move(pv);
+    }
+    // the last report stays up once the move is played, until the next search begins
+    void end() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _progress.thinking = false;
+        _progress.elapsedMs = elapsedLocked();
+    }
+    AIProgress snapshot() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        AIProgress progress = _progress;
+        if (progress.thinking) {
+            progress.elapsedMs = elapsedLocked();
+        }
+        return progress;
+    }
+
+private:
+    double elapsedLocked() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+    }
+
+    mutable std::mutex _mutex;
+    AIProgress _progress;
+    std::chrono::steady_clock::time_point _start;
+};
+
+class AIJob {
+public:
+    // runs on the job's thread; returns what to do with the result on the frame's thread
+    using Work = std::function<std::function<void()>(AIJob& job)>;
+
+    AIJob() : _stopRequest(false) {}
+    ~AIJob() { cancel(); }
+    AIJob(const AIJob&) = delete;
+    AIJob& operator=(const AIJob&) = delete;
+
+    void start(Work work) {
+        cancel();
+        _stopRequest.store(false);
+        _report.begin();
+        _pending = std::async(std::launch::async, [this, work = std::move(work)]() { return work(*this); });
+    }
+    // started and not collected yet
+    bool running() const { return _pending.valid(); }
+    bool finished() const {
+        return _pending.valid() && _pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+    // on the frame's thread: plays a finished job's result, false while it is still searching
+    bool collect() {
+        if (!finished()) {
+            return false;
+        }
+        std::function<void()> play = _pending.get();
+        _report.end();
+        if (play) {
+            play();
+        }
+        return true;
+    }
+    // asks the search to finish early with the best it has; collect() still plays it
+    void stop() { _stopRequest.store(true); }
+    // stops and waits for the search, throwing its result away
+    void cancel() {
+        if (_pending.valid()) {
+            _stopRequest.store(true);
+            _pending.wait();
+            _pending = std::future<std::function<void()>>();
+            _report.end();
+        }
+    }
+
+    // for the search: polled with its clock
+    const std::atomic<bool>* stopRequest() const { return &_stopRequest; }
+    void report(int depth, int score, uint64_t nodes, std::string bestMove, std::string pv) {
+        _report.update(depth, score, nodes, std::move(bestMove), std::move(pv));
+    }
+    AIProgress progress() const { return _report.snapshot(); }
+
+private:
+    std::future<std::function<void()>> _pending;
+    std::atomic<bool> _stopRequest;
+    AIProgressReport _report;
+};
+
+// reports each completed iteration of a Search from root to job, moves named by the game
+constexpr int AI_PV_LENGTH = 12;
+
+template <typename SearchType, typename Position, typename MoveName>
+void reportIterations(AIJob& job, SearchType& search, const Position& root, MoveName moveName) {
+    search.setStopRequest(job.stopRequest());
+    search.setIterationCallback([&job, &search, root, moveName](const typename SearchType::Result& result) {
+        typename Position::Move line[AI_PV_LENGTH];
+        const int length = search.principalVariation(root, line, AI_PV_LENGTH);
+        std::string pv;
+        for (int i = 0; i < length; i++) {
+            pv += (i ? " " : "") + moveName(line[i]);
+        }
+        job.report(result.depth, result.score, result.nodes, result.hasMove ? moveName(result.move) : std::string(), pv);
+    });
+}
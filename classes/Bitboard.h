@@ -112,13 +112,14 @@ class BitBoard {
         std::cout << std::flush;
     }
 
+    // tzcnt/bsf, bb must not be empty
     inline int bitScanForward(uint64_t bb) const {
 #if defined(_MSC_VER) && !defined(__clang__)
         unsigned long index;
         _BitScanForward64(&index, bb);
         return index;
 #else
-        return __builtin_ffsll(bb) - 1;
+        return __builtin_ctzll(bb);
 #endif
     };
 
@@ -9,6 +9,7 @@ Checkers::Checkers() : Game() {
 }
 
 Checkers::~Checkers() {
+    _aiJob.cancel();
     delete _grid;
 }
 
@@ -38,6 +39,9 @@ void Checkers::setUpBoard() {
         }
     });
 
+    if (gameHasAI()) {
+        setAIPlayer(AI_PLAYER);
+    }
     startGame();
 }
 
@@ -138,14 +142,15 @@ void Checkers::bitMovedFromTo(Bit &bit, BitHolder &src, BitHolder &dst) {
         (jumped->bit()->getOwner() == getPlayerAt(RED_PLAYER)) ? _redPieces-- : _yellowPieces--;
         jumped->destroyBit();
 
-        // Promotion check
-        if ((bit.gameTag() == RED_PIECE && dstY == 7) || (bit.gameTag() == YELLOW_PIECE && dstY == 0)) {
+        // Promotion check, being crowned ends the move
+        bool crowned = (bit.gameTag() == RED_PIECE && dstY == 7) || (bit.gameTag() == YELLOW_PIECE && dstY == 0);
+        if (crowned) {
             bit.setGameTag(bit.gameTag() == RED_PIECE ? RED_KING : YELLOW_KING);
             bit.setScale(1.3f);
         }
 
         // Check for more jumps
-        if (canJumpFrom(*dstSquare)) {
+        if (!crowned && canJumpFrom(*dstSquare)) {
             _mustContinueJumping = true;
             _jumpingPiece = &dst;
             return;
@@ -208,38 +213,11 @@ Player* Checkers::checkForWinner() {
     if (_redPieces == 0) return getPlayerAt(YELLOW_PLAYER);
     if (_yellowPieces == 0) return getPlayerAt(RED_PLAYER);
 
-    // Check if current player has any moves
+    // Check if current player has any moves, jumps included
     Player* current = getCurrentPlayer();
-    bool hasMove = false;
-
-    _grid->forEachEnabledSquare([&](ChessSquare* square, int x, int y) {
-        if (hasMove) return;
-        Bit* piece = square->bit();
-        if (piece && piece->getOwner() == current) {
-            bool isKing = (piece->gameTag() == RED_KING || piece->gameTag() == YELLOW_KING);
-            bool isRed = (current == getPlayerAt(RED_PLAYER));
-
-            // Check for any valid move
-            auto checkMove = [&](ChessSquare* target) {
-                if (target && !target->bit()) hasMove = true;
-            };
-
-            if (isKing) {
-                checkMove(_grid->getFL(x, y));
-                checkMove(_grid->getFR(x, y));
-                checkMove(_grid->getBL(x, y));
-                checkMove(_grid->getBR(x, y));
-            } else if (isRed) {
-                checkMove(_grid->getBL(x, y));
-                checkMove(_grid->getBR(x, y));
-            } else {
-                checkMove(_grid->getFL(x, y));
-                checkMove(_grid->getFR(x, y));
-            }
-        }
-    });
-
-    if (!hasMove) {
+    CheckersMoveList moves;
+    boardFor(current).generateMoves(moves);
+    if (moves.count == 0) {
         return current == getPlayerAt(RED_PLAYER) ? getPlayerAt(YELLOW_PLAYER) : getPlayerAt(RED_PLAYER);
     }
     return nullptr;
@@ -290,5 +268,63 @@ void Checkers::setStateString(const std::string &s) {
     });
 }
 
-void Checkers::updateAI() {}
+// squares numbered 1..32 in board order, "-" for a step and "x" before every square a jump lands on
+static std::string checkersMoveName(const CheckersMove& move) {
+    std::string name = std::to_string(move.from + 1);
+    if (!move.hops) {
+        return name + "-" + std::to_string(move.path[0] + 1);
+    }
+    for (int i = 0; i < move.hops; i++) {
+        name += "x" + std::to_string(move.path[i] + 1);
+    }
+    return name;
+}
+
+AIJob::Work Checkers::aiWork() {
+    if (!gameHasAI()) return nullptr;
+
+    const CheckersPosition position{ boardFor(getCurrentPlayer()) };
+    return [this, position](AIJob& job) -> std::function<void()> {
+        reportIterations(job, _search, position, checkersMoveName);
+        CheckersSearchResult result = _search.search(position, AI_MOVE_TIME_MS);
+        if (!result.hasMove) return nullptr;
+
+        // play the move one hop at a time, the way a player drags it, so captures and crowning go through bitMovedFromTo
+        return [this, move = result.move]() {
+            ChessSquare* src = squareFor(move.from);
+            for (int i = 0; i < (move.hops ? move.hops : 1); i++) {
+                ChessSquare* dst = squareFor(move.path[i]);
+                Bit* bit = src->bit();
+                if (!bit) return;
+                dst->dropBitAtPoint(bit, ImVec2(0, 0));
+                src->setBit(nullptr);
+                bitMovedFromTo(*bit, *src, *dst);
+                src = dst;
+            }
+        };
+    };
+}
+
+CheckersBoard Checkers::boardFor(Player* toMove) const {
+    CheckersBoard board;
+    _grid->forEachEnabledSquare([&](ChessSquare* square, int x, int y) {
+        Bit* piece = square->bit();
+        if (piece) {
+            const uint32_t bit = 1u << (y * 4 + x / 2);
+            board.pieces[piece->getOwner() == getPlayerAt(RED_PLAYER) ? CHECKERS_RED : CHECKERS_YELLOW] |= bit;
+            if (piece->gameTag() == RED_KING || piece->gameTag() == YELLOW_KING) {
+                board.kings |= bit;
+            }
+        }
+    });
+    board.side = toMove == getPlayerAt(RED_PLAYER) ? CHECKERS_RED : CHECKERS_YELLOW;
+    board.computeHash();
+    return board;
+}
+
+// the dark square of a CheckersBoard square, which sits at odd x on even rows
+ChessSquare* Checkers::squareFor(int square) const {
+    const int y = square / 4;
+    return _grid->getSquare(2 * (square % 4) + (y + 1) % 2, y);
+}
 
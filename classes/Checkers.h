@@ -1,5 +1,6 @@
 #pragma once
 #include "Game.h"
+#include "CheckersSearch.h"
 
 // NOTE: If Square class needs modifications to support colored squares for checkerboard pattern,
 // add a method like setColor(ImVec4 color) to Square class
@@ -24,10 +25,12 @@ public:
     void        bitMovedFromTo(Bit &bit, BitHolder &src, BitHolder &dst) override;
 
     // AI methods
-    void        updateAI() override;
-    bool        gameHasAI() override { return false; } // Set to true when AI is implemented
+    bool        gameHasAI() override { return true; }
     Grid* getGrid() override { return _grid; }
 
+protected:
+    AIJob::Work aiWork() override;
+
 private:
     // Constants for piece types
     static const int EMPTY = 0;
@@ -40,6 +43,9 @@ private:
     static const int RED_PLAYER = 0;
     static const int YELLOW_PLAYER = 1;
 
+    // how long the AI thinks per move
+    static const int AI_MOVE_TIME_MS = 500;
+
     // Helper methods
     Bit*        createPiece(int pieceType);
     int         getPieceType(const Bit& bit) const;
@@ -52,6 +58,9 @@ private:
     void        promoteToKing(Bit& bit, int y);
     void        getBoardPosition(BitHolder &holder, int &x, int &y) const;
     bool        isValidSquare(int x, int y) const;
+    // the grid as a bitboard position with toMove to move
+    CheckersBoard boardFor(Player* toMove) const;
+    ChessSquare* squareFor(int square) const;
 
     // Board representation
     Grid*        _grid;
@@ -61,4 +70,6 @@ private:
     BitHolder*  _jumpingPiece;
     int         _redPieces;
     int         _yellowPieces;
+
+    CheckersSearch _search;
 };
\ No newline at end of file
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include "Zobrist.h"
+
+//
+// Checkers position on the 32 playable squares
+// square = y * 4 + x / 2, the same order as the Grid's enabled squares and the state string. Rows with
+// even y hold the odd x squares and rows with odd y the even ones, so stepping a diagonal is a shift by
+// 4 plus a shift by 3 or 5 depending on the row, with the squares that would wrap masked out first.
+// Which pieces can capture, and where men and kings can step, are whole-board shifts in each of the
+// four directions; only the chains of a multi-jump are followed one piece at a time. Captures are
+// forced, a chain must be jumped to its end, and a man reaching the far row is crowned and stops.
+// Red starts at y 0..2 and moves towards y 7, yellow the other way, red moves first.
+//
+
+constexpr int CHECKERS_RED = 0;
+constexpr int CHECKERS_YELLOW = 1;
+constexpr int CHECKERS_MAX_HOPS = 12;      // one capture per opponent piece at the very most
+constexpr int CHECKERS_MAX_MOVES = 128;
+
+namespace checkers {
+    enum Direction { DownLeft, DownRight, UpLeft, UpRight };    // down is towards y 7
+
+    constexpr uint32_t EVEN_ROWS = 0x0f0f0f0fu;
+    constexpr uint32_t ODD_ROWS = 0xf0f0f0f0u;
+    constexpr uint32_t FIRST_COLUMN = 0x11111111u;  // x / 2 == 0
+    constexpr uint32_t LAST_COLUMN = 0x88888888u;   // x / 2 == 3
+    constexpr uint32_t CROWN_ROW[2] = { 0xf0000000u, 0x0000000fu };    // y 7 for red, y 0 for yellow
+
+    constexpr uint32_t step(uint32_t b, Direction direction) {
+        switch (direction) {
+        case DownLeft:  return ((b & EVEN_ROWS) << 4) | ((b & ODD_ROWS & ~FIRST_COLUMN) << 3);
+        case DownRight: return ((b & EVEN_ROWS & ~LAST_COLUMN) << 5) | ((b & ODD_ROWS) << 4);
+        case UpLeft:    return ((b & EVEN_ROWS) >> 4) | ((b & ODD_ROWS & ~FIRST_COLUMN) >> 5);
+        case UpRight:   return ((b & EVEN_ROWS & ~LAST_COLUMN) >> 3) | ((b & ODD_ROWS) >> 4);
+        }
+        return 0;
+    }
+    constexpr Direction opposite(Direction direction) {
+        return direction == DownLeft ? UpRight : direction == DownRight ? UpLeft : direction == UpLeft ? DownRight : DownLeft;
+    }
+    // a man's two directions come first, a king has all four
+    constexpr Direction directions[2][4] = { { DownLeft, DownRight, UpLeft, UpRight }, { UpLeft, UpRight, DownLeft, DownRight } };
+
+    struct ZobristKeys {
+        uint64_t pieces[2][2][32];  // side, king, square
+        uint64_t sideToMove;        // xored in when yellow is to move
+    };
+    constexpr ZobristKeys makeZobristKeys() {
+        ZobristKeys keys{};
+        uint64_t seed = 0x436865636b657273ull;
+        for (auto& side : keys.pieces) {
+            for (auto& type : side) {
+                for (auto& key : type) {
+                    key = zobristSplitMix64(seed);
+                }
+            }
+        }
+        keys.sideToMove = zobristSplitMix64(seed);
+        return keys;
+    }
+    inline constexpr ZobristKeys zobristKeys = makeZobristKeys();
+}
+
+struct CheckersMove {
+    uint8_t from = 0;
+    uint8_t hops = 0;               // 0 for a step, else the number of pieces jumped
+    uint8_t path[CHECKERS_MAX_HOPS] = {};   // the squares landed on; a step's destination is path[0]
+    uint32_t captured = 0;
+
+    int to() const { return path[hops ? hops - 1 : 0]; }
+    bool operator==(const CheckersMove& other) const {
+        return from == other.from && to() == other.to() && captured == other.captured;
+    }
+};
+
+struct CheckersMoveList {
+    CheckersMove moves[CHECKERS_MAX_MOVES];
+    int count = 0;
+
+    void add(const CheckersMove& move) {
+        if (count < CHECKERS_MAX_MOVES) {
+            moves[count++] = move;
+        }
+    }
+};
+
+struct CheckersBoard {
+    uint32_t pieces[2] = { 0, 0 };  // by side, men and kings
+    uint32_t kings = 0;
+    int side = CHECKERS_RED;        // to move
+    uint64_t hash = 0;
+
+    static CheckersBoard initial() {
+        CheckersBoard board;
+        board.pieces[CHECKERS_RED] = 0x00000fffu;
+        board.pieces[CHECKERS_YELLOW] = 0xfff00000u;
+        board.computeHash();
+        return board;
+    }
+
+    uint32_t empty() const { return ~(pieces[0] | pieces[1]); }
+
+    void computeHash() {
+        hash = side == CHECKERS_YELLOW ? checkers::zobristKeys.sideToMove : 0;
+        for (int s = 0; s < 2; s++) {
+            for (uint32_t b = pieces[s]; b; b &= b - 1) {
+                const int square = std::countr_zero(b);
+                hash ^= checkers::zobristKeys.pieces[s][(kings >> square) & 1][square];
+            }
+        }
+    }
+
+    // pieces of the side to move that have a capture, one shift pair per direction
+    uint32_t jumpers() const {
+        using namespace checkers;
+        const uint32_t men = pieces[side] & ~kings;
+        const uint32_t ownKings = pieces[side] & kings;
+        const uint32_t opponent = pieces[side ^ 1];
+        const uint32_t open = empty();
+        uint32_t result = 0;
+        for (int i = 0; i < 4; i++) {
+            const Direction direction = directions[side][i];
+            const uint32_t movers = i < 2 ? men | ownKings : ownKings;
+            result |= movers & step(step(open, opposite(direction)) & opponent, opposite(direction));
+        }
+        return result;
+    }
+
+    // legal moves only: if anything can capture, only captures
+    void generateMoves(CheckersMoveList& list) const {
+        using namespace checkers;
+        list.count = 0;
+        const uint32_t open = empty();
+        if (uint32_t capturing = jumpers()) {
+            for (; capturing; capturing &= capturing - 1) {
+                const int square = std::countr_zero(capturing);
+                CheckersMove move;
+                move.from = static_cast<uint8_t>(square);
+                addJumps(list, move, side, square, (kings >> square) & 1, pieces[side ^ 1], open | (1u << square));
+            }
+            return;
+        }
+        const uint32_t men = pieces[side] & ~kings;
+        const uint32_t ownKings = pieces[side] & kings;
+        for (int i = 0; i < 4; i++) {
+            const Direction direction = directions[side][i];
+            for (uint32_t targets = step(i < 2 ? men | ownKings : ownKings, direction) & open; targets; targets &= targets - 1) {
+                const int to = std::countr_zero(targets);
+                CheckersMove move;
+                move.from = static_cast<uint8_t>(std::countr_zero(step(1u << to, opposite(direction))));
+                move.path[0] = static_cast<uint8_t>(to);
+                list.add(move);
+            }
+        }
+    }
+
+    void makeMove(const CheckersMove& move) {
+        const uint32_t from = 1u << move.from;
+        const uint32_t to = 1u << move.to();
+        const int king = (kings & from) ? 1 : 0;
+        const int crowned = king || (to & checkers::CROWN_ROW[side]) ? 1 : 0;
+        const auto& keys = checkers::zobristKeys;
+        hash ^= keys.pieces[side][king][move.from] ^ keys.pieces[side][crowned][move.to()];
+        for (uint32_t b = move.captured; b; b &= b - 1) {
+            const int square = std::countr_zero(b);
+            hash ^= keys.pieces[side ^ 1][(kings >> square) & 1][square];
+        }
+        // a king's chain can end where it started, so the from square is cleared before to is set
+        pieces[side] = (pieces[side] & ~from) | to;
+        pieces[side ^ 1] &= ~move.captured;
+        kings &= ~(move.captured | from);
+        if (crowned) {
+            kings |= to;
+        }
+        side ^= 1;
+        hash ^= keys.sideToMove;
+    }
+
+private:
+    // every chain of jumps from square onwards; jumped pieces leave opponent at once so they can't be
+    // taken twice, but stay out of open so nothing lands on them before the move is over
+    static void addJumps(CheckersMoveList& list, const CheckersMove& move, int side, int square, bool king, uint32_t opponent, uint32_t open) {
+        using namespace checkers;
+        bool extended = false;
+        for (int i = 0; i < (king ? 4 : 2); i++) {
+            const Direction direction = directions[side][i];
+            const uint32_t over = step(1u << square, direction) & opponent;
+            const uint32_t land = step(over, direction) & open;
+            if (!land || move.hops == CHECKERS_MAX_HOPS) {
+                continue;
+            }
+            CheckersMove next = move;
+            const int landing = std::countr_zero(land);
+            next.path[next.hops++] = static_cast<uint8_t>(landing);
+            next.captured |= over;
+            extended = true;
+            if (!king && (land & CROWN_ROW[side])) {
+                list.add(next);
+            } else {
+                addJumps(list, next, side, landing, king, opponent & ~over, open);
+            }
+        }
+        if (!extended && move.hops > 0) {
+            list.add(move);
+        }
+    }
+};
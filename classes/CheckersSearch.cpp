@@ -0,0 +1,28 @@
+#include "CheckersSearch.h"
+#include <bit>
+
+namespace {
+    constexpr int MAN_VALUE = 100;
+    constexpr int KING_VALUE = 150;
+    constexpr int ADVANCE_WEIGHT = 3;       // per row a man has come from its own back row
+    constexpr int BACK_ROW_WEIGHT = 10;     // per man still on its own back row, where it keeps the opponent from crowning
+
+    constexpr uint32_t BACK_ROW[2] = { checkers::CROWN_ROW[CHECKERS_YELLOW], checkers::CROWN_ROW[CHECKERS_RED] };
+
+    int sideScore(const CheckersBoard& board, int side)
+    {
+        const uint32_t men = board.pieces[side] & ~board.kings;
+        int score = MAN_VALUE * std::popcount(men) + KING_VALUE * std::popcount(board.pieces[side] & board.kings);
+        for (uint32_t b = men; b; b &= b - 1) {
+            const int y = std::countr_zero(b) / 4;
+            score += ADVANCE_WEIGHT * (side == CHECKERS_RED ? y : 7 - y);
+        }
+        score += BACK_ROW_WEIGHT * std::popcount(men & BACK_ROW[side]);
+        return score;
+    }
+}
+
+int CheckersPosition::evaluate() const
+{
+    return sideScore(board, board.side) - sideScore(board, board.side ^ 1);
+}
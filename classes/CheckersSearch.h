@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include "CheckersBoard.h"
+#include "Search.h"
+
+//
+// Checkers search, kept free of the UI like ChessSearch
+// CheckersBoard as a Search position. Captures are forced, so a position with only one move costs no
+// depth, and one with a capture pending is searched on past the horizon, never scored mid-exchange.
+// Kings can go back and forth, so positions repeated along the search path are draws. The
+// evaluation counts material, how far the men have come, and the men still guarding the back row.
+//
+
+struct CheckersPosition {
+    using Move = CheckersMove;
+    static constexpr int MAX_MOVES = CHECKERS_MAX_MOVES;
+    static constexpr bool CAN_REPEAT = true;
+
+    CheckersBoard board;
+
+    int generateMoves(Move* moves) const {
+        CheckersMoveList list;
+        board.generateMoves(list);
+        std::copy(list.moves, list.moves + list.count, moves);
+        return list.count;
+    }
+    void makeMove(const Move& move) { board.makeMove(move); }
+    uint64_t hash() const { return board.hash; }
+    int evaluate() const;
+    // losing every piece, or every move, is the position without moves the search already scores
+    bool terminal(int, int&) const { return false; }
+    bool noisy() const { return board.jumpers() != 0; }
+
+    // the longest captures, then moves that crown a man
+    int orderKey(const Move& move, int) const {
+        const uint32_t men = board.pieces[board.side] & ~board.kings;
+        const bool crowns = (men & (1u << move.from)) && ((1u << move.to()) & checkers::CROWN_ROW[board.side]);
+        return move.hops * 4 + (crowns ? 2 : 0);
+    }
+};
+
+using CheckersSearch = Search<CheckersPosition>;
+using CheckersSearchResult = CheckersSearch::Result;
@@ -6,44 +6,42 @@
 #include <tuple>
 #include <algorithm>
 #include <chrono>
-#include <iomanip>
+#include <cstdio>
+#include <fstream>
 #include <iterator>
-#include <sstream>
 #include <random>
 #include "ChessSquare.h"
 #include "ChessEval.h"
+#include "Notation.h"
+#include "Trace.h"
 
-Chess::Chess()
+Chess::Chess() : _stopRequest(false), _searchAbandoned(false), _searchDone(false), _pondering(false), _evaluate(ChessEval::shared("resources/models/neural_final.bin")), _search(*_evaluate), _log("")
 {
     _grid = new Grid(8, 8);
-    _countMoves = 0;
+    _moveTimeMs = 0;
+    setClock(0, 0);
+    _randomizeAIMove = true;
     _lastAIMove = BitMove();
     
-    // Load trained neural network model
-    if (!_evaluate.loadModel("resources/models/neural_final.bin")) {
-        std::cout << "Warning: Failed to load neural network model. Using untrained network." << std::endl;
-    } else {
-        std::cout << "Successfully loaded trained neural network model." << std::endl;
+    // The trained model is loaded by the first game and shared by the ones after it
+    if (!_evaluate->isLoaded()) {
+        _log.log(LogLevel::Warning, "Warning: Failed to load neural network model. Using untrained network.");
+    }
+    // tablebases are optional too, the search just has nothing to probe without them
+    _search.setTablebase(Tablebase::shared("resources/tablebases"));
+    // the book is optional, only a file that is there but isn't a book is worth a warning
+    const char* bookPath = "resources/books/book.bin";
+    if (std::ifstream(bookPath).good() && !loadOpeningBook(bookPath)) {
+        _log.log(LogLevel::Warning, std::string("Warning: ") + bookPath + " is not an opening book.");
     }
 }
 
 Chess::~Chess()
 {
+    abandonAISearch();
     delete _grid;
 }
 
-char Chess::pieceNotation(int x, int y) const
-{
-    const char *wpieces = { "0PNBRQK" };
-    const char *bpieces = { "0pnbrqk" };
-    Bit *bit = _grid->getSquare(x, y)->bit();
-    char notation = '0';
-    if (bit) {
-        notation = bit->gameTag() < 128 ? wpieces[bit->gameTag()] : bpieces[bit->gameTag()-128];
-    }
-    return notation;
-}
-
 Bit* Chess::PieceForPlayer(const int playerNumber, ChessPiece piece)
 {
     const char* pieces[] = { "pawn.png", "knight.png", "bishop.png", "rook.png", "queen.png", "king.png" };
@@ -66,8 +64,8 @@ void Chess::setUpBoard()
     _gameOptions.rowY = 8;
 
     _grid->initializeChessSquares(pieceSize, "boardsquare.png");
-    FENtoBoard("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR");
-    syncEngineFromGrid();
+    _engineState.loadFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    syncGridFromEngine();
     regenerateLegalMoves();
 
     // Enable AI for player 1 (black)
@@ -75,6 +73,7 @@ void Chess::setUpBoard()
         setAIPlayer(AI_PLAYER);
         _gameOptions.AIMAXDepth = 3; // Set search depth
     }
+    _search.resizeTT(_gameOptions.TTSizeMB);
 
     startGame();
 }
@@ -123,49 +122,19 @@ bool Chess::placePieceFromFEN(char fenChar, int x, int y)
     return false;
 }
 
-void Chess::FENtoBoard(const std::string &fen)
+// The grid is only a picture of _engineState: this redraws it from scratch, after the engine was set up
+// from a FEN or a state string. Moves played on the board keep the two in step on their own.
+void Chess::syncGridFromEngine()
 {
-    // convert a FEN string to a board
-    // FEN is a space delimited string with 6 fields
-    // 1: piece placement (from white's perspective)
-    // NOT PART OF THIS ASSIGNMENT BUT OTHER THINGS THAT CAN BE IN A FEN STRING
-    // ARE BELOW
-    // 2: active color (W or B)
-    // 3: castling availability (KQkq or -)
-    // 4: en passant target square (in algebraic notation, or -)
-    // 5: halfmove clock (number of halfmoves since the last capture or pawn advance)
-
-    // Clear the board first
-    _grid->forEachSquare([](ChessSquare *square, int x, int y)
-                         { square->destroyBit(); });
-
-    int y = 7; // Start at rank 8
-    int x = 0; // Start at file a
-
-    for (size_t i = 0; i < fen.length() && y >= 0; i++)
-    {
-        char c = fen[i];
-
-        // Shift to next rank on slashes and reset the file
-        if (c == '/')
+    TRACE_ZONE("Chess::syncGridFromEngine");
+    _grid->forEachSquare([&](ChessSquare *square, int x, int y)
+                         {
+        square->destroyBit();
+        const char piece = _engineState.state[y * 8 + x];
+        if (piece != '0')
         {
-            y--;
-            x = 0;
-        }
-        // Skip consecutive empty squares
-        else if (c >= '1' && c <= '8')
-        {
-            x += (c - '0');
-        }
-        else
-        {
-            // Place piece if valid FEN character
-            if (placePieceFromFEN(c, x, y) && x < 8)
-            {
-                x++;
-            }
-        }
-    }
+            placePieceFromFEN(piece, x, y);
+        } });
 }
 
 bool Chess::actionForEmptyHolder(BitHolder &holder)
@@ -218,8 +187,74 @@ bool Chess::canBitMoveFromTo(Bit &bit, BitHolder &src, BitHolder &dst)
     return it != _legalMoves.end();
 }
 
+// The grid only moved the piece that was dragged or dropped, so finish castling, en passant and
+// promotion here before the turn ends
+void Chess::bitMovedFromTo(Bit &bit, BitHolder &src, BitHolder &dst)
+{
+    auto srcSquare = dynamic_cast<ChessSquare *>(&src);
+    auto dstSquare = dynamic_cast<ChessSquare *>(&dst);
+    if (srcSquare && dstSquare)
+    {
+        int fromIndex = srcSquare->getSquareIndex();
+        int toIndex = dstSquare->getSquareIndex();
+
+        // several promotions share from/to, prefer the one the AI picked and default to the queen listed first
+        const BitMove *played = nullptr;
+        for (const BitMove &move : _legalMoves)
+        {
+            if (move.from != fromIndex || move.to != toIndex)
+                continue;
+            if (!played || (move.flags == _lastAIMove.flags && move.from == _lastAIMove.from && move.to == _lastAIMove.to))
+                played = &move;
+        }
+        if (played)
+        {
+            applySpecialMoveToGrid(*played);
+            // the engine follows the game move by move, so castling rights, en passant and the clocks carry over
+            _engineState.pushMove(*played);
+        }
+    }
+    Game::bitMovedFromTo(bit, src, dst);
+}
+
+void Chess::applySpecialMoveToGrid(const BitMove& move)
+{
+    if (move.flags & (KingSideCastle | QueenSideCastle))
+    {
+        int rookFrom = (move.flags & KingSideCastle) ? move.to + 1 : move.to - 2;
+        int rookTo = (move.flags & KingSideCastle) ? move.to - 1 : move.to + 1;
+        BitHolder& rookSrc = getHolderAt(rookFrom & 7, rookFrom / 8);
+        BitHolder& rookDst = getHolderAt(rookTo & 7, rookTo / 8);
+        Bit* rook = rookSrc.bit();
+        if (rook && rookDst.dropBitAtPoint(rook, ImVec2(0, 0)))
+        {
+            rookSrc.setBit(nullptr);
+        }
+    }
+    else if (move.flags & EnPassant)
+    {
+        int capturedSquare = (move.to > move.from) ? move.to - 8 : move.to + 8;
+        getHolderAt(capturedSquare & 7, capturedSquare / 8).destroyBit();
+    }
+
+    if (move.flags & IsPromotion)
+    {
+        BitHolder& holder = getHolderAt(move.to & 7, move.to / 8);
+        Bit* pawn = holder.bit();
+        if (!pawn)
+            return;
+        int playerNumber = (pawn->gameTag() & 128) ? 1 : 0;
+        ChessPiece piece = move.promotionPiece();
+        Bit* promoted = PieceForPlayer(playerNumber, piece);
+        promoted->setGameTag(playerNumber == 0 ? piece : piece + 128);
+        promoted->setPosition(holder.getPosition());
+        holder.setBit(promoted); // replaces (and deletes) the pawn
+    }
+}
+
 void Chess::stopGame()
 {
+    abandonAISearch();
     _grid->forEachSquare([](ChessSquare* square, int x, int y) { 
         square->destroyBit(); 
     });
@@ -243,9 +278,17 @@ Player* Chess::checkForWinner()
     return nullptr;
 }
 
+// Threefold repetition, the fifty move rule and stalemate, all read off the engine, which has seen
+// every move since the board was last set up
 bool Chess::checkForDraw()
 {
-    return false;
+    if (_engineState.repetitions(2) >= 2)
+        return true;
+    MoveList moves;
+    _engineState.generateAllMoves(moves);
+    if (moves.empty())
+        return !_engineState.isInCheck();
+    return _engineState.fiftyMoveRuleReached();
 }
 
 std::string Chess::initialStateString()
@@ -253,132 +296,248 @@ std::string Chess::initialStateString()
     return stateString();
 }
 
+// 64 piece characters, a1 first, read straight off the engine
 std::string Chess::stateString()
 {
-    std::string s;
-    s.reserve(64);
-    _grid->forEachSquare([&](ChessSquare* square, int x, int y) {
-         s += pieceNotation(x, y ); 
-        }
-    );
-    return s;}
-
-void Chess::setStateString(const std::string &s)
-{
-    _grid->forEachSquare([&](ChessSquare* square, int x, int y) {
-        int index = y * 8 + x;
-        char playerNumber = s[index] - '0';
-        if (playerNumber) {
-            square->setBit(PieceForPlayer(playerNumber - 1, static_cast<ChessPiece>(Pawn)));
-        } else {
-            square->setBit(nullptr);
-        } });
-    syncEngineFromGrid();
-    regenerateLegalMoves();
+    return std::string(_engineState.state, sizeof(_engineState.state));
 }
 
-void Chess::syncEngineFromGrid()
+// The inverse of stateString: the side to move comes from the game and the castling rights from the pieces
+void Chess::setStateString(const std::string &s)
 {
-    std::string state = stateString();
+    if (s.size() < sizeof(_engineState.state))
+        return;
     Player *current = getCurrentPlayer();
     char playerColor = (current && current->playerNumber() == 0) ? WHITE : BLACK;
-    _engineState.init(state.c_str(), playerColor);
+    _engineState.init(s.c_str(), playerColor);
+    syncGridFromEngine();
+    regenerateLegalMoves();
 }
 
 void Chess::regenerateLegalMoves()
 {
-    syncEngineFromGrid();
-    _legalMoves = _engineState.generateAllMoves();
+    _engineState.generateAllMoves(_legalMoves);
 }
 
-int Chess::negamax(GameState& gamestate, int depth, int alpha, int beta)
+void Chess::updateAI()
 {
-    _countMoves++;
-
-    // Terminal node evaluation
-    if (depth == 0) {
-        return hybridEvaluate(gamestate, depth);
-    }
+    TRACE_ZONE("Chess::updateAI");
+    if (!gameHasAI()) return;
 
-    // Generate all legal moves
-    std::vector<BitMove> newMoves = gamestate.generateAllMoves();
-    
-    // Check for terminal conditions (checkmate or stalemate)
-    if (newMoves.empty()) {
-        // Check if king is in check (checkmate) or not (stalemate)
-        // For simplicity, return a very negative value for checkmate, 0 for stalemate
-        // You may want to improve this check
-        return -10000; // Assume checkmate for now
+    // the frame loop calls this every frame while the AI is to move, so it only ever polls
+    if (!aiSearchRunning()) {
+        startAISearch();
+        if (!aiSearchRunning()) {
+            playAISearchResult();   // no legal move, nothing was started
+        }
+    } else if (aiSearchFinished()) {
+        playAISearchResult();
     }
+}
 
-    int bestVal = std::numeric_limits<int>::min();
-
-    // code to generate moves and setup negamax here
-    for(const auto& move : newMoves) {
-        gamestate.pushMove(move);
-
-        bestVal = std::max(bestVal, -negamax(gamestate, depth - 1, -beta, -alpha));
+// The search runs on a copy of the engine taken here, so the board and the engine stay free for the UI
+// thread; only playAISearchResult touches the grid
+void Chess::startAISearch(std::function<void(const BitMove&)> onMoveChosen)
+{
+    abandonAISearch();
+    _lastAIMove = BitMove();  // Reset last AI move
 
-        // Undo the move
-        gamestate.popState();
+    _engineState.generateAllMoves(_legalMoves);
+    if (_legalMoves.empty()) {
+        return;
+    }
 
-        // alpha beta cut-off
-        alpha = std::max(alpha, bestVal);
-        if (alpha >= beta) {
-            break;
+    // the heaviest book move when the AI must replay exactly, else weighted at random
+    if (_book.isOpen()) {
+        static std::mt19937_64 bookRandom(std::random_device{}());
+        const BitMove bookMove = _book.pick(polyglotKey(_engineState), _legalMoves, _randomizeAIMove ? bookRandom() : 0);
+        if (bookMove.piece != NoPiece) {
+            launchBookMove(bookMove, std::move(onMoveChosen));
+            return;
         }
     }
 
-    // code to return bestVal here
-    return bestVal;
+    // without a clock the configured depth is the limit, with one we go as deep as the budget allows
+    SearchLimits limits;
+    limits.maxDepth = getAIMAXDepth();
+    if (limits.maxDepth <= 0) limits.maxDepth = 3; // Default depth
+    if (_moveTimeMs > 0 || _clockMs > 0) limits.maxDepth = MAX_SEARCH_DEPTH;
+    limits.moveTimeMs = _moveTimeMs;
+    limits.timeLeftMs = _clockMs;
+    limits.incrementMs = _incrementMs;
+    limits.movesToGo = _movesToGo;
+
+    _searchRoot = _engineState;
+    launchAISearch(limits, std::move(onMoveChosen), false);
 }
 
-void Chess::updateAI()
+void Chess::launchAISearch(const SearchLimits& searchLimits, std::function<void(const BitMove&)> onMoveChosen, bool pondering)
 {
-    if (!gameHasAI()) return;
+    SearchLimits limits = searchLimits;
+    limits.stopRequest = &_stopRequest;
+    // the line after the best move is read back from the TT, on the search thread where _searchRoot may be read
+    limits.onIteration = [this](const SearchProgress& progress) {
+        std::string pv;
+        for (const BitMove& move : _search.principalVariation(_searchRoot, progress.bestMove, AI_PV_LENGTH)) {
+            pv += (pv.empty() ? "" : " ") + moveToUCI(move);
+        }
+        _progress.update(progress.depth, progress.score, progress.nodes, moveToUCI(progress.bestMove), pv);
+    };
+    _progress.begin();
+
+    _search.setThreads(_gameOptions.AIThreads);
+    _onMoveChosen = std::move(onMoveChosen);
+    _stopRequest.store(false);
+    _searchAbandoned.store(false);
+    _searchDone = false;
+    _pondering.store(pondering);
+    _searchStart = std::chrono::steady_clock::now();
+    _pendingSearch = std::async(std::launch::async, [this, limits]() {
+        TRACE_THREAD("chess search");
+        SearchResult result = _search.search(_searchRoot, limits);
+        _progress.end();
+        _searchMove = chooseAIMove(result);
+        // the TT still holds the line under our move, its best reply is the one to ponder on
+        GameState reply = _searchRoot;
+        reply.pushMove(_searchMove);
+        _ponderMove = _search.hashMove(reply);
+
+        bool deliver;
+        {
+            std::lock_guard<std::mutex> lock(_searchMutex);
+            _searchDone = true;
+            deliver = !_pondering.load();
+        }
+        if (deliver && _onMoveChosen && !_searchAbandoned.load()) {
+            _onMoveChosen(_searchMove);
+        }
+        return result;
+    });
+}
 
-    _lastAIMove = BitMove();  // Reset last AI move
+// a book move comes back through a finished search of its own, so every caller plays it the way it plays a searched one
+void Chess::launchBookMove(const BitMove& move, std::function<void(const BitMove&)> onMoveChosen)
+{
+    _progress.begin();
+    _progress.update(0, 0, 0, moveToUCI(move), moveToUCI(move) + " (book)");
+    _log.log(LogLevel::Info, "Book move " + moveToUCI(move));
+
+    _onMoveChosen = std::move(onMoveChosen);
+    _stopRequest.store(false);
+    _searchAbandoned.store(false);
+    _searchDone = false;
+    _pondering.store(false);
+    _searchStart = std::chrono::steady_clock::now();
+    _pendingSearch = std::async(std::launch::async, [this, move]() {
+        SearchResult result;
+        result.rootMoves.push_back(RootMove{ move, 0 });
+        _progress.end();
+        _searchMove = move;
+        _ponderMove = BitMove();    // nothing was searched to guess the reply from
+        {
+            std::lock_guard<std::mutex> lock(_searchMutex);
+            _searchDone = true;
+        }
+        if (_onMoveChosen && !_searchAbandoned.load()) {
+            _onMoveChosen(_searchMove);
+        }
+        return result;
+    });
+}
 
-    const auto searchStart = std::chrono::steady_clock::now();
-    _countMoves = 0;
+bool Chess::startPondering(std::function<void(const BitMove&)> onMoveChosen)
+{
+    abandonAISearch();
+    if (_ponderMove.piece == NoPiece) {
+        return false;
+    }
+    _engineState.generateAllMoves(_legalMoves);
+    const auto expected = std::find_if(_legalMoves.begin(), _legalMoves.end(), [this](const BitMove& move) {
+        return move.from == _ponderMove.from && move.to == _ponderMove.to && move.flags == _ponderMove.flags;
+    });
+    if (expected == _legalMoves.end()) {
+        return false;
+    }
 
-    syncEngineFromGrid();
-    std::vector<BitMove> moves = _engineState.generateAllMoves();
+    _searchRoot = _engineState;
+    _searchRoot.pushMove(*expected);
+    MoveList replies;
+    _searchRoot.generateAllMoves(replies);
+    if (replies.empty()) {
+        return false;
+    }
+    // no clock and no depth limit, it runs until ponderHit gives it one or the guess turns out wrong
+    SearchLimits limits;
+    limits.maxDepth = MAX_SEARCH_DEPTH;
+    limits.moveTimeMs = 0;
+    launchAISearch(limits, std::move(onMoveChosen), true);
+    return true;
+}
 
-    if (moves.empty()) {
-        endTurn();
-        return;
+bool Chess::ponderHit(const std::string& fen)
+{
+    // without a clock there is nothing to hand the search, a depth limited AI just searches again
+    if (!_pendingSearch.valid() || !_pondering.load() || (_moveTimeMs <= 0 && _clockMs <= 0)) {
+        return false;
+    }
+    // read the FEN the way setBoardFromFEN would, so a bare piece placement compares the same
+    GameState played = _engineState;
+    if (!played.loadFEN(fen) || played.getZobristHash() != _searchRoot.getZobristHash()) {
+        return false;
     }
 
-    // Shuffle moves to add variety and prevent repetitive games
-    // This ensures different move orders are tried, leading to different games
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::shuffle(moves.begin(), moves.end(), gen);
+    _engineState = played;
+    syncGridFromEngine();
+    _engineState.generateAllMoves(_legalMoves);
+    return ponderHit();
+}
 
-    const int negInfinite = std::numeric_limits<int>::min();
-    int bestVal = negInfinite;
-    std::vector<BitMove> bestMoves;  // Store all moves with best evaluation
-    int depth = getAIMAXDepth();
-    if (depth <= 0) depth = 3; // Default depth
+bool Chess::ponderHit()
+{
+    if (!_pendingSearch.valid() || !_pondering.load() || (_moveTimeMs <= 0 && _clockMs <= 0) ||
+        _engineState.getZobristHash() != _searchRoot.getZobristHash()) {
+        return false;
+    }
+    // the budget starts now, the depths searched on the opponent's time come for free
+    if (_clockMs > 0) {
+        _search.setClock(_clockMs, _incrementMs, _movesToGo);
+    } else {
+        _search.setMoveTime(_moveTimeMs);
+    }
+    bool deliver;
+    {
+        std::lock_guard<std::mutex> lock(_searchMutex);
+        _pondering.store(false);
+        deliver = _searchDone;
+    }
+    if (deliver && _onMoveChosen && !_searchAbandoned.load()) {
+        _onMoveChosen(_searchMove);
+    }
+    return true;
+}
 
+// Runs on the search thread: one of the moves the last completed iteration scored within a few
+// centipawns of the best, picked at random so the AI doesn't play the same game every time
+BitMove Chess::chooseAIMove(const SearchResult& result)
+{
     // Threshold for considering moves "equal" (in centipawns)
     // Moves within this threshold will be randomly selected from
     const int EQUALITY_THRESHOLD = 10; // 10 centipawns = 0.1 pawns
 
-    // Try each move and find the best one(s)
-    for (const auto& move : moves) {
-        _engineState.pushMove(move);
-        int moveVal = -negamax(_engineState, depth - 1, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
-        _engineState.popState();
-
-        if (moveVal > bestVal) {
-            bestVal = moveVal;
-            bestMoves.clear();
-            bestMoves.push_back(move);
-        } else if (moveVal >= bestVal - EQUALITY_THRESHOLD && !bestMoves.empty()) {
+    // the search itself is deterministic, the only randomness is this choice made after it; a forced
+    // result is played exactly, a slower mate picked at random could let the win slip
+    if (!_randomizeAIMove || std::abs(result.rootMoves[0].score) >= DECIDED_SCORE) {
+        return result.rootMoves[0].move;
+    }
+
+    std::vector<BitMove> bestMoves;  // Store all moves with best evaluation from the last completed depth
+    if (result.completedDepth > 0) {
+        const int bestVal = result.rootMoves[0].score;
+        for (const auto& rootMove : result.rootMoves) {
             // If this move is within the threshold of the best, add it to candidates
-            bestMoves.push_back(move);
+            if (rootMove.score >= bestVal - EQUALITY_THRESHOLD) {
+                bestMoves.push_back(rootMove.move);
+            }
         }
     }
 
@@ -390,172 +549,58 @@ void Chess::updateAI()
         std::uniform_int_distribution<> dis(0, bestMoves.size() - 1);
         bestMove = bestMoves[dis(gen)];
     } else {
-        // Fallback (shouldn't happen, but safety check)
-        bestMove = moves[0];
-    }
-
-    // Make the best move
-    if(bestVal != negInfinite) {
-        _lastAIMove = bestMove;
-        
-        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - searchStart).count();
-        const double boardsPerSecond = seconds > 0.0 ? static_cast<double>(_countMoves) / seconds : 0.0;
-        std::cout << "Moves checked: " << _countMoves
-                  << " (" << std::fixed << std::setprecision(2) << boardsPerSecond
-                  << " boards/s)" << std::defaultfloat << std::endl;
-
-        int srcSquare = bestMove.from;
-        int dstSquare = bestMove.to;
-        BitHolder& src = getHolderAt(srcSquare & 7, srcSquare / 8);
-        BitHolder& dst = getHolderAt(dstSquare & 7, dstSquare / 8);
-        Bit* bit = src.bit();
-        if (bit && dst.dropBitAtPoint(bit, ImVec2(0, 0))) {
-            src.setBit(nullptr);
-            bitMovedFromTo(*bit, src, dst);
-        }
+        // not even depth 1 finished in time, play the first move rather than nothing
+        bestMove = result.rootMoves[0].move;
     }
-}
 
-// Material piece values (in centipawns)
-namespace {
-    const int PIECE_VALUES[] = {
-        0,      // NoPiece
-        100,    // Pawn
-        320,    // Knight
-        330,    // Bishop
-        500,    // Rook
-        900,    // Queen
-        20000   // King (very high to prioritize king safety)
-    };
+    return bestMove;
 }
 
-int Chess::evaluateMaterial(const GameState& gamestate) const
+bool Chess::aiSearchFinished() const
 {
-    int material = 0;
-    
-    // Count pieces for both sides
-    for (int i = 0; i < 64; ++i) {
-        char piece = gamestate.state[i];
-        if (piece == '0') continue;
-        
-        // Determine piece type and color
-        bool isWhite = (piece >= 'A' && piece <= 'Z');
-        char pieceUpper = isWhite ? piece : (piece - 32); // Convert to uppercase
-        
-        int pieceValue = 0;
-        switch (pieceUpper) {
-            case 'P': pieceValue = PIECE_VALUES[Pawn]; break;
-            case 'N': pieceValue = PIECE_VALUES[Knight]; break;
-            case 'B': pieceValue = PIECE_VALUES[Bishop]; break;
-            case 'R': pieceValue = PIECE_VALUES[Rook]; break;
-            case 'Q': pieceValue = PIECE_VALUES[Queen]; break;
-            case 'K': pieceValue = PIECE_VALUES[King]; break;
-        }
-        
-        // Add for white, subtract for black
-        material += isWhite ? pieceValue : -pieceValue;
-    }
-    
-    // Return from white's perspective (positive = white advantage)
-    return material;
+    return !_pendingSearch.valid() || _pendingSearch.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
 }
 
-uint64_t Chess::computeZobristHash(const GameState& gamestate) const
+void Chess::abandonAISearch()
 {
-    // Simple Zobrist hash based on piece positions and color to move
-    // For a full implementation, you'd use precomputed random numbers
-    // This is a simplified version that still works for material caching
-    
-    uint64_t hash = 0;
-    
-    // Hash piece positions
-    for (int i = 0; i < 64; ++i) {
-        char piece = gamestate.state[i];
-        if (piece != '0') {
-            // Combine square index and piece type into hash
-            hash ^= (static_cast<uint64_t>(piece) << (i % 8)) + (static_cast<uint64_t>(i) << 8);
-        }
-    }
-    
-    // Hash side to move
-    if (gamestate.color == BLACK) {
-        hash ^= 0x123456789ABCDEF0ULL;
-    }
-    
-    return hash;
-}
-
-bool Chess::isCriticalPosition(const GameState& gamestate, const std::vector<BitMove>& moves, int depth) const
-{
-    // Use neural network evaluation at critical positions:
-    
-    // 1. Positions with captures (tactical situations)
-    bool hasCapture = std::any_of(moves.begin(), moves.end(), 
-        [](const BitMove& m) { return m.flags & IsCapture; });
-    if (hasCapture) return true;
-    
-    // 2. Near the root of search tree (top 2 plies) - use NN for important decisions
-    // Note: depth decreases as we go deeper, so depth >= 2 means we're near the root
-    // Actually, we want to use NN at the root level, so we need to track original depth
-    // For now, use NN at all leaf nodes (depth == 0 means we're evaluating)
-    // This will be called from depth 0, so we'll use a different approach
-    
-    // 3. Endgame positions (few pieces remaining) - positional nuances matter more
-    int pieceCount = 0;
-    for (int i = 0; i < 64; ++i) {
-        if (gamestate.state[i] != '0') pieceCount++;
+    if (_pendingSearch.valid()) {
+        _searchAbandoned.store(true);
+        _stopRequest.store(true);
+        _pendingSearch.wait();
+        _pendingSearch = std::future<SearchResult>();
     }
-    if (pieceCount <= 12) return true; // Endgame threshold
-    
-    // 4. Positions with promotions (important tactical moments)
-    bool hasPromotion = std::any_of(moves.begin(), moves.end(), 
-        [](const BitMove& m) { return m.flags & IsPromotion; });
-    if (hasPromotion) return true;
-    
-    return false;
+    _pondering.store(false);
 }
 
-int Chess::hybridEvaluate(GameState& gamestate, int depth)
+bool Chess::playAISearchResult()
 {
-    // Compute Zobrist hash for this position
-    uint64_t hash = computeZobristHash(gamestate);
-    
-    // Check cache first
-    auto it = _materialCache.find(hash);
-    if (it != _materialCache.end()) {
-        // Found in cache, use material evaluation
-        return it->second;
-    }
-    
-    // Generate moves to check if this is a critical position
-    std::vector<BitMove> moves = gamestate.generateAllMoves();
-    bool isCritical = isCriticalPosition(gamestate, moves, depth);
-    
-    int evaluation;
-    
-    if (isCritical) {
-        // Use neural network for critical positions
-        PositionContext context;
-        context.whiteToMove = (gamestate.color == WHITE);
-        evaluation = _evaluate.evaluate(gamestate.state, context);
-    } else {
-        // Use fast material evaluation for non-critical positions
-        evaluation = evaluateMaterial(gamestate);
+    if (!_pendingSearch.valid()) {
+        // no search was started, or the position had no legal move to search
+        if (_legalMoves.empty()) endTurn();
+        return false;
     }
-    
-    // Cache the material evaluation (even if we used NN, cache material for future use)
-    int materialEval = evaluateMaterial(gamestate);
-    _materialCache[hash] = materialEval;
-    
-    // Limit cache size to prevent memory issues
-    if (_materialCache.size() > 100000) {
-        // Clear half the cache (simple FIFO-like behavior)
-        auto it = _materialCache.begin();
-        std::advance(it, _materialCache.size() / 2);
-        _materialCache.erase(_materialCache.begin(), it);
+    SearchResult result = _pendingSearch.get();
+    const BitMove bestMove = _searchMove;
+    _lastAIMove = bestMove;
+    _lastSearchStats = result.stats;
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _searchStart).count();
+    const double boardsPerSecond = seconds > 0.0 ? static_cast<double>(result.nodes) / seconds : 0.0;
+    char stats[128];
+    std::snprintf(stats, sizeof(stats), "Moves checked: %llu on %d thread(s) (%.2f boards/s)",
+                  static_cast<unsigned long long>(result.nodes), _search.threads(), boardsPerSecond);
+    _log.log(LogLevel::Info, stats);
+
+    int srcSquare = bestMove.from;
+    int dstSquare = bestMove.to;
+    BitHolder& src = getHolderAt(srcSquare & 7, srcSquare / 8);
+    BitHolder& dst = getHolderAt(dstSquare & 7, dstSquare / 8);
+    Bit* bit = src.bit();
+    if (bit && dst.dropBitAtPoint(bit, ImVec2(0, 0))) {
+        src.setBit(nullptr);
+        bitMovedFromTo(*bit, src, dst);
     }
-    
-    return evaluation;
+    return true;
 }
 
 // Tournament support: Get current player color (WHITE=1, BLACK=-1)
@@ -567,106 +612,47 @@ int Chess::getCurrentPlayerColor() const
 
 // Tournament support: Set board from FEN and reinitialize game state for AI
 void Chess::setBoardFromFEN(const std::string& fen) {
-    // Parse FEN string - can be full FEN or just piece placement
-    std::string piecePlacement = fen;
-    std::string activeColor = "w";
-    std::string castling = "KQkq";
-    std::string enPassant = "-";
-
-    // Check if this is a full FEN string (has spaces)
-    size_t spacePos = fen.find(' ');
-    if (spacePos != std::string::npos) {
-        // Parse full FEN
-        std::istringstream fenStream(fen);
-        fenStream >> piecePlacement >> activeColor >> castling >> enPassant;
+    TRACE_ZONE("Chess::setBoardFromFEN");
+    abandonAISearch();
+    // full FEN or just the piece placement, the engine keeps castling, en passant and the clocks
+    if (!_engineState.loadFEN(fen)) {
+        _log.log(LogLevel::Error, "[Tournament] Invalid FEN: " + fen);
+        return;
     }
+    const char playerColor = _engineState.color;
 
-    // Set visual board from piece placement
-    FENtoBoard(piecePlacement);
-
-    // Determine current player from FEN
-    char playerColor = (activeColor == "w" || activeColor == "W") ? WHITE : BLACK;
-
-    // Reinitialize game state so AI sees correct board
-    syncEngineFromGrid();
-    _engineState.init(stateString().c_str(), playerColor);
-
-    // TODO: Parse castling rights and en passant from FEN for more accurate state
-    // For now, the basic state is sufficient for AI to calculate moves
+    // the board only shows the position, the engine already holds all of it
+    syncGridFromEngine();
 
     // Generate legal moves for the new position
-    regenerateLegalMoves();
+    _engineState.generateAllMoves(_legalMoves);
 
-    std::cout << "[Tournament] Board set from FEN. Player: "
-              << (playerColor == WHITE ? "White" : "Black")
-              << ", Legal moves: " << _legalMoves.size() << std::endl;
+    char status[96];
+    std::snprintf(status, sizeof(status), "[Tournament] Board set from FEN. Player: %s, Legal moves: %d",
+                  playerColor == WHITE ? "White" : "Black", static_cast<int>(_legalMoves.size()));
+    _log.log(LogLevel::Info, status);
 }
 
-// Tournament support: Generate FEN string from current board
-std::string Chess::getFEN() const {
-    std::string fen;
-    fen.reserve(90);
-
-    // Piece placement (from rank 8 to rank 1)
-    for (int rank = 7; rank >= 0; --rank) {
-        int emptyCount = 0;
-        for (int file = 0; file < 8; ++file) {
-            char piece = pieceNotation(file, rank);
-            if (piece == '0') {
-                emptyCount++;
-            } else {
-                if (emptyCount > 0) {
-                    fen += std::to_string(emptyCount);
-                    emptyCount = 0;
-                }
-                fen += piece;
-            }
-        }
-        if (emptyCount > 0) {
-            fen += std::to_string(emptyCount);
+bool Chess::playEngineMove(int from, int to, int promotion)
+{
+    _engineState.generateAllMoves(_legalMoves);
+    for (const BitMove& move : _legalMoves) {
+        if (move.from != from || move.to != to) {
+            continue;
         }
-        if (rank > 0) {
-            fen += '/';
+        // the queen is listed first, so without a piece the first promotion found is the queen
+        if (promotion >= 0 && (move.flags & IsPromotion) && ((move.flags & PromotionPieceMask) >> 5) != promotion) {
+            continue;
         }
+        _engineState.pushMove(move);
+        syncGridFromEngine();
+        regenerateLegalMoves();
+        return true;
     }
+    return false;
+}
 
-    // Active color
-    fen += ' ';
-    char currentColor = _engineState.color;
-    fen += (currentColor == WHITE) ? 'w' : 'b';
-
-    // Castling availability (simplified - always report based on piece positions)
-    fen += ' ';
-    std::string castling;
-
-    // Check if white can castle (king on e1, rooks on a1/h1)
-    char e1 = pieceNotation(4, 0);
-    char a1 = pieceNotation(0, 0);
-    char h1 = pieceNotation(7, 0);
-    if (e1 == 'K') {
-        if (h1 == 'R') castling += 'K';
-        if (a1 == 'R') castling += 'Q';
-    }
-
-    // Check if black can castle (king on e8, rooks on a8/h8)
-    char e8 = pieceNotation(4, 7);
-    char a8 = pieceNotation(0, 7);
-    char h8 = pieceNotation(7, 7);
-    if (e8 == 'k') {
-        if (h8 == 'r') castling += 'k';
-        if (a8 == 'r') castling += 'q';
-    }
-
-    fen += castling.empty() ? "-" : castling;
-
-    // En passant target square (simplified - report as '-')
-    fen += " -";
-
-    // Halfmove clock (simplified)
-    fen += " 0";
-
-    // Fullmove number (simplified)
-    fen += " 1";
-
-    return fen;
+// Tournament support: Generate FEN string from current board
+std::string Chess::getFEN() const {
+    return _engineState.toFEN();
 }
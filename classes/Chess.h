@@ -5,9 +5,16 @@
 #include "GameState.h"
 #include "Bitboard.h"
 #include "ChessEval.h"
+#include "ChessSearch.h"
+#include "OpeningBook.h"
 #include <vector>
 #include <unordered_map>
 #include <cstdint>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
 
 constexpr int pieceSize = 80;
 
@@ -22,6 +29,7 @@ public:
     bool canBitMoveFrom(Bit &bit, BitHolder &src) override;
     bool canBitMoveFromTo(Bit &bit, BitHolder &src, BitHolder &dst) override;
     bool actionForEmptyHolder(BitHolder &holder) override;
+    void bitMovedFromTo(Bit &bit, BitHolder &src, BitHolder &dst) override;
 
     void stopGame() override;
 
@@ -33,7 +41,32 @@ public:
     void setStateString(const std::string &s) override;
 
     bool gameHasAI() override { return true; }
+    // one frame of the AI: starts a search, and plays its move on the frame it has finished
     void updateAI() override;
+    AIProgress aiProgress() const override { return _progress.snapshot(); }
+    void stopAI() override { stopAISearch(); }
+
+    // Background search: starts on a copy of the position and leaves the board alone until
+    // playAISearchResult, which waits for the search if it hasn't finished and plays the move it chose.
+    // onMoveChosen is called on the search thread as soon as the move is known, unless the search was
+    // abandoned. stopAISearch asks the search to end early with the best move it has so far, and never blocks.
+    void startAISearch(std::function<void(const BitMove&)> onMoveChosen = nullptr);
+    bool aiSearchRunning() const { return _pendingSearch.valid(); }
+    bool aiSearchFinished() const;
+    void stopAISearch() { _stopRequest.store(true); }
+    bool playAISearchResult();
+    // stops and waits for the search, throwing its result away
+    void abandonAISearch();
+
+    // Pondering: after the AI has moved, search the position after the reply it expects with no clock.
+    // onMoveChosen is held back until ponderHit confirms the opponent played that reply, and the search
+    // then gets the clock or move time budget from that moment on, keeping everything it has already searched.
+    // Any other position is a miss, and setBoardFromFEN or startAISearch abandon the ponder search.
+    bool startPondering(std::function<void(const BitMove&)> onMoveChosen);
+    bool ponderHit(const std::string& fen);
+    // the same for a board that is already up to date, after playEngineMove
+    bool ponderHit();
+    bool isPondering() const { return _pondering.load(); }
 
     Grid* getGrid() override { return _grid; }
 
@@ -41,35 +74,74 @@ public:
     void setBoardFromFEN(const std::string& fen);
     BitMove getLastAIMove() const { return _lastAIMove; }
     std::string getFEN() const;
+    // plays a move straight on the engine and redraws the board, for moves arriving over the network.
+    // promotion is the BitMove promotion piece index, -1 for a queen or none. A ponder search is left
+    // running so ponderHit can still pick it up. False if the move isn't legal here
+    bool playEngineMove(int from, int to, int promotion = -1);
+    uint64_t positionHash() const { return _engineState.getZobristHash(); }
+    const GameState& position() const { return _engineState; }
 
     // Get current player color (WHITE=1, BLACK=-1)
     int getCurrentPlayerColor() const;
 
+    // counters of the last search played, all threads summed
+    const SearchStats& lastSearchStats() const { return _lastSearchStats; }
+
+    // pick at random among the moves scored within a few centipawns of the best, on by default; off the
+    // AI always plays the top ranked move, so a game replays exactly
+    void setRandomizeAIMove(bool randomize) { _randomizeAIMove = randomize; }
+
+    // wall clock budget for the next updateAI, 0 searches to getAIMAXDepth() instead
+    void setMoveTimeBudget(int milliseconds) { _moveTimeMs = milliseconds; }
+    // the AI's remaining clock for the next updateAI, shared out by the search's time manager in place
+    // of the move time budget; 0 goes back to the budget
+    void setClock(int timeLeftMs, int incrementMs, int movesToGo = 0) {
+        _clockMs = timeLeftMs;
+        _incrementMs = incrementMs;
+        _movesToGo = movesToGo;
+    }
+
+    // while the position is in the book the AI plays a book move without searching; resources/books/book.bin
+    // is opened by default when it exists. False if the file isn't a book
+    bool loadOpeningBook(const std::string& path) { return _book.open(path); }
+
     // you can make this variable private, it's just grouped with the public methods for convenience
     BitMove _lastAIMove;  // Stores the last move calculated by AI (for tournament)
 
 private:
     Bit* PieceForPlayer(const int playerNumber, ChessPiece piece);
     Player* ownerAt(int x, int y) const;
-    void FENtoBoard(const std::string& fen);
-    char pieceNotation(int x, int y) const;
     bool placePieceFromFEN(char fenChar, int x, int y);
-    void syncEngineFromGrid();
+    void syncGridFromEngine();
     void regenerateLegalMoves();
-    int negamax(GameState& gamestate, int depth, int alpha, int beta);
-    
-    // Evaluation functions
-    int evaluateMaterial(const GameState& gamestate) const;
-    uint64_t computeZobristHash(const GameState& gamestate) const;
-    bool isCriticalPosition(const GameState& gamestate, const std::vector<BitMove>& moves, int depth) const;
-    int hybridEvaluate(GameState& gamestate, int depth);
+    void applySpecialMoveToGrid(const BitMove& move);
+    BitMove chooseAIMove(const SearchResult& result);
+    void launchAISearch(const SearchLimits& limits, std::function<void(const BitMove&)> onMoveChosen, bool pondering);
+    void launchBookMove(const BitMove& move, std::function<void(const BitMove&)> onMoveChosen);
 
     Grid* _grid;
     GameState _engineState;
-    std::vector<BitMove> _legalMoves;
-    int _countMoves;
-    ChessEval _evaluate;  // Neural network evaluator (loaded with trained model)
-    
-    // Transposition table for material evaluations (Zobrist hash -> material score)
-    mutable std::unordered_map<uint64_t, int> _materialCache;
+    GameState _searchRoot;  // the position a background search was started from, only the search reads it
+    std::future<SearchResult> _pendingSearch;
+    std::atomic<bool> _stopRequest;
+    std::atomic<bool> _searchAbandoned;
+    BitMove _searchMove;    // written by the search thread, read once its future is ready
+    BitMove _ponderMove;    // the reply the last search expects, from the TT after its move
+    std::function<void(const BitMove&)> _onMoveChosen;
+    std::mutex _searchMutex;  // orders a finished ponder search against the ponder hit that releases it
+    bool _searchDone;
+    std::atomic<bool> _pondering;
+    std::chrono::steady_clock::time_point _searchStart;
+    AIProgressReport _progress;   // filled in by the search thread after each iteration
+    SearchStats _lastSearchStats;
+    MoveList _legalMoves;
+    int _moveTimeMs;
+    int _clockMs;
+    int _incrementMs;
+    int _movesToGo;
+    bool _randomizeAIMove;
+    std::shared_ptr<const ChessEval> _evaluate;  // Neural network evaluator, one trained model shared by every game
+    OpeningBook _book;
+    ChessSearch _search;  // threads, TT and search tables, sized by GameOptions::AIThreads and TTSizeMB
+    LogRing _log;         // game thread messages, printed by the log sink so the move path never waits on the console
 };
\ No newline at end of file
@@ -6,21 +6,38 @@
 #include <cmath>
 #include <sstream>
 #include <iomanip>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "Trace.h"
 
 // Initialize neural network with random weights and set up board state
-ChessEval::ChessEval() : castleStatus(0),
+ChessEval::ChessEval() : ChessEval(std::random_device{}())
+{
+}
+
+ChessEval::ChessEval(uint32_t seed) : kernels(nnKernels()),
+                         adamSteps(0),
+                         batchesTrained(0),
+                         castleStatus(0),
                          currentTurnNo(0),
-                         rng(std::random_device{}()),
-                         weight_dist(0.0f, 0.1f)
+                         rng(seed),
+                         weight_dist(0.0f, 0.1f),
+                         modelLoaded(false)
 {
+    static_assert(HIDDEN1_SIZE % NN_KERNEL_WIDTH == 0 && HIDDEN2_SIZE % NN_KERNEL_WIDTH == 0,
+                  "layer widths must suit the SIMD kernels");
 
     // Allocate memory for weights and biases
-    weights1 = std::vector<std::vector<float>>(HIDDEN1_SIZE, std::vector<float>(INPUT_SIZE));
-    bias1 = std::vector<float>(HIDDEN1_SIZE);
-    weights2 = std::vector<std::vector<float>>(HIDDEN2_SIZE, std::vector<float>(HIDDEN1_SIZE));
-    bias2 = std::vector<float>(HIDDEN2_SIZE);
-    weights3 = std::vector<std::vector<float>>(OUTPUT_SIZE, std::vector<float>(HIDDEN2_SIZE));
-    bias3 = std::vector<float>(OUTPUT_SIZE);
+    weights1 = AlignedFloats(static_cast<size_t>(INPUT_SIZE) * HIDDEN1_SIZE);
+    bias1 = AlignedFloats(HIDDEN1_SIZE);
+    weights2 = AlignedFloats(static_cast<size_t>(HIDDEN2_SIZE) * HIDDEN1_SIZE);
+    bias2 = AlignedFloats(HIDDEN2_SIZE);
+    weights3 = AlignedFloats(static_cast<size_t>(OUTPUT_SIZE) * HIDDEN2_SIZE);
+    bias3 = AlignedFloats(OUTPUT_SIZE);
 
     // Initialize weights and biases with random values
     initializeWeights(weights1, bias1);
@@ -29,113 +46,107 @@ ChessEval::ChessEval() : castleStatus(0),
 }
 
 // Initialize weights and biases using Xavier initialization
-void ChessEval::initializeWeights(std::vector<std::vector<float>> &weights, std::vector<float> &bias)
-{
-    for (auto &row : weights)
-    {
-        for (float &w : row)
-            w = weight_dist(rng);
-    }
-    for (float &b : bias)
-        b = weight_dist(rng);
-}
-
-// ReLU activation function: max(0, x)
-float ChessEval::relu(float x) const
+void ChessEval::initializeWeights(AlignedFloats &weights, AlignedFloats &bias)
 {
-    return std::max(0.0f, x);
+    for (size_t i = 0; i < weights.size(); ++i)
+        weights[i] = weight_dist(rng);
+    for (size_t i = 0; i < bias.size(); ++i)
+        bias[i] = weight_dist(rng);
 }
 
-// Compute dot product of two vectors
-float ChessEval::dotProduct(const std::vector<float> &a, const std::vector<float> &b) const
-{
-    float sum = 0.0f;
-    for (size_t i = 0; i < a.size(); ++i)
+namespace {
+    // Maps ASCII character to piece index (0-11), 0 for unknown characters
+    // built by a static initializer so concurrent search threads can't race on it
+    const std::array<int, 256> pieceLookup = []() {
+        std::array<int, 256> lookup{};
+        lookup['P'] = 0;
+        lookup['R'] = 1;
+        lookup['N'] = 2;
+        lookup['B'] = 3;
+        lookup['Q'] = 4;
+        lookup['K'] = 5;
+        lookup['p'] = 6;
+        lookup['r'] = 7;
+        lookup['n'] = 8;
+        lookup['b'] = 9;
+        lookup['q'] = 10;
+        lookup['k'] = 11;
+        return lookup;
+    }();
+
+    int pieceIndex(char piece)
     {
-        sum += a[i] * b[i];
+        return pieceLookup[static_cast<unsigned char>(piece)];
     }
-    return sum;
 }
 
 // Perform forward pass through the neural network and store activations
-LayerActivations ChessEval::forwardWithActivations(const std::vector<float> &input) const
+LayerActivations ChessEval::forwardWithActivations(const ActiveFeatures &input) const
 {
     LayerActivations activations;
     activations.input = input;
 
-    // First hidden layer
-    activations.hidden1.resize(HIDDEN1_SIZE);
-    for (size_t i = 0; i < HIDDEN1_SIZE; ++i)
+    // First hidden layer: the inputs are 0 or 1, so it is the bias plus a gather-sum of the active weight columns
+    alignas(NN_ALIGNMENT) float hidden1Raw[HIDDEN1_SIZE];
+    std::copy(bias1.data(), bias1.data() + HIDDEN1_SIZE, hidden1Raw);
+    for (int i = 0; i < input.count; ++i)
     {
-        activations.hidden1[i] = relu(dotProduct(weights1[i], input) + bias1[i]);
+        kernels.add(hidden1Raw, weights1.data() + static_cast<size_t>(input.index[i]) * HIDDEN1_SIZE, HIDDEN1_SIZE);
     }
+    activations.hidden1.resize(HIDDEN1_SIZE);
+    kernels.relu(hidden1Raw, activations.hidden1.data(), HIDDEN1_SIZE);
 
     // Second hidden layer
     activations.hidden2.resize(HIDDEN2_SIZE);
-    for (size_t i = 0; i < HIDDEN2_SIZE; ++i)
-    {
-        activations.hidden2[i] = relu(dotProduct(weights2[i], activations.hidden1) + bias2[i]);
-    }
+    kernels.denseRelu(weights2.data(), bias2.data(), activations.hidden1.data(), activations.hidden2.data(), HIDDEN2_SIZE, HIDDEN1_SIZE);
 
     // Output layer with tanh activation scaled to reasonable centipawn range
-    float raw_output = dotProduct(weights3[0], activations.hidden2) + bias3[0];
+    float raw_output = kernels.dot(weights3.data(), activations.hidden2.data(), HIDDEN2_SIZE) + bias3[0];
     activations.output = 2000.0f * std::tanh(raw_output); // Scale to ±2000 centipawns
     return activations;
 }
 
+// Second hidden layer and output from the first layer's pre-activations, as kept in an NNAccumulator
+float ChessEval::forwardFromHidden1(const float *hidden1Raw) const
+{
+    alignas(NN_ALIGNMENT) float hidden1[HIDDEN1_SIZE];
+    kernels.relu(hidden1Raw, hidden1, HIDDEN1_SIZE);
+
+    alignas(NN_ALIGNMENT) float hidden2[HIDDEN2_SIZE];
+    kernels.denseRelu(weights2.data(), bias2.data(), hidden1, hidden2, HIDDEN2_SIZE, HIDDEN1_SIZE);
+
+    float raw_output = kernels.dot(weights3.data(), hidden2, HIDDEN2_SIZE) + bias3[0];
+    return 2000.0f * std::tanh(raw_output);
+}
+
 // Forward pass wrapper that returns only the final output
-float ChessEval::forward(const std::vector<float> &input) const
+float ChessEval::forward(const ActiveFeatures &input) const
 {
     return forwardWithActivations(input).output;
 }
 
-// Convert board state to one-hot encoded input vector plus contextual features
-std::vector<float> ChessEval::encodePosition(const char *state, const PositionContext &context) const
+// Convert board state to the indices of its one-hot inputs plus contextual features
+ActiveFeatures ChessEval::encodePosition(const char *state, const PositionContext &context)
 {
-    // Static lookup table: maps ASCII character to piece index (0-11)
-    static bool initTable = false;
-    static int pieceLookup[256];
-
-    if (!initTable)
-    {
-        initTable = true;
-        pieceLookup['P'] = 0;
-        pieceLookup['R'] = 1;
-        pieceLookup['N'] = 2;
-        pieceLookup['B'] = 3;
-        pieceLookup['Q'] = 4;
-        pieceLookup['K'] = 5;
-        pieceLookup['p'] = 6;
-        pieceLookup['r'] = 7;
-        pieceLookup['n'] = 8;
-        pieceLookup['b'] = 9;
-        pieceLookup['q'] = 10;
-        pieceLookup['k'] = 11;
-    }
-
-    std::vector<float> encoded(INPUT_SIZE, 0.0f);
+    ActiveFeatures features;
 
     // Single pass through the board: O(64) instead of O(64 * 12)
     for (int i = 0; i < BOARD_SIZE; ++i)
     {
-        char piece = state[i];
-        if (piece != '0')
+        const int feature = featureIndex(state[i], i);
+        if (feature >= 0)
         {
-            int piece_idx = pieceLookup[static_cast<unsigned char>(piece)];
-            // piece_idx will be 0 for unknown characters, but that's fine
-            // since 'P' legitimately maps to 0
-            encoded[i + piece_idx * BOARD_SIZE] = 1.0f;
+            features.add(feature);
         }
     }
 
-    size_t base = BOARD_SIZE * PIECE_TYPES;
-    encoded[base + 0] = context.whiteToMove ? 1.0f : 0.0f;
-    encoded[base + 1] = context.whiteCastleKingside ? 1.0f : 0.0f;
-    encoded[base + 2] = context.whiteCastleQueenside ? 1.0f : 0.0f;
-    encoded[base + 3] = context.blackCastleKingside ? 1.0f : 0.0f;
-    encoded[base + 4] = context.blackCastleQueenside ? 1.0f : 0.0f;
+    if (context.whiteToMove) features.add(FeatureWhiteToMove);
+    if (context.whiteCastleKingside) features.add(FeatureWhiteCastleKingside);
+    if (context.whiteCastleQueenside) features.add(FeatureWhiteCastleQueenside);
+    if (context.blackCastleKingside) features.add(FeatureBlackCastleKingside);
+    if (context.blackCastleQueenside) features.add(FeatureBlackCastleQueenside);
 
-    return encoded;
+    return features;
 }
 
 /** convert FEN string to board state
@@ -177,22 +188,87 @@ void ChessEval::FENtoState(const std::string &fen, char *state)
 }
 
 // Evaluate a chess position using the neural network
-int ChessEval::evaluate(const char *state, const PositionContext &context)
+int ChessEval::evaluate(const char *state, const PositionContext &context) const
 {
-    std::vector<float> input = encodePosition(state, context);
-    float output = forward(input);
+    TRACE_ZONE("ChessEval::evaluate");
+    float output = forward(encodePosition(state, context));
     return -static_cast<int>(output);
 }
 
-// Clip gradient to prevent explosion
-float ChessEval::clipGradient(float gradient) const
+// Evaluate from an accumulator, same sign convention as evaluate(state, context)
+int ChessEval::evaluate(const NNAccumulator &accumulator) const
+{
+    TRACE_ZONE("ChessEval::evaluate");
+    return -static_cast<int>(forwardFromHidden1(accumulator.hidden1));
+}
+
+// One tile at a time: the sparse first layer per position, then the dense layers as batch x layer products
+void ChessEval::evaluateBatch(const char *const *states, const PositionContext *contexts, int n, int *out) const
 {
-    float abs_grad = std::abs(gradient);
-    if (abs_grad > CLIP_THRESHOLD)
+    TRACE_ZONE("ChessEval::evaluateBatch");
+    alignas(NN_ALIGNMENT) float hidden1[BATCH_TILE * HIDDEN1_SIZE];
+    alignas(NN_ALIGNMENT) float hidden2[BATCH_TILE * HIDDEN2_SIZE];
+    const PositionContext defaultContext;
+
+    for (int start = 0; start < n; start += BATCH_TILE)
     {
-        return (gradient * CLIP_THRESHOLD) / abs_grad;
+        const int count = std::min(BATCH_TILE, n - start);
+        for (int b = 0; b < count; ++b)
+        {
+            const ActiveFeatures features = encodePosition(states[start + b], contexts ? contexts[start + b] : defaultContext);
+            float *row = hidden1 + b * HIDDEN1_SIZE;
+            std::copy(bias1.data(), bias1.data() + HIDDEN1_SIZE, row);
+            for (int i = 0; i < features.count; ++i)
+            {
+                kernels.add(row, weights1.data() + static_cast<size_t>(features.index[i]) * HIDDEN1_SIZE, HIDDEN1_SIZE);
+            }
+            kernels.relu(row, row, HIDDEN1_SIZE);
+        }
+
+        kernels.denseReluBatch(weights2.data(), bias2.data(), hidden1, hidden2, HIDDEN2_SIZE, HIDDEN1_SIZE, count);
+
+        for (int b = 0; b < count; ++b)
+        {
+            const float raw_output = kernels.dot(weights3.data(), hidden2 + b * HIDDEN2_SIZE, HIDDEN2_SIZE) + bias3[0];
+            out[start + b] = -static_cast<int>(2000.0f * std::tanh(raw_output));
+        }
+    }
+}
+
+int ChessEval::featureIndex(char piece, int square)
+{
+    if (piece == '0')
+    {
+        return -1;
+    }
+    return square + pieceIndex(piece) * BOARD_SIZE;
+}
+
+// Full first layer for one position: bias plus the weight column of every active input
+void ChessEval::refresh(NNAccumulator &accumulator, const char *state, const PositionContext &context) const
+{
+    const ActiveFeatures features = encodePosition(state, context);
+    std::copy(bias1.data(), bias1.data() + HIDDEN1_SIZE, accumulator.hidden1);
+    for (int i = 0; i < features.count; ++i)
+    {
+        addFeature(accumulator, features.index[i]);
     }
-    return gradient;
+}
+
+void ChessEval::addFeature(NNAccumulator &accumulator, int feature) const
+{
+    kernels.add(accumulator.hidden1, weights1.data() + static_cast<size_t>(feature) * HIDDEN1_SIZE, HIDDEN1_SIZE);
+}
+
+void ChessEval::removeFeature(NNAccumulator &accumulator, int feature) const
+{
+    kernels.sub(accumulator.hidden1, weights1.data() + static_cast<size_t>(feature) * HIDDEN1_SIZE, HIDDEN1_SIZE);
+}
+
+// Clip gradient to prevent explosion, written as a clamp so the per-weight loops vectorize
+float ChessEval::clipGradient(float gradient) const
+{
+    return std::max(-CLIP_THRESHOLD, std::min(CLIP_THRESHOLD, gradient));
 }
 
 // Get formatted training status report
@@ -262,76 +338,198 @@ void ChessEval::backpropagate(const LayerActivations &activations,
     // For a simple MLP in this context, a small constant rate is often better.
     float effective_learning_rate = learning_rate;
 
+    sampleGradients.allocate();
+    sampleGradients.clear();
+    accumulateGradients(activations, target, sampleGradients);
+    applySGD(sampleGradients, effective_learning_rate);
+}
+
+void ChessEval::Gradients::allocate()
+{
+    if (weights1.size() > 0)
+        return;
+    weights1.resize(static_cast<size_t>(INPUT_SIZE) * HIDDEN1_SIZE);
+    bias1.resize(HIDDEN1_SIZE);
+    weights2.resize(static_cast<size_t>(HIDDEN2_SIZE) * HIDDEN1_SIZE);
+    bias2.resize(HIDDEN2_SIZE);
+    weights3.resize(static_cast<size_t>(OUTPUT_SIZE) * HIDDEN2_SIZE);
+    bias3.resize(OUTPUT_SIZE);
+    isTouched.assign(INPUT_SIZE, 0);
+    touched.reserve(INPUT_SIZE);
+}
+
+// zeroes only the weights1 columns that were used, a batch touches a small part of the 773 inputs
+void ChessEval::Gradients::clear()
+{
+    for (int input : touched)
+    {
+        std::fill_n(weights1.data() + static_cast<size_t>(input) * HIDDEN1_SIZE, HIDDEN1_SIZE, 0.0f);
+        isTouched[input] = 0;
+    }
+    touched.clear();
+    std::fill_n(bias1.data(), bias1.size(), 0.0f);
+    std::fill_n(weights2.data(), weights2.size(), 0.0f);
+    std::fill_n(bias2.data(), bias2.size(), 0.0f);
+    std::fill_n(weights3.data(), weights3.size(), 0.0f);
+    std::fill_n(bias3.data(), bias3.size(), 0.0f);
+    samples = 0;
+    squaredError = 0.0;
+    absoluteError = 0.0;
+}
+
+void ChessEval::Gradients::add(const Gradients &other)
+{
+    const NNKernels &kernels = nnKernels();
+    for (int input : other.touched)
+    {
+        float *column = weights1.data() + static_cast<size_t>(input) * HIDDEN1_SIZE;
+        if (!isTouched[input])
+        {
+            isTouched[input] = 1;
+            touched.push_back(input);
+        }
+        kernels.add(column, other.weights1.data() + static_cast<size_t>(input) * HIDDEN1_SIZE, HIDDEN1_SIZE);
+    }
+    kernels.add(bias1.data(), other.bias1.data(), HIDDEN1_SIZE);
+    kernels.add(weights2.data(), other.weights2.data(), static_cast<int>(weights2.size()));
+    kernels.add(bias2.data(), other.bias2.data(), HIDDEN2_SIZE);
+    kernels.add(weights3.data(), other.weights3.data(), HIDDEN2_SIZE);
+    bias3[0] += other.bias3[0];
+    samples += other.samples;
+    squaredError += other.squaredError;
+    absoluteError += other.absoluteError;
+}
+
+// Adds one position's gradients to the sums. They point downhill already (error is target - output),
+// so applying them is always weight += rate * gradient.
+void ChessEval::accumulateGradients(const LayerActivations &activations, float target, Gradients &gradients) const
+{
+    float output = activations.output;
+    float error = (target - output) * LOSS_SCALE;
+
+    gradients.samples++;
+    gradients.squaredError += static_cast<double>(target - output) * (target - output);
+    gradients.absoluteError += std::abs(target - output);
+
     // FIX 2: ADD TANH DERIVATIVE
     // Your output is 2000 * tanh(x). The derivative of tanh(x) is (1 - tanh(x)^2).
     // Without this, the gradients are treated as linear, which makes learning
     // extreme values (like +/- 900 for a Queen) very slow.
     float norm_output = output / 2000.0f; // Map back to -1..1 range
     float tanh_derivative = 2000.0f * (1.0f - (norm_output * norm_output));
+    float output_gradient = error * tanh_derivative;
 
     // Output layer gradients with clipping
-    std::vector<float> d_weights3(HIDDEN2_SIZE);
-
-    // Apply derivative to the error signal
-    float d_bias3 = clipGradient(error * tanh_derivative);
-
+    gradients.bias3[0] += clipGradient(output_gradient);
     for (int i = 0; i < HIDDEN2_SIZE; ++i)
     {
-        // Apply derivative here too
-        d_weights3[i] = clipGradient(error * tanh_derivative * activations.hidden2[i]);
+        gradients.weights3[i] += clipGradient(output_gradient * activations.hidden2[i]);
     }
 
     // Hidden2 layer gradients
-    std::vector<float> d_hidden2(HIDDEN2_SIZE);
+    alignas(NN_ALIGNMENT) float d_hidden2[HIDDEN2_SIZE];
     for (int i = 0; i < HIDDEN2_SIZE; ++i)
     {
-        // Propagate the error * derivative back
-        float grad = (error * tanh_derivative) * weights3[0][i];
-        grad = clipGradient(grad);
+        float grad = clipGradient(output_gradient * weights3[i]);
         d_hidden2[i] = activations.hidden2[i] > 0 ? grad : 0; // ReLU derivative
     }
 
-    // Hidden1 layer gradients
-    std::vector<float> d_hidden1(HIDDEN1_SIZE);
+    // Hidden1 layer gradients, summed as rows of weights2 so the inner loop runs over contiguous memory
+    alignas(NN_ALIGNMENT) float d_hidden1[HIDDEN1_SIZE] = {};
+    for (int j = 0; j < HIDDEN2_SIZE; ++j)
+    {
+        if (d_hidden2[j] != 0.0f)
+            kernels.addScaled(d_hidden1, weights2.data() + static_cast<size_t>(j) * HIDDEN1_SIZE, d_hidden2[j], HIDDEN1_SIZE);
+    }
     for (int i = 0; i < HIDDEN1_SIZE; ++i)
     {
-        float sum = 0;
-        for (int j = 0; j < HIDDEN2_SIZE; ++j)
-        {
-            sum += d_hidden2[j] * weights2[j][i];
-        }
-        sum = clipGradient(sum);
-        d_hidden1[i] = activations.hidden1[i] > 0 ? sum : 0; // ReLU derivative
+        d_hidden1[i] = activations.hidden1[i] > 0 ? clipGradient(d_hidden1[i]) : 0; // ReLU derivative
     }
 
-    // Update weights and biases using gradient descent
+    // hidden1 copied to the stack so the compiler can see it doesn't overlap the gradient rows and vectorize
+    alignas(NN_ALIGNMENT) float hidden1[HIDDEN1_SIZE];
+    std::copy(activations.hidden1.begin(), activations.hidden1.end(), hidden1);
     for (int i = 0; i < HIDDEN2_SIZE; ++i)
     {
-        weights3[0][i] += effective_learning_rate * d_weights3[i];
+        if (d_hidden2[i] == 0.0f)
+            continue;
+        float *row = gradients.weights2.data() + static_cast<size_t>(i) * HIDDEN1_SIZE;
+        for (int j = 0; j < HIDDEN1_SIZE; ++j)
+        {
+            row[j] += clipGradient(d_hidden2[i] * hidden1[j]);
+        }
+        gradients.bias2[i] += d_hidden2[i];
     }
-    bias3[0] += effective_learning_rate * d_bias3;
 
-    for (int i = 0; i < HIDDEN2_SIZE; ++i)
+    // an inactive input has a zero gradient, so only the active weight columns change, each by the
+    // same clipped hidden1 gradient (the input value is 1)
+    for (int j = 0; j < activations.input.count; ++j)
     {
-        for (int j = 0; j < HIDDEN1_SIZE; ++j)
+        const int input = activations.input.index[j];
+        if (!gradients.isTouched[input])
         {
-            float update = clipGradient(d_hidden2[i] * activations.hidden1[j]);
-            weights2[i][j] += effective_learning_rate * update;
+            gradients.isTouched[input] = 1;
+            gradients.touched.push_back(input);
         }
-        bias2[i] += effective_learning_rate * d_hidden2[i];
+        kernels.add(gradients.weights1.data() + static_cast<size_t>(input) * HIDDEN1_SIZE, d_hidden1, HIDDEN1_SIZE);
     }
+    kernels.add(gradients.bias1.data(), d_hidden1, HIDDEN1_SIZE);
+}
 
-    for (int i = 0; i < HIDDEN1_SIZE; ++i)
+// Plain gradient step on the averaged gradients
+void ChessEval::applySGD(const Gradients &gradients, float learning_rate)
+{
+    const float step = learning_rate / std::max(1, gradients.samples);
+    for (int input : gradients.touched)
+    {
+        const size_t offset = static_cast<size_t>(input) * HIDDEN1_SIZE;
+        kernels.addScaled(weights1.data() + offset, gradients.weights1.data() + offset, step, HIDDEN1_SIZE);
+    }
+    kernels.addScaled(bias1.data(), gradients.bias1.data(), step, HIDDEN1_SIZE);
+    kernels.addScaled(weights2.data(), gradients.weights2.data(), step, static_cast<int>(weights2.size()));
+    kernels.addScaled(bias2.data(), gradients.bias2.data(), step, HIDDEN2_SIZE);
+    kernels.addScaled(weights3.data(), gradients.weights3.data(), step, HIDDEN2_SIZE);
+    bias3[0] += step * gradients.bias3[0];
+}
+
+namespace {
+    void adamUpdate(AlignedFloats &parameters, const AlignedFloats &gradients, AlignedFloats &m, AlignedFloats &v,
+                    float scale, const TrainingOptions &options, float stepSize, float secondCorrection)
     {
-        for (int j = 0; j < INPUT_SIZE; ++j)
+        const float beta1 = options.beta1;
+        const float beta2 = options.beta2;
+        for (size_t i = 0; i < parameters.size(); ++i)
         {
-            float update = clipGradient(d_hidden1[i] * activations.input[j]);
-            weights1[i][j] += effective_learning_rate * update;
+            const float g = gradients[i] * scale;
+            m[i] = beta1 * m[i] + (1.0f - beta1) * g;
+            v[i] = beta2 * v[i] + (1.0f - beta2) * g * g;
+            parameters[i] += stepSize * m[i] / (std::sqrt(v[i] * secondCorrection) + options.epsilon);
         }
-        bias1[i] += effective_learning_rate * d_hidden1[i];
     }
 }
 
+// Adam on the averaged gradients. Every parameter is updated, including weights1 columns with no gradient
+// this batch, their moments keep decaying and still move them.
+void ChessEval::applyAdam(const Gradients &gradients, const TrainingOptions &options)
+{
+    adamFirstMoment.allocate();
+    adamSecondMoment.allocate();
+    adamSteps++;
+
+    // bias corrections folded into the step: m / (1 - beta1^t) and v / (1 - beta2^t)
+    const float firstCorrection = 1.0f - std::pow(options.beta1, static_cast<float>(adamSteps));
+    const float secondCorrection = 1.0f / (1.0f - std::pow(options.beta2, static_cast<float>(adamSteps)));
+    const float stepSize = options.learningRate / firstCorrection;
+    const float scale = 1.0f / std::max(1, gradients.samples);
+
+    adamUpdate(weights1, gradients.weights1, adamFirstMoment.weights1, adamSecondMoment.weights1, scale, options, stepSize, secondCorrection);
+    adamUpdate(bias1, gradients.bias1, adamFirstMoment.bias1, adamSecondMoment.bias1, scale, options, stepSize, secondCorrection);
+    adamUpdate(weights2, gradients.weights2, adamFirstMoment.weights2, adamSecondMoment.weights2, scale, options, stepSize, secondCorrection);
+    adamUpdate(bias2, gradients.bias2, adamFirstMoment.bias2, adamSecondMoment.bias2, scale, options, stepSize, secondCorrection);
+    adamUpdate(weights3, gradients.weights3, adamFirstMoment.weights3, adamSecondMoment.weights3, scale, options, stepSize, secondCorrection);
+    adamUpdate(bias3, gradients.bias3, adamFirstMoment.bias3, adamSecondMoment.bias3, scale, options, stepSize, secondCorrection);
+}
+
 // Train the network on a single position
 void ChessEval::train(const char *state,
                       int stockfish_eval,
@@ -346,13 +544,13 @@ void ChessEval::train(const char *state,
         return; // *cracks whip* No training on checkmates!
     }
     float effective_learning_rate = learning_rate > 0.0f ? learning_rate : INITIAL_LEARNING_RATE;
+    makeWeightsWritable();
 
     // Get evaluation BEFORE training
     int preTrainEval = evaluate(state, context);
 
     // Perform training
-    std::vector<float> input = encodePosition(state, context);
-    LayerActivations activations = forwardWithActivations(input);
+    LayerActivations activations = forwardWithActivations(encodePosition(state, context));
     float clamped_target = std::max(-MAX_EVAL, std::min(MAX_EVAL, (float)stockfish_eval));
     backpropagate(activations, clamped_target, effective_learning_rate);
 
@@ -386,44 +584,202 @@ void ChessEval::train(const char *state,
     }
 }
 
-// Helper function to write a vector to file
-void ChessEval::writeVector(std::ofstream &out, const std::vector<float> &vec) const
+// Mini-batch training: each worker runs the forward pass and sums gradients for a contiguous slice of the
+// batch, the sums are reduced in worker order and applied once, so a given thread count always produces
+// the same weights
+float ChessEval::trainBatch(const TrainingSample *samples, int count, const TrainingOptions &options)
 {
-    size_t size = vec.size();
-    out.write(reinterpret_cast<const char *>(&size), sizeof(size_t));
-    out.write(reinterpret_cast<const char *>(vec.data()), size * sizeof(float));
+    makeWeightsWritable();
+    const int batchSize = std::max(1, options.batchSize);
+    const int threads = std::max(1, std::min(options.threads, batchSize));
+    if (static_cast<int>(threadGradients.size()) < threads)
+        threadGradients.resize(threads);
+    for (int t = 0; t < threads; ++t)
+        threadGradients[t].allocate();
+
+    double totalError = 0.0;
+    int totalSamples = 0;
+    for (int start = 0; start < count; start += batchSize)
+    {
+        const int end = std::min(count, start + batchSize);
+        const int slice = (end - start + threads - 1) / threads;
+
+        auto work = [this, samples, start, end, slice](int t)
+        {
+            Gradients &gradients = threadGradients[t];
+            gradients.clear();
+            const int first = start + t * slice;
+            const int last = std::min(end, first + slice);
+            for (int i = first; i < last; ++i)
+            {
+                const TrainingSample &sample = samples[i];
+                if (std::abs(sample.target) > 5000)
+                    continue; // no training on checkmate positions
+                const float clamped_target = std::max(-MAX_EVAL, std::min(MAX_EVAL, static_cast<float>(sample.target)));
+                accumulateGradients(forwardWithActivations(encodePosition(sample.state, sample.context)), clamped_target, gradients);
+            }
+        };
+
+        std::vector<std::thread> helpers;
+        for (int t = 1; t < threads; ++t)
+        {
+            helpers.emplace_back(work, t);
+        }
+        work(0);
+        for (auto &helper : helpers)
+        {
+            helper.join();
+        }
+
+        Gradients &gradients = threadGradients[0];
+        for (int t = 1; t < threads; ++t)
+        {
+            gradients.add(threadGradients[t]);
+        }
+        if (gradients.samples == 0)
+            continue;
+
+        if (options.optimizer == TrainingOptions::Adam)
+            applyAdam(gradients, options);
+        else
+            applySGD(gradients, options.learningRate);
+
+        // metrics once per batch: the loss values follow backpropagate, the running error moves as far as
+        // the per position average would have over the whole batch
+        const float meanSquared = static_cast<float>(gradients.squaredError / gradients.samples);
+        const float meanError = static_cast<float>(gradients.absoluteError / gradients.samples);
+        metrics.last_loss = meanSquared;
+        if (metrics.iterations == 0)
+        {
+            metrics.average_loss = meanSquared;
+            metrics.best_loss = meanSquared;
+        }
+        else
+        {
+            metrics.average_loss = metrics.average_loss * MOVING_AVG_FACTOR + meanSquared * (1.0f - MOVING_AVG_FACTOR);
+            metrics.best_loss = std::min(metrics.best_loss, meanSquared);
+        }
+        if (metrics.positions_trained == 0)
+        {
+            metrics.initial_average_error = meanError;
+            metrics.running_average_error = meanError;
+        }
+        else
+        {
+            const float alpha = 1.0f - std::pow(0.99f, static_cast<float>(gradients.samples));
+            metrics.running_average_error = (1.0f - alpha) * metrics.running_average_error + alpha * meanError;
+        }
+        metrics.iterations++;
+        metrics.positions_trained += gradients.samples;
+        batchesTrained++;
+
+        totalError += gradients.absoluteError;
+        totalSamples += gradients.samples;
+
+        if (options.logEvery > 0 && batchesTrained % options.logEvery == 0)
+        {
+            std::cout << "Batch " << batchesTrained << ": " << metrics.positions_trained << " positions, batch error "
+                      << std::fixed << std::setprecision(1) << meanError << " cp, running error "
+                      << metrics.running_average_error << " cp" << std::defaultfloat << std::endl;
+        }
+    }
+    return totalSamples > 0 ? static_cast<float>(totalError / totalSamples) : 0.0f;
+}
+
+namespace {
+    const uint32_t LEGACY_MAGIC = 0xDEADBEAF; // My special touch
+    const uint32_t MODEL_MAGIC = 0x3256454E;  // "NEV2"
+    const uint32_t MODEL_VERSION = 2;
+    const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+    // the model file is mapped and used as-is, so its byte order has to be the machine's
+    static_assert(std::endian::native == std::endian::little, "model files are little-endian");
+
+    // fixed width fields only, the same bytes on every platform and compiler
+    struct ModelHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t headerBytes;   // the first layer starts here
+        uint32_t alignment;     // every layer starts on a multiple of this
+        uint32_t inputSize;
+        uint32_t hidden1Size;
+        uint32_t hidden2Size;
+        uint32_t outputSize;
+        uint64_t payloadBytes;  // everything after the header, padding included
+        uint64_t checksum;      // FNV-1a over the payload
+        int32_t positionsTrained;
+        int32_t iterations;
+        float lastLoss;
+        float averageLoss;
+        float bestLoss;
+        float initialAverageError;
+        float runningAverageError;
+        int32_t errorWindowSize;
+        uint8_t reserved[48];
+    };
+    static_assert(sizeof(ModelHeader) == 128, "ModelHeader is part of the file format");
+
+    // padded size of a layer of count floats
+    size_t sectionBytes(size_t count)
+    {
+        const size_t bytes = count * sizeof(float);
+        return (bytes + NN_ALIGNMENT - 1) / NN_ALIGNMENT * NN_ALIGNMENT;
+    }
+
+    uint64_t fnv1a(uint64_t hash, const void *data, size_t bytes)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            hash = (hash ^ p[i]) * FNV_PRIME;
+        }
+        return hash;
+    }
 }
 
-// Helper function to read a vector from file
-void ChessEval::readVector(std::ifstream &in, std::vector<float> &vec)
+void ChessEval::makeWeightsWritable()
 {
-    size_t size;
-    in.read(reinterpret_cast<char *>(&size), sizeof(size_t));
-    vec.resize(size);
-    in.read(reinterpret_cast<char *>(vec.data()), size * sizeof(float));
+    weights1.makeOwned();
+    bias1.makeOwned();
+    weights2.makeOwned();
+    bias2.makeOwned();
+    weights3.makeOwned();
+    bias3.makeOwned();
+    mappedModel.reset();
 }
 
-// Helper function to write a matrix to file
-void ChessEval::writeMatrix(std::ofstream &out, const std::vector<std::vector<float>> &matrix) const
+// Helper function to read a vector from file, the stored size must match the allocated one
+bool ChessEval::readVector(std::ifstream &in, AlignedFloats &vec)
 {
-    size_t rows = matrix.size();
-    out.write(reinterpret_cast<const char *>(&rows), sizeof(size_t));
-    for (const auto &row : matrix)
-    {
-        writeVector(out, row);
-    }
+    size_t size;
+    in.read(reinterpret_cast<char *>(&size), sizeof(size_t));
+    if (!in || size != vec.size())
+        return false;
+    in.read(reinterpret_cast<char *>(vec.data()), size * sizeof(float));
+    return static_cast<bool>(in);
 }
 
 // Helper function to read a matrix from file
-void ChessEval::readMatrix(std::ifstream &in, std::vector<std::vector<float>> &matrix)
+bool ChessEval::readMatrix(std::ifstream &in, AlignedFloats &matrix, int rows, int cols, int rowStride, int colStride)
 {
-    size_t rows;
-    in.read(reinterpret_cast<char *>(&rows), sizeof(size_t));
-    matrix.resize(rows);
-    for (auto &row : matrix)
+    size_t storedRows;
+    in.read(reinterpret_cast<char *>(&storedRows), sizeof(size_t));
+    if (!in || storedRows != static_cast<size_t>(rows))
+        return false;
+    std::vector<float> row(cols);
+    for (int r = 0; r < rows; ++r)
     {
-        readVector(in, row);
+        size_t storedCols;
+        in.read(reinterpret_cast<char *>(&storedCols), sizeof(size_t));
+        if (!in || storedCols != static_cast<size_t>(cols))
+            return false;
+        in.read(reinterpret_cast<char *>(row.data()), cols * sizeof(float));
+        for (int c = 0; c < cols; ++c)
+            matrix[static_cast<size_t>(r) * rowStride + static_cast<size_t>(c) * colStride] = row[c];
     }
+    return static_cast<bool>(in);
 }
 
 // Save model weights and training metrics to file
@@ -436,37 +792,114 @@ bool ChessEval::saveModel(const std::string &filename) const
         return false;
     }
 
-    // Add a magic number to verify file type
-    const uint32_t MAGIC_NUMBER = 0xDEADBEAF; // My special touch
-    out.write(reinterpret_cast<const char *>(&MAGIC_NUMBER), sizeof(uint32_t));
+    const AlignedFloats *layers[] = {&weights1, &bias1, &weights2, &bias2, &weights3, &bias3};
+    const char padding[NN_ALIGNMENT] = {};
+
+    ModelHeader header = {};
+    header.magic = MODEL_MAGIC;
+    header.version = MODEL_VERSION;
+    header.headerBytes = sizeof(ModelHeader);
+    header.alignment = NN_ALIGNMENT;
+    header.inputSize = INPUT_SIZE;
+    header.hidden1Size = HIDDEN1_SIZE;
+    header.hidden2Size = HIDDEN2_SIZE;
+    header.outputSize = OUTPUT_SIZE;
+    header.checksum = FNV_OFFSET;
+    for (const AlignedFloats *layer : layers)
+    {
+        const size_t bytes = layer->size() * sizeof(float);
+        header.checksum = fnv1a(header.checksum, layer->data(), bytes);
+        header.checksum = fnv1a(header.checksum, padding, sectionBytes(layer->size()) - bytes);
+        header.payloadBytes += sectionBytes(layer->size());
+    }
+    header.positionsTrained = metrics.positions_trained;
+    header.iterations = metrics.iterations;
+    header.lastLoss = metrics.last_loss;
+    header.averageLoss = metrics.average_loss;
+    header.bestLoss = metrics.best_loss;
+    header.initialAverageError = metrics.initial_average_error;
+    header.runningAverageError = metrics.running_average_error;
+    header.errorWindowSize = metrics.error_window_size;
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const AlignedFloats *layer : layers)
+    {
+        const size_t bytes = layer->size() * sizeof(float);
+        out.write(reinterpret_cast<const char *>(layer->data()), bytes);
+        out.write(padding, sectionBytes(layer->size()) - bytes);
+    }
+
+    out.close();
+    return static_cast<bool>(out);
+}
 
-    // Save network architecture
-    out.write(reinterpret_cast<const char *>(&INPUT_SIZE), sizeof(int));
-    out.write(reinterpret_cast<const char *>(&HIDDEN1_SIZE), sizeof(int));
-    out.write(reinterpret_cast<const char *>(&HIDDEN2_SIZE), sizeof(int));
-    out.write(reinterpret_cast<const char *>(&OUTPUT_SIZE), sizeof(int));
+// Map a current format file and point every layer into it
+bool ChessEval::loadMappedModel(const std::string &filename)
+{
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(filename))
+        return false;
+
+    ModelHeader header;
+    if (file->size() < sizeof(ModelHeader))
+    {
+        std::cerr << "Model file is truncated: " << filename << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
 
-    // Save weights and biases
-    writeMatrix(out, weights1);
-    writeVector(out, bias1);
-    writeMatrix(out, weights2);
-    writeVector(out, bias2);
-    writeMatrix(out, weights3);
-    writeVector(out, bias3);
+    if (header.version != MODEL_VERSION || header.headerBytes != sizeof(ModelHeader) || header.alignment != NN_ALIGNMENT)
+    {
+        std::cerr << "Unsupported model file version " << header.version << ": " << filename << std::endl;
+        return false;
+    }
+    if (header.inputSize != INPUT_SIZE || header.hidden1Size != HIDDEN1_SIZE ||
+        header.hidden2Size != HIDDEN2_SIZE || header.outputSize != OUTPUT_SIZE)
+    {
+        return false; // Architecture mismatch
+    }
 
-    // Save training metrics
-    out.write(reinterpret_cast<const char *>(&metrics), sizeof(TrainingMetrics));
+    AlignedFloats *layers[] = {&weights1, &bias1, &weights2, &bias2, &weights3, &bias3};
+    size_t expected = 0;
+    for (const AlignedFloats *layer : layers)
+        expected += sectionBytes(layer->size());
+    if (header.payloadBytes != expected || file->size() < sizeof(ModelHeader) + expected)
+    {
+        std::cerr << "Model file is truncated or has mismatched layer sizes: " << filename << std::endl;
+        return false;
+    }
 
-    // Save board state
-    out.write(reinterpret_cast<const char *>(&castleStatus), sizeof(int));
-    out.write(reinterpret_cast<const char *>(&currentTurnNo), sizeof(int));
+    const char *payload = static_cast<const char *>(file->data()) + sizeof(ModelHeader);
+    if (fnv1a(FNV_OFFSET, payload, expected) != header.checksum)
+    {
+        std::cerr << "Model file checksum mismatch, the file is corrupt: " << filename << std::endl;
+        return false;
+    }
 
-    out.close();
+    // the mapping is page aligned and every layer sits at a multiple of NN_ALIGNMENT, so the kernels'
+    // alignment holds for the borrowed layers too
+    size_t offset = 0;
+    for (AlignedFloats *layer : layers)
+    {
+        const size_t count = layer->size();
+        layer->borrow(reinterpret_cast<const float *>(payload + offset), count);
+        offset += sectionBytes(count);
+    }
+    mappedModel = file;
+
+    metrics.positions_trained = header.positionsTrained;
+    metrics.iterations = header.iterations;
+    metrics.last_loss = header.lastLoss;
+    metrics.average_loss = header.averageLoss;
+    metrics.best_loss = header.bestLoss;
+    metrics.initial_average_error = header.initialAverageError;
+    metrics.running_average_error = header.runningAverageError;
+    metrics.error_window_size = header.errorWindowSize;
     return true;
 }
 
-// Load model weights and training metrics from file
-bool ChessEval::loadModel(const std::string &filename)
+// The original format: size_t prefixed rows read into owned memory
+bool ChessEval::loadLegacyModel(const std::string &filename)
 {
     std::ifstream in(filename, std::ios::binary);
     if (!in)
@@ -475,14 +908,8 @@ bool ChessEval::loadModel(const std::string &filename)
         return false;
     }
 
-    // Verify magic number
     uint32_t stored_magic;
     in.read(reinterpret_cast<char *>(&stored_magic), sizeof(uint32_t));
-    if (stored_magic != 0xDEADBEAF)
-    {
-        std::cerr << "Not a valid model file." << std::endl;
-        return false;
-    }
 
     // Verify network architecture
     int stored_input_size, stored_h1_size, stored_h2_size, stored_output_size;
@@ -498,12 +925,17 @@ bool ChessEval::loadModel(const std::string &filename)
     }
 
     // Load weights and biases
-    readMatrix(in, weights1);
-    readVector(in, bias1);
-    readMatrix(in, weights2);
-    readVector(in, bias2);
-    readMatrix(in, weights3);
-    readVector(in, bias3);
+    makeWeightsWritable();
+    if (!readMatrix(in, weights1, HIDDEN1_SIZE, INPUT_SIZE, 1, HIDDEN1_SIZE) ||
+        !readVector(in, bias1) ||
+        !readMatrix(in, weights2, HIDDEN2_SIZE, HIDDEN1_SIZE, HIDDEN1_SIZE, 1) ||
+        !readVector(in, bias2) ||
+        !readMatrix(in, weights3, OUTPUT_SIZE, HIDDEN2_SIZE, HIDDEN2_SIZE, 1) ||
+        !readVector(in, bias3))
+    {
+        std::cerr << "Model file is truncated or has mismatched layer sizes: " << filename << std::endl;
+        return false;
+    }
 
     // Load training metrics
     in.read(reinterpret_cast<char *>(&metrics), sizeof(TrainingMetrics));
@@ -513,6 +945,40 @@ bool ChessEval::loadModel(const std::string &filename)
     in.read(reinterpret_cast<char *>(&currentTurnNo), sizeof(int));
 
     in.close();
+    return true;
+}
+
+// Load model weights and training metrics from file
+bool ChessEval::loadModel(const std::string &filename)
+{
+    uint32_t stored_magic = 0;
+    {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "Failed to open file for reading: " << filename << std::endl;
+            return false;
+        }
+        in.read(reinterpret_cast<char *>(&stored_magic), sizeof(uint32_t));
+    }
+
+    // Verify magic number
+    bool loaded = false;
+    if (stored_magic == MODEL_MAGIC)
+    {
+        loaded = loadMappedModel(filename);
+    }
+    else if (stored_magic == LEGACY_MAGIC)
+    {
+        loaded = loadLegacyModel(filename);
+    }
+    else
+    {
+        std::cerr << "Not a valid model file." << std::endl;
+    }
+    if (!loaded)
+        return false;
+    modelLoaded = true;
 
     metrics.initial_average_error = metrics.running_average_error;
     // Print loaded model statistics
@@ -533,6 +999,23 @@ bool ChessEval::loadModel(const std::string &filename)
     return true;
 }
 
+std::shared_ptr<const ChessEval> ChessEval::shared(const std::string &filename)
+{
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<const ChessEval>> registry;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<const ChessEval> model = registry[filename].lock();
+    if (!model)
+    {
+        auto loaded = std::make_shared<ChessEval>();
+        loaded->loadModel(filename);
+        model = loaded;
+        registry[filename] = model;
+    }
+    return model;
+}
+
 void ChessEval::updateTrainingMetrics(float pre_error, float post_error, bool whiteToMove)
 {
     // Normalize errors based on side to move
@@ -1,18 +1,34 @@
 #ifndef CHESS_EVAL_H
 #define CHESS_EVAL_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <random>
 #include <fstream>
 #include <limits>
+#include <memory>
+#include "MappedFile.h"
+#include "NNKernels.h"
+
+/**
+ * The network input in sparse form: the indices of the inputs that are 1, every other input is 0.
+ * One piece per square at most, plus the five side-to-move and castling bits.
+ */
+struct ActiveFeatures {
+    static constexpr int MAX_ACTIVE = 64 + 5;
+    int count = 0;
+    int index[MAX_ACTIVE];
+
+    void add(int feature) { index[count++] = feature; }
+};
 
 /**
  * Structure to hold neural network layer activations during forward pass.
  * Used for both evaluation and training to avoid redundant computation.
  */
 struct LayerActivations {
-    std::vector<float> input;    // Input layer activations (one-hot encoded board)
+    ActiveFeatures input;        // Input layer activations (active one-hot features)
     std::vector<float> hidden1;  // First hidden layer activations
     std::vector<float> hidden2;  // Second hidden layer activations
     float output;                // Final output value
@@ -42,6 +58,18 @@ struct TrainingMetrics {
     int error_window_size;       // Window size for moving average
 };
 
+// width of the first hidden layer, needed outside the class to size NNAccumulator
+constexpr int NN_HIDDEN1_SIZE = 256;
+
+/**
+ * First hidden layer pre-activations (bias1 + weights1 * input) for one position.
+ * A move only flips a handful of inputs, so the search keeps one of these per ply and updates it with
+ * addFeature/removeFeature rather than encoding the board and running the full first layer again.
+ */
+struct alignas(64) NNAccumulator {
+    float hidden1[NN_HIDDEN1_SIZE];
+};
+
 struct PositionContext {
     bool whiteToMove = true;
     bool whiteCastleKingside = false;
@@ -50,6 +78,33 @@ struct PositionContext {
     bool blackCastleQueenside = false;
 };
 
+/**
+ * One labelled position for trainBatch.
+ */
+struct TrainingSample {
+    char state[64];            // board state, same layout evaluate() takes
+    PositionContext context;
+    int target;                // Stockfish (or search) evaluation in centipawns, white's point of view
+    bool hasResult = false;    // the position comes from a game that was played out
+    int result = 0;            // then how it ended for white: 1 won, 0 drawn, -1 lost
+};
+
+/**
+ * Settings for trainBatch.
+ */
+struct TrainingOptions {
+    enum Optimizer { SGD, Adam };
+
+    Optimizer optimizer = SGD;
+    float learningRate = 0.001f;
+    int batchSize = 256;       // positions whose gradients are averaged into one update
+    int threads = 1;           // workers per batch, each with its own gradient buffer
+    float beta1 = 0.9f;        // Adam first and second moment decay
+    float beta2 = 0.999f;
+    float epsilon = 1e-8f;
+    int logEvery = 100;        // batches between progress lines, 0 for none
+};
+
 /**
  * Neural network-based chess position evaluator that learns from Stockfish.
  * Implements a feedforward neural network with two hidden layers that takes
@@ -62,6 +117,12 @@ public:
      * Sets up the network architecture and initializes board state tracking.
      */
     ChessEval();
+
+    /**
+     * The same with a fixed seed, so an untrained network is identical from run to run.
+     * @param seed Seed for the weight initialisation
+     */
+    explicit ChessEval(uint32_t seed);
     
     /**
      * Evaluates a chess position and returns a score in centipawns.
@@ -69,7 +130,58 @@ public:
      * @param context Additional metadata (side to move, castling rights)
      * @return Evaluation score in centipawns (positive for white advantage)
      */
-    int evaluate(const char* state, const PositionContext& context = PositionContext());
+    int evaluate(const char* state, const PositionContext& context = PositionContext()) const;
+
+    /**
+     * Evaluates from a first layer accumulator, skipping the input encoding and the first layer.
+     * @param accumulator Pre-activations built by refresh and kept current with addFeature/removeFeature
+     * @return Same score evaluate(state, context) gives for the position the accumulator describes
+     */
+    int evaluate(const NNAccumulator& accumulator) const;
+
+    /**
+     * Evaluates many positions at once. The hidden layers run as small matrix products over tiles of
+     * positions so each weight row is reused across the tile; scores match evaluate() position by position.
+     * @param states n board states, 64 chars each
+     * @param contexts n contexts, or nullptr for the default context everywhere
+     * @param n Number of positions
+     * @param out Receives n scores, same convention as evaluate()
+     */
+    void evaluateBatch(const char* const* states, const PositionContext* contexts, int n, int* out) const;
+
+    /**
+     * Rebuilds an accumulator from scratch for a position.
+     * @param accumulator Accumulator to overwrite
+     * @param state 64-char array representing the board state
+     * @param context Side to move and castling rights
+     */
+    void refresh(NNAccumulator& accumulator, const char* state, const PositionContext& context) const;
+
+    /**
+     * Turns one input feature on or off in an accumulator (adds or subtracts its weights1 column).
+     * @param feature Input index, from featureIndex or one of the ContextFeature values
+     */
+    void addFeature(NNAccumulator& accumulator, int feature) const;
+    void removeFeature(NNAccumulator& accumulator, int feature) const;
+
+    /**
+     * One-hot encoding of a position, as the indices of its active inputs.
+     */
+    static ActiveFeatures encodePosition(const char* state, const PositionContext& context);
+
+    /**
+     * Input index of a piece standing on a square, -1 for an empty square.
+     */
+    static int featureIndex(char piece, int square);
+
+    // inputs after the 768 piece-square features
+    enum ContextFeature {
+        FeatureWhiteToMove = 768,
+        FeatureWhiteCastleKingside,
+        FeatureWhiteCastleQueenside,
+        FeatureBlackCastleKingside,
+        FeatureBlackCastleQueenside
+    };
     
     /**
      * Trains the network on a single position using Stockfish's evaluation as ground truth.
@@ -84,6 +196,18 @@ public:
                bool verbose = false,
                const PositionContext& context = PositionContext());
 
+    /**
+     * Trains on many positions in mini-batches. The samples of a batch are split between worker threads,
+     * each summing gradients into its own buffer; the buffers are then added together and one averaged
+     * update is applied. Metrics are updated once per batch from the errors of the forward pass, so no
+     * position is evaluated twice.
+     * @param samples Training positions, used in the order given
+     * @param count Number of samples
+     * @param options Optimizer, learning rate, batch size and thread count
+     * @return Mean absolute error in centipawns over the trained samples, before their updates
+     */
+    float trainBatch(const TrainingSample* samples, int count, const TrainingOptions& options = TrainingOptions());
+
     /**
      * Reports current training status and metrics
      * @return String containing formatted training statistics
@@ -91,19 +215,35 @@ public:
     std::string getTrainingStatus() const;
 
     /**
-     * Saves the neural network weights and training metrics to a file
+     * Saves the neural network weights and training metrics to a file.
+     * The file is little-endian with fixed width fields: a 128 byte header holding the layer sizes,
+     * metrics and a checksum, then each layer in its in-memory layout starting on a 64 byte boundary.
      * @param filename Path to save the model
      * @return true if save was successful, false otherwise
      */
     bool saveModel(const std::string& filename) const;
 
     /**
-     * Loads neural network weights and training metrics from a file
+     * Loads neural network weights and training metrics from a file.
+     * Current files are mapped and the layers point straight into the mapping, nothing is copied until the
+     * network is trained. Files in the original size_t-prefixed format are still read, into memory.
      * @param filename Path to load the model from
      * @return true if load was successful, false otherwise
      */
     bool loadModel(const std::string& filename);
 
+    /**
+     * The model stored at filename, loaded once per process and shared by every caller asking for the
+     * same file while any of them still holds it. Never null: if the file can't be loaded the shared
+     * network is an untrained one, and isLoaded() says so.
+     */
+    static std::shared_ptr<const ChessEval> shared(const std::string& filename);
+
+    /**
+     * Whether the weights came from a model file rather than random initialization.
+     */
+    bool isLoaded() const { return modelLoaded; }
+
     /**
      * Updates training metrics based on the difference between pre- and post-training evaluations
      * @param pre_error Evaluation before training
@@ -113,39 +253,66 @@ public:
     float getRunningAverageError() const;
 
 private:
+    friend class QuantizedEval;  // reads the float weights and activations to build the integer network
+
     // Network architecture constants
     static constexpr int BOARD_SIZE = 64;    // Standard chess board size
     static constexpr int PIECE_TYPES = 12;   // 6 pieces * 2 colors
     static constexpr int EXTRA_FEATURES = 5; // side-to-move + castling rights
     static constexpr int INPUT_SIZE = BOARD_SIZE * PIECE_TYPES + EXTRA_FEATURES;
-    static constexpr int HIDDEN1_SIZE = 256; // First hidden layer size
+    static constexpr int HIDDEN1_SIZE = NN_HIDDEN1_SIZE; // First hidden layer size
     static constexpr int HIDDEN2_SIZE = 64;  // Second hidden layer size
     static constexpr int OUTPUT_SIZE = 1;    // Single evaluation output
     static constexpr float MAX_EVAL = 2000.0f;
+    static constexpr int BATCH_TILE = 16;    // positions per evaluateBatch tile, activations stay in L1
 
     static constexpr int BAD_EVAL = 0xDEADDEAD; // used to indicate an error in evaluation
-    // Neural network parameters
-    std::vector<std::vector<float> > weights1;  // Input to Hidden1 weights
-    std::vector<float> bias1;                   // Hidden1 bias terms
-    std::vector<std::vector<float> > weights2;  // Hidden1 to Hidden2 weights
-    std::vector<float> bias2;                   // Hidden2 bias terms
-    std::vector<std::vector<float> > weights3;  // Hidden2 to Output weights
-    std::vector<float> bias3;                   // Output bias terms
+    // Neural network parameters, each layer one flat aligned buffer
+    AlignedFloats weights1;  // Input to Hidden1 weights, input-major: the HIDDEN1_SIZE weights of input i start at i * HIDDEN1_SIZE
+    AlignedFloats bias1;     // Hidden1 bias terms
+    AlignedFloats weights2;  // Hidden1 to Hidden2 weights, row-major HIDDEN2_SIZE x HIDDEN1_SIZE
+    AlignedFloats bias2;     // Hidden2 bias terms
+    AlignedFloats weights3;  // Hidden2 to Output weights, row-major OUTPUT_SIZE x HIDDEN2_SIZE
+    AlignedFloats bias3;     // Output bias terms
+    const NNKernels& kernels; // SIMD kernels for this CPU
 
     // Neural network helper functions
-    float relu(float x) const;                  // ReLU activation function
-    float forward(const std::vector<float>& input) const;  // Forward pass
-    LayerActivations forwardWithActivations(const std::vector<float>& input) const;  // Forward pass with stored activations
-    float dotProduct(const std::vector<float>& a, const std::vector<float>& b) const;
-    void initializeWeights(std::vector<std::vector<float> >& weights, std::vector<float>& bias);
+    float forward(const ActiveFeatures& input) const;  // Forward pass
+    float forwardFromHidden1(const float* hidden1Raw) const;  // Layers 2 and 3 from first layer pre-activations
+    LayerActivations forwardWithActivations(const ActiveFeatures& input) const;  // Forward pass with stored activations
+    void initializeWeights(AlignedFloats& weights, AlignedFloats& bias);
     
     // Position representation helpers
-    std::vector<float> encodePosition(const char* state, const PositionContext& context) const;  // One-hot encoding
     
-    // Training helper
+    // Gradient sums for every parameter, laid out like the parameters themselves. Only the weights1
+    // columns of inputs that were active get a gradient, so those are tracked and the rest left alone.
+    struct Gradients {
+        AlignedFloats weights1, bias1, weights2, bias2, weights3, bias3;
+        std::vector<int> touched;        // inputs whose weights1 column is nonzero
+        std::vector<char> isTouched;     // INPUT_SIZE flags for the same
+        int samples = 0;
+        double squaredError = 0.0;       // of the output against the clamped target, before the update
+        double absoluteError = 0.0;
+
+        void allocate();
+        void clear();
+        void add(const Gradients& other);
+    };
+
+    // Training helpers
     void backpropagate(const LayerActivations& activations,
                       float target, 
                       float learning_rate);
+    void accumulateGradients(const LayerActivations& activations, float target, Gradients& gradients) const;
+    void applySGD(const Gradients& gradients, float learning_rate);
+    void applyAdam(const Gradients& gradients, const TrainingOptions& options);
+
+    Gradients sampleGradients;               // backpropagate's single position buffer
+    std::vector<Gradients> threadGradients;  // one per trainBatch worker
+    Gradients adamFirstMoment;               // Adam state, allocated on the first Adam step
+    Gradients adamSecondMoment;
+    int adamSteps;
+    int batchesTrained;
 
     // Board state tracking
     int castleStatus;   // Tracks castling rights using bit flags
@@ -167,10 +334,16 @@ private:
     TrainingMetrics metrics;
 
     // Serialization helpers
-    void writeVector(std::ofstream& out, const std::vector<float>& vec) const;
-    void readVector(std::ifstream& in, std::vector<float>& vec);
-    void writeMatrix(std::ofstream& out, const std::vector<std::vector<float> >& matrix) const;
-    void readMatrix(std::ifstream& in, std::vector<std::vector<float> >& matrix);
+    std::shared_ptr<MappedFile> mappedModel;  // backs the layers while they point into a loaded file
+    bool modelLoaded;
+    bool loadMappedModel(const std::string& filename);
+    bool loadLegacyModel(const std::string& filename);
+    void makeWeightsWritable();               // copies mapped layers into owned memory before training
+
+    // the original format has a nested-vector layout: a row count, then each row as size + floats. Element
+    // (row, col) lives at data[row * rowStride + col * colStride] in memory, weights1 is stored transposed
+    bool readVector(std::ifstream& in, AlignedFloats& vec);
+    bool readMatrix(std::ifstream& in, AlignedFloats& matrix, int rows, int cols, int rowStride, int colStride);
     void FENtoState(const std::string& fen, char* state);
 };
 
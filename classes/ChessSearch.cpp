@@ -0,0 +1,899 @@
+#include "ChessSearch.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include "Trace.h"
+
+// SearchStats counting, compiled out entirely without CHESS_SEARCH_STATS
+#ifdef CHESS_SEARCH_STATS
+#define SEARCH_STAT(...) __VA_ARGS__
+#else
+#define SEARCH_STAT(...)
+#endif
+
+// Material piece values (in centipawns)
+namespace {
+    const int PIECE_VALUES[] = {
+        0,      // NoPiece
+        100,    // Pawn
+        320,    // Knight
+        330,    // Bishop
+        500,    // Rook
+        900,    // Queen
+        20000   // King (very high to prioritize king safety)
+    };
+
+    const int negInfinite = std::numeric_limits<int>::min();
+    const int DRAW_SCORE = 0;
+
+    // aspiration window half width at the root, doubled after every fail high or low
+    const int ASPIRATION_WINDOW = 25;
+    const int ASPIRATION_MIN_DEPTH = 4;
+
+    // a capture that can't bring the score back to alpha even with this much to spare is skipped
+    const int DELTA_MARGIN = 200;
+
+    // the main thread reads the clock once this many nodes, a power of two: a few microseconds apart
+    const uint64_t CLOCK_CHECK_NODES = 1024;
+
+    // scores this close to MATE_SCORE are mates (or the root window), null move can't prove those
+    const int MATE_BOUND = MATE_SCORE - MAX_SEARCH_DEPTH;
+    const int NULL_MOVE_MIN_DEPTH = 3;
+    const int LMR_MIN_DEPTH = 3;
+    const int LMR_MIN_MOVES = 3;    // the TT move, captures and first quiets are searched at full depth
+
+    // late move reduction by [depth][moves searched so far], growing with the log of both
+    const std::array<std::array<int, 64>, MAX_SEARCH_DEPTH + 1> lmrReductions = []() {
+        std::array<std::array<int, 64>, MAX_SEARCH_DEPTH + 1> table{};
+        for (int depth = 1; depth <= MAX_SEARCH_DEPTH; depth++) {
+            for (int moves = 1; moves < 64; moves++) {
+                table[depth][moves] = static_cast<int>(0.75 + std::log(depth) * std::log(moves) / 2.25);
+            }
+        }
+        return table;
+    }();
+
+    // null move is unsound in zugzwang, which is mostly king and pawn endings: require a piece
+    bool hasNonPawnMaterial(const GameState& gamestate)
+    {
+        const uint64_t pieces = (gamestate.color == WHITE)
+            ? (gamestate._bitboards[WHITE_KNIGHTS] | gamestate._bitboards[WHITE_BISHOPS] | gamestate._bitboards[WHITE_ROOKS] | gamestate._bitboards[WHITE_QUEENS]).getData()
+            : (gamestate._bitboards[BLACK_KNIGHTS] | gamestate._bitboards[BLACK_BISHOPS] | gamestate._bitboards[BLACK_ROOKS] | gamestate._bitboards[BLACK_QUEENS]).getData();
+        return pieces != 0;
+    }
+
+    int pieceTypeValue(char piece)
+    {
+        switch (piece) {
+            case 'P': case 'p': return PIECE_VALUES[Pawn];
+            case 'N': case 'n': return PIECE_VALUES[Knight];
+            case 'B': case 'b': return PIECE_VALUES[Bishop];
+            case 'R': case 'r': return PIECE_VALUES[Rook];
+            case 'Q': case 'q': return PIECE_VALUES[Queen];
+        }
+        return 0;
+    }
+
+    // material a noisy move wins outright: the captured piece plus whatever a promotion adds
+    int noisyMoveGain(const GameState& gamestate, const BitMove& move)
+    {
+        int gain = (move.flags & EnPassant) ? PIECE_VALUES[Pawn] : pieceTypeValue(gamestate.state[move.to]);
+        if (move.flags & IsPromotion) {
+            gain += PIECE_VALUES[move.promotionPiece()] - PIECE_VALUES[Pawn];
+        }
+        return gain;
+    }
+
+    PositionContext positionContext(const GameStateData& gamestate)
+    {
+        PositionContext context;
+        context.whiteToMove = (gamestate.color == WHITE);
+        context.whiteCastleKingside = (gamestate.castlingRights & WhiteKingSide) != 0;
+        context.whiteCastleQueenside = (gamestate.castlingRights & WhiteQueenSide) != 0;
+        context.blackCastleKingside = (gamestate.castlingRights & BlackKingSide) != 0;
+        context.blackCastleQueenside = (gamestate.castlingRights & BlackQueenSide) != 0;
+        return context;
+    }
+
+    // mates are scored from the root, -MATE_SCORE + ply for the side mated at ply, so a shorter mate
+    // scores higher. The TT holds them from its own node instead, for a hit at another ply to be right
+    int scoreToTT(int score, int ply)
+    {
+        return score >= MATE_BOUND ? score + ply : (score <= -MATE_BOUND ? score - ply : score);
+    }
+
+    int scoreFromTT(int score, int ply)
+    {
+        return score >= MATE_BOUND ? score - ply : (score <= -MATE_BOUND ? score + ply : score);
+    }
+
+    // the tablebase's result as a search score; a win or loss the fifty move rule could turn into a
+    // draw isn't taken, the search works those out itself
+    bool tablebaseScore(const Tablebase& tablebase, const GameState& gamestate, int& score)
+    {
+        if (std::popcount(gamestate._bitboards[OCCUPANCY].getData()) > tablebase.maxPieces()) {
+            return false;
+        }
+        TablebaseResult result;
+        if (!tablebase.probe(gamestate, result)) {
+            return false;
+        }
+        if (result.wdl != 0 && gamestate.halfmoveClock + result.distance > 100) {
+            return false;
+        }
+        score = result.wdl == 0 ? DRAW_SCORE : result.wdl * (TABLEBASE_WIN - result.distance);
+        return true;
+    }
+
+    // SearchLimits::searchMoves applied to the root's legal moves; a list with nothing legal in it is ignored
+    void restrictToSearchMoves(MoveList& moves, const std::vector<BitMove>& searchMoves)
+    {
+        if (searchMoves.empty()) {
+            return;
+        }
+        MoveList kept;
+        for (const BitMove& move : moves) {
+            if (std::find(searchMoves.begin(), searchMoves.end(), move) != searchMoves.end()) {
+                kept.push_back(move);
+            }
+        }
+        if (!kept.empty()) {
+            moves = kept;
+        }
+    }
+
+    void toggleFeature(const ChessEval& evaluator, NNAccumulator& accumulator, int feature, bool on)
+    {
+        if (on) {
+            evaluator.addFeature(accumulator, feature);
+        } else {
+            evaluator.removeFeature(accumulator, feature);
+        }
+    }
+}
+
+SearchThread::SearchThread(ChessSearch& search, int id)
+    : _search(search), _id(id), _rootStackPtr(0), _completedDepth(0), _nodes(0), _aborted(false)
+{
+    clearHistory();
+}
+
+void SearchThread::clearHistory()
+{
+    std::memset(_history, 0, sizeof(_history));
+}
+
+void SearchThread::prepare(const GameState& root, const std::vector<BitMove>& searchMoves)
+{
+    _state = root;
+    _rootStackPtr = _state.stackPtr;
+    _search._evaluator.refresh(_accumulators[0], _state.state, positionContext(_state));
+    _completedDepth = 0;
+    _nodes = 0;
+    _stats = SearchStats();
+    _aborted = false;
+
+    // killers are only meaningful within one search, history carries over at half weight
+    for (auto& killers : _killers) {
+        killers[0] = killers[1] = BitMove();
+    }
+    ageHistory();
+
+    // the first iteration takes the root in move picker order, later ones in the previous iteration's ranking
+    MoveList moves;
+    _state.generateAllMoves(moves);
+    restrictToSearchMoves(moves, searchMoves);
+    TTEntry ttEntry;
+    const bool ttHit = _search._transpositionTable.probe(_state.getZobristHash(), ttEntry);
+    MovePicker picker(_state, moves, ttHit ? ttEntry.move : BitMove(), _killers[0], _history);
+    _rootMoves.clear();
+    BitMove move;
+    while (picker.next(move)) {
+        _rootMoves.push_back({ move, -SEARCH_INFINITE });
+    }
+}
+
+// Iterative deepening: each depth is searched in the order the previous one ranked the moves, so the
+// principal variation from the last iteration leads and the TT supplies its continuation. From
+// ASPIRATION_MIN_DEPTH on the window is centred on the previous score and only opened up, one side at a
+// time, when the result falls outside it. Odd helper threads start one ply deeper so the threads spread
+// over more than one depth at a time. With MultiPV each depth is searched once per line, every line
+// over the moves the lines before it didn't take.
+void SearchThread::iterativeDeepening(const SearchLimits& limits)
+{
+    const bool mainThread = (_id == 0);
+    const SearchOptions& options = _search._options;
+    std::vector<RootMove> iteration = _rootMoves;
+    const size_t lines = std::min(iteration.size(), static_cast<size_t>(std::max(1, limits.multiPV)));
+
+    for (int depth = 1 + (mainThread ? 0 : (_id & 1)); depth <= limits.maxDepth; depth++) {
+        TRACE_ZONE("search iteration");
+        for (size_t pvIndex = 0; pvIndex < lines && !_aborted; pvIndex++) {
+            int delta = ASPIRATION_WINDOW;
+            int alpha = -SEARCH_INFINITE;
+            int beta = SEARCH_INFINITE;
+            const int previous = _rootMoves[pvIndex].score;
+            if (options.aspirationWindows && depth >= ASPIRATION_MIN_DEPTH && std::abs(previous) < MATE_BOUND) {
+                alpha = previous - delta;
+                beta = previous + delta;
+            }
+
+            while (true) {
+                const int score = searchRoot(iteration, pvIndex, depth, alpha, beta);
+                if (_aborted) break;
+
+                // the best move (even a failed one) leads the next attempt, the rest by how hard they were to refute
+                std::stable_sort(iteration.begin() + static_cast<std::ptrdiff_t>(pvIndex), iteration.end(), [](const RootMove& a, const RootMove& b) {
+                    return a.score != b.score ? a.score > b.score : a.nodes > b.nodes;
+                });
+
+                if (score <= alpha) {
+                    beta = (alpha + beta) / 2;
+                    alpha = std::max(score - delta, -SEARCH_INFINITE);
+                } else if (score >= beta) {
+                    beta = std::min(score + delta, SEARCH_INFINITE);
+                } else {
+                    break;
+                }
+                delta *= 2;
+            }
+        }
+        // an unfinished iteration is thrown away, the previous depth's answer stands
+        if (_aborted) break;
+
+        _rootMoves = iteration;
+        _completedDepth = depth;
+
+        if (mainThread) {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _search._searchStart).count();
+            char line[224];
+            int length = std::snprintf(line, sizeof(line), "depth %d score %d best %d-%d (%lld ms)", depth, _rootMoves[0].score,
+                                       static_cast<int>(_rootMoves[0].move.from), static_cast<int>(_rootMoves[0].move.to), static_cast<long long>(elapsed));
+#ifdef CHESS_SEARCH_STATS
+            // the helpers' counters are still moving, so the iteration lines show the main thread's
+            SearchStats stats = _stats;
+            stats.elapsedMs = static_cast<double>(elapsed);
+            std::snprintf(line + length, sizeof(line) - length,
+                          " nodes %llu qnodes %llu nps %.0f seldepth %d tt %.1f%% first cut %.1f%% cache %.1f%% nn %.1f%%",
+                          static_cast<unsigned long long>(stats.nodes), static_cast<unsigned long long>(stats.qnodes), stats.nps(),
+                          stats.seldepth, stats.ttHitRate() * 100, stats.firstMoveCutoffRate() * 100,
+                          stats.evalCacheHitRate() * 100, stats.networkEvalShare() * 100);
+#else
+            (void)length;
+#endif
+            _search._log.log(LogLevel::Info, line);
+            if (limits.onIteration) {
+                limits.onIteration(SearchProgress{ depth, _rootMoves[0].score, _rootMoves[0].move, _nodes });
+            }
+
+            // the next depth costs more than everything so far, so don't start one that can't finish
+            if (_search.pastSoftLimit(_search._timeManager.update(_rootMoves[0].move, _rootMoves[0].score))) break;
+        }
+    }
+}
+
+// One pass over the root moves from first on inside (alpha, beta). The first move gets the window, the
+// rest a zero window at the best score so far, and only a move that beats it is searched again for its
+// exact score. Moves that don't are left at -SEARCH_INFINITE and ranked by their subtree size instead.
+int SearchThread::searchRoot(std::vector<RootMove>& moves, size_t first, int depth, int alpha, int beta)
+{
+    const bool pvs = _search._options.pvs;
+    int bestVal = -SEARCH_INFINITE;
+    for (size_t i = first; i < moves.size(); i++) {
+        RootMove& rootMove = moves[i];
+        const uint64_t nodesBefore = _nodes;
+        makeMove(rootMove.move);
+        int value;
+        if (i == first || !pvs) {
+            value = -negamax(depth - 1, -beta, -alpha, 1);
+        } else {
+            value = -negamax(depth - 1, -alpha - 1, -alpha, 1);
+            if (value > alpha && value < beta) {
+                value = -negamax(depth - 1, -beta, -alpha, 1);
+            }
+        }
+        unmakeMove();
+        if (_aborted) return 0;
+
+        rootMove.nodes = _nodes - nodesBefore;
+        rootMove.score = (i == first || value > alpha) ? value : -SEARCH_INFINITE;
+        bestVal = std::max(bestVal, value);
+        if (value > alpha) {
+            alpha = value;
+            if (alpha >= beta) {
+                // the window is reopened and every move searched again, so what's left is unscored
+                for (size_t j = i + 1; j < moves.size(); j++) {
+                    moves[j].score = -SEARCH_INFINITE;
+                }
+                break;
+            }
+        }
+    }
+    return bestVal;
+}
+
+// The child accumulator starts as a copy of the parent's and only the inputs the move flipped are
+// updated, read off the undo record: the moved piece, any capture, the castling rook, side to move and
+// any lost castling rights.
+void SearchThread::makeMove(const BitMove& move)
+{
+    _state.pushMove(move);
+    // the hash is already the child's, its bucket loads while the accumulator is updated
+    _search._transpositionTable.prefetch(_state.getZobristHash());
+    const UndoRecord& undo = _state.undoStack[_state.stackPtr - 1];
+    const ChessEval& evaluator = _search._evaluator;
+    const int ply = _state.stackPtr - _rootStackPtr;
+    NNAccumulator& accumulator = _accumulators[ply];
+    accumulator = _accumulators[ply - 1];
+
+    // the piece on move.to is the promoted one for promotions
+    evaluator.removeFeature(accumulator, ChessEval::featureIndex(undo.piece, move.from));
+    evaluator.addFeature(accumulator, ChessEval::featureIndex(_state.state[move.to], move.to));
+    if (undo.captured != '0') {
+        const int captureSquare = !(move.flags & EnPassant) ? move.to : (undo.piece == 'P' ? move.to - 8 : move.to + 8);
+        evaluator.removeFeature(accumulator, ChessEval::featureIndex(undo.captured, captureSquare));
+    }
+    if (move.flags & (KingSideCastle | QueenSideCastle)) {
+        const int rookFrom = (move.flags & KingSideCastle) ? move.to + 1 : move.to - 2;
+        const int rookTo = (move.flags & KingSideCastle) ? move.to - 1 : move.to + 1;
+        evaluator.removeFeature(accumulator, ChessEval::featureIndex(_state.state[rookTo], rookFrom));
+        evaluator.addFeature(accumulator, ChessEval::featureIndex(_state.state[rookTo], rookTo));
+    }
+
+    toggleFeature(evaluator, accumulator, ChessEval::FeatureWhiteToMove, _state.color == WHITE);
+    const unsigned char lostRights = undo.castlingRights & ~_state.castlingRights;
+    if (lostRights & WhiteKingSide) evaluator.removeFeature(accumulator, ChessEval::FeatureWhiteCastleKingside);
+    if (lostRights & WhiteQueenSide) evaluator.removeFeature(accumulator, ChessEval::FeatureWhiteCastleQueenside);
+    if (lostRights & BlackKingSide) evaluator.removeFeature(accumulator, ChessEval::FeatureBlackCastleKingside);
+    if (lostRights & BlackQueenSide) evaluator.removeFeature(accumulator, ChessEval::FeatureBlackCastleQueenside);
+}
+
+// Passing changes only the side to move, so only that input of the accumulator flips
+void SearchThread::makeNullMove()
+{
+    _state.pushNullMove();
+    _search._transpositionTable.prefetch(_state.getZobristHash());
+    const int ply = _state.stackPtr - _rootStackPtr;
+    NNAccumulator& accumulator = _accumulators[ply];
+    accumulator = _accumulators[ply - 1];
+    toggleFeature(_search._evaluator, accumulator, ChessEval::FeatureWhiteToMove, _state.color == WHITE);
+}
+
+// only the main thread reads the clock, every thread watches the shared stop flag
+bool SearchThread::shouldStop()
+{
+    if (_id == 0 && (_nodes & (CLOCK_CHECK_NODES - 1)) == 0) {
+        const int64_t deadline = _search._deadline.load(std::memory_order_relaxed);
+        if ((deadline && ChessSearch::clockNow() >= deadline) ||
+            (_search._stopRequest && _search._stopRequest->load(std::memory_order_relaxed))) {
+            _search.stop();
+        }
+    }
+    if (_search._stop.load(std::memory_order_relaxed)) {
+        _aborted = true;
+    }
+    return _aborted;
+}
+
+int SearchThread::negamax(int depth, int alpha, int beta, int ply, bool nullAllowed)
+{
+    _nodes++;
+    SEARCH_STAT(_stats.nodes++; _stats.nodesAtPly[ply]++; _stats.seldepth = std::max(_stats.seldepth, ply));
+
+    // once out of time every node unwinds without touching the TT
+    if (shouldStop()) {
+        return 0;
+    }
+
+    const SearchOptions& options = _search._options;
+    const bool inCheck = _state.isInCheck();
+
+    // a repeated position is a draw however deep we look: one repetition is enough, since the side that
+    // allowed it can always repeat again
+    if (_state.repetitions(1) > 0) {
+        return DRAW_SCORE;
+    }
+    if (_state.fiftyMoveRuleReached()) {
+        MoveList evasions;
+        if (inCheck) _state.generateAllMoves(evasions, Evasions);
+        if (!inCheck || !evasions.empty()) return DRAW_SCORE;
+    }
+
+    // an endgame the tablebase knows needs no search
+    int tablebaseValue;
+    if (_search._tablebase && tablebaseScore(*_search._tablebase, _state, tablebaseValue)) {
+        SEARCH_STAT(_stats.tablebaseHits++);
+        return tablebaseValue;
+    }
+
+    // a check is searched one ply further so the evasions are seen before the horizon
+    if (inCheck && options.checkExtensions && ply < MAX_SEARCH_DEPTH) {
+        depth++;
+    }
+
+    // Terminal node evaluation, settled by resolving the captures first
+    if (depth <= 0 || ply >= MAX_SEARCH_DEPTH) {
+        return quiescence(alpha, beta, ply);
+    }
+
+    // a deep enough result for this position may settle the node outright, otherwise its move goes first
+    const int alphaOrig = alpha;
+    const uint64_t hash = _state.getZobristHash();
+    TTEntry ttEntry;
+    const bool ttHit = _search._transpositionTable.probe(hash, ttEntry);
+    SEARCH_STAT(_stats.ttProbes++; _stats.ttHits += ttHit);
+    if (ttHit && ttEntry.depth >= depth) {
+        const int ttScore = scoreFromTT(ttEntry.score, ply);
+        if (ttEntry.bound() == TTExact) return ttScore;
+        if (ttEntry.bound() == TTLower && ttScore >= beta) return ttScore;
+        if (ttEntry.bound() == TTUpper && ttScore <= alpha) return ttScore;
+    }
+
+    // Null move: if passing still fails high on a reduced search, a real move will too. Never twice in a
+    // row, never in check, and not without a piece to move, where zugzwang makes passing the best move
+    if (options.nullMove && nullAllowed && !inCheck && depth >= NULL_MOVE_MIN_DEPTH &&
+        beta < MATE_BOUND && beta > -MATE_BOUND && hasNonPawnMaterial(_state)) {
+        const int reduction = depth > 6 ? 3 : 2;
+        makeNullMove();
+        const int value = -negamax(depth - 1 - reduction, -beta, -beta + 1, ply + 1, false);
+        unmakeMove();
+        if (_aborted) {
+            return 0;
+        }
+        if (value >= beta) {
+            // a mate found after passing isn't a real mate
+            return value >= MATE_BOUND ? beta : value;
+        }
+    }
+
+    // Generate all legal moves
+    MoveList newMoves;
+    _state.generateAllMoves(newMoves);
+
+    // Check for terminal conditions (checkmate or stalemate)
+    if (newMoves.empty()) {
+        return inCheck ? -MATE_SCORE + ply : DRAW_SCORE;
+    }
+
+    int bestVal = negInfinite;
+    BitMove bestMove;
+    MovePicker picker(_state, newMoves, ttHit ? ttEntry.move : BitMove(), _killers[ply], _history);
+
+    BitMove move;
+    int movesSearched = 0;
+    while (picker.next(move)) {
+        makeMove(move);
+        movesSearched++;
+
+        // late quiet moves are searched shallower first, only the ones that beat alpha get the full depth
+        int reduction = 0;
+        if (options.lateMoveReductions && movesSearched > LMR_MIN_MOVES && depth >= LMR_MIN_DEPTH &&
+            !inCheck && !MovePicker::isNoisy(move) && !_state.isInCheck()) {
+            reduction = lmrReductions[std::min(depth, MAX_SEARCH_DEPTH)][std::min(movesSearched, 63)];
+            reduction = std::min(reduction, depth - 2);
+        }
+
+        int value = 0;
+        bool fullDepth = true;
+        if (reduction > 0) {
+            value = -negamax(depth - 1 - reduction, -alpha - 1, -alpha, ply + 1);
+            fullDepth = value > alpha;
+        }
+        if (fullDepth) {
+            // PVS: after the first move only prove the rest can't beat alpha, the exact score is needed
+            // only for a move that does
+            if (options.pvs && movesSearched > 1) {
+                value = -negamax(depth - 1, -alpha - 1, -alpha, ply + 1);
+                if (value > alpha && value < beta) {
+                    value = -negamax(depth - 1, -beta, -alpha, ply + 1);
+                }
+            } else {
+                value = -negamax(depth - 1, -beta, -alpha, ply + 1);
+            }
+        }
+        if (value > bestVal) {
+            bestVal = value;
+            bestMove = move;
+        }
+
+        // Undo the move
+        unmakeMove();
+        if (_aborted) {
+            return 0;
+        }
+
+        // alpha beta cut-off
+        alpha = std::max(alpha, bestVal);
+        if (alpha >= beta) {
+            SEARCH_STAT(_stats.betaCutoffs++; _stats.firstMoveCutoffs += movesSearched == 1);
+            if (!MovePicker::isNoisy(move)) {
+                recordQuietCutoff(move, depth, ply);
+            }
+            break;
+        }
+    }
+
+    // a fail low has no trustworthy best move, only an upper bound
+    const TTBound bound = bestVal <= alphaOrig ? TTUpper : (bestVal >= beta ? TTLower : TTExact);
+    if (_search._transpositionTable.store(hash, bound == TTUpper ? BitMove() : bestMove, scoreToTT(bestVal, ply), depth, bound)) {
+        SEARCH_STAT(_stats.ttCollisions++);
+    }
+
+    return bestVal;
+}
+
+// Captures and promotions only, so leaves are never scored in the middle of an exchange. The side to
+// move may stand pat on the static eval; in check every evasion is searched instead.
+int SearchThread::quiescence(int alpha, int beta, int ply)
+{
+    _nodes++;
+    SEARCH_STAT(_stats.qnodes++; _stats.qnodesAtPly[ply]++; _stats.seldepth = std::max(_stats.seldepth, ply));
+
+    if (shouldStop()) {
+        return 0;
+    }
+    if (ply >= MAX_SEARCH_DEPTH) {
+        return hybridEvaluate(_state);
+    }
+
+    const bool inCheck = _state.isInCheck();
+    MoveList moves;
+    int bestVal = negInfinite;
+    int standPat = 0;
+
+    if (inCheck) {
+        _state.generateAllMoves(moves, Evasions);
+        if (moves.empty()) {
+            return -MATE_SCORE + ply; // checkmate
+        }
+    } else {
+        standPat = hybridEvaluate(_state);
+        if (standPat >= beta) {
+            return standPat;
+        }
+        alpha = std::max(alpha, standPat);
+        bestVal = standPat;
+        _state.generateAllMoves(moves, NoisyMoves);
+    }
+
+    MovePicker picker(_state, moves, BitMove(), _killers[ply], _history);
+    BitMove move;
+    while (picker.next(move)) {
+        // a capture that loses material can't be what saves the position, standing pat is better
+        if (!inCheck && picker.pickingBadCaptures()) {
+            break;
+        }
+        if (!inCheck && standPat + noisyMoveGain(_state, move) + DELTA_MARGIN <= alpha) {
+            continue;
+        }
+
+        makeMove(move);
+        int value = -quiescence(-beta, -alpha, ply + 1);
+        unmakeMove();
+        if (_aborted) {
+            return 0;
+        }
+
+        bestVal = std::max(bestVal, value);
+        alpha = std::max(alpha, bestVal);
+        if (alpha >= beta) {
+            break;
+        }
+    }
+
+    return bestVal;
+}
+
+// A quiet move that refuted this node becomes a killer for the ply and earns history, so sibling
+// positions try it right after the captures
+void SearchThread::recordQuietCutoff(const BitMove& move, int depth, int ply)
+{
+    BitMove* killers = _killers[ply];
+    if (!(killers[0] == move)) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+
+    int& history = _history[_state.color == WHITE ? 0 : 1][move.from][move.to];
+    history += depth * depth;
+    if (history > HISTORY_MAX) {
+        ageHistory();
+    }
+}
+
+void SearchThread::ageHistory()
+{
+    for (auto& side : _history) {
+        for (auto& from : side) {
+            for (int& score : from) {
+                score /= 2;
+            }
+        }
+    }
+}
+
+// Where the network's judgement is worth its cost, decided from the bitboards: generating the moves
+// just to look for a capture or a promotion would cost more than the evaluation saves
+bool SearchThread::isCriticalPosition(const GameState& gamestate) const
+{
+    const bool white = gamestate.color == WHITE;
+
+    // 1. Something to capture (tactical situations); pins aren't looked at, so a pinned attacker counts
+    const uint64_t targets = gamestate._bitboards[white ? BLACK_ALL_PIECES : WHITE_ALL_PIECES].getData() &
+                             ~gamestate._bitboards[white ? BLACK_KING : WHITE_KING].getData();
+    if ((gamestate.attackedBy(gamestate.color) & targets) || gamestate.enPassantSquare >= 0) return true;
+
+    // 2. Endgame positions (few pieces remaining) - positional nuances matter more
+    if (std::popcount(gamestate._bitboards[OCCUPANCY].getData()) <= 12) return true;
+
+    // 3. A pawn one step from promoting (important tactical moments)
+    const uint64_t seventhRank = white ? 0x00FF000000000000ULL : 0x000000000000FF00ULL;
+    if (gamestate._bitboards[white ? WHITE_PAWNS : BLACK_PAWNS].getData() & seventhRank) return true;
+
+    return false;
+}
+
+int SearchThread::hybridEvaluate(const GameState& gamestate)
+{
+    // Zobrist hash is maintained incrementally by GameState
+    uint64_t hash = gamestate.getZobristHash();
+
+    // search scores are from the side to move's point of view, the evaluations below are from white's
+    const int perspective = (gamestate.color == WHITE) ? 1 : -1;
+
+    // Check cache first, it holds the final score whichever evaluator produced it
+    int evaluation;
+    SEARCH_STAT(_stats.evalCacheProbes++);
+    if (_search._evalCache.probe(hash, evaluation)) {
+        SEARCH_STAT(_stats.evalCacheHits++);
+        return perspective * evaluation;
+    }
+
+    if (isCriticalPosition(gamestate)) {
+        // Use neural network for critical positions, the accumulator already holds its first layer
+        evaluation = _search._evaluator.evaluate(_accumulators[gamestate.stackPtr - _rootStackPtr]);
+        SEARCH_STAT(_stats.networkEvals++);
+    } else {
+        // quiet positions get the tapered piece-square score GameState keeps up to date move by move
+        evaluation = gamestate.pstScore();
+        SEARCH_STAT(_stats.materialEvals++);
+    }
+
+    _search._evalCache.store(hash, evaluation);
+    return perspective * evaluation;
+}
+
+ChessSearch::ChessSearch(const ChessEval& evaluator)
+    : _evaluator(evaluator), _stop(false), _clockStart(0), _softLimit(0), _deadline(0), _flexibleTime(false), _stopRequest(nullptr), _log("")
+{
+    setThreads(1);
+}
+
+void ChessSearch::setThreads(int count)
+{
+    count = std::max(1, count);
+    while (static_cast<int>(_threads.size()) < count) {
+        _threads.push_back(std::make_unique<SearchThread>(*this, static_cast<int>(_threads.size())));
+    }
+    _threads.resize(count);
+}
+
+void ChessSearch::newGame()
+{
+    _transpositionTable.clear();
+    _evalCache.clear();
+    for (auto& thread : _threads) {
+        thread->clearHistory();
+    }
+}
+
+void ChessSearch::setMoveTime(int milliseconds)
+{
+    startClock(TimeManager::fixed(milliseconds), false);
+}
+
+void ChessSearch::setClock(int timeLeftMs, int incrementMs, int movesToGo)
+{
+    startClock(TimeManager::allocate(timeLeftMs, incrementMs, movesToGo), true);
+}
+
+void ChessSearch::startClock(const TimeBudget& budget, bool flexible)
+{
+    const int64_t now = clockNow();
+    _clockStart.store(now, std::memory_order_relaxed);
+    _softLimit.store(static_cast<int64_t>(budget.softMs) * 1000000, std::memory_order_relaxed);
+    _flexibleTime.store(flexible, std::memory_order_relaxed);
+    _deadline.store(budget.hardMs > 0 ? now + static_cast<int64_t>(budget.hardMs) * 1000000 : 0, std::memory_order_relaxed);
+}
+
+bool ChessSearch::pastSoftLimit(double factor) const
+{
+    const int64_t deadline = _deadline.load(std::memory_order_relaxed);
+    if (!deadline) {
+        return false;
+    }
+    const int64_t start = _clockStart.load(std::memory_order_relaxed);
+    double limit = static_cast<double>(_softLimit.load(std::memory_order_relaxed));
+    if (_flexibleTime.load(std::memory_order_relaxed)) {
+        limit = std::min(limit * factor, static_cast<double>(deadline - start));
+    }
+    return static_cast<double>(clockNow() - start) > limit;
+}
+
+BitMove ChessSearch::hashMove(const GameState& position) const
+{
+    TTEntry entry;
+    if (!_transpositionTable.probe(position.getZobristHash(), entry) || entry.move.piece == NoPiece) {
+        return BitMove();
+    }
+    // a key collision can leave any move in the entry, so it is only trusted if it is legal here
+    GameState copy = position;
+    MoveList moves;
+    copy.generateAllMoves(moves);
+    for (const BitMove& move : moves) {
+        if (move.from == entry.move.from && move.to == entry.move.to && move.flags == entry.move.flags) {
+            return move;
+        }
+    }
+    return BitMove();
+}
+
+std::vector<BitMove> ChessSearch::principalVariation(const GameState& root, const BitMove& first, int maxLength) const
+{
+    std::vector<BitMove> line;
+    GameState position = root;
+    BitMove move = first;
+    while (move.piece != NoPiece && static_cast<int>(line.size()) < maxLength) {
+        line.push_back(move);
+        position.pushMove(move);
+        move = hashMove(position);
+    }
+    return line;
+}
+
+bool ChessSearch::mateInMoves(int score, int& moves)
+{
+    const int magnitude = std::abs(score);
+    if (magnitude < DECIDED_SCORE) {
+        return false;
+    }
+    // the search's mates lose a point a ply from the root, the tablebase's wins one a ply from it
+    const int plies = magnitude > TABLEBASE_WIN ? MATE_SCORE - magnitude : TABLEBASE_WIN - magnitude;
+    moves = score > 0 ? (plies + 1) / 2 : -(plies / 2);
+    return true;
+}
+
+bool ChessSearch::rankByTablebase(const GameState& root, const std::vector<BitMove>& searchMoves, SearchResult& result) const
+{
+    int rootScore;
+    if (!_tablebase || !tablebaseScore(*_tablebase, root, rootScore)) {
+        return false;
+    }
+    GameState position = root;
+    MoveList moves;
+    position.generateAllMoves(moves);
+    restrictToSearchMoves(moves, searchMoves);
+    // a root that is mate or stalemate goes the normal way, which returns no root moves for it
+    if (moves.empty()) {
+        return false;
+    }
+    result.rootMoves.clear();
+    for (const BitMove& move : moves) {
+        position.pushMove(move);
+        int score;
+        const bool covered = tablebaseScore(*_tablebase, position, score);
+        position.popState();
+        if (!covered) {
+            return false;
+        }
+        result.rootMoves.push_back(RootMove{ move, -score, 1 });
+    }
+    std::stable_sort(result.rootMoves.begin(), result.rootMoves.end(), [](const RootMove& a, const RootMove& b) { return a.score > b.score; });
+    result.completedDepth = 1;
+    result.nodes = result.rootMoves.size();
+    SEARCH_STAT(result.stats.tablebaseHits = result.rootMoves.size());
+    return true;
+}
+
+SearchResult ChessSearch::search(const GameState& root, const SearchLimits& limits)
+{
+    TRACE_ZONE("ChessSearch::search");
+    _transpositionTable.newSearch();
+    _stop.store(false, std::memory_order_relaxed);
+    _searchStart = std::chrono::steady_clock::now();
+    _timeManager.reset();
+    if (limits.timeLeftMs > 0) {
+        setClock(limits.timeLeftMs, limits.incrementMs, limits.movesToGo);
+    } else {
+        setMoveTime(limits.moveTimeMs);
+    }
+    _stopRequest = limits.stopRequest;
+
+    SearchResult tablebaseResult;
+    if (rankByTablebase(root, limits.searchMoves, tablebaseResult)) {
+        char line[128];
+        const RootMove& best = tablebaseResult.rootMoves[0];
+        std::snprintf(line, sizeof(line), "tablebase score %d best %d-%d", best.score, best.move.from, best.move.to);
+        _log.log(LogLevel::Info, line);
+        if (limits.onIteration) {
+            limits.onIteration(SearchProgress{ 1, best.score, best.move, tablebaseResult.nodes });
+        }
+        tablebaseResult.stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _searchStart).count();
+        return tablebaseResult;
+    }
+
+    for (auto& thread : _threads) {
+        thread->prepare(root, limits.searchMoves);
+    }
+    // mate, stalemate, or none of searchMoves legal: nothing to rank and no move to give
+    if (_threads[0]->rootMoves().empty()) {
+        SearchResult result;
+        result.stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _searchStart).count();
+        return result;
+    }
+
+    // helpers run until the main thread is done, whether it finished its depth or ran out of time
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < _threads.size(); i++) {
+        helpers.emplace_back([this, i, &limits]() {
+            TRACE_THREAD("search helper");
+            _threads[i]->iterativeDeepening(limits);
+        });
+    }
+    _threads[0]->iterativeDeepening(limits);
+    stop();
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+
+    SearchResult result;
+    result.rootMoves = _threads[0]->rootMoves();
+    result.completedDepth = _threads[0]->completedDepth();
+    for (const auto& thread : _threads) {
+        result.nodes += thread->nodes();
+        result.stats.add(thread->stats());
+    }
+    result.stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _searchStart).count();
+    return result;
+}
+
+bool SearchOptions::switchOff(const char* name)
+{
+    bool* option = std::strcmp(name, "pvs") == 0 ? &pvs
+                 : std::strcmp(name, "null") == 0 ? &nullMove
+                 : std::strcmp(name, "lmr") == 0 ? &lateMoveReductions
+                 : std::strcmp(name, "check") == 0 ? &checkExtensions
+                 : std::strcmp(name, "aspiration") == 0 ? &aspirationWindows
+                 : nullptr;
+    if (option) {
+        *option = false;
+    }
+    return option != nullptr;
+}
+
+void SearchStats::add(const SearchStats& other)
+{
+    nodes += other.nodes;
+    qnodes += other.qnodes;
+    for (int ply = 0; ply <= MAX_SEARCH_DEPTH; ply++) {
+        nodesAtPly[ply] += other.nodesAtPly[ply];
+        qnodesAtPly[ply] += other.qnodesAtPly[ply];
+    }
+    seldepth = std::max(seldepth, other.seldepth);
+    ttProbes += other.ttProbes;
+    ttHits += other.ttHits;
+    ttCollisions += other.ttCollisions;
+    betaCutoffs += other.betaCutoffs;
+    firstMoveCutoffs += other.firstMoveCutoffs;
+    evalCacheProbes += other.evalCacheProbes;
+    evalCacheHits += other.evalCacheHits;
+    networkEvals += other.networkEvals;
+    materialEvals += other.materialEvals;
+    tablebaseHits += other.tablebaseHits;
+}
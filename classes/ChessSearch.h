@@ -0,0 +1,243 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "GameState.h"
+#include "ChessEval.h"
+#include "TranspositionTable.h"
+#include "EvalCache.h"
+#include "MovePicker.h"
+#include "LogRing.h"
+#include "Tablebase.h"
+#include "TimeManager.h"
+
+//
+// Chess search, kept free of the UI so it can run on worker threads (and outside the app)
+// Lazy SMP: every thread runs its own iterative deepening over a private copy of the position and
+// only the transposition table and the stop flag are shared. Thread 0 owns the clock and the
+// result, the helpers just fill the table with work it can reuse.
+//
+
+constexpr int MAX_SEARCH_DEPTH = 64; // iterative deepening ceiling when searching against a clock
+constexpr int HISTORY_MAX = 1 << 20; // history scores are halved once any of them passes this
+constexpr int MATE_SCORE = 10000;
+constexpr int SEARCH_INFINITE = MATE_SCORE + MAX_SEARCH_DEPTH + 1; // wider than any score, and safe to negate
+// a tablebase win scores this less the plies to mate: below any mate the search finds, above any evaluation
+constexpr int TABLEBASE_WIN = MATE_SCORE - MAX_SEARCH_DEPTH - 1;
+constexpr int DECIDED_SCORE = TABLEBASE_WIN - TABLEBASE_MAX_DISTANCE; // from here on a score is a forced result
+static_assert(MAX_SEARCH_DEPTH + 1 < MAX_DEPTH, "GameState stack must hold a full search line");
+
+struct RootMove {
+    BitMove move;
+    int score;          // exact only for moves that beat alpha, the rest are -SEARCH_INFINITE
+    uint64_t nodes = 0; // size of the move's subtree, orders the moves that didn't get a score
+};
+
+// what the main thread has after each completed iteration
+struct SearchProgress {
+    int depth = 0;
+    int score = 0;
+    BitMove bestMove;
+    uint64_t nodes = 0;     // the main thread's, the helpers' aren't settled mid search
+};
+
+struct SearchLimits {
+    int maxDepth = MAX_SEARCH_DEPTH;
+    int moveTimeMs = 0;     // 0 searches to maxDepth without a clock
+    // the side to move's clock instead of a fixed move time, split by the TimeManager into soft and
+    // hard limits; used whenever timeLeftMs is set
+    int timeLeftMs = 0;
+    int incrementMs = 0;
+    int movesToGo = 0;      // to the next time control, 0 if the clock must last the game
+    int multiPV = 1;        // how many of the best moves get an exact score, each its own line
+    // only these root moves are searched, all of them when empty (or when none of them is legal)
+    std::vector<BitMove> searchMoves;
+    // set by the caller to end the search early, polled with the clock. Unlike stop() it can be raised
+    // before the search has started and can't leak into the next one
+    const std::atomic<bool>* stopRequest = nullptr;
+    // called on the main search thread, so it must be quick and thread safe towards whoever reads it
+    std::function<void(const SearchProgress&)> onIteration;
+};
+
+// What the search did, counted per thread while CHESS_SEARCH_STATS is defined (the CMake option of the
+// same name) and left at zero otherwise. Everything but the per ply node counts is cheap enough to
+// read at a glance; the rates come out as 0 to 1.
+struct SearchStats {
+    uint64_t nodes = 0;             // negamax nodes, the root's children down to the horizon
+    uint64_t qnodes = 0;            // quiescence nodes
+    uint64_t nodesAtPly[MAX_SEARCH_DEPTH + 1] = {};
+    uint64_t qnodesAtPly[MAX_SEARCH_DEPTH + 1] = {};
+    int seldepth = 0;               // deepest ply reached, quiescence included
+    uint64_t ttProbes = 0;
+    uint64_t ttHits = 0;
+    uint64_t ttCollisions = 0;      // stores that evicted another position, the keys are full 64 bit
+    uint64_t betaCutoffs = 0;
+    uint64_t firstMoveCutoffs = 0;  // cutoffs by the first move searched, how good the ordering is
+    uint64_t evalCacheProbes = 0;
+    uint64_t evalCacheHits = 0;
+    uint64_t networkEvals = 0;      // hybridEvaluate's split between the network and the
+    uint64_t materialEvals = 0;     // piece-square score, cache hits not counted
+    uint64_t tablebaseHits = 0;     // nodes settled by the tablebase, root moves included
+    double elapsedMs = 0;
+
+    void add(const SearchStats& other);
+    uint64_t totalNodes() const { return nodes + qnodes; }
+    double nps() const { return elapsedMs > 0 ? totalNodes() * 1000.0 / elapsedMs : 0; }
+    double ttHitRate() const { return ttProbes ? double(ttHits) / ttProbes : 0; }
+    double firstMoveCutoffRate() const { return betaCutoffs ? double(firstMoveCutoffs) / betaCutoffs : 0; }
+    double evalCacheHitRate() const { return evalCacheProbes ? double(evalCacheHits) / evalCacheProbes : 0; }
+    double networkEvalShare() const {
+        const uint64_t evals = networkEvals + materialEvals;
+        return evals ? double(networkEvals) / evals : 0;
+    }
+};
+
+struct SearchResult {
+    std::vector<RootMove> rootMoves;    // ranked by the last completed iteration, the first multiPV exactly
+    int completedDepth = 0;
+    uint64_t nodes = 0;                 // summed over all threads
+    SearchStats stats;                  // summed over all threads
+};
+
+// search features that can be switched off one at a time, to measure what each is worth
+struct SearchOptions {
+    bool pvs = true;                // zero window for all but the first move, re-searched if it beats alpha
+    bool nullMove = true;           // pass and search shallower, a fail high proves the node is good enough
+    bool lateMoveReductions = true; // late quiet moves get less depth unless they beat alpha
+    bool checkExtensions = true;    // a side in check gets one more ply
+    bool aspirationWindows = true;  // root window around the previous iteration's score, widened on failure
+
+    // turns off the option the tools' -off flags call name: pvs, null, lmr, check or aspiration.
+    // False for any other name
+    bool switchOff(const char* name);
+};
+
+class ChessSearch;
+
+class SearchThread
+{
+public:
+    SearchThread(ChessSearch& search, int id);
+
+    void prepare(const GameState& root, const std::vector<BitMove>& searchMoves);
+    void clearHistory();
+    void iterativeDeepening(const SearchLimits& limits);
+
+    const std::vector<RootMove>& rootMoves() const { return _rootMoves; }
+    int completedDepth() const { return _completedDepth; }
+    uint64_t nodes() const { return _nodes; }
+    // only consistent once the search is over, or on the thread itself
+    const SearchStats& stats() const { return _stats; }
+
+private:
+    int negamax(int depth, int alpha, int beta, int ply, bool nullAllowed = true);
+    int searchRoot(std::vector<RootMove>& moves, size_t first, int depth, int alpha, int beta);
+    int quiescence(int alpha, int beta, int ply);
+    bool shouldStop();
+
+    // pushMove/popState plus the network accumulator for the new ply
+    void makeMove(const BitMove& move);
+    void unmakeMove() { _state.popState(); }
+    void makeNullMove();
+
+    void recordQuietCutoff(const BitMove& move, int depth, int ply);
+    void ageHistory();
+
+    // Evaluation functions
+    bool isCriticalPosition(const GameState& gamestate) const;
+    int hybridEvaluate(const GameState& gamestate);
+
+    ChessSearch& _search;
+    int _id;
+    GameState _state;
+    int _rootStackPtr;      // _state.stackPtr at the root, the game's own history lies below it
+    std::vector<RootMove> _rootMoves;
+    int _completedDepth;
+    uint64_t _nodes;
+    SearchStats _stats;
+    bool _aborted;
+    BitMove _killers[MAX_SEARCH_DEPTH + 1][MAX_KILLERS];  // quiet moves that caused cutoffs, per ply
+    HistoryTable _history;  // quiet cutoff counts by side/from/to
+
+    // first layer of the network for each position on the search line, indexed by ply from the root
+    NNAccumulator _accumulators[MAX_SEARCH_DEPTH + 1];
+};
+
+class ChessSearch
+{
+public:
+    explicit ChessSearch(const ChessEval& evaluator);
+
+    void setThreads(int count);
+    int threads() const { return static_cast<int>(_threads.size()); }
+    void resizeTT(size_t megabytes) { _transpositionTable.resize(megabytes); }
+    void clearTT() { _transpositionTable.clear(); }
+    void resizeEvalCache(size_t megabytes) { _evalCache.resize(megabytes); }
+    // forgets everything learned from earlier searches (TT, eval cache, history), so the next search
+    // runs as if on a fresh ChessSearch; only call between searches
+    void newGame();
+    // the per depth lines are Info
+    void setLogLevel(LogLevel level) { _log.setLevel(level); }
+    void setOptions(const SearchOptions& options) { _options = options; }
+    const SearchOptions& options() const { return _options; }
+
+    // blocks until the limits are reached; a root without a legal move to search returns no root moves
+    SearchResult search(const GameState& root, const SearchLimits& limits);
+
+    // may be called from any thread to end the current search early
+    void stop() { _stop.store(true, std::memory_order_relaxed); }
+
+    // restarts the clock with a new budget, 0 for none. Safe from any thread during a search, which is
+    // how a search started without a clock (pondering) is given one once it turns out to be useful
+    void setMoveTime(int milliseconds);
+    // the same with the clock, for the time manager to share out
+    void setClock(int timeLeftMs, int incrementMs, int movesToGo);
+
+    // the table's move for a position, if it is legal there; NoPiece otherwise
+    BitMove hashMove(const GameState& position) const;
+    // first, then the table's move in each position after it, at most maxLength moves; a repetition
+    // can make the table go round in circles, which the length stops
+    std::vector<BitMove> principalVariation(const GameState& root, const BitMove& first, int maxLength) const;
+    // the moves to mate a score stands for, negative when the side to move is the one mated, as UCI's
+    // "score mate" reports them; false for a score that isn't a forced result. Covers the search's own
+    // mates and the tablebase's wins alike
+    static bool mateInMoves(int score, int& moves);
+
+    // endgames the tablebase covers end the search at once: inside the tree a probe replaces the
+    // subtree, at the root every move is ranked by its exact result and nothing is searched. The tables
+    // are read-only and may be shared by any number of searches; null turns probing off
+    void setTablebase(std::shared_ptr<const Tablebase> tablebase) { _tablebase = std::move(tablebase); }
+
+private:
+    friend class SearchThread;
+
+    static int64_t clockNow() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // past the soft limit, as scaled by the time manager, no new iteration is started
+    bool pastSoftLimit(double factor) const;
+    void startClock(const TimeBudget& budget, bool flexible);
+    // every root move scored by the tablebase, false if any of them isn't covered
+    bool rankByTablebase(const GameState& root, const std::vector<BitMove>& searchMoves, SearchResult& result) const;
+
+    const ChessEval& _evaluator;
+    std::shared_ptr<const Tablebase> _tablebase;
+    TranspositionTable _transpositionTable;
+    EvalCache _evalCache;   // final static evaluations, shared by the threads like the TT
+    SearchOptions _options;
+    std::vector<std::unique_ptr<SearchThread>> _threads;
+    std::atomic<bool> _stop;
+    std::chrono::steady_clock::time_point _searchStart;
+    // steady clock nanoseconds, atomic so setMoveTime can move them under a running search
+    std::atomic<int64_t> _clockStart;
+    std::atomic<int64_t> _softLimit;    // after the start
+    std::atomic<int64_t> _deadline;     // the hard limit, 0 without a clock
+    std::atomic<bool> _flexibleTime;    // a clock to share out rather than a fixed move time
+    TimeManager _timeManager;           // the main thread's
+    const std::atomic<bool>* _stopRequest;
+    LogRing _log;   // the main search thread's per depth lines, printed off the search thread
+};
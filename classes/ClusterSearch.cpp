@@ -0,0 +1,412 @@
+#include "ClusterSearch.h"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include "Notation.h"
+
+namespace {
+    constexpr int PV_LENGTH = 16;
+
+    // text split at its first count - 1 commas, the last field keeps any commas after that
+    bool splitFields(std::string_view text, std::string_view* fields, int count)
+    {
+        for (int i = 0; i < count - 1; i++) {
+            const size_t comma = text.find(',');
+            if (comma == std::string_view::npos) {
+                return false;
+            }
+            fields[i] = text.substr(0, comma);
+            text = text.substr(comma + 1);
+        }
+        fields[count - 1] = text;
+        return true;
+    }
+
+    template <typename T>
+    bool parseNumber(std::string_view text, T& value)
+    {
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return error == std::errc() && end == text.data() + text.size() && !text.empty();
+    }
+
+    std::string joinMoves(const std::vector<BitMove>& moves)
+    {
+        std::string text;
+        for (const BitMove& move : moves) {
+            if (!text.empty()) {
+                text += ' ';
+            }
+            text += moveToUCI(move);
+        }
+        return text;
+    }
+
+    std::string resultPayload(uint32_t id, int depth, int score, uint64_t nodes, bool done, const std::vector<BitMove>& pv)
+    {
+        std::string payload = "RESULT:" + std::to_string(id);
+        payload += ',';
+        payload += std::to_string(depth);
+        payload += ',';
+        payload += std::to_string(score);
+        payload += ',';
+        payload += std::to_string(nodes);
+        payload += done ? ",1," : ",0,";
+        payload += joinMoves(pv);
+        return payload;
+    }
+}
+
+ClusterHelper::ClusterHelper(const ChessEval& evaluator) : _search(evaluator), _stop(false), _working(false)
+{
+    _search.setLogLevel(LogLevel::Error);
+}
+
+bool ClusterHelper::start(std::string_view work, Reply reply)
+{
+    std::string_view fields[4];
+    uint32_t id;
+    int moveTimeMs;
+    GameState root;
+    if (!splitFields(work, fields, 4) || !parseNumber(fields[0], id) || !parseNumber(fields[1], moveTimeMs) ||
+        !root.loadFEN(std::string(fields[3]))) {
+        return false;
+    }
+    std::vector<BitMove> moves;
+    std::string_view list = fields[2];
+    while (!list.empty()) {
+        const size_t space = list.find(' ');
+        const BitMove move = parseMove(root, std::string(list.substr(0, space)));
+        if (move.piece == NoPiece) {
+            return false;
+        }
+        moves.push_back(move);
+        list = space == std::string_view::npos ? std::string_view() : list.substr(space + 1);
+    }
+
+    cancel();
+    _stop.store(false);
+    _reply = std::move(reply);
+    _working = true;
+    _lastReply = Clock::now();
+    _heartbeatThread = std::thread([this, id]() { heartbeat(id); });
+    _thread = std::thread([this, id, moveTimeMs, root, moves = std::move(moves)]() {
+        SearchLimits limits;
+        limits.moveTimeMs = std::max(1, moveTimeMs);
+        limits.searchMoves = moves;
+        limits.stopRequest = &_stop;
+        limits.onIteration = [&](const SearchProgress& progress) {
+            send(resultPayload(id, progress.depth, progress.score, progress.nodes, false,
+                               _search.principalVariation(root, progress.bestMove, PV_LENGTH)));
+        };
+        const SearchResult result = _search.search(root, limits);
+        if (!_stop.load()) {
+            // depth 0 if not even the first iteration finished, which still tells the coordinator it is done
+            const bool searched = result.completedDepth > 0 && !result.rootMoves.empty();
+            send(resultPayload(id, searched ? result.completedDepth : 0, searched ? result.rootMoves[0].score : 0, result.nodes, true,
+                               searched ? _search.principalVariation(root, result.rootMoves[0].move, PV_LENGTH) : std::vector<BitMove>()));
+        }
+        std::lock_guard<std::mutex> lock(_replyMutex);
+        _working = false;
+        _workEnded.notify_all();
+    });
+    return true;
+}
+
+void ClusterHelper::send(const std::string& payload)
+{
+    std::lock_guard<std::mutex> lock(_replyMutex);
+    _lastReply = Clock::now();
+    _reply(payload);
+}
+
+void ClusterHelper::heartbeat(uint32_t id)
+{
+    const std::string alive = "ALIVE:" + std::to_string(id);
+    std::unique_lock<std::mutex> lock(_replyMutex);
+    while (_working) {
+        const Clock::time_point due = _lastReply + std::chrono::milliseconds(CLUSTER_HEARTBEAT_MS);
+        if (_workEnded.wait_until(lock, due, [&]() { return !_working; })) {
+            break;
+        }
+        if (Clock::now() >= _lastReply + std::chrono::milliseconds(CLUSTER_HEARTBEAT_MS)) {
+            _lastReply = Clock::now();
+            _reply(alive);
+        }
+    }
+}
+
+void ClusterHelper::cancel()
+{
+    _stop.store(true);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_heartbeatThread.joinable()) {
+        _heartbeatThread.join();
+    }
+}
+
+ClusterCoordinator::ClusterCoordinator(const ChessEval& evaluator, Send send) : _local(evaluator), _send(std::move(send))
+{
+}
+
+void ClusterCoordinator::start(const GameState& root, int moveTimeMs)
+{
+    cancel();
+    _root = root;
+    _rootFEN = root.toFEN();
+    _shares.clear();
+    _bestMove = BitMove();
+    _fallback = BitMove();
+    _summary.clear();
+    _retiredNodes = 0;
+    _stopRequested = false;
+    _running = true;
+    const Clock::time_point now = Clock::now();
+    _deadline = now + std::chrono::milliseconds(moveTimeMs);
+    _judgeSpeedFrom = now + std::chrono::milliseconds(moveTimeMs / 4);
+
+    for (const std::string& helper : _absent) {
+        _send(helper, "TEST:PING");
+    }
+
+    // the ranking decides the deal, so the best few candidates are searched on different machines
+    SearchLimits ordering;
+    ordering.maxDepth = CLUSTER_ORDERING_DEPTH;
+    const SearchResult ranked = _local.search().search(_root, ordering);
+    if (ranked.rootMoves.empty()) {
+        _stopRequested = true;
+        return;
+    }
+    _fallback = ranked.rootMoves[0].move;
+
+    _shares.emplace_back();
+    for (const std::string& helper : _helpers) {
+        if (!_absent.count(helper)) {
+            _shares.emplace_back();
+            _shares.back().helper = helper;
+        }
+    }
+    _shares.resize(std::min(_shares.size(), ranked.rootMoves.size()));
+    for (size_t i = 0; i < ranked.rootMoves.size(); i++) {
+        _shares[i % _shares.size()].moves.push_back(ranked.rootMoves[i].move);
+    }
+    for (Share& share : _shares) {
+        assign(share, now);
+    }
+}
+
+void ClusterCoordinator::assign(Share& share, Clock::time_point now)
+{
+    share.id = _nextId++;
+    share.reports.clear();
+    share.nodes = 0;
+    share.done = false;
+    share.lastHeard = now;
+    const long long remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(_deadline - now).count();
+    const int timeMs = static_cast<int>(std::max<long long>(1, remainingMs - CLUSTER_RESULT_MARGIN_MS));
+
+    std::string work = std::to_string(share.id);
+    work += ',';
+    work += std::to_string(timeMs);
+    work += ',';
+    work += joinMoves(share.moves);
+    work += ',';
+    work += _rootFEN;
+    if (share.helper.empty()) {
+        _local.start(work, [this](const std::string& payload) {
+            std::lock_guard<std::mutex> lock(_localMutex);
+            _localResults.push_back(payload);
+        });
+    } else {
+        _send(share.helper, "WORK:" + work);
+    }
+}
+
+void ClusterCoordinator::handleMessage(const std::string& sender, std::string_view payload)
+{
+    if (payload == "TEST:PONG") {
+        _absent.erase(sender);
+        return;
+    }
+    const bool result = payload.starts_with("RESULT:");
+    if (!result && !payload.starts_with("ALIVE:")) {
+        return;
+    }
+    _absent.erase(sender);
+    if (!_running) {
+        return;
+    }
+    const std::string_view fields = payload.substr(result ? 7 : 6);
+    uint32_t id;
+    if (!parseNumber(fields.substr(0, fields.find(',')), id)) {
+        return;
+    }
+    // anything for work that has since been replaced doesn't count
+    auto share = std::find_if(_shares.begin(), _shares.end(), [&](const Share& s) { return s.helper == sender && s.id == id; });
+    if (share == _shares.end()) {
+        return;
+    }
+    share->lastHeard = Clock::now();
+    if (result) {
+        handleResult(*share, fields);
+    }
+}
+
+void ClusterCoordinator::handleResult(Share& share, std::string_view fields)
+{
+    std::string_view field[6];
+    uint32_t id;
+    int depth;
+    int score;
+    uint64_t nodes;
+    if (!splitFields(fields, field, 6) || !parseNumber(field[0], id) || !parseNumber(field[1], depth) ||
+        !parseNumber(field[2], score) || !parseNumber(field[3], nodes)) {
+        return;
+    }
+    share.nodes = nodes;
+    share.done = share.done || field[4] == "1";
+
+    const std::string_view pv = field[5];
+    const BitMove move = parseMove(_root, std::string(pv.substr(0, pv.find(' '))));
+    const bool ours = std::find(share.moves.begin(), share.moves.end(), move) != share.moves.end();
+    if (depth > 0 && ours && (share.reports.empty() || depth > share.reports.back().depth)) {
+        share.reports.push_back(Report{ depth, score, move, std::string(pv) });
+    }
+}
+
+bool ClusterCoordinator::poll()
+{
+    if (!_running) {
+        return true;
+    }
+    std::vector<std::string> localResults;
+    {
+        std::lock_guard<std::mutex> lock(_localMutex);
+        localResults.swap(_localResults);
+    }
+    for (const std::string& payload : localResults) {
+        handleMessage("", payload);
+    }
+
+    const Clock::time_point now = Clock::now();
+    if (!_stopRequested && now < _deadline) {
+        int deepest = 0;
+        for (const Share& share : _shares) {
+            deepest = std::max(deepest, share.reports.empty() ? 0 : share.reports.back().depth);
+        }
+        for (size_t i = 0; i < _shares.size(); i++) {
+            const Share& share = _shares[i];
+            if (share.helper.empty() || share.done) {
+                continue;
+            }
+            const bool silent = now - share.lastHeard > std::chrono::milliseconds(CLUSTER_SILENCE_MS);
+            const bool slow = now >= _judgeSpeedFrom && deepest - (share.reports.empty() ? 0 : share.reports.back().depth) >= CLUSTER_SLOW_PLIES;
+            if (silent || slow) {
+                _absent.insert(share.helper);
+                reassign(i, now);
+                // the shares have moved, the rest are checked at the next poll
+                return false;
+            }
+        }
+        const bool allDone = std::all_of(_shares.begin(), _shares.end(), [](const Share& share) { return share.done; });
+        if (!allDone) {
+            return false;
+        }
+    }
+    decide();
+    finish();
+    return true;
+}
+
+void ClusterCoordinator::reassign(size_t lost, Clock::time_point now)
+{
+    // too late to start anything over: what the helper sent before it went quiet still counts
+    if (_deadline - now < std::chrono::milliseconds(MIN_REASSIGN_MS)) {
+        _shares[lost].done = true;
+        return;
+    }
+    if (lost == 0) {
+        return;
+    }
+    Share gone = std::move(_shares[lost]);
+    _shares.erase(_shares.begin() + static_cast<std::ptrdiff_t>(lost));
+    _retiredNodes += gone.nodes;
+    // a slow helper is still at it
+    _send(gone.helper, "WORK:CANCEL");
+
+    // the local share is first and can't be lost; its TT still holds what it searched, so starting
+    // over costs it little
+    Share& local = _shares[0];
+    _retiredNodes += local.nodes;
+    local.moves.insert(local.moves.end(), gone.moves.begin(), gone.moves.end());
+    assign(local, now);
+}
+
+void ClusterCoordinator::decide()
+{
+    int common = INT_MAX;
+    int deepest = 0;
+    uint64_t nodes = _retiredNodes;
+    for (const Share& share : _shares) {
+        nodes += share.nodes;
+        if (!share.reports.empty()) {
+            common = std::min(common, share.reports.back().depth);
+            deepest = std::max(deepest, share.reports.back().depth);
+        }
+    }
+
+    // scores from different depths don't compare, so each share is taken at the depth every share reached
+    const Share* winner = nullptr;
+    int winnerScore = 0;
+    for (const Share& share : _shares) {
+        for (auto report = share.reports.rbegin(); report != share.reports.rend(); ++report) {
+            if (report->depth <= common) {
+                if (!winner || report->score > winnerScore) {
+                    winner = &share;
+                    winnerScore = report->score;
+                }
+                break;
+            }
+        }
+    }
+    _bestMove = winner ? winner->reports.back().move : _fallback;
+
+    _summary = std::to_string(_shares.size()) + " shares, ";
+    if (winner) {
+        _summary += "depth " + std::to_string(common);
+        if (deepest > common) {
+            _summary += '-';
+            _summary += std::to_string(deepest);
+        }
+        _summary += ", score " + std::to_string(winner->reports.back().score);
+        _summary += ", pv " + winner->reports.back().pv;
+        _summary += ", ";
+    } else {
+        _summary += "no results, the ordering search's move, ";
+    }
+    _summary += std::to_string(nodes) + " nodes";
+}
+
+void ClusterCoordinator::finish()
+{
+    for (const Share& share : _shares) {
+        if (!share.helper.empty() && !share.done) {
+            _send(share.helper, "WORK:CANCEL");
+        }
+    }
+    _local.cancel();
+    {
+        std::lock_guard<std::mutex> lock(_localMutex);
+        _localResults.clear();
+    }
+    _running = false;
+}
+
+void ClusterCoordinator::cancel()
+{
+    if (_running) {
+        finish();
+    }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "ChessSearch.h"
+
+//
+// Root splitting across processes, over whatever carries the messages (the tournament relay)
+// The coordinator ranks the root moves with a short search and deals them out round robin between its
+// own search and its helpers, so the strongest candidates land on different machines, each of which
+// searches its share alone for the whole move time and reports every completed iteration. The shares
+// are compared at the deepest depth all of them have completed, and the winner's deepest best move is
+// played. A helper is written off for the move when it has been silent for CLUSTER_SILENCE_MS (between
+// iterations it sends ALIVE every CLUSTER_HEARTBEAT_MS) or, from a quarter of the move time on, has
+// fallen CLUSTER_SLOW_PLIES behind the deepest share; its moves go to the coordinator's own share,
+// which starts over on them and its own while there is time for it. A helper written off gets no more
+// work until it answers a TEST:PING.
+// Only the move time is shared out, never a clock: a helper can't stretch its search the way the time
+// manager would.
+//
+// Messages, the payloads of the relay's TARGET|PAYLOAD lines:
+//   WORK:<id>,<ms>,<moves>,<fen>                      search these root moves (UCI, space separated) for ms
+//   WORK:CANCEL                                        the move is played, drop the work
+//   RESULT:<id>,<depth>,<score>,<nodes>,<done>,<pv>   back after each iteration, done 1 once the time is up
+//   ALIVE:<id>                                         still searching, sent when there has been no RESULT for a while
+// A helper only knows the position by its FEN, so repetitions of positions before it are lost on it.
+//
+
+constexpr int CLUSTER_RESULT_MARGIN_MS = 30;   // the shares stop this much early, for their results to get back
+constexpr int CLUSTER_ORDERING_DEPTH = 4;      // the search that ranks the root moves before they are dealt out
+constexpr int CLUSTER_HEARTBEAT_MS = 100;
+constexpr int CLUSTER_SILENCE_MS = 400;        // four heartbeats missed, the relay's latency allowed for
+constexpr int CLUSTER_SLOW_PLIES = 3;          // a tree about ten times smaller than the deepest share's
+
+// Searches the work a coordinator sends, on a thread of its own
+class ClusterHelper {
+public:
+    // called on the helper's threads, one call at a time, with every RESULT: and ALIVE: payload
+    using Reply = std::function<void(const std::string& payload)>;
+
+    explicit ClusterHelper(const ChessEval& evaluator);
+    ~ClusterHelper() { cancel(); }
+    ClusterHelper(const ClusterHelper&) = delete;
+    ClusterHelper& operator=(const ClusterHelper&) = delete;
+
+    // threads, TT size and tablebases are set up on this
+    ChessSearch& search() { return _search; }
+
+    // a WORK: payload after the prefix, replacing any work still running; false if it doesn't parse
+    bool start(std::string_view work, Reply reply);
+    // stops and waits for the work, without sending anything more
+    void cancel();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void send(const std::string& payload);
+    // ALIVE whenever the search has sent nothing for a heartbeat, until the work is done
+    void heartbeat(uint32_t id);
+
+    ChessSearch _search;
+    Reply _reply;
+    std::thread _thread;
+    std::thread _heartbeatThread;
+    std::atomic<bool> _stop;
+    std::mutex _replyMutex;     // guards the three below and orders the replies
+    std::condition_variable _workEnded;
+    bool _working;
+    Clock::time_point _lastReply;
+};
+
+// Splits the root of every move between the local search and the helpers, and picks the move
+// everything but the constructor is called from one thread, the one the messages arrive on
+class ClusterCoordinator {
+public:
+    // a payload for a helper, by name
+    using Send = std::function<void(const std::string& helper, const std::string& payload)>;
+
+    static constexpr int MIN_REASSIGN_MS = 100;    // less time left than this isn't worth starting a share over
+
+    ClusterCoordinator(const ChessEval& evaluator, Send send);
+    ~ClusterCoordinator() { cancel(); }
+    ClusterCoordinator(const ClusterCoordinator&) = delete;
+    ClusterCoordinator& operator=(const ClusterCoordinator&) = delete;
+
+    void setHelpers(const std::vector<std::string>& helpers) { _helpers = helpers; }
+    // the coordinator's own share is searched on this; its threads, TT size and tablebases are set up here
+    ChessSearch& localSearch() { return _local.search(); }
+
+    // deals out the root's moves, to be decided moveTimeMs from now
+    void start(const GameState& root, int moveTimeMs);
+    // RESULT: and ALIVE: from a helper, or TEST:PONG, which takes it back; anything else is ignored.
+    // The local share's come through here too, as sender ""
+    void handleMessage(const std::string& sender, std::string_view payload);
+    // writes off the helpers that have gone quiet or fallen behind; true once the move is decided, which is then bestMove()
+    bool poll();
+    // decide at the next poll, with what has come back so far
+    void stop() { _stopRequested = true; }
+    // drops the move, helpers included
+    void cancel();
+
+    bool running() const { return _running; }
+    BitMove bestMove() const { return _bestMove; }
+    // for the log: shares, depth and nodes of the last move decided
+    const std::string& summary() const { return _summary; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Report {
+        int depth;
+        int score;
+        BitMove move;
+        std::string pv;
+    };
+
+    struct Share {
+        std::string helper;             // empty for the local search
+        uint32_t id = 0;
+        std::vector<BitMove> moves;
+        std::vector<Report> reports;    // one per completed iteration, deepest last
+        uint64_t nodes = 0;
+        bool done = false;
+        Clock::time_point lastHeard;
+    };
+
+    void assign(Share& share, Clock::time_point now);
+    void handleResult(Share& share, std::string_view fields);
+    // the lost share's moves go to the local one
+    void reassign(size_t lost, Clock::time_point now);
+    void decide();
+    void finish();
+
+    ClusterHelper _local;
+    Send _send;
+    std::vector<std::string> _helpers;
+    std::set<std::string> _absent;      // written off, until they answer a ping
+    GameState _root;
+    std::string _rootFEN;
+    std::vector<Share> _shares;
+    BitMove _fallback;                  // the ordering search's best, if no share reports anything
+    uint64_t _retiredNodes = 0;         // searched by work that was replaced or written off
+    uint32_t _nextId = 1;
+    Clock::time_point _deadline;
+    Clock::time_point _judgeSpeedFrom;  // the first iterations are too quick to tell a slow helper by
+    bool _running = false;
+    bool _stopRequested = false;
+    BitMove _bestMove;
+    std::string _summary;
+
+    // the local share's results, written on its search thread
+    std::mutex _localMutex;
+    std::vector<std::string> _localResults;
+};
@@ -2,6 +2,8 @@
 #include <limits>
 #include <cmath>
 
+static_assert(CONNECT4_COLS == CONNECT4_WIDTH && CONNECT4_ROWS == CONNECT4_HEIGHT, "the grid and the bitboard must agree");
+
 Connect4::Connect4()
 {
     _grid = new Grid(CONNECT4_COLS, CONNECT4_ROWS);
@@ -9,6 +11,7 @@ Connect4::Connect4()
 
 Connect4::~Connect4()
 {
+    _aiJob.cancel();
     delete _grid;
 }
 
@@ -28,6 +31,10 @@ void Connect4::setUpBoard()
 
     _grid->initializeSquares(80, "square.png");
 
+    if (gameHasAI()) {
+        setAIPlayer(AI_PLAYER);
+    }
+
     startGame();
 }
 
@@ -120,52 +127,16 @@ Player* Connect4::ownerAt(int x, int y) const
     return square->bit()->getOwner();
 }
 
-// Searches in a specific direction (dx, dy) from a starting point (startX, startY)
-// to check if there are 4 consecutive pieces belonging to the same player.
-bool Connect4::checkDirection(int startX, int startY, int dx, int dy, Player* player)
-{
-    int count = 0;
-    for (int i = 0; i < 4; i++) {
-        int x = startX + i * dx;
-        int y = startY + i * dy;
-
-        if (ownerAt(x, y) == player) {
-            count++;
-        } else {
-            break;
-        }
-    }
-    return count >= 4;
-}
-
-// Checks for a Connect 4 winner by examining all possible 4-in-a-row combinations:
-// horizontal, vertical, and both diagonal directions.
-
+// Checks for a Connect 4 winner with the bitboard's shift-and-AND test over all four directions
 Player* Connect4::checkForWinner()
 {
-    for (int y = 0; y < CONNECT4_ROWS; y++) {
-        for (int x = 0; x < CONNECT4_COLS; x++) {
-            Player* player = ownerAt(x, y);
-            if (player) {
-                if (x <= CONNECT4_COLS - 4 && checkDirection(x, y, 1, 0, player)) {
-                    return player;
-                }
-
-                if (y <= CONNECT4_ROWS - 4 && checkDirection(x, y, 0, 1, player)) {
-                    return player;
-                }
-
-                if (x <= CONNECT4_COLS - 4 && y <= CONNECT4_ROWS - 4 &&
-                    checkDirection(x, y, 1, 1, player)) {
-                    return player;
-                }
-
-                if (x >= 3 && y <= CONNECT4_ROWS - 4 &&
-                    checkDirection(x, y, -1, 1, player)) {
-                    return player;
-                }
-            }
-        }
+    Player* first = getPlayerAt(0);
+    const Connect4Board board = boardFor(first);
+    if (connect4::hasFour(board.current)) {
+        return first;
+    }
+    if (connect4::hasFour(board.opponent())) {
+        return getPlayerAt(1);
     }
     return nullptr;
 }
@@ -210,3 +181,35 @@ void Connect4::setStateString(const std::string &s)
     });
 }
 
+// grid row 0 is the top, the bitboard counts rows from the bottom
+Connect4Board Connect4::boardFor(Player* player) const
+{
+    Connect4Board board;
+    _grid->forEachSquare([&](ChessSquare* square, int x, int y) {
+        Bit *bit = square->bit();
+        if (bit) {
+            const uint64_t cell = 1ull << (x * connect4::COLUMN_BITS + (CONNECT4_ROWS - 1 - y));
+            board.mask |= cell;
+            if (bit->getOwner() == player) {
+                board.current |= cell;
+            }
+            board.moves++;
+        }
+    });
+    return board;
+}
+
+AIJob::Work Connect4::aiWork()
+{
+    const Connect4Position position{ boardFor(getCurrentPlayer()) };
+    return [this, position](AIJob& job) -> std::function<void()> {
+        // columns numbered 1..7 from the left
+        reportIterations(job, _search, position, [](int column) { return std::to_string(column + 1); });
+        Connect4SearchResult result = _search.search(position, AI_MOVE_TIME_MS);
+        return [this, result]() {
+            if (result.hasMove) {
+                actionForEmptyHolder(*_grid->getSquare(result.move, 0));
+            }
+        };
+    };
+}
@@ -2,6 +2,7 @@
 
 #include "Game.h"
 #include "Grid.h"
+#include "Connect4Search.h"
 
 const int CONNECT4_COLS = 7;
 const int CONNECT4_ROWS = 6;
@@ -29,12 +30,22 @@ public:
 
     Grid* getGrid() override { return _grid; }
 
+    bool gameHasAI() override { return true; }
+
+protected:
+    AIJob::Work aiWork() override;
+
 private:
+    // how long the AI thinks per move; the game is solved well before the board fills up
+    static const int AI_MOVE_TIME_MS = 500;
+
     Bit* PieceForPlayer(const int playerNumber);
     int getLowestEmptyRow(int col);
     bool isColumnFull(int col);
     Player* ownerAt(int x, int y) const;
-    bool checkDirection(int startX, int startY, int dx, int dy, Player* player);
+    // the grid as a bitboard position with player to move
+    Connect4Board boardFor(Player* player) const;
 
     Grid* _grid;
+    Connect4Search _search;
 };
\ No newline at end of file
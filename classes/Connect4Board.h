@@ -0,0 +1,106 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+
+//
+// Connect 4 position as two bitboards
+// each column takes HEIGHT + 1 bits, bottom row first, and the spare bit on top of every column keeps
+// columns apart: bit = column * 7 + row, 49 bits in all. mask has every stone, current the side to
+// move's. Four in a row in a direction is a shift-and-AND by the direction's bit distance (1 up a
+// column, 7 along a row, 6 and 8 on the diagonals), and the same shifts find every empty square that
+// would complete a four. Playing a column is one add: mask + bottom bit lands on the lowest empty cell.
+//
+
+constexpr int CONNECT4_WIDTH = 7;
+constexpr int CONNECT4_HEIGHT = 6;
+constexpr int CONNECT4_CELLS = CONNECT4_WIDTH * CONNECT4_HEIGHT;
+
+namespace connect4 {
+    constexpr int COLUMN_BITS = CONNECT4_HEIGHT + 1;
+
+    constexpr uint64_t bottomMask() {
+        uint64_t mask = 0;
+        for (int column = 0; column < CONNECT4_WIDTH; column++) {
+            mask |= 1ull << (column * COLUMN_BITS);
+        }
+        return mask;
+    }
+    constexpr uint64_t BOTTOM_MASK = bottomMask();
+    constexpr uint64_t BOARD_MASK = BOTTOM_MASK * ((1ull << CONNECT4_HEIGHT) - 1);
+
+    constexpr uint64_t columnMask(int column) { return ((1ull << CONNECT4_HEIGHT) - 1) << (column * COLUMN_BITS); }
+    constexpr uint64_t topMask(int column) { return 1ull << (CONNECT4_HEIGHT - 1 + column * COLUMN_BITS); }
+    constexpr uint64_t bottomMask(int column) { return 1ull << (column * COLUMN_BITS); }
+
+    // empty cells that would give stones a four, whether or not they can be played yet
+    constexpr uint64_t winningCells(uint64_t stones, uint64_t mask) {
+        // vertical, only completed from above
+        uint64_t cells = (stones << 1) & (stones << 2) & (stones << 3);
+        // the other three directions, the gap can be at either end or inside
+        for (int shift : { COLUMN_BITS, COLUMN_BITS - 1, COLUMN_BITS + 1 }) {
+            uint64_t pair = (stones << shift) & (stones << (2 * shift));
+            cells |= pair & (stones << (3 * shift));
+            cells |= pair & (stones >> shift);
+            pair = (stones >> shift) & (stones >> (2 * shift));
+            cells |= pair & (stones << shift);
+            cells |= pair & (stones >> (3 * shift));
+        }
+        return cells & (BOARD_MASK ^ mask);
+    }
+
+    constexpr bool hasFour(uint64_t stones) {
+        for (int shift : { 1, COLUMN_BITS, COLUMN_BITS - 1, COLUMN_BITS + 1 }) {
+            const uint64_t pairs = stones & (stones >> shift);
+            if (pairs & (pairs >> (2 * shift))) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+struct Connect4Board {
+    uint64_t current = 0;   // side to move's stones
+    uint64_t mask = 0;      // every stone
+    int moves = 0;          // stones played
+
+    uint64_t opponent() const { return current ^ mask; }
+    bool full() const { return moves == CONNECT4_CELLS; }
+    bool canPlay(int column) const { return (mask & connect4::topMask(column)) == 0; }
+
+    // the lowest empty cell of every column that isn't full
+    uint64_t playableCells() const { return (mask + connect4::BOTTOM_MASK) & connect4::BOARD_MASK; }
+    // true if playing the column wins on the spot
+    bool isWinningMove(int column) const {
+        return connect4::winningCells(current, mask) & playableCells() & connect4::columnMask(column);
+    }
+    bool canWinNext() const { return connect4::winningCells(current, mask) & playableCells(); }
+
+    // playable cells that don't hand the opponent a four next move: with two of their threats open
+    // there are none, with one it has to be blocked, and a cell right under one of theirs is out
+    uint64_t nonLosingCells() const {
+        uint64_t playable = playableCells();
+        const uint64_t threats = connect4::winningCells(opponent(), mask);
+        const uint64_t forced = playable & threats;
+        if (forced) {
+            if (forced & (forced - 1)) {
+                return 0;
+            }
+            playable = forced;
+        }
+        return playable & ~(threats >> 1);
+    }
+
+    // cell is one bit of playableCells(); the stones swap sides so current is the next mover's
+    void playCell(uint64_t cell) {
+        current ^= mask;
+        mask |= cell;
+        moves++;
+    }
+    void play(int column) { playCell((mask + connect4::bottomMask(column)) & connect4::columnMask(column)); }
+
+    // unique per position: current plus mask sets the bit above each column's top stone
+    uint64_t key() const { return current + mask; }
+};
@@ -0,0 +1,16 @@
+#include "Connect4Search.h"
+
+namespace {
+    constexpr int THREAT_WEIGHT = 16;
+    constexpr int CENTRE_WEIGHT = 4;
+}
+
+int Connect4Position::evaluate() const
+{
+    const uint64_t opponent = board.opponent();
+    const int threats = std::popcount(connect4::winningCells(board.current, board.mask))
+                      - std::popcount(connect4::winningCells(opponent, board.mask));
+    const uint64_t centre = connect4::columnMask(3);
+    const int centreStones = std::popcount(board.current & centre) - std::popcount(opponent & centre);
+    return THREAT_WEIGHT * threats + CENTRE_WEIGHT * centreStones;
+}
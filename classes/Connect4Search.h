@@ -0,0 +1,82 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include "Connect4Board.h"
+#include "Search.h"
+
+//
+// Connect 4 search, kept free of the UI like ChessSearch
+// Connect4Board as a Search position. Threats are used before anything is searched: a position that
+// can win at once is scored without looking at its moves, and only moves that don't let the opponent
+// win next are generated, so the tree loses most of its forced lines and the result of a game still
+// open is bounded by the next win either side could have. Columns go centre first, then by how many
+// fours they set up. Past the horizon a position is scored on open threats and centre stones.
+//
+
+struct Connect4Position {
+    using Move = int;                       // a column
+    static constexpr int MAX_MOVES = CONNECT4_WIDTH;
+
+    Connect4Board board;
+
+    // centre first. A position that can win only generates the winning columns, and one where every
+    // column loses generates them all, so a root always has a move to play
+    int generateMoves(Move* moves) const {
+        static constexpr int centreFirst[CONNECT4_WIDTH] = { 3, 2, 4, 1, 5, 0, 6 };
+        const uint64_t playable = board.playableCells();
+        uint64_t cells = connect4::winningCells(board.current, board.mask) & playable;
+        if (!cells) {
+            cells = board.nonLosingCells();
+        }
+        if (!cells) {
+            cells = playable;
+        }
+        int count = 0;
+        for (int column : centreFirst) {
+            if (cells & connect4::columnMask(column)) {
+                moves[count++] = column;
+            }
+        }
+        return count;
+    }
+    void makeMove(Move column) { board.play(column); }
+    uint64_t hash() const { return board.key(); }
+    int evaluate() const;
+
+    bool terminal(int ply, int& score) const {
+        if (board.canWinNext()) {
+            score = searchWin(ply + 1);
+            return true;
+        }
+        if (board.full()) {
+            score = 0;
+            return true;
+        }
+        if (!board.nonLosingCells()) {
+            score = searchLoss(ply + 2);
+            return true;
+        }
+        // nobody can win in the last two stones any more
+        if (board.moves >= CONNECT4_CELLS - 2) {
+            score = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // we can't win with the next stone, so the best there is comes with the one after; nothing played
+    // loses to the opponent's next stone either, so the worst is losing to the one after that
+    void bounds(int ply, int& lowest, int& highest) const {
+        lowest = searchLoss(ply + 4);
+        highest = searchWin(ply + 3);
+    }
+
+    int orderKey(Move column, int) const {
+        const uint64_t cell = (board.mask + connect4::bottomMask(column)) & connect4::columnMask(column);
+        return std::popcount(connect4::winningCells(board.current | cell, board.mask | cell));
+    }
+};
+
+using Connect4Search = Search<Connect4Position>;
+using Connect4SearchResult = Connect4Search::Result;
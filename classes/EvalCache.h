@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+//
+// Evaluation cache for the chess search
+// a direct-mapped, power-of-two table of 8 byte entries indexed by the low bits of the Zobrist hash.
+// Each entry is one atomic word holding the top 32 bits of the hash over the 32 bit score, so it is
+// shared by every search thread without locks and a racing write can't tear it. A store simply
+// overwrites whatever was in its slot: nothing is ever searched for, moved or freed during a search.
+// An evaluation depends on the position alone, so entries never go stale and the table is only
+// cleared when it is resized.
+//
+
+class EvalCache {
+public:
+    EvalCache() : _mask(0) { resize(4); }
+
+    // size is rounded down to a power of two number of entries, at least one
+    void resize(size_t megabytes) {
+        size_t entries = 1;
+        const size_t bytes = megabytes * 1024 * 1024;
+        while (entries * 2 * sizeof(std::atomic<uint64_t>) <= bytes) {
+            entries *= 2;
+        }
+        _entries.reset(new std::atomic<uint64_t>[entries]);
+        _mask = entries - 1;
+        clear();
+    }
+
+    // not thread safe, only call between searches
+    void clear() {
+        for (size_t i = 0; i <= _mask; i++) {
+            _entries[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    size_t sizeInBytes() const { return (_mask + 1) * sizeof(std::atomic<uint64_t>); }
+
+    bool probe(uint64_t key, int& score) const {
+        const uint64_t entry = _entries[key & _mask].load(std::memory_order_relaxed);
+        if ((entry >> 32) != (key >> 32)) {
+            return false;
+        }
+        score = static_cast<int32_t>(static_cast<uint32_t>(entry));
+        return true;
+    }
+
+    void store(uint64_t key, int score) {
+        const uint64_t entry = (key & 0xFFFFFFFF00000000ull) | static_cast<uint32_t>(score);
+        _entries[key & _mask].store(entry, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> _entries;
+    size_t _mask;
+};
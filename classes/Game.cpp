@@ -2,6 +2,7 @@
 #include "Bit.h"
 #include "BitHolder.h"
 #include "Turn.h"
+#include "Trace.h"
 #include "../Application.h"
 
 Game::Game()
@@ -16,6 +17,8 @@ Game::Game()
 	_gameOptions.score = 0;
 	_gameOptions.AIDepthSearches = 0;
 	_gameOptions.AIvsAI = false;
+	_gameOptions.TTSizeMB = 16;
+	_gameOptions.AIThreads = 1;
 
 	_table = nullptr;
 	_winner = nullptr;
@@ -85,6 +88,8 @@ void Game::startGame()
 	turn->_boardState = startState;
 	turn->_gameNumber = _gameOptions.gameNumber;
 	_gameOptions.currentTurnNo = 0;
+	// a search still running belongs to the game before this one
+	_aiJob.cancel();
 }
 
 void Game::endTurn()
@@ -177,39 +182,39 @@ void Game::findDropTarget(ImVec2 &pos)
 //
 void Game::drawFrame()
 {
+	TRACE_ZONE("Game::drawFrame");
 	scanForMouse();
 
 	Grid* grid = getGrid();
 
-	// Paint squares
-	grid->forEachEnabledSquare([](ChessSquare* square, int x, int y) {
+	// Paint squares in one pass over the board, sorting the pieces into the layers they are drawn in
+	for (std::vector<Bit *> &layer : _drawLayers)
+	{
+		layer.clear();
+	}
+	grid->forEachEnabledSquare([this](ChessSquare* square, int x, int y) {
 		square->paintSprite();
-	});
-
-	// Paint stationary pieces
-	grid->forEachEnabledSquare([](ChessSquare* square, int x, int y) {
-		if (square->bit() && !square->bit()->getPickedUp() && !square->bit()->getMoving())
+		if (Bit *bit = square->bit())
 		{
-			square->bit()->paintSprite();
+			const DrawLayer layer = bit->getPickedUp() ? DrawPickedUp : (bit->getMoving() ? DrawMoving : DrawStationary);
+			_drawLayers[layer].push_back(bit);
 		}
 	});
 
-	// Paint moving pieces
-	grid->forEachEnabledSquare([](ChessSquare* square, int x, int y) {
-		if (square->bit() && square->bit()->getMoving() && !square->bit()->getPickedUp())
-		{
-			square->bit()->update();
-			square->bit()->paintSprite();
-		}
-	});
-
-	// Paint picked up pieces
-	grid->forEachEnabledSquare([](ChessSquare* square, int x, int y) {
-		if (square->bit() && square->bit()->getPickedUp())
-		{
-			square->bit()->paintSprite();
-		}
-	});
+	// Paint stationary pieces, then moving ones, then the one picked up on top of everything
+	for (Bit *bit : _drawLayers[DrawStationary])
+	{
+		bit->paintSprite();
+	}
+	for (Bit *bit : _drawLayers[DrawMoving])
+	{
+		bit->update();
+		bit->paintSprite();
+	}
+	for (Bit *bit : _drawLayers[DrawPickedUp])
+	{
+		bit->paintSprite();
+	}
 }
 
 void Game::bitMovedFromTo(Bit &bit, BitHolder &src, BitHolder &dst)
@@ -244,6 +249,16 @@ bool Game::gameHasAI()
 
 void Game::updateAI()
 {
+	TRACE_ZONE("Game::updateAI");
+	if (_aiJob.running())
+	{
+		_aiJob.collect();
+		return;
+	}
+	if (AIJob::Work work = aiWork())
+	{
+		_aiJob.start(std::move(work));
+	}
 }
 
 void Game::mouseDown(ImVec2 &location, Entity *entity)
@@ -22,6 +22,7 @@
 #include "Bit.h"
 #include "BitHolder.h"
 #include "Grid.h"
+#include "AIJob.h"
 
 
 const int AI_PLAYER = 1;
@@ -42,6 +43,8 @@ struct GameOptions
 	int AIDepthSearches;
 	int AIMAXDepth;
 	bool AIvsAI;
+	int TTSizeMB;
+	int AIThreads;
 };
 
 class Game
@@ -94,7 +97,13 @@ public:
 
 	virtual void stopGame() = 0;
 	virtual bool gameHasAI();
+	// called every frame while the AI is to move and must never block: the default starts aiWork() on
+	// _aiJob and plays its result on the frame it's done
 	virtual void updateAI();
+	// what the running (or last) AI search has found so far, for the UI
+	virtual AIProgress aiProgress() const { return _aiJob.progress(); }
+	// have the AI play the best move it has found now
+	virtual void stopAI() { _aiJob.stop(); }
 	virtual void pieceTaken(Bit *bit){};
 
 	virtual std::string initialStateString() = 0;
@@ -138,6 +147,9 @@ public:
 	GameOptions _gameOptions;
 
 protected:
+	// the AI's search for the position on the board, run on _aiJob's thread; nullptr for no AI
+	virtual AIJob::Work aiWork() { return nullptr; }
+
 	void mouseDown(ImVec2 &location, Entity *bit);
 	void mouseMoved(ImVec2 &location, Entity *bit);
 	void mouseUp(ImVec2 &location, Entity *bit);
@@ -151,4 +163,17 @@ protected:
 	BitHolder *_dropTarget;
 	BitHolder *_oldHolder;
 	bool _dragMoved;
+
+	// drawFrame's pieces by the order they are painted in, kept between frames for their capacity
+	enum DrawLayer
+	{
+		DrawStationary,
+		DrawMoving,
+		DrawPickedUp,
+		DrawLayerCount
+	};
+	std::vector<Bit *> _drawLayers[DrawLayerCount];
+
+	// games cancel it in their destructors, before the search it runs goes away
+	AIJob _aiJob;
 };
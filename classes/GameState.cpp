@@ -1,152 +1,350 @@
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include "GameState.h"
 #include "MagicBitboards.h"
+#include "Trace.h"
 
-static int _bitboardLookup[128];
-static bool _initedMagic = false;
-static BitBoard _pawnAttacks[2][64]; // Precomputed pawn attacks for each square
+bool GameState::selectSliderLookup(const std::string& name) {
+    if (name == "magic") {
+        return setSliderLookup(MagicLookup);
+    }
+    return name == "pext" && setSliderLookup(PextLookup);
+}
+
+const char* GameState::sliderLookup() {
+    return sliderLookupName();
+}
 
-void GameState::init(const char* newState, char player) {
-    std::memcpy(state, newState, 64);
+void GameState::init(const char* newState, char player, int castling, int enPassant, int halfmoves, int fullmoves) {
     color = player;
-    flags = 0;
-    _zobristHash[0] = 0;
-    _zobristHash[1] = 0;
+    halfmoveClock = static_cast<uint16_t>(halfmoves);
+    fullmoveNumber = static_cast<uint16_t>(fullmoves > 0 ? fullmoves : 1);
+    stackPtr = 0;
     _attackBitBoard.setData(0);
-    // Clear all bitboards
+    // Clear all bitboards, the one full scan of state[] happens here instead of every generateAllMoves
     for (int i = 0; i < e_numBitboards; ++i) {
         _bitboards[i].setData(0);
     }
+    _bitboards[EMPTY_SQUARES] = ~0ULL;
+    _pstMidgame = 0;
+    _pstEndgame = 0;
+    _pstPhase = 0;
+    std::memset(state, '0', sizeof(state));
+    for (int square = 0; square < 64; square++) {
+        if (newState[square] != '0') {
+            putPiece(square, newState[square]);
+        }
+    }
 
-    if (!_initedMagic) {
-        initMagicBitboards();
-        // remove branching when we make the bitboards
-        for(int i=0; i<128; i++) { _bitboardLookup[i] = 0; }
-
-        _bitboardLookup['P'] = WHITE_PAWNS;
-        _bitboardLookup['N'] = WHITE_KNIGHTS;
-        _bitboardLookup['B'] = WHITE_BISHOPS;
-        _bitboardLookup['R'] = WHITE_ROOKS;
-        _bitboardLookup['Q'] = WHITE_QUEENS;
-        _bitboardLookup['K'] = WHITE_KING;
-        _bitboardLookup['p'] = BLACK_PAWNS;
-        _bitboardLookup['n'] = BLACK_KNIGHTS;
-        _bitboardLookup['b'] = BLACK_BISHOPS;
-        _bitboardLookup['r'] = BLACK_ROOKS;
-        _bitboardLookup['q'] = BLACK_QUEENS;
-        _bitboardLookup['k'] = BLACK_KING;
-        _bitboardLookup['0'] = EMPTY_SQUARES;
-
-        for(int square = 0; square < 64; square++) {
-            _pawnAttacks[0][square].setData(generatePawnAttacksBitBoard(square, WHITE));
-            _pawnAttacks[1][square].setData(generatePawnAttacksBitBoard(square, BLACK));
+    if (castling < 0) {
+        // no history available, assume anything still on its home square keeps its rights
+        castling = 0;
+        if (state[4] == 'K') {
+            if (state[7] == 'R') castling |= WhiteKingSide;
+            if (state[0] == 'R') castling |= WhiteQueenSide;
+        }
+        if (state[60] == 'k') {
+            if (state[63] == 'r') castling |= BlackKingSide;
+            if (state[56] == 'r') castling |= BlackQueenSide;
         }
+    }
+    castlingRights = static_cast<unsigned char>(castling & AllCastling);
+    // like pushMove, only keep a target some pawn can actually take on, so equal positions hash equal
+    enPassantSquare = -1;
+    if (enPassant >= 0 && (enPassant >> 3) == (player == WHITE ? 5 : 2)) {
+        const uint64_t pushedPawn = 1ULL << (player == WHITE ? enPassant - 8 : enPassant + 8);
+        const uint64_t neighbours = ((pushedPawn << 1) & NotAFile) | ((pushedPawn >> 1) & NotHFile);
+        if (neighbours & _bitboards[player == WHITE ? WHITE_PAWNS : BLACK_PAWNS].getData()) {
+            enPassantSquare = static_cast<signed char>(enPassant);
+        }
+    }
+    _zobristHash = computeZobristHash();
+}
 
-        _initedMagic = true;
+bool GameState::loadFEN(const std::string& fen) {
+    std::istringstream fenStream(fen);
+    std::string placement, side = "w", castling, enPassant = "-";
+    int halfmoves = 0, fullmoves = 1;
+    fenStream >> placement >> side >> castling >> enPassant >> halfmoves >> fullmoves;
+
+    char board[64];
+    std::memset(board, '0', sizeof(board));
+    int rank = 7, file = 0;
+    for (char ch : placement) {
+        if (ch == '/') {
+            rank--;
+            file = 0;
+        } else if (ch >= '1' && ch <= '8') {
+            file += ch - '0';
+        } else {
+            if (rank < 0 || file > 7 || std::strchr("PNBRQKpnbrqk", ch) == nullptr) {
+                return false;
+            }
+            board[rank * 8 + file++] = ch;
+        }
+    }
+    if (rank != 0 || (side != "w" && side != "b")) {
+        return false;
+    }
 
-        std::cout << "initialized magic bitboards and bitboard lookup" << std::endl;
+    // a bare board keeps whatever rights the pieces still could have
+    int rights = castling.empty() ? -1 : 0;
+    for (char ch : castling) {
+        if (ch == 'K') rights |= WhiteKingSide;
+        if (ch == 'Q') rights |= WhiteQueenSide;
+        if (ch == 'k') rights |= BlackKingSide;
+        if (ch == 'q') rights |= BlackQueenSide;
+    }
+    int epSquare = -1;
+    if (enPassant.size() == 2 && enPassant[0] >= 'a' && enPassant[0] <= 'h' && (enPassant[1] == '3' || enPassant[1] == '6')) {
+        epSquare = (enPassant[0] - 'a') + (enPassant[1] - '1') * 8;
     }
+
+    init(board, side == "b" ? BLACK : WHITE, rights, epSquare, halfmoves, fullmoves);
+    return true;
 }
 
-void GameState::shutdown() {
-    cleanupMagicBitboards();
+std::string GameState::toFEN() const {
+    std::string fen;
+    fen.reserve(90);
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            const char piece = state[rank * 8 + file];
+            if (piece == '0') {
+                empty++;
+                continue;
+            }
+            if (empty > 0) {
+                fen += static_cast<char>('0' + empty);
+                empty = 0;
+            }
+            fen += piece;
+        }
+        if (empty > 0) {
+            fen += static_cast<char>('0' + empty);
+        }
+        if (rank > 0) {
+            fen += '/';
+        }
+    }
+
+    fen += (color == WHITE) ? " w " : " b ";
+    if (castlingRights & WhiteKingSide) fen += 'K';
+    if (castlingRights & WhiteQueenSide) fen += 'Q';
+    if (castlingRights & BlackKingSide) fen += 'k';
+    if (castlingRights & BlackQueenSide) fen += 'q';
+    if (castlingRights == 0) fen += '-';
+
+    fen += ' ';
+    if (enPassantSquare >= 0) {
+        fen += static_cast<char>('a' + (enPassantSquare & 7));
+        fen += static_cast<char>('1' + (enPassantSquare >> 3));
+    } else {
+        fen += '-';
+    }
+    fen += ' ' + std::to_string(halfmoveClock) + ' ' + std::to_string(fullmoveNumber);
+    return fen;
 }
 
-void GameState::addPawnBitboardMovesToList(std::vector<BitMove>& moves, const BitBoard bitboard, const int shift) {
-    if (bitboard.getData() == 0)
-        return;
-    bitboard.forEachBit([&](int toSquare) {
-        int fromSquare = toSquare - shift; // Correct calculation for fromSquare
-        moves.emplace_back(fromSquare, toSquare, Pawn);
+uint64_t GameState::computeZobristHash() const {
+    uint64_t hash = 0;
+    for (int square = 0; square < 64; square++) {
+        if (state[square] != '0') {
+            hash ^= _zobristKeys.pieces[_bitboardLookup[(unsigned char)state[square]]][square];
+        }
+    }
+    hash ^= _zobristKeys.castling[castlingRights];
+    if (enPassantSquare >= 0) {
+        hash ^= _zobristKeys.enPassant[enPassantSquare & 7];
+    }
+    if (color == BLACK) {
+        hash ^= _zobristKeys.sideToMove;
+    }
+    return hash;
+}
+
+int GameState::computePstScore() const {
+    int midgame = 0;
+    int endgame = 0;
+    int phase = 0;
+    for (int square = 0; square < 64; square++) {
+        if (state[square] != '0') {
+            const int index = _bitboardLookup[(unsigned char)state[square]];
+            midgame += _pieceSquareTables.midgame[index][square];
+            endgame += _pieceSquareTables.endgame[index][square];
+            phase += _pieceSquareTables.phase[index];
+        }
+    }
+    phase = phase < PST_MAX_PHASE ? phase : PST_MAX_PHASE;
+    return (midgame * phase + endgame * (PST_MAX_PHASE - phase)) / PST_MAX_PHASE;
+}
+
+// Add one move per destination, splitting captures from quiet moves so the flag is set once per batch
+static inline void addPieceMoves(MoveList& moves, int fromSquare, uint64_t destinations, ChessPiece piece, uint64_t enemies) {
+    BitBoard(destinations & enemies).forEachBit([&](int toSquare) {
+        moves.emplace_back(fromSquare, toSquare, piece, IsCapture);
+    });
+    BitBoard(destinations & ~enemies).forEachBit([&](int toSquare) {
+        moves.emplace_back(fromSquare, toSquare, piece);
+    });
+}
+
+// Everything about the side to move that the generators need, so a generator instantiated for one side
+// has its shifts, ranks and bitboard indices folded into constants
+template <int Us>
+struct SideTraits {
+    static constexpr int them = -Us;
+    static constexpr int pieces = Us == WHITE ? WHITE_PAWNS : BLACK_PAWNS;        // AllBitBoards base of our pieces
+    static constexpr int enemyPieces = Us == WHITE ? BLACK_PAWNS : WHITE_PAWNS;
+    static constexpr int forward = Us == WHITE ? 8 : -8;
+    static constexpr int captureLeft = Us == WHITE ? 7 : -9;                      // toward the a file
+    static constexpr int captureRight = Us == WHITE ? 9 : -7;
+    static constexpr uint64_t doublePushRank = Us == WHITE ? Rank3 : Rank6;     // where a single push may go on
+    static constexpr int pawnAttacks = Us == WHITE ? 0 : 1;                       // our row of PawnAttacks
+    static constexpr int kingHome = Us == WHITE ? 4 : 60;
+    static constexpr char rook = Us == WHITE ? 'R' : 'r';
+    static constexpr int kingSide = Us == WHITE ? WhiteKingSide : BlackKingSide;
+    static constexpr int queenSide = Us == WHITE ? WhiteQueenSide : BlackQueenSide;
+};
+
+template <int Shift>
+static constexpr uint64_t shiftBoard(uint64_t board) {
+    if constexpr (Shift > 0) {
+        return board << Shift;
+    } else {
+        return board >> -Shift;
+    }
+}
+
+// Pawn moves that all travel by Shift, anything landing on the back ranks promotes, queen first so it
+// is the default pick for the UI
+template <int Shift, int Flags>
+static inline void addPawnMoves(MoveList& moves, uint64_t destinations) {
+    BitBoard(destinations & (Rank1 | Rank8)).forEachBit([&](int toSquare) {
+        const int fromSquare = toSquare - Shift;
+        moves.emplace_back(fromSquare, toSquare, Pawn, Flags | IsPromotion);
+        moves.emplace_back(fromSquare, toSquare, Pawn, Flags | IsPromotion | PromoteKnight);
+        moves.emplace_back(fromSquare, toSquare, Pawn, Flags | IsPromotion | PromoteRook);
+        moves.emplace_back(fromSquare, toSquare, Pawn, Flags | IsPromotion | PromoteBishop);
+    });
+    BitBoard(destinations & ~(Rank1 | Rank8)).forEachBit([&](int toSquare) {
+        moves.emplace_back(toSquare - Shift, toSquare, Pawn, Flags);
     });
 }
 
-void GameState::generatePawnMoveList(std::vector<BitMove>& moves, const BitBoard pawns, const BitBoard emptySquares, const BitBoard enemyPieces, char color) {
-    if (pawns.getData() == 0)
+// A whole set of pawns at once: captures may land on targets, pushes on pushTargets
+template <int Us>
+void GameState::generatePawnMoves(MoveList& moves, uint64_t pawns, uint64_t targets, uint64_t pushTargets, const MoveGenContext& context) {
+    using Side = SideTraits<Us>;
+    if (!pawns) {
         return;
+    }
+    const uint64_t emptySquares = ~context.occupancy;
+    const uint64_t singleMoves = shiftBoard<Side::forward>(pawns) & emptySquares;
+    const uint64_t doubleMoves = shiftBoard<Side::forward>(singleMoves & Side::doublePushRank) & emptySquares;
+    const uint64_t capturesLeft = shiftBoard<Side::captureLeft>(pawns & NotAFile) & context.enemies;
+    const uint64_t capturesRight = shiftBoard<Side::captureRight>(pawns & NotHFile) & context.enemies;
+
+    addPawnMoves<Side::forward, 0>(moves, singleMoves & pushTargets);
+    addPawnMoves<2 * Side::forward, 0>(moves, doubleMoves & pushTargets);
+    addPawnMoves<Side::captureLeft, IsCapture>(moves, capturesLeft & targets);
+    addPawnMoves<Side::captureRight, IsCapture>(moves, capturesRight & targets);
+}
 
-    BitBoard demoRight(NotAFile);
-    BitBoard demoLeft(NotHFile);
-
-    // Calculate single pawn moves forward
-    BitBoard singleMoves = (color == WHITE) ? (pawns.getData() << 8) & emptySquares.getData() : (pawns.getData() >> 8) & emptySquares.getData();
-    // Calculate double pawn moves from starting rank
-    BitBoard doubleMoves = (color == WHITE) ? ((singleMoves.getData() & Rank3) << 8) & emptySquares.getData() : ((singleMoves.getData() & Rank6) >> 8) & emptySquares.getData();
-    // Calculate left and right pawn captures
-    BitBoard capturesLeft = (color == WHITE) ? ((pawns.getData() & NotAFile) << 7) & enemyPieces.getData() : ((pawns.getData() & NotAFile) >> 9) & enemyPieces.getData();
-    BitBoard capturesRight = (color == WHITE) ? ((pawns.getData() & NotHFile) << 9) & enemyPieces.getData() : ((pawns.getData() & NotHFile) >> 7) & enemyPieces.getData();
-
-    int shiftForward = (color == WHITE) ? 8 : -8;
-    int doubleShift = (color == WHITE) ? 16 : -16;
-    int captureLeftShift = (color == WHITE) ? 7 : -9;
-    int captureRightShift = (color == WHITE) ? 9 : -7;
-    
-    // Add single pawn moves to the list
-    addPawnBitboardMovesToList(moves, singleMoves, shiftForward);
-
-    // Add double pawn moves to the list
-    addPawnBitboardMovesToList(moves, doubleMoves, doubleShift);
-
-    // Add pawn captures to the list
-    addPawnBitboardMovesToList(moves, capturesLeft, captureLeftShift);
-    addPawnBitboardMovesToList(moves, capturesRight, captureRightShift);
+// Pinned pieces may only move along the ray between their king and the pinning piece
+static inline uint64_t pinMask(const MoveGenContext& context, int square) {
+    return (context.pinned & (1ULL << square)) ? context.pinRays[square] : ~0ULL;
 }
 
 // Generate actual move objects from a bitboard
-void GameState::generateKnightMoves(std::vector<BitMove>& moves, BitBoard knightBoard, uint64_t occupancy) {
-    knightBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(KnightAttacks[fromSquare] & occupancy);
-        // Efficiently iterate through only the set bits
-        moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Knight);
-        });
+void GameState::generateKnightMoves(MoveList& moves, BitBoard knightBoard, const MoveGenContext& context) {
+    // a pinned knight can never stay on its pin ray
+    BitBoard(knightBoard.getData() & ~context.pinned).forEachBit([&](int fromSquare) {
+        addPieceMoves(moves, fromSquare, KnightAttacks[fromSquare] & context.targets, Knight, context.enemies);
     });
 }
 
-// Generate actual move objects from a bitboard
-void GameState::generateKingMoves(std::vector<BitMove>& moves, BitBoard piecesBoard, uint64_t occupancy) {
-    piecesBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(KingAttacks[fromSquare] & occupancy);
-        // Efficiently iterate through only the set bits
-        moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, King);
-        });
+// King moves get the full verification: every destination is checked with the king lifted off the board
+// so sliders see through the square it is leaving
+template <int Us>
+void GameState::generateKingMoves(MoveList& moves, int kingSquare, const MoveGenContext& context) {
+    const uint64_t occupancy = context.occupancy & ~(1ULL << kingSquare);
+    uint64_t destinations = 0;
+    BitBoard(KingAttacks[kingSquare] & context.kingTargets).forEachBit([&](int toSquare) {
+        if (!isSquareAttacked(toSquare, SideTraits<Us>::them, occupancy)) {
+            destinations |= 1ULL << toSquare;
+        }
+    });
+    addPieceMoves(moves, kingSquare, destinations, King, context.enemies);
+}
+
+// Castling is never generated while in check, so only the rook's path and the king's two steps need testing
+template <int Us>
+void GameState::generateCastlingMoves(MoveList& moves, int kingSquare, const MoveGenContext& context) {
+    using Side = SideTraits<Us>;
+    constexpr int home = Side::kingHome;
+    if (kingSquare != home) {
+        return;
+    }
+
+    if ((castlingRights & Side::kingSide) && state[home + 3] == Side::rook &&
+        !(context.occupancy & ((1ULL << (home + 1)) | (1ULL << (home + 2)))) &&
+        !isSquareAttacked(home + 1, Side::them, context.occupancy) &&
+        !isSquareAttacked(home + 2, Side::them, context.occupancy)) {
+        moves.emplace_back(home, home + 2, King, KingSideCastle);
+    }
+    if ((castlingRights & Side::queenSide) && state[home - 4] == Side::rook &&
+        !(context.occupancy & ((1ULL << (home - 1)) | (1ULL << (home - 2)) | (1ULL << (home - 3)))) &&
+        !isSquareAttacked(home - 1, Side::them, context.occupancy) &&
+        !isSquareAttacked(home - 2, Side::them, context.occupancy)) {
+        moves.emplace_back(home, home - 2, King, QueenSideCastle);
+    }
+}
+
+// En passant removes two pawns from the same rank, which no pin mask describes, so it is verified by
+// replaying the occupancy change and looking for any attacker left on the king
+template <int Us>
+void GameState::generateEnPassantMoves(MoveList& moves, int kingSquare, const MoveGenContext& context) {
+    using Side = SideTraits<Us>;
+    const int capturedSquare = enPassantSquare - Side::forward;
+    const uint64_t capturedMask = 1ULL << capturedSquare;
+    // our pawns that attack the target sit where an enemy pawn on the target would attack
+    const uint64_t attackers = PawnAttacks[1 - Side::pawnAttacks][enPassantSquare] & _bitboards[Side::pieces + WHITE_PAWNS].getData();
+
+    BitBoard(attackers).forEachBit([&](int fromSquare) {
+        if (kingSquare >= 0) {
+            const uint64_t occupancy = (context.occupancy & ~(1ULL << fromSquare) & ~capturedMask) | (1ULL << enPassantSquare);
+            if (attackersTo(kingSquare, occupancy) & context.enemies & ~capturedMask) {
+                return;
+            }
+        }
+        moves.emplace_back(fromSquare, enPassantSquare, Pawn, EnPassant | IsCapture);
     });
 }
 
 // Generate actual move objects from a bitboard
-void GameState::generateBishopMoves(std::vector<BitMove>& moves, BitBoard piecesBoard, uint64_t occupancy, uint64_t friendlies)
+void GameState::generateBishopMoves(MoveList& moves, BitBoard piecesBoard, const MoveGenContext& context)
 {
     piecesBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(getBishopAttacks(fromSquare, occupancy) & ~friendlies);
-        // Efficiently iterate through only the set bits
-        moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Bishop);
-        });
+        addPieceMoves(moves, fromSquare, getBishopAttacks(fromSquare, context.occupancy) & context.targets & pinMask(context, fromSquare), Bishop, context.enemies);
     });
 }
 
-void GameState::generateRooksMoves(std::vector<BitMove>& moves, BitBoard piecesBoard, uint64_t occupancy, uint64_t friendlies)
+void GameState::generateRooksMoves(MoveList& moves, BitBoard piecesBoard, const MoveGenContext& context)
 {
     piecesBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(getRookAttacks(fromSquare, occupancy) & ~friendlies);
-        // Efficiently iterate through only the set bits
-        moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Rook);
-        });
+        addPieceMoves(moves, fromSquare, getRookAttacks(fromSquare, context.occupancy) & context.targets & pinMask(context, fromSquare), Rook, context.enemies);
     });
 }
 
-void GameState::generateQueensMoves(std::vector<BitMove>& moves, BitBoard piecesBoard, uint64_t occupancy, uint64_t friendlies)
+void GameState::generateQueensMoves(MoveList& moves, BitBoard piecesBoard, const MoveGenContext& context)
 {
     piecesBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(getQueenAttacks(fromSquare, occupancy) & ~friendlies);
-        // Efficiently iterate through only the set bits
-        moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Queen);
-        });
+        addPieceMoves(moves, fromSquare, getQueenAttacks(fromSquare, context.occupancy) & context.targets & pinMask(context, fromSquare), Queen, context.enemies);
     });
 }
 
@@ -186,195 +384,262 @@ inline BitBoard generatePieceAttackList(
     return attacks;
 }
 
-uint64_t GameState::generatePawnAttacksBitBoard(int square, char color) {
-    uint64_t bitboard = 0ULL;
-    int rank = square / 8;
-    int file = square % 8;
-
-    // Pawns can only attack diagonally forward
-    // For white: up-right and up-left
-    // For black: down-right and down-left
-    const int direction = (color == WHITE) ? 1 : -1;
-    
-    // Check diagonal left attack
-    if (file > 0) {  // Not on a-file
-        int r = rank + direction;
-        int f = file - 1;
-        if (r >= 0 && r < 8) {  // Stay within board bounds
-            bitboard |= 1ULL << (r * 8 + f);
-        }
-    }
-    
-    // Check diagonal right attack
-    if (file < 7) {  // Not on h-file
-        int r = rank + direction;
-        int f = file + 1;
-        if (r >= 0 && r < 8) {  // Stay within board bounds
-            bitboard |= 1ULL << (r * 8 + f);
-        }
-    }
-    return bitboard;
-}
-
 const BitBoard GameState::generatePawnAttacks(const BitBoard pawns, char color) {
     BitBoard result(0);
 
     pawns.forEachBit([&](int fromSquare) {
         // Using precomputed or dynamic logic
-        result |= _pawnAttacks[color == WHITE ? 0 : 1][fromSquare];
+        result |= PawnAttacks[color == WHITE ? 0 : 1][fromSquare];
     });
 
     return result;
 }
 
-// Returns true if 'square' is attacked by any piece belonging to 'attackerColor'
-bool GameState::isSquareAttacked(int square, char attackerColor, const BitBoard (&boards)[e_numBitboards]) {
-	const int pawnIdx   = (attackerColor == WHITE) ? WHITE_PAWNS : BLACK_PAWNS;
-	const int knightIdx = (attackerColor == WHITE) ? WHITE_KNIGHTS : BLACK_KNIGHTS;
-	const int bishopIdx = (attackerColor == WHITE) ? WHITE_BISHOPS : BLACK_BISHOPS;
-	const int rookIdx   = (attackerColor == WHITE) ? WHITE_ROOKS : BLACK_ROOKS;
-	const int queenIdx  = (attackerColor == WHITE) ? WHITE_QUEENS : BLACK_QUEENS;
-	const int kingIdx   = (attackerColor == WHITE) ? WHITE_KING : BLACK_KING;
+// Returns every piece of either color attacking 'square' for the given occupancy
+uint64_t GameState::attackersTo(int square, uint64_t occupancy) const {
+	const uint64_t diagonals = _bitboards[WHITE_BISHOPS].getData() | _bitboards[BLACK_BISHOPS].getData() |
+	                           _bitboards[WHITE_QUEENS].getData() | _bitboards[BLACK_QUEENS].getData();
+	const uint64_t straights = _bitboards[WHITE_ROOKS].getData() | _bitboards[BLACK_ROOKS].getData() |
+	                           _bitboards[WHITE_QUEENS].getData() | _bitboards[BLACK_QUEENS].getData();
+	// a white pawn attacks 'square' from wherever a black pawn on 'square' would attack, and vice versa
+	return (PawnAttacks[1][square] & _bitboards[WHITE_PAWNS].getData()) |
+	       (PawnAttacks[0][square] & _bitboards[BLACK_PAWNS].getData()) |
+	       (KnightAttacks[square] & (_bitboards[WHITE_KNIGHTS].getData() | _bitboards[BLACK_KNIGHTS].getData())) |
+	       (KingAttacks[square] & (_bitboards[WHITE_KING].getData() | _bitboards[BLACK_KING].getData())) |
+	       (getBishopAttacks(square, occupancy) & diagonals) |
+	       (getRookAttacks(square, occupancy) & straights);
+}
 
-	// Get Occupancy of all pieces for sliding checks
-	BitBoard occ = boards[OCCUPANCY];
+// Returns true if 'square' is attacked by any piece belonging to 'attackerColor'
+bool GameState::isSquareAttacked(int square, char attackerColor, uint64_t occupancy) const {
+	const int base = (attackerColor == WHITE) ? WHITE_PAWNS : BLACK_PAWNS;
 
-	// Check Pawn Attacks
-	char targetColor = (attackerColor == WHITE) ? BLACK : WHITE; 
-	if ((generatePawnAttacksBitBoard(square, targetColor) & boards[pawnIdx].getData()) != 0) return true;
+	// Check Pawn Attacks, using the precomputed table of the defending color
+	if ((PawnAttacks[attackerColor == WHITE ? 1 : 0][square] & _bitboards[base + WHITE_PAWNS].getData()) != 0) return true;
 
 	// Check Knight Attacks
-	if ((KnightAttacks[square] & boards[knightIdx].getData()) != 0) return true;
+	if ((KnightAttacks[square] & _bitboards[base + WHITE_KNIGHTS].getData()) != 0) return true;
 
 	// Check King Attacks (Neighboring kings)
-	if ((KingAttacks[square] & boards[kingIdx].getData()) != 0) return true;
+	if ((KingAttacks[square] & _bitboards[base + WHITE_KING].getData()) != 0) return true;
+
+	const uint64_t queens = _bitboards[base + WHITE_QUEENS].getData();
 
 	// Check Bishop/Queen (Diagonal) Attacks
-	uint64_t diagonalAttacks = getBishopAttacks(square, occ.getData());
-	if ((diagonalAttacks & (boards[bishopIdx].getData() | boards[queenIdx].getData())) != 0) return true;
+	if ((getBishopAttacks(square, occupancy) & (_bitboards[base + WHITE_BISHOPS].getData() | queens)) != 0) return true;
 
 	// Check Rook/Queen (Straight) Attacks
-	uint64_t straightAttacks = getRookAttacks(square, occ.getData());
-	if ((straightAttacks & (boards[rookIdx].getData() | boards[queenIdx].getData())) != 0) return true;
+	if ((getRookAttacks(square, occupancy) & (_bitboards[base + WHITE_ROOKS].getData() | queens)) != 0) return true;
 
 	return false;
 }
 
-void GameState::filterOutIllegalMoves(std::vector<BitMove>& moves) {
-	if (moves.empty()) return;
-
-	const char myColor = color;
-	const char opponentColor = (color == WHITE) ? BLACK : WHITE;
-	const int myKingIdx = (myColor == WHITE) ? WHITE_KING : BLACK_KING;
-
-	// Remove moves that leave the king in check
-	moves.erase(std::remove_if(moves.begin(), moves.end(), [&](const BitMove& move) {
-		
-		// Create a temporary copy of the board state
-		BitBoard tempBoards[e_numBitboards];
-		for (int i = 0; i < e_numBitboards; ++i) tempBoards[i] = _bitboards[i];
-
-		// Apply the move to the temporary boards
-		// Note: We just need occupancy correct for check detection.
-		
-		const uint64_t fromMask = 1ULL << move.from;
-		const uint64_t toMask   = 1ULL << move.to;
-		
-		// Helper to determine which bitboard a piece belongs to
-		auto getPieceIdx = [&](ChessPiece p, char c) {
-			if (p == Pawn) return c == WHITE ? WHITE_PAWNS : BLACK_PAWNS;
-			if (p == Knight) return c == WHITE ? WHITE_KNIGHTS : BLACK_KNIGHTS;
-			if (p == Bishop) return c == WHITE ? WHITE_BISHOPS : BLACK_BISHOPS;
-			if (p == Rook) return c == WHITE ? WHITE_ROOKS : BLACK_ROOKS;
-			if (p == Queen) return c == WHITE ? WHITE_QUEENS : BLACK_QUEENS;
-			return c == WHITE ? WHITE_KING : BLACK_KING; // King
-		};
-
-		int moverIdx = getPieceIdx(static_cast<ChessPiece>(move.piece), myColor);
-		
-		// Remove from 'from'
-		tempBoards[moverIdx] &= ~fromMask;
-		tempBoards[OCCUPANCY] &= ~fromMask;
-
-		// Handle Captures (Remove opponent piece at 'to')
-		// We scan opponent boards to find what was captured (slower than lookup, but safe for generic bitboards)
-		int startOpp = (opponentColor == WHITE) ? WHITE_PAWNS : BLACK_PAWNS;
-		int endOpp   = (opponentColor == WHITE) ? WHITE_KING : BLACK_KING;
-		
-		// Specialized handling for En Passant
-		if (move.flags & EnPassant) {
-			int capSq = (myColor == WHITE) ? (move.to - 8) : (move.to + 8);
-			uint64_t capMask = 1ULL << capSq;
-			tempBoards[startOpp] &= ~capMask; // Opponent Pawns
-			tempBoards[OCCUPANCY] &= ~capMask;
-		} else {
-			// Standard capture
-			for (int i = startOpp; i <= endOpp; ++i) {
-				tempBoards[i] &= ~toMask;
-			}
-			tempBoards[OCCUPANCY] &= ~toMask; // Clear strictly to ensure no overlap before adding
-		}
-
-		// Handle Promotion
-		if ((move.flags & IsPromotion)) {
-			moverIdx = getPieceIdx(Queen, myColor); // Assume Queen promotion for check safety (mostly covers it)
-		}
+uint64_t GameState::attackedBy(char attackerColor) const {
+	const int base = (attackerColor == WHITE) ? WHITE_PAWNS : BLACK_PAWNS;
+	const uint64_t occupancy = _bitboards[OCCUPANCY].getData();
+	const uint64_t pawns = _bitboards[base + WHITE_PAWNS].getData();
+	const uint64_t queens = _bitboards[base + WHITE_QUEENS].getData();
+	uint64_t attacks = (attackerColor == WHITE) ? WHITE_PAWN_ATTACKS(pawns) : BLACK_PAWN_ATTACKS(pawns);
+	for (uint64_t knights = _bitboards[base + WHITE_KNIGHTS].getData(); knights; knights &= knights - 1) {
+		attacks |= KnightAttacks[BitBoard(knights).firstBit()];
+	}
+	for (uint64_t diagonals = _bitboards[base + WHITE_BISHOPS].getData() | queens; diagonals; diagonals &= diagonals - 1) {
+		attacks |= getBishopAttacks(BitBoard(diagonals).firstBit(), occupancy);
+	}
+	for (uint64_t straights = _bitboards[base + WHITE_ROOKS].getData() | queens; straights; straights &= straights - 1) {
+		attacks |= getRookAttacks(BitBoard(straights).firstBit(), occupancy);
+	}
+	const int kingSquare = _bitboards[base + WHITE_KING].firstBit();
+	if (kingSquare >= 0) {
+		attacks |= KingAttacks[kingSquare];
+	}
+	return attacks;
+}
 
-		// Add to 'to'
-		tempBoards[moverIdx] |= toMask;
-		tempBoards[OCCUPANCY] |= toMask;
-
-		// Handle King Move (Update King Index tracking)
-		int currentKingSquare = -1;
-		if (move.piece == King) {
-			currentKingSquare = move.to;
-		} else {
-			// If king didn't move, find him
-			currentKingSquare = tempBoards[myKingIdx].firstBit();
+// The swap algorithm: gain[d] is what the side making capture d has won if the exchange stops there.
+// Each capture is made with the cheapest attacker left, sliders behind it join in as it leaves, and
+// working back from the end either side may decline to recapture
+int GameState::see(const BitMove& move) const {
+	const int to = move.to;
+	const uint64_t diagonals = _bitboards[WHITE_BISHOPS].getData() | _bitboards[BLACK_BISHOPS].getData() |
+	                           _bitboards[WHITE_QUEENS].getData() | _bitboards[BLACK_QUEENS].getData();
+	const uint64_t straights = _bitboards[WHITE_ROOKS].getData() | _bitboards[BLACK_ROOKS].getData() |
+	                           _bitboards[WHITE_QUEENS].getData() | _bitboards[BLACK_QUEENS].getData();
+	uint64_t occupancy = _bitboards[OCCUPANCY].getData() & ~(1ULL << move.from);
+
+	int gain[32];
+	int victim = NoPiece;
+	if (move.flags & EnPassant) {
+		victim = Pawn;
+		occupancy &= ~(1ULL << (color == WHITE ? to - 8 : to + 8));
+	} else if (state[to] != '0') {
+		victim = _bitboardLookup[(unsigned char)state[to]] % BLACK_PAWNS + Pawn;
+	}
+	gain[0] = SEE_VALUES[victim];
+	int onSquare = SEE_VALUES[move.piece];
+	if (move.flags & IsPromotion) {
+		gain[0] += SEE_VALUES[move.promotionPiece()] - SEE_VALUES[Pawn];
+		onSquare = SEE_VALUES[move.promotionPiece()];
+	}
+
+	uint64_t attackers = attackersTo(to, occupancy) & occupancy;
+	int side = (color == WHITE) ? BLACK_PAWNS : WHITE_PAWNS;
+	int depth = 0;
+	while (depth < 31) {
+		depth++;
+		gain[depth] = onSquare - gain[depth - 1];
+		// neither side can do better by going on
+		if (std::max(-gain[depth - 1], gain[depth]) < 0) break;
+
+		const uint64_t ours = attackers & _bitboards[side + WHITE_ALL_PIECES].getData();
+		int piece = NoPiece;
+		uint64_t from = 0;
+		for (int type = Pawn; type <= King; type++) {
+			from = ours & _bitboards[side + type - Pawn].getData();
+			if (from) {
+				piece = type;
+				break;
+			}
 		}
+		// the king only takes last, onto a square nothing defends
+		if (piece == NoPiece || (piece == King && (attackers & ~ours))) break;
+
+		from &= ~from + 1;
+		occupancy &= ~from;
+		if (piece == Pawn || piece == Bishop || piece == Queen) attackers |= getBishopAttacks(to, occupancy) & diagonals;
+		if (piece == Rook || piece == Queen) attackers |= getRookAttacks(to, occupancy) & straights;
+		attackers &= occupancy;
+		onSquare = SEE_VALUES[piece];
+		side = (side == WHITE_PAWNS) ? BLACK_PAWNS : WHITE_PAWNS;
+	}
+	while (--depth) {
+		gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+	}
+	return gain[0];
+}
 
-		// If the King is attacked by the opponent after this move, the move is illegal.
-		return isSquareAttacked(currentKingSquare, opponentColor, tempBoards);
-
-	}), moves.end());
+bool GameState::isInCheck() const {
+	const int kingSquare = _bitboards[color == WHITE ? WHITE_KING : BLACK_KING].firstBit();
+	return kingSquare >= 0 && isSquareAttacked(kingSquare, color == WHITE ? BLACK : WHITE, _bitboards[OCCUPANCY].getData());
 }
 
-std::vector<BitMove> GameState::generateAllMoves()
+// Legal move generation: the checkers and pinned pieces are found once for the node, then every
+// generator only emits moves that respect them. Only king moves and en passant need a full test.
+// Instantiated per side and move type, so the only runtime branch on either is in generateAllMoves.
+template <int Us, MoveGenType Type>
+void GameState::generateMoves(MoveList& moves)
 {
-    std::vector<BitMove> moves;
-    moves.reserve(32);
-
-    for (int i=0; i<e_numBitboards; i++) {
-        _bitboards[i] = 0;
+    using Side = SideTraits<Us>;
+    moves.clear();
+
+    // _bitboards are maintained incrementally by init/pushMove/popState
+    const int kingSquare = _bitboards[Side::pieces + WHITE_KING].firstBit();
+
+    MoveGenContext context;
+    context.occupancy = _bitboards[OCCUPANCY].getData();
+    context.friendlies = _bitboards[Side::pieces + WHITE_ALL_PIECES].getData();
+    context.enemies = _bitboards[Side::enemyPieces + WHITE_ALL_PIECES].getData();
+    context.targets = ~context.friendlies;
+    context.pinned = 0;
+    if constexpr (Type == NoisyMoves) {
+        context.kingTargets = context.enemies;
+    } else if constexpr (Type == QuietMoves) {
+        context.kingTargets = ~context.occupancy;
+    } else {
+        context.kingTargets = ~context.friendlies;
     }
 
-    for(int i = 0; i<64; i++) {
-        int bitIndex = _bitboardLookup[(unsigned char)state[i]];
-        _bitboards[bitIndex] |= 1ULL << i;
-    }
+    uint64_t checkers = 0;
+    if (kingSquare >= 0) {
+        checkers = attackersTo(kingSquare, context.occupancy) & context.enemies;
+        if constexpr (Type == Evasions) {
+            if (!checkers) {
+                return;
+            }
+        }
 
-    _bitboards[WHITE_ALL_PIECES] = _bitboards[WHITE_PAWNS].getData() | _bitboards[WHITE_KNIGHTS].getData() |
-    _bitboards[WHITE_BISHOPS].getData() | _bitboards[WHITE_ROOKS].getData() |
-    _bitboards[WHITE_QUEENS].getData() | _bitboards[WHITE_KING].getData();
+        // enemy sliders that would hit the king if only enemy pieces were on the board are pinning
+        // whichever single friendly piece stands between them and the king
+        const uint64_t enemyQueens = _bitboards[Side::enemyPieces + WHITE_QUEENS].getData();
+        const uint64_t snipers = (getRookAttacks(kingSquare, context.enemies) & (_bitboards[Side::enemyPieces + WHITE_ROOKS].getData() | enemyQueens)) |
+                                 (getBishopAttacks(kingSquare, context.enemies) & (_bitboards[Side::enemyPieces + WHITE_BISHOPS].getData() | enemyQueens));
+        BitBoard(snipers).forEachBit([&](int sniper) {
+            const uint64_t blockers = _betweenTable.squares[kingSquare][sniper] & context.occupancy;
+            if (blockers && !(blockers & (blockers - 1)) && (blockers & context.friendlies)) {
+                context.pinned |= blockers;
+                context.pinRays[BitBoard(blockers).firstBit()] = _betweenTable.squares[kingSquare][sniper] | (1ULL << sniper);
+            }
+        });
+
+        if (checkers & (checkers - 1)) {
+            // double check, only the king can move
+            generateKingMoves<Us>(moves, kingSquare, context);
+            return;
+        }
+        if (checkers) {
+            // single check, everything else must capture the checker or block its ray
+            context.targets = checkers | _betweenTable.squares[kingSquare][BitBoard(checkers).firstBit()];
+        }
+    } else if constexpr (Type == Evasions) {
+        return;
+    }
 
-    _bitboards[BLACK_ALL_PIECES] = _bitboards[BLACK_PAWNS].getData() | _bitboards[BLACK_KNIGHTS].getData() |
-    _bitboards[BLACK_BISHOPS].getData() | _bitboards[BLACK_ROOKS].getData() |
-    _bitboards[BLACK_QUEENS].getData() | _bitboards[BLACK_KING].getData();
-    
-    _bitboards[OCCUPANCY] = _bitboards[WHITE_ALL_PIECES].getData() | _bitboards[BLACK_ALL_PIECES].getData();
+    // pushes are noisy exactly when they promote
+    if constexpr (Type == NoisyMoves) {
+        context.pushTargets = context.targets & (Rank1 | Rank8);
+        context.targets &= context.enemies;
+    } else if constexpr (Type == QuietMoves) {
+        context.pushTargets = context.targets & ~(Rank1 | Rank8);
+        context.targets &= ~context.enemies;
+    } else {
+        context.pushTargets = context.targets;
+    }
 
-    int bitIndex = color == WHITE ? WHITE_PAWNS : BLACK_PAWNS;
-    int oppBitIndex = color == WHITE ? BLACK_PAWNS : WHITE_PAWNS;
+    generateKnightMoves(moves, _bitboards[Side::pieces + WHITE_KNIGHTS], context);
 
-    generateKnightMoves(moves, _bitboards[WHITE_KNIGHTS + bitIndex], ~_bitboards[WHITE_ALL_PIECES + bitIndex].getData());
-    generatePawnMoveList(moves, _bitboards[WHITE_PAWNS  + bitIndex], ~_bitboards[OCCUPANCY].getData(), _bitboards[WHITE_ALL_PIECES + oppBitIndex].getData(), color);
-    generateKingMoves(moves, _bitboards[WHITE_KING + bitIndex], ~_bitboards[WHITE_ALL_PIECES + bitIndex].getData());
-    generateBishopMoves(moves, _bitboards[WHITE_BISHOPS + bitIndex], _bitboards[OCCUPANCY].getData(), _bitboards[WHITE_ALL_PIECES + bitIndex].getData());
-    generateRooksMoves(moves, _bitboards[WHITE_ROOKS + bitIndex], _bitboards[OCCUPANCY].getData(), _bitboards[WHITE_ALL_PIECES + bitIndex].getData());
-    generateQueensMoves(moves, _bitboards[WHITE_QUEENS + bitIndex], _bitboards[OCCUPANCY].getData(), _bitboards[WHITE_ALL_PIECES + bitIndex].getData());
+    // unpinned pawns are generated a whole bitboard at a time, pinned ones one by one along their ray
+    const uint64_t pawns = _bitboards[Side::pieces + WHITE_PAWNS].getData();
+    generatePawnMoves<Us>(moves, pawns & ~context.pinned, context.targets, context.pushTargets, context);
+    BitBoard(pawns & context.pinned).forEachBit([&](int fromSquare) {
+        generatePawnMoves<Us>(moves, 1ULL << fromSquare, context.targets & context.pinRays[fromSquare],
+                              context.pushTargets & context.pinRays[fromSquare], context);
+    });
 
-    filterOutIllegalMoves(moves);
+    if (kingSquare >= 0) {
+        generateKingMoves<Us>(moves, kingSquare, context);
+        if constexpr (Type == AllMoves || Type == QuietMoves) {
+            if (!checkers) {
+                generateCastlingMoves<Us>(moves, kingSquare, context);
+            }
+        }
+    }
+    generateBishopMoves(moves, _bitboards[Side::pieces + WHITE_BISHOPS], context);
+    generateRooksMoves(moves, _bitboards[Side::pieces + WHITE_ROOKS], context);
+    generateQueensMoves(moves, _bitboards[Side::pieces + WHITE_QUEENS], context);
 
-    return moves;
+    if constexpr (Type != QuietMoves) {
+        if (enPassantSquare >= 0) {
+            generateEnPassantMoves<Us>(moves, kingSquare, context);
+        }
+    }
 }
 
+void GameState::generateAllMoves(MoveList& moves, MoveGenType type)
+{
+    TRACE_ZONE("generateAllMoves");
+    const bool white = (color == WHITE);
+    switch (type) {
+    case AllMoves:
+        white ? generateMoves<WHITE, AllMoves>(moves) : generateMoves<BLACK, AllMoves>(moves);
+        break;
+    case NoisyMoves:
+        white ? generateMoves<WHITE, NoisyMoves>(moves) : generateMoves<BLACK, NoisyMoves>(moves);
+        break;
+    case QuietMoves:
+        white ? generateMoves<WHITE, QuietMoves>(moves) : generateMoves<BLACK, QuietMoves>(moves);
+        break;
+    case Evasions:
+        white ? generateMoves<WHITE, Evasions>(moves) : generateMoves<BLACK, Evasions>(moves);
+        break;
+    }
+}
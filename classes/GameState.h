@@ -4,18 +4,25 @@
 #include <iostream>
 #include <cstring>
 #include <cstdint>
+#include <utility>
+#include <array>
+#include <string>
 #include <vector>
 #include "Bitboard.h"
+#include "Zobrist.h"
+#include "PieceSquareTables.h"
 
 constexpr int WHITE = +1;
 constexpr int BLACK = -1;
-// Define a constant for the maximum depth of your AI.
-constexpr int MAX_DEPTH = 24;
+// plies the undo stack holds before it has to grow, enough for any search line
+constexpr int MAX_DEPTH = 128;
 // Define constants for ranks and files
 constexpr uint64_t NotAFile(0xFEFEFEFEFEFEFEFEULL); // A file mask
 constexpr uint64_t NotHFile(0x7F7F7F7F7F7F7F7FULL); // H file mask
+constexpr uint64_t Rank1(0x00000000000000FFULL); // Rank 1 mask
 constexpr uint64_t Rank3(0x0000000000FF0000ULL); // Rank 3 mask
 constexpr uint64_t Rank6(0x0000FF0000000000ULL); // Rank 6 mask
+constexpr uint64_t Rank8(0xFF00000000000000ULL); // Rank 8 mask
 
 enum AllBitBoards
 {
@@ -38,14 +45,45 @@ enum AllBitBoards
     e_numBitboards
 };
 
+enum CastlingRights {
+    WhiteKingSide = 0x01,
+    WhiteQueenSide = 0x02,
+    BlackKingSide = 0x04,
+    BlackQueenSide = 0x08,
+    AllCastling = 0x0F
+};
+
+// castling rights that survive a move touching each square: a king or rook leaving home, or a rook
+// being captured there, clears the matching rights with a single and
+constexpr std::array<unsigned char, 64> makeCastlingMasks() {
+    std::array<unsigned char, 64> masks{};
+    for (auto& mask : masks) { mask = AllCastling; }
+    masks[0] = AllCastling & ~WhiteQueenSide;                    // a1
+    masks[4] = AllCastling & ~(WhiteKingSide | WhiteQueenSide);  // e1
+    masks[7] = AllCastling & ~WhiteKingSide;                     // h1
+    masks[56] = AllCastling & ~BlackQueenSide;                   // a8
+    masks[60] = AllCastling & ~(BlackKingSide | BlackQueenSide); // e8
+    masks[63] = AllCastling & ~BlackKingSide;                    // h8
+    return masks;
+}
+inline constexpr std::array<unsigned char, 64> _castlingMasks = makeCastlingMasks();
+
 enum MoveFlags {
     EnPassant = 0x01, // 0000 0001
     IsCapture = 0x02, // 0000 0010
     KingSideCastle = 0x04, // 0000 0100
     QueenSideCastle = 0x08, // 0000 1000
-    IsPromotion = 0x10 // 0001 0000
+    IsPromotion = 0x10, // 0001 0000
+    // promotion piece, a bare IsPromotion means a queen
+    PromoteKnight = 0x20, // 0010 0000
+    PromoteBishop = 0x40, // 0100 0000
+    PromoteRook = 0x60, // 0110 0000
+    PromotionPieceMask = 0x60
 };
 
+// promoted piece characters indexed by [color == WHITE ? 0 : 1][(flags & PromotionPieceMask) >> 5]
+inline constexpr char _promotionPieces[2][4] = { { 'Q', 'N', 'B', 'R' }, { 'q', 'n', 'b', 'r' } };
+
 #pragma pack(push, 1)
 struct BitMove {
     unsigned char from;
@@ -57,6 +95,12 @@ struct BitMove {
         : from(from), to(to), piece(piece), flags(flags) { }
         
     BitMove() : from(0), to(0), piece(NoPiece), flags(0) { }
+
+    // piece a pawn becomes, only meaningful when IsPromotion is set
+    ChessPiece promotionPiece() const {
+        constexpr ChessPiece pieces[4] = { Queen, Knight, Bishop, Rook };
+        return pieces[(flags & PromotionPieceMask) >> 5];
+    }
     
     bool operator==(const BitMove& other) const {
         return from == other.from && 
@@ -67,82 +111,344 @@ struct BitMove {
 };
 #pragma pack(pop)
 
+// no legal chess position has more than 218 moves
+constexpr int MAX_MOVES = 256;
+
+// what each piece is worth in an exchange, indexed by ChessPiece; the king can't be traded
+constexpr int SEE_VALUES[7] = { 0, 100, 320, 330, 500, 900, 20000 };
+
+// fixed capacity move list that lives on the stack, so generating moves at a node never touches the heap
+struct MoveList {
+    // left uninitialised on purpose, only [0, count) is ever read
+    union { BitMove _moves[MAX_MOVES]; };
+    int count;
+
+    MoveList() : count(0) { }
+    MoveList(const MoveList& other) : count(other.count) {
+        std::memcpy(_moves, other._moves, count * sizeof(BitMove));
+    }
+    MoveList& operator=(const MoveList& other) {
+        count = other.count;
+        std::memcpy(_moves, other._moves, count * sizeof(BitMove));
+        return *this;
+    }
+
+    template <typename... Args>
+    inline void emplace_back(Args&&... args) {
+        assert(count < MAX_MOVES);
+        _moves[count++] = BitMove(std::forward<Args>(args)...);
+    }
+    inline void push_back(const BitMove& move) {
+        assert(count < MAX_MOVES);
+        _moves[count++] = move;
+    }
+    inline void clear() { count = 0; }
+    inline int size() const { return count; }
+    inline bool empty() const { return count == 0; }
+
+    BitMove& operator[](int index) { return _moves[index]; }
+    const BitMove& operator[](int index) const { return _moves[index]; }
+    BitMove* begin() { return _moves; }
+    BitMove* end() { return _moves + count; }
+    const BitMove* begin() const { return _moves; }
+    const BitMove* end() const { return _moves + count; }
+};
+
+// maps a state[] character to the bitboard that holds it, '0' lands on EMPTY_SQUARES
+constexpr std::array<unsigned char, 128> makeBitboardLookup() {
+    std::array<unsigned char, 128> lookup{};
+    for (auto& entry : lookup) { entry = EMPTY_SQUARES; }
+    lookup['P'] = WHITE_PAWNS;
+    lookup['N'] = WHITE_KNIGHTS;
+    lookup['B'] = WHITE_BISHOPS;
+    lookup['R'] = WHITE_ROOKS;
+    lookup['Q'] = WHITE_QUEENS;
+    lookup['K'] = WHITE_KING;
+    lookup['p'] = BLACK_PAWNS;
+    lookup['n'] = BLACK_KNIGHTS;
+    lookup['b'] = BLACK_BISHOPS;
+    lookup['r'] = BLACK_ROOKS;
+    lookup['q'] = BLACK_QUEENS;
+    lookup['k'] = BLACK_KING;
+    return lookup;
+}
+inline constexpr std::array<unsigned char, 128> _bitboardLookup = makeBitboardLookup();
+
 struct alignas(32) GameStateData {
     char state[64];                 // persisitent
-    int flags;
+    uint16_t halfmoveClock;         // plies since the last capture or pawn move, for the fifty move rule
+    uint16_t fullmoveNumber;        // starts at 1, goes up after every black move
     char color;                     // BLACK or WHITE
+    unsigned char castlingRights;   // CastlingRights bits
+    signed char enPassantSquare;    // target square of a capturable double push, -1 if none
+    BitBoard _bitboards[e_numBitboards]; // kept in step with state[] by putPiece/removePiece
+    uint64_t _zobristHash;          // pieces, side to move, castling rights and en passant file
+    int16_t _pstMidgame;            // piece-square sums, white minus black, kept by putPiece/removePiece
+    int16_t _pstEndgame;
+    int16_t _pstPhase;              // PST_MAX_PHASE with all the pieces on, more after promotions
 
-    GameStateData() : flags(0)
-        , color(WHITE) {
+    GameStateData() : halfmoveClock(0)
+        , fullmoveNumber(1)
+        , color(WHITE)
+        , castlingRights(0)
+        , enPassantSquare(-1)
+        , _zobristHash(0)
+        , _pstMidgame(0)
+        , _pstEndgame(0)
+        , _pstPhase(0) {
         std::memset(state, '0', sizeof(state));
+        _bitboards[EMPTY_SQUARES] = ~0ULL;
     }
     GameStateData(const GameStateData&) = default;
     GameStateData& operator=(const GameStateData&) = default;
 };
 
+// what a move destroys and popState needs back: the rest is worked out by playing the move in reverse
+struct UndoRecord {
+    uint64_t zobristHash;           // restored rather than unwound
+    BitMove move;
+    char piece;                     // what stood on move.from, a pawn for promotions
+    char captured;                  // '0' if nothing was taken, the pawn for en passant
+    unsigned char castlingRights;
+    signed char enPassantSquare;
+    uint16_t halfmoveClock;
+    uint16_t fullmoveNumber;
+    bool nullMove;
+};
+
+enum MoveGenType {
+    AllMoves,
+    NoisyMoves,  // captures (including en passant) and promotions
+    QuietMoves,  // the rest of AllMoves, castling included
+    Evasions     // AllMoves when in check, nothing otherwise
+};
+
+// per-node data shared by the move generators, worked out once at the top of generateMoves
+struct MoveGenContext {
+    uint64_t occupancy;
+    uint64_t friendlies;
+    uint64_t enemies;
+    uint64_t targets;       // where a non-king move may land: not on a friendly, and on the check ray when in check
+    uint64_t pushTargets;   // where a pawn push may land, only the back ranks for noisy generation
+    uint64_t kingTargets;   // where the king may step before its destinations are tested for attacks
+    uint64_t pinned;        // friendly pieces pinned to their king
+    uint64_t pinRays[64];   // for each pinned square, the ray it may move along (including the pinner)
+};
+
 class GameState : public GameStateData {
 public:
-    GameStateData stateStack[MAX_DEPTH];
-    int stackPtr = 0;
+    std::vector<UndoRecord> undoStack; // one record per move made since init, grown on demand
+    int stackPtr = 0;                  // plies made since init, the top of undoStack
 
-    uint64_t _zobristHash[2]; // when one hash value is made, the other is made as well because it's just a xor of the first by the color bit
-    BitBoard _bitboards[e_numBitboards];
     BitBoard _attackBitBoard;
 
-    GameState() : stackPtr(0) { }
+    GameState() : undoStack(MAX_DEPTH), stackPtr(0) { }
+
+    // castling < 0 infers the rights from the king and rook placement
+    void init(const char* newState, char player, int castling = -1, int enPassant = -1, int halfmoves = 0, int fullmoves = 1);
+    // all six FEN fields, anything after the board may be left out; false leaves the state untouched
+    bool loadFEN(const std::string& fen);
+    std::string toFEN() const;
+
+    uint64_t getZobristHash() const { return _zobristHash; }
+    // full recompute of the incrementally maintained _zobristHash, for init and debugging
+    uint64_t computeZobristHash() const;
+
+    // earlier occurrences of this position, up to maxCount. Only every second ply since the last capture,
+    // pawn move or null move can match, and the undo records already hold those hashes, so this is
+    // cheap enough for every search node
+    int repetitions(int maxCount) const {
+        int count = 0;
+        const int limit = halfmoveClock < stackPtr ? halfmoveClock : stackPtr;
+        for (int back = 2; back <= limit; back += 2) {
+            const UndoRecord& undo = undoStack[stackPtr - back];
+            if (undo.nullMove || undoStack[stackPtr - back + 1].nullMove) {
+                break;
+            }
+            if (undo.zobristHash == _zobristHash && ++count >= maxCount) {
+                break;
+            }
+        }
+        return count;
+    }
+    // a hundred plies without a capture or pawn move, checkmate still takes precedence
+    bool fiftyMoveRuleReached() const { return halfmoveClock >= 100; }
+
+    // tapered piece-square score from white's point of view, in centipawns
+    int pstScore() const {
+        const int phase = _pstPhase < PST_MAX_PHASE ? _pstPhase : PST_MAX_PHASE;
+        return (_pstMidgame * phase + _pstEndgame * (PST_MAX_PHASE - phase)) / PST_MAX_PHASE;
+    }
+    // the same from a rescan of state[], for debugging the incremental sums
+    int computePstScore() const;
 
-    void init(const char* newState, char player);
+    // every board edit goes through these so the bitboards never need a rescan of state[]
+    inline void putPiece(int square, char piece) {
+        const uint64_t mask = 1ULL << square;
+        const int index = _bitboardLookup[(unsigned char)piece];
+        state[square] = piece;
+        _bitboards[index] |= mask;
+        _bitboards[index < WHITE_ALL_PIECES ? WHITE_ALL_PIECES : BLACK_ALL_PIECES] |= mask;
+        _bitboards[OCCUPANCY] |= mask;
+        _bitboards[EMPTY_SQUARES] &= ~mask;
+        _zobristHash ^= _zobristKeys.pieces[index][square];
+        _pstMidgame += _pieceSquareTables.midgame[index][square];
+        _pstEndgame += _pieceSquareTables.endgame[index][square];
+        _pstPhase += _pieceSquareTables.phase[index];
+    }
+    inline void removePiece(int square) {
+        const uint64_t mask = ~(1ULL << square);
+        const int index = _bitboardLookup[(unsigned char)state[square]];
+        state[square] = '0';
+        _bitboards[index] &= mask;
+        _bitboards[index < WHITE_ALL_PIECES ? WHITE_ALL_PIECES : BLACK_ALL_PIECES] &= mask;
+        _bitboards[OCCUPANCY] &= mask;
+        _bitboards[EMPTY_SQUARES] |= ~mask;
+        _zobristHash ^= _zobristKeys.pieces[index][square];
+        _pstMidgame -= _pieceSquareTables.midgame[index][square];
+        _pstEndgame -= _pieceSquareTables.endgame[index][square];
+        _pstPhase -= _pieceSquareTables.phase[index];
+    }
+    inline void movePiece(int from, int to) {
+        const char piece = state[from];
+        removePiece(from);
+        putPiece(to, piece);
+    }
 
     inline void pushMove(const BitMove& move) {
-        pushState();
-        unsigned char fromPiece = state[move.from];
-        state[move.from] = '0';
-        state[move.to] = fromPiece;
+        UndoRecord& undo = pushUndo();
+        const char fromPiece = state[move.from];
+        undo.move = move;
+        undo.piece = fromPiece;
+        undo.captured = state[move.to];
+        undo.nullMove = false;
+        if (enPassantSquare >= 0) {
+            _zobristHash ^= _zobristKeys.enPassant[enPassantSquare & 7];
+            enPassantSquare = -1;
+        }
+        if (state[move.to] != '0') {
+            removePiece(move.to);
+        }
+        movePiece(move.from, move.to);
         if (move.flags & KingSideCastle) {
-            state[move.to - 1] = state[move.to + 1];
-            state[move.to + 1] = '0';
+            movePiece(move.to + 1, move.to - 1);
         } else if (move.flags & QueenSideCastle) {
-            state[move.to + 1] = state[move.to - 2];
-            state[move.to - 2] = '0';
+            movePiece(move.to - 2, move.to + 1);
         } else if (move.flags & EnPassant) {
             // check for color to determine which direction to capture
-            if (fromPiece == 'P') {
-                state[move.to - 8] = '0';
-            } else {
-                state[move.to + 8] = '0';
-            }
+            const int captureSquare = fromPiece == 'P' ? move.to - 8 : move.to + 8;
+            undo.captured = state[captureSquare];
+            removePiece(captureSquare);
         } else if (move.flags & IsPromotion) {
-            state[move.to] = color == WHITE ? 'Q' : 'q';
+            removePiece(move.to);
+            putPiece(move.to, _promotionPieces[color == WHITE ? 0 : 1][(move.flags & PromotionPieceMask) >> 5]);
+        } else if ((fromPiece == 'P' || fromPiece == 'p') && (move.to ^ move.from) == 16) {
+            // only record the target when an enemy pawn could take it, so the hash of otherwise
+            // identical positions doesn't depend on a double push nobody can answer
+            const uint64_t toMask = 1ULL << move.to;
+            const uint64_t neighbours = ((toMask << 1) & NotAFile) | ((toMask >> 1) & NotHFile);
+            if (neighbours & _bitboards[fromPiece == 'P' ? BLACK_PAWNS : WHITE_PAWNS].getData()) {
+                enPassantSquare = (move.from + move.to) / 2;
+                _zobristHash ^= _zobristKeys.enPassant[enPassantSquare & 7];
+            }
+        }
+        const unsigned char rights = castlingRights & _castlingMasks[move.from] & _castlingMasks[move.to];
+        if (rights != castlingRights) {
+            _zobristHash ^= _zobristKeys.castling[castlingRights] ^ _zobristKeys.castling[rights];
+            castlingRights = rights;
+        }
+        halfmoveClock = (fromPiece == 'P' || fromPiece == 'p' || undo.captured != '0') ? 0 : halfmoveClock + 1;
+        if (color == BLACK) {
+            fullmoveNumber++;
         }
         // flip the color bit as it now becomes the other player's turn
         color = (color == WHITE) ? BLACK : WHITE;
-        flags = 0; // invalidate all the flags
+        _zobristHash ^= _zobristKeys.sideToMove;
     }
 
-    inline void pushState() {
-        assert(stackPtr < MAX_DEPTH);
-        stateStack[stackPtr++] = static_cast<const GameStateData&>(*this);
+    // pass: only the side to move changes, for null move pruning
+    inline void pushNullMove() {
+        UndoRecord& undo = pushUndo();
+        undo.nullMove = true;
+        if (enPassantSquare >= 0) {
+            _zobristHash ^= _zobristKeys.enPassant[enPassantSquare & 7];
+            enPassantSquare = -1;
+        }
+        halfmoveClock++;
+        color = (color == WHITE) ? BLACK : WHITE;
+        _zobristHash ^= _zobristKeys.sideToMove;
     }
+
+    // takes back the last pushMove or pushNullMove
     inline void popState() {
         assert(stackPtr > 0);
-        static_cast<GameStateData&>(*this) = stateStack[--stackPtr];
+        const UndoRecord& undo = undoStack[--stackPtr];
+        color = (color == WHITE) ? BLACK : WHITE;
+        if (!undo.nullMove) {
+            const BitMove& move = undo.move;
+            // putting the original piece back on from also undoes a promotion
+            removePiece(move.to);
+            putPiece(move.from, undo.piece);
+            if (move.flags & KingSideCastle) {
+                movePiece(move.to - 1, move.to + 1);
+            } else if (move.flags & QueenSideCastle) {
+                movePiece(move.to + 1, move.to - 2);
+            }
+            if (undo.captured != '0') {
+                const int captureSquare = !(move.flags & EnPassant) ? move.to : (undo.piece == 'P' ? move.to - 8 : move.to + 8);
+                putPiece(captureSquare, undo.captured);
+            }
+        }
+        castlingRights = undo.castlingRights;
+        enPassantSquare = undo.enPassantSquare;
+        halfmoveClock = undo.halfmoveClock;
+        fullmoveNumber = undo.fullmoveNumber;
+        _zobristHash = undo.zobristHash;
     }
 
-    std::vector<BitMove> generateAllMoves();
-    void shutdown();
+    // legal moves only, see GameState.cpp for how checks and pins are handled. The side to move and the
+    // type are dispatched here once to a generator specialised for both
+    void generateAllMoves(MoveList& moves, MoveGenType type = AllMoves);
+    bool isInCheck() const;
+    bool isSquareAttacked(int square, char attackerColor, uint64_t occupancy) const;
+    uint64_t attackersTo(int square, uint64_t occupancy) const;
+    // every square attackerColor's pieces attack, pins ignored
+    uint64_t attackedBy(char attackerColor) const;
+    // static exchange evaluation: the material the side to move comes out with, in SEE_VALUES, once
+    // both sides have recaptured on the move's square with their cheapest piece for as long as it pays
+    int see(const BitMove& move) const;
+
+    // slider attacks by "magic" multiply or BMI2 "pext", the fastest the CPU has is picked on its own;
+    // false if this build or CPU can't do the one asked for
+    static bool selectSliderLookup(const std::string& name);
+    static const char* sliderLookup();
 private:
+    // the record for the move being made, with everything that isn't known before it filled in
+    inline UndoRecord& pushUndo() {
+        if (stackPtr == static_cast<int>(undoStack.size())) {
+            undoStack.resize(undoStack.size() * 2);
+        }
+        UndoRecord& undo = undoStack[stackPtr++];
+        undo.zobristHash = _zobristHash;
+        undo.castlingRights = castlingRights;
+        undo.enPassantSquare = enPassantSquare;
+        undo.halfmoveClock = halfmoveClock;
+        undo.fullmoveNumber = fullmoveNumber;
+        return undo;
+    }
+
     const BitBoard generatePawnAttacks(const BitBoard pawns, char color);
-    uint64_t generatePawnAttacksBitBoard(int square, char color);
-    
-    void generateKnightMoves(std::vector<BitMove>& moves, BitBoard knightBoard, uint64_t occupancy);
-    void generateKingMoves(std::vector<BitMove>& moves, BitBoard kingBoard, uint64_t occupancy);
-    void generateRooksMoves(std::vector<BitMove>& moves, BitBoard bishopBoard, uint64_t occupancy, uint64_t friendlies);
-    void generateQueensMoves(std::vector<BitMove>& moves, BitBoard bishopBoard, uint64_t occupancy, uint64_t friendlies);
-
-    void generateBishopMoves(std::vector<BitMove>& moves, BitBoard bishopBoard, uint64_t occupancy, uint64_t friendlies);
-    void generatePawnMoveList(std::vector<BitMove>& moves, const BitBoard pawns, const BitBoard emptySquares, const BitBoard enemyPieces, char color);
-    void addPawnBitboardMovesToList(std::vector<BitMove>& moves, const BitBoard bitboard, const int shift);
-    bool isSquareAttacked(int square, char attackerColor, const BitBoard (&boards)[e_numBitboards]);
-    void filterOutIllegalMoves(std::vector<BitMove>& moves);
+
+    // the generators that depend on the side to move are instantiated for each, Us is WHITE or BLACK
+    template <int Us, MoveGenType Type> void generateMoves(MoveList& moves);
+    template <int Us> void generatePawnMoves(MoveList& moves, uint64_t pawns, uint64_t targets, uint64_t pushTargets, const MoveGenContext& context);
+    template <int Us> void generateKingMoves(MoveList& moves, int kingSquare, const MoveGenContext& context);
+    template <int Us> void generateCastlingMoves(MoveList& moves, int kingSquare, const MoveGenContext& context);
+    template <int Us> void generateEnPassantMoves(MoveList& moves, int kingSquare, const MoveGenContext& context);
+
+    void generateKnightMoves(MoveList& moves, BitBoard knightBoard, const MoveGenContext& context);
+    void generateBishopMoves(MoveList& moves, BitBoard bishopBoard, const MoveGenContext& context);
+    void generateRooksMoves(MoveList& moves, BitBoard rookBoard, const MoveGenContext& context);
+    void generateQueensMoves(MoveList& moves, BitBoard queenBoard, const MoveGenContext& context);
 
 };
@@ -1,59 +1,15 @@
 #include "Grid.h"
+#include <algorithm>
 
-Grid::Grid(int width, int height) : _width(width), _height(height)
+Grid::Grid(int width, int height) : _squares(width * height), _enabled(width * height, 1), _width(width), _height(height)
 {
-    // Initialize 2D vectors
-    _squares.resize(height);
-    _enabled.resize(height);
-
-    for (int y = 0; y < height; y++) {
-        _squares[y].resize(width);
-        _enabled[y].resize(width);
-
-        for (int x = 0; x < width; x++) {
-            _squares[y][x] = new ChessSquare();
-            _enabled[y][x] = true; // All squares enabled by default
-        }
-    }
-}
-
-Grid::~Grid()
-{
-    for (int y = 0; y < _height; y++) {
-        for (int x = 0; x < _width; x++) {
-            delete _squares[y][x];
-        }
-    }
-}
-
-ChessSquare* Grid::getSquare(int x, int y)
-{
-    if (!isValid(x, y)) return nullptr;
-    return _squares[y][x];
-}
-
-ChessSquare* Grid::getSquareByIndex(int index)
-{
-    int x, y;
-    getCoordinates(index, x, y);
-    return getSquare(x, y);
-}
-
-bool Grid::isValid(int x, int y) const
-{
-    return x >= 0 && x < _width && y >= 0 && y < _height;
-}
-
-bool Grid::isEnabled(int x, int y) const
-{
-    if (!isValid(x, y)) return false;
-    return _enabled[y][x];
+    // All squares enabled by default
 }
 
 void Grid::setEnabled(int x, int y, bool enabled)
 {
     if (isValid(x, y)) {
-        _enabled[y][x] = enabled;
+        _enabled[getIndex(x, y)] = enabled;
     }
 }
 
@@ -149,27 +105,6 @@ bool Grid::areConnected(int fromX, int fromY, int toX, int toY)
     return false;
 }
 
-// Iterator support
-void Grid::forEachSquare(std::function<void(ChessSquare*, int x, int y)> func)
-{
-    for (int y = 0; y < _height; y++) {
-        for (int x = 0; x < _width; x++) {
-            func(_squares[y][x], x, y);
-        }
-    }
-}
-
-void Grid::forEachEnabledSquare(std::function<void(ChessSquare*, int x, int y)> func)
-{
-    for (int y = 0; y < _height; y++) {
-        for (int x = 0; x < _width; x++) {
-            if (_enabled[y][x]) {
-                func(_squares[y][x], x, y);
-            }
-        }
-    }
-}
-
 // Initialize squares
 void Grid::initializeSquares(float squareSize, const char* spriteName)
 {
@@ -186,7 +121,7 @@ void Grid::initializeChessSquares(float squareSize, const char* spriteName)
     for (int y = 0; y < _height; y++) {
         for (int x = 0; x < _width; x++) {
             ImVec2 position(squareSize * x + squareSize/2, squareSize * (7-y) + squareSize/2);
-            _squares[y][x]->initHolder(position, spriteName, x, y);
+            _squares[getIndex(x, y)].initHolder(position, spriteName, x, y);
         }
     }
 }
@@ -195,7 +130,7 @@ void Grid::initializeSquare(int x, int y, float squareSize, const char* spriteNa
 {
     if (isValid(x, y)) {
         ImVec2 position(squareSize * x + squareSize/2, squareSize * y + squareSize/2);
-        _squares[y][x]->initHolder(position, spriteName, x, y);
+        _squares[getIndex(x, y)].initHolder(position, spriteName, x, y);
     }
 }
 
@@ -203,16 +138,15 @@ void Grid::initializeSquare(int x, int y, float squareSize, const char* spriteNa
 std::string Grid::getStateString() const
 {
     std::string state;
-
-    for (int y = 0; y < _height; y++) {
-        for (int x = 0; x < _width; x++) {
-            if (_enabled[y][x]) {
-                Bit* bit = _squares[y][x]->bit();
-                if (bit) {
-                    state += std::to_string(bit->gameTag());
-                } else {
-                    state += '0';
-                }
+    state.reserve(_squares.size());
+
+    for (size_t i = 0; i < _squares.size(); i++) {
+        if (_enabled[i]) {
+            Bit* bit = _squares[i].bit();
+            if (bit) {
+                state += std::to_string(bit->gameTag());
+            } else {
+                state += '0';
             }
         }
     }
@@ -224,17 +158,15 @@ void Grid::setStateString(const std::string& state)
 {
     size_t index = 0;
 
-    for (int y = 0; y < _height && index < state.length(); y++) {
-        for (int x = 0; x < _width && index < state.length(); x++) {
-            if (_enabled[y][x]) {
-                char pieceChar = state[index++];
+    for (size_t i = 0; i < _squares.size() && index < state.length(); i++) {
+        if (_enabled[i]) {
+            char pieceChar = state[index++];
 
-                // Clear existing piece
-                _squares[y][x]->destroyBit();
+            // Clear existing piece
+            _squares[i].destroyBit();
 
-                // This method just sets the state - games need to create their own pieces
-                // when loading from state string based on the piece type
-            }
+            // This method just sets the state - games need to create their own pieces
+            // when loading from state string based on the piece type
         }
     }
 }
\ No newline at end of file
@@ -1,22 +1,24 @@
 #pragma once
 
 #include "ChessSquare.h"
+#include <cstdint>
 #include <vector>
 #include <unordered_map>
-#include <functional>
 #include <string>
 
+// Squares live by value in one row-major array, index = y * width + x, so walking the board is a walk
+// through contiguous memory. The iteration helpers take the callable as a template parameter and
+// inline into the caller's loop instead of going through a std::function per square.
 class Grid
 {
 public:
     Grid(int width, int height);
-    ~Grid();
 
     // Basic access
-    ChessSquare* getSquare(int x, int y);
-    ChessSquare* getSquareByIndex(int index);
-    bool isValid(int x, int y) const;
-    bool isEnabled(int x, int y) const;
+    ChessSquare* getSquare(int x, int y) { return isValid(x, y) ? &_squares[getIndex(x, y)] : nullptr; }
+    ChessSquare* getSquareByIndex(int index) { return index >= 0 && index < _width * _height ? &_squares[index] : nullptr; }
+    bool isValid(int x, int y) const { return x >= 0 && x < _width && y >= 0 && y < _height; }
+    bool isEnabled(int x, int y) const { return isValid(x, y) && _enabled[getIndex(x, y)]; }
     void setEnabled(int x, int y, bool enabled);
 
     // Grid properties
@@ -49,9 +51,30 @@ public:
     std::vector<ChessSquare*> getConnectedSquares(int x, int y);
     bool areConnected(int fromX, int fromY, int toX, int toY);
 
-    // Iterator support
-    void forEachSquare(std::function<void(ChessSquare*, int x, int y)> func);
-    void forEachEnabledSquare(std::function<void(ChessSquare*, int x, int y)> func);
+    // Iterator support, func(ChessSquare*, int x, int y) in row-major order
+    template <typename Func>
+    void forEachSquare(Func&& func)
+    {
+        ChessSquare* square = _squares.data();
+        for (int y = 0; y < _height; y++) {
+            for (int x = 0; x < _width; x++, square++) {
+                func(square, x, y);
+            }
+        }
+    }
+    template <typename Func>
+    void forEachEnabledSquare(Func&& func)
+    {
+        ChessSquare* square = _squares.data();
+        const uint8_t* enabled = _enabled.data();
+        for (int y = 0; y < _height; y++) {
+            for (int x = 0; x < _width; x++, square++, enabled++) {
+                if (*enabled) {
+                    func(square, x, y);
+                }
+            }
+        }
+    }
 
     // Initialize squares with positions and sprites
     void initializeChessSquares(float squareSize, const char* spriteName);
@@ -63,8 +86,9 @@ public:
     void setStateString(const std::string& state);
 
 private:
-    std::vector<std::vector<ChessSquare*>> _squares;
-    std::vector<std::vector<bool>> _enabled;
+    // sized once in the constructor and never again, so pointers to squares stay valid
+    std::vector<ChessSquare> _squares;
+    std::vector<uint8_t> _enabled;
     std::unordered_map<int, std::vector<int>> _connections;
     int _width;
     int _height;
@@ -0,0 +1,134 @@
+#include "LargePages.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+#ifndef _WIN32
+    constexpr size_t CACHE_LINE = 64;
+    constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+#endif
+
+    size_t roundUp(size_t bytes, size_t unit)
+    {
+        return (bytes + unit - 1) / unit * unit;
+    }
+}
+
+bool LargePageMemory::allocate(size_t bytes)
+{
+    release();
+    if (bytes == 0) {
+        return false;
+    }
+
+#ifdef _WIN32
+    const size_t largePage = GetLargePageMinimum();
+    if (largePage > 0 && bytes >= largePage) {
+        const size_t size = roundUp(bytes, largePage);
+        _data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (_data) {
+            _size = size;
+            _kind = WindowsLarge;
+        }
+    }
+    if (!_data) {
+        _data = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (_data) {
+            _size = bytes;
+            _kind = Windows;
+        }
+    }
+    // VirtualAlloc hands out zeroed pages
+#else
+    if (bytes >= HUGE_PAGE_SIZE) {
+        const size_t size = roundUp(bytes, HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapped != MAP_FAILED) {
+            _data = mapped;
+            _size = size;
+            _kind = HugeTlb;
+        }
+#endif
+        // no huge pages reserved: aligned to one, the kernel can back it with transparent huge pages
+        if (!_data) {
+            _data = std::aligned_alloc(HUGE_PAGE_SIZE, size);
+            if (_data) {
+                _size = size;
+#ifdef MADV_HUGEPAGE
+                madvise(_data, size, MADV_HUGEPAGE);
+                _kind = Transparent;
+#else
+                _kind = Aligned;
+#endif
+                std::memset(_data, 0, size);
+            }
+        }
+    }
+    if (!_data) {
+        const size_t size = roundUp(bytes, CACHE_LINE);
+        _data = std::aligned_alloc(CACHE_LINE, size);
+        if (_data) {
+            _size = size;
+            _kind = Aligned;
+            std::memset(_data, 0, size);
+        }
+    }
+#endif
+    if (!_data) {
+        _size = 0;
+        _kind = None;
+        return false;
+    }
+    return true;
+}
+
+void LargePageMemory::release()
+{
+    if (!_data) {
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(_data, 0, MEM_RELEASE);
+#else
+    if (_kind == HugeTlb) {
+        munmap(_data, _size);
+    } else {
+        std::free(_data);
+    }
+#endif
+    _data = nullptr;
+    _size = 0;
+    _kind = None;
+}
+
+bool LargePageMemory::enableLargePages()
+{
+#ifdef _WIN32
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        return false;
+    }
+    TOKEN_PRIVILEGES privileges{};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool enabled = false;
+    if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)) {
+        // succeeds even without the right, which only GetLastError tells apart
+        enabled = AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+    }
+    CloseHandle(token);
+    return enabled;
+#else
+    return true;
+#endif
+}
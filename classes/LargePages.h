@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+//
+// Memory for the big, randomly probed search tables, backed by large pages where the OS gives them:
+// on Linux MAP_HUGETLB from the reserved pool, failing that 2 MB aligned memory with MADV_HUGEPAGE
+// for transparent huge pages; on Windows VirtualAlloc with MEM_LARGE_PAGES, which needs the "Lock
+// pages in memory" right that enableLargePages() switches on. One TLB entry then covers 2 MB of the
+// table instead of 4 KB. Anything the OS refuses falls back to ordinary pages, so an allocation only
+// fails when memory itself runs out. The memory is zeroed and aligned to at least a cache line.
+//
+class LargePageMemory {
+public:
+    LargePageMemory() : _data(nullptr), _size(0), _kind(None) {}
+    ~LargePageMemory() { release(); }
+    LargePageMemory(const LargePageMemory&) = delete;
+    LargePageMemory& operator=(const LargePageMemory&) = delete;
+
+    // replaces anything allocated before; false if there wasn't the memory
+    bool allocate(size_t bytes);
+    void release();
+
+    void* data() const { return _data; }
+    size_t size() const { return _size; }
+    // the OS gave large pages (or, with transparent huge pages, was asked to)
+    bool largePages() const { return _kind == HugeTlb || _kind == Transparent || _kind == WindowsLarge; }
+
+    // Windows only, once at startup: asks for the privilege large pages need. True if the process has
+    // it; elsewhere there is nothing to ask for
+    static bool enableLargePages();
+
+private:
+    enum Kind { None, HugeTlb, Transparent, Aligned, WindowsLarge, Windows };
+
+    void* _data;
+    size_t _size;
+    Kind _kind;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+//
+// Newline framing for a byte stream without allocating
+// bytes are received straight into a fixed buffer and every complete line is handed out as a string_view
+// into it, so nothing is copied until the caller decides to keep a line. compact() moves the unfinished
+// tail to the front once per read instead of erasing each line from the front of a string. A line too
+// long to fit is dropped whole, up to and including its newline, and counted in overflows().
+//
+
+template <size_t Capacity>
+class LineFramer {
+public:
+    LineFramer() : _start(0), _end(0), _discarding(false), _overflows(0) { }
+
+    // the read goes straight into the buffer: at most writeSpace() bytes at writePtr(), then commit()
+    char* writePtr() { return _buffer + _end; }
+    size_t writeSpace() const { return Capacity - _end; }
+    void commit(size_t bytes) { _end += bytes; }
+
+    // the next complete line without its newline, trailing '\r' and spaces; empty lines are skipped.
+    // The view stays valid until compact()
+    bool next(std::string_view& line) {
+        while (true) {
+            const char* begin = _buffer + _start;
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', _end - _start));
+            if (!newline) {
+                return false;
+            }
+            size_t length = static_cast<size_t>(newline - begin);
+            _start += length + 1;
+            if (_discarding) {
+                // the end of a line that overflowed
+                _discarding = false;
+                continue;
+            }
+            while (length > 0 && (begin[length - 1] == '\r' || begin[length - 1] == ' ')) {
+                length--;
+            }
+            if (length > 0) {
+                line = std::string_view(begin, length);
+                return true;
+            }
+        }
+    }
+
+    // drops the lines handed out so far and makes room behind the unfinished one
+    void compact() {
+        const size_t tail = _end - _start;
+        if (tail == Capacity) {
+            if (!_discarding) {
+                _overflows++;
+            }
+            _discarding = true;
+            _start = _end = 0;
+            return;
+        }
+        if (_start > 0) {
+            std::memmove(_buffer, _buffer + _start, tail);
+            _start = 0;
+            _end = tail;
+        }
+    }
+
+    void clear() {
+        _start = _end = 0;
+        _discarding = false;
+    }
+
+    size_t overflows() const { return _overflows; }
+
+private:
+    char _buffer[Capacity];
+    size_t _start;      // first byte not handed out yet
+    size_t _end;        // end of the received bytes
+    bool _discarding;   // skipping the rest of a line that didn't fit
+    size_t _overflows;
+};
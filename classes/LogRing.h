@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "SpscQueue.h"
+
+//
+// Bounded logging for threads that mustn't wait on the console
+// each producing thread owns a LogRing, and log() only copies the message and its time into a slot of
+// an SpscQueue: no allocation, no clock formatting, no stream. The one LogSink thread drains every ring
+// a few times a second, adds the timestamp and prints. A full ring drops the message and counts it
+// rather than make the producer wait. A ring can also keep its last lines for display.
+//
+
+enum class LogLevel : uint8_t { Debug, Info, Warning, Error };
+
+class LogRing {
+public:
+    // console lines get "[name] " in front unless name is empty, history keeps the last historySize lines
+    explicit LogRing(const char* name, size_t historySize = 0);
+    ~LogRing();
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    // anything below the level is dropped before it reaches the ring
+    void setLevel(LogLevel level) { _level.store(level, std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const { return level >= _level.load(std::memory_order_relaxed); }
+
+    // producer side, one thread at a time; a message longer than an entry is cut short
+    void log(LogLevel level, std::string_view message) {
+        if (!enabled(level)) {
+            return;
+        }
+        Entry* entry = _queue.claim();
+        if (!entry) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        entry->time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        entry->level = level;
+        entry->length = static_cast<uint16_t>(std::min(message.size(), sizeof(entry->text)));
+        std::memcpy(entry->text, message.data(), entry->length);
+        _queue.publish();
+    }
+
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    // "[HH:MM:SS] message", oldest first; only has what the sink has already taken
+    std::vector<std::string> recent() const {
+        std::lock_guard<std::mutex> lock(_historyMutex);
+        return std::vector<std::string>(_history.begin(), _history.end());
+    }
+
+private:
+    friend class LogSink;
+
+    static constexpr size_t CAPACITY = 256;
+    static constexpr size_t ENTRY_LENGTH = 240;
+
+    struct Entry {
+        int64_t time;                // system clock milliseconds
+        LogLevel level;
+        uint16_t length;
+        char text[ENTRY_LENGTH];
+    };
+
+    // consumer side, only the sink calls it, under its lock
+    void drain(std::ostream& out);
+
+    std::string _name;
+    std::atomic<LogLevel> _level;
+    std::atomic<uint64_t> _dropped;
+    uint64_t _reportedDrops;         // sink side
+    SpscQueue<Entry, CAPACITY> _queue;
+    size_t _historySize;
+    mutable std::mutex _historyMutex;  // the sink and recent(), never the producer
+    std::deque<std::string> _history;
+};
+
+class LogSink {
+public:
+    // never destroyed, so rings owned by other statics can still detach at exit
+    static LogSink& shared() {
+        static LogSink* sink = new LogSink();
+        return *sink;
+    }
+
+    void attach(LogRing* ring) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rings.push_back(ring);
+        if (!_thread.joinable()) {
+            _thread = std::thread([this]() { run(); });
+        }
+    }
+
+    // prints what is left in the ring, so nothing logged before it went away is lost
+    void detach(LogRing* ring) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ring->drain(std::cout);
+        _rings.erase(std::remove(_rings.begin(), _rings.end(), ring), _rings.end());
+    }
+
+    // print everything logged so far now, from the calling thread
+    void flush() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (LogRing* ring : _rings) {
+            ring->drain(std::cout);
+        }
+    }
+
+private:
+    static constexpr int DRAIN_INTERVAL_MS = 50;
+
+    LogSink() = default;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _wake.wait_for(lock, std::chrono::milliseconds(DRAIN_INTERVAL_MS));
+            for (LogRing* ring : _rings) {
+                ring->drain(std::cout);
+            }
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::vector<LogRing*> _rings;
+    std::thread _thread;
+};
+
+inline LogRing::LogRing(const char* name, size_t historySize)
+    : _name(name), _level(LogLevel::Debug), _dropped(0), _reportedDrops(0), _historySize(historySize)
+{
+    LogSink::shared().attach(this);
+}
+
+inline LogRing::~LogRing()
+{
+    LogSink::shared().detach(this);
+}
+
+inline void LogRing::drain(std::ostream& out)
+{
+    const Entry* entry = _queue.peek();
+    if (!entry) {
+        return;
+    }
+    // localtime only changes once a second, so it is worked out once per second seen
+    int64_t formattedSecond = -1;
+    char timeStr[16] = "";
+    for (; entry; entry = _queue.peek()) {
+        const std::string_view message(entry->text, entry->length);
+        if (!_name.empty()) {
+            out << '[' << _name << "] ";
+        }
+        out << message << '\n';
+
+        if (_historySize > 0) {
+            const int64_t second = entry->time / 1000;
+            if (second != formattedSecond) {
+                const std::time_t time = static_cast<std::time_t>(second);
+                std::strftime(timeStr, sizeof(timeStr), "%H:%M:%S", std::localtime(&time));
+                formattedSecond = second;
+            }
+            std::string line = std::string("[") + timeStr + "] ";
+            line.append(message);
+            std::lock_guard<std::mutex> lock(_historyMutex);
+            _history.push_back(std::move(line));
+            while (_history.size() > _historySize) {
+                _history.pop_front();
+            }
+        }
+        _queue.release();
+    }
+    const uint64_t dropped = _dropped.load(std::memory_order_relaxed);
+    if (dropped != _reportedDrops) {
+        out << '[' << (_name.empty() ? "log" : _name) << "] " << (dropped - _reportedDrops) << " message(s) dropped, the log was full\n";
+        _reportedDrops = dropped;
+    }
+    out.flush();
+}
@@ -4,7 +4,7 @@
 #include <stdint.h>
 
 // Generate rook attacks for a given square and blocking pieces
-static inline uint64_t ratt(int sq, uint64_t block) {
+static constexpr uint64_t ratt(int sq, uint64_t block) {
     uint64_t result = 0ULL;
     int rk = sq / 8, fl = sq % 8, r, f;
 
@@ -32,7 +32,7 @@ static inline uint64_t ratt(int sq, uint64_t block) {
 }
 
 // Generate bishop attacks for a given square and blocking pieces
-static inline uint64_t batt(int sq, uint64_t block) {
+static constexpr uint64_t batt(int sq, uint64_t block) {
     uint64_t result = 0ULL;
     int rk = sq / 8, fl = sq % 8, r, f;
 
@@ -59,9 +59,8 @@ static inline uint64_t batt(int sq, uint64_t block) {
     return result;
 }
 
-// Compiler-specific bit manipulation functions
-#ifdef __clang__
-    // Clang/LLVM specific bit counting
+// Compiler-specific bit manipulation functions, popcnt/tzcnt (or bsf) wherever the compiler offers them
+#if defined(__GNUC__) || defined(__clang__)
     static inline int countOnes(uint64_t b) {
         return __builtin_popcountll(b);
     }
@@ -70,6 +69,16 @@ static inline uint64_t batt(int sq, uint64_t block) {
     static inline int getFirstBit(uint64_t b) {
         return __builtin_ctzll(b);
     }
+#elif defined(_MSC_VER) && defined(_M_X64)
+    static inline int countOnes(uint64_t b) {
+        return static_cast<int>(__popcnt64(b));
+    }
+
+    static inline int getFirstBit(uint64_t b) {
+        unsigned long index;
+        _BitScanForward64(&index, b);
+        return static_cast<int>(index);
+    }
 #else
     // Fallback bit counting implementation
     static inline int countOnes(uint64_t b) {
@@ -94,8 +103,61 @@ static inline uint64_t batt(int sq, uint64_t block) {
     }
 #endif
 
+// Slider lookups either multiply by a magic and shift, or gather the relevant occupancy bits with
+// BMI2's pext. pext is emitted inline (as asm on gcc/clang, so the rest of the build needs no -mbmi2)
+// and picked at runtime only where the CPU has it and it is fast: AMD before Zen 3 runs it in microcode.
+enum SliderLookup {
+    MagicLookup,
+    PextLookup
+};
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define CHESS_HAS_PEXT 1
+static inline uint64_t pext64(uint64_t source, uint64_t mask) {
+    uint64_t result;
+    __asm__("pextq %2, %1, %0" : "=r"(result) : "r"(source), "rm"(mask));
+    return result;
+}
+
+static inline bool cpuHasFastPext() {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, nullptr) < 7) return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (!(ebx & (1u << 8))) return false;  // BMI2
+    __cpuid(0, eax, ebx, ecx, edx);
+    const bool amd = (ebx == 0x68747541);    // "Auth"enticAMD
+    __cpuid(1, eax, ebx, ecx, edx);
+    const unsigned int family = ((eax >> 8) & 0xF) + ((eax >> 20) & 0xFF);
+    return !amd || family >= 0x19;
+}
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#define CHESS_HAS_PEXT 1
+static inline uint64_t pext64(uint64_t source, uint64_t mask) {
+    return _pext_u64(source, mask);
+}
+
+static inline bool cpuHasFastPext() {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    const bool amd = (info[1] == 0x68747541);
+    __cpuidex(info, 7, 0);
+    if (!(info[1] & (1 << 8))) return false;
+    __cpuid(info, 1);
+    const unsigned int family = ((info[0] >> 8) & 0xF) + ((info[0] >> 20) & 0xFF);
+    return !amd || family >= 0x19;
+}
+#else
+static inline bool cpuHasFastPext() {
+    return false;
+}
+#endif
+
 // Convert index to bitboard configuration
-static inline uint64_t indexToUint64(int index, int bits, uint64_t m) {
+static constexpr uint64_t indexToUint64(int index, int bits, uint64_t m) {
     uint64_t result = 0ULL;
     for (int i = 0; i < bits; i++) {
         uint64_t least_bit = m & -m;  // get least significant bit
@@ -128,7 +190,7 @@ static inline uint64_t indexToUint64(int index, int bits, uint64_t m) {
 #define BLACK_PAWN_ATTACKS(pawns) (SOUTH_EAST(pawns) | SOUTH_WEST(pawns))
 
 // Size of attack tables for each square
-const int RAttackSize[64] = {
+constexpr int RAttackSize[64] = {
   4096,
   2048,
   2048,
@@ -195,7 +257,7 @@ const int RAttackSize[64] = {
   4096,
 };
 
-const int BAttackSize[64] = {
+constexpr int BAttackSize[64] = {
   64,
   32,
   32,
@@ -262,12 +324,9 @@ const int BAttackSize[64] = {
   64,
 };
 
-// Attack lookup tables
-static uint64_t* RAttacks[64];
-static uint64_t* BAttacks[64];
 
 // Magic bitboard shift amounts
-const int RShifts[64] = {
+constexpr int RShifts[64] = {
   52,
   53,
   53,
@@ -334,7 +393,7 @@ const int RShifts[64] = {
   52,
 };
 
-const int BShifts[64] = {
+constexpr int BShifts[64] = {
   58,
   59,
   59,
@@ -402,7 +461,7 @@ const int BShifts[64] = {
 };
 
 // Magic numbers for rooks
-const uint64_t RMagic[64] = {
+constexpr uint64_t RMagic[64] = {
   0xa8002c000108020ULL,
   0x6c00049b0002001ULL,
   0x100200010090040ULL,
@@ -470,7 +529,7 @@ const uint64_t RMagic[64] = {
 };
 
 // Magic numbers for bishops
-const uint64_t BMagic[64] = {
+constexpr uint64_t BMagic[64] = {
   0x89a1121896040240ULL,
   0x2004844802002010ULL,
   0x2068080051921000ULL,
@@ -538,7 +597,7 @@ const uint64_t BMagic[64] = {
 };
 
 // Attack masks for each square
-const uint64_t RMasks[64] = {
+constexpr uint64_t RMasks[64] = {
   0x101010101017eULL,
   0x202020202027cULL,
   0x404040404047aULL,
@@ -605,7 +664,7 @@ const uint64_t RMasks[64] = {
   0x7e80808080808000ULL,
 };
 
-const uint64_t BMasks[64] = {
+constexpr uint64_t BMasks[64] = {
   0x40201008040200ULL,
   0x402010080400ULL,
   0x4020100a00ULL,
@@ -673,7 +732,7 @@ const uint64_t BMasks[64] = {
 };
 
 // Pre-calculated knight attack bitboards
-const uint64_t KnightAttacks[64] = {
+constexpr uint64_t KnightAttacks[64] = {
   0x20400ULL,
   0x50800ULL,
   0xa1100ULL,
@@ -741,7 +800,7 @@ const uint64_t KnightAttacks[64] = {
 };
 
 // Pre-calculated king attack bitboards
-const uint64_t KingAttacks[64] = {
+constexpr uint64_t KingAttacks[64] = {
   0x302ULL,
   0x705ULL,
   0xe0aULL,
@@ -808,66 +867,166 @@ const uint64_t KingAttacks[64] = {
   0x40c0000000000000ULL,
 };
 
+// Every square's attack sets in one table, rooks first. A square has 2^bits entries for its mask either
+// way, the lookup only decides the order within them
+constexpr int ROOK_ATTACK_ENTRIES = 102400;
+constexpr int BISHOP_ATTACK_ENTRIES = 5248;
+
+struct SliderOffsets {
+    int rook[64];
+    int bishop[64];
+};
+
+constexpr SliderOffsets makeSliderOffsets() {
+    SliderOffsets offsets{};
+    int offset = 0;
+    for (int square = 0; square < 64; square++) {
+        offsets.rook[square] = offset;
+        offset += RAttackSize[square];
+    }
+    for (int square = 0; square < 64; square++) {
+        offsets.bishop[square] = offset;
+        offset += BAttackSize[square];
+    }
+    return offsets;
+}
+
+static constexpr SliderOffsets _sliderOffsets = makeSliderOffsets();
+static_assert(_sliderOffsets.bishop[63] + BAttackSize[63] == ROOK_ATTACK_ENTRIES + BISHOP_ATTACK_ENTRIES,
+              "slider table sizes don't add up");
+
+// Attack sets by table index, in pext and in magic order. Both are built by the compiler, so they sit in
+// read-only data and nothing has to run (or race) before the first move is generated. Walking a mask's
+// subsets with the carry-rippler trick visits them in counting order, which is exactly the order pext
+// gives back, and the magic table is a reshuffle of that one.
+struct SliderAttackTable {
+    uint64_t attacks[ROOK_ATTACK_ENTRIES + BISHOP_ATTACK_ENTRIES];
+};
+
+constexpr SliderAttackTable makePextSliderAttackTable() {
+    SliderAttackTable table{};
+    for (int square = 0; square < 64; square++) {
+        uint64_t subset = 0;
+        int index = _sliderOffsets.rook[square];
+        do {
+            table.attacks[index++] = ratt(square, subset);
+            subset = (subset - RMasks[square]) & RMasks[square];
+        } while (subset);
+
+        index = _sliderOffsets.bishop[square];
+        do {
+            table.attacks[index++] = batt(square, subset);
+            subset = (subset - BMasks[square]) & BMasks[square];
+        } while (subset);
+    }
+    return table;
+}
+
+static constexpr SliderAttackTable _pextSliderAttacks = makePextSliderAttackTable();
+
+constexpr SliderAttackTable makeMagicSliderAttackTable() {
+    SliderAttackTable table{};
+    for (int square = 0; square < 64; square++) {
+        uint64_t subset = 0;
+        int index = _sliderOffsets.rook[square];
+        do {
+            table.attacks[_sliderOffsets.rook[square] + ((subset * RMagic[square]) >> RShifts[square])] = _pextSliderAttacks.attacks[index++];
+            subset = (subset - RMasks[square]) & RMasks[square];
+        } while (subset);
+
+        index = _sliderOffsets.bishop[square];
+        do {
+            table.attacks[_sliderOffsets.bishop[square] + ((subset * BMagic[square]) >> BShifts[square])] = _pextSliderAttacks.attacks[index++];
+            subset = (subset - BMasks[square]) & BMasks[square];
+        } while (subset);
+    }
+    return table;
+}
+
+static constexpr SliderAttackTable _magicSliderAttacks = makeMagicSliderAttackTable();
+
+// set once during static initialisation, before any thread can look at it
+static SliderLookup _sliderLookup = cpuHasFastPext() ? PextLookup : MagicLookup;
+
 // Helper functions for move generation
 static inline uint64_t getRookAttacks(int square, uint64_t occupied) {
-    occupied &= RMasks[square];
-    occupied *= RMagic[square];
-    occupied >>= RShifts[square];
-    return RAttacks[square][occupied];
+#ifdef CHESS_HAS_PEXT
+    if (_sliderLookup == PextLookup) {
+        return _pextSliderAttacks.attacks[_sliderOffsets.rook[square] + pext64(occupied, RMasks[square])];
+    }
+#endif
+    return _magicSliderAttacks.attacks[_sliderOffsets.rook[square] + (((occupied & RMasks[square]) * RMagic[square]) >> RShifts[square])];
 }
 
 static inline uint64_t getBishopAttacks(int square, uint64_t occupied) {
-    occupied &= BMasks[square];
-    occupied *= BMagic[square];
-    occupied >>= BShifts[square];
-    return BAttacks[square][occupied];
+#ifdef CHESS_HAS_PEXT
+    if (_sliderLookup == PextLookup) {
+        return _pextSliderAttacks.attacks[_sliderOffsets.bishop[square] + pext64(occupied, BMasks[square])];
+    }
+#endif
+    return _magicSliderAttacks.attacks[_sliderOffsets.bishop[square] + (((occupied & BMasks[square]) * BMagic[square]) >> BShifts[square])];
 }
 
 static inline uint64_t getQueenAttacks(int square, uint64_t occupied) {
     return getRookAttacks(square, occupied) | getBishopAttacks(square, occupied);
 }
 
-// Initialize magic bitboards
-void initMagicBitboards(void) {
-    int square, i;
-    uint64_t subset, index;
-
-    // Initialize rook attack tables
-    for (square = 0; square < 64; square++) {
-        RAttacks[square] = new uint64_t[RAttackSize[square]];
-        uint64_t mask = RMasks[square];
-        int bits = countOnes(mask);
-        int n = 1 << bits;
-
-        for (i = 0; i < n; i++) {
-            subset = indexToUint64(i, bits, mask);
-            index = (subset * RMagic[square]) >> RShifts[square];
-            RAttacks[square][index] = ratt(square, subset);
-        }
-    }
+// PextLookup is refused where pext isn't built in or the CPU doesn't have it. Not thread safe, pick
+// one before any search starts
+static inline bool setSliderLookup(SliderLookup lookup) {
+#ifdef CHESS_HAS_PEXT
+    if (lookup == PextLookup && !cpuHasFastPext()) return false;
+    _sliderLookup = lookup;
+    return true;
+#else
+    return lookup == MagicLookup;
+#endif
+}
 
-    // Initialize bishop attack tables
-    for (square = 0; square < 64; square++) {
-        BAttacks[square] = new uint64_t[BAttackSize[square]];
-        uint64_t mask = BMasks[square];
-        int bits = countOnes(mask);
-        int n = 1 << bits;
-
-        for (i = 0; i < n; i++) {
-            subset = indexToUint64(i, bits, mask);
-            index = (subset * BMagic[square]) >> BShifts[square];
-            BAttacks[square][index] = batt(square, subset);
-        }
+static inline const char* sliderLookupName() {
+    return _sliderLookup == PextLookup ? "pext" : "magic";
+}
+
+// Pawn captures by [white = 0, black = 1][square]
+struct PawnAttackTable {
+    uint64_t attacks[2][64];
+};
+
+constexpr PawnAttackTable makePawnAttackTable() {
+    PawnAttackTable table{};
+    for (int square = 0; square < 64; square++) {
+        const uint64_t pawn = 1ULL << square;
+        table.attacks[0][square] = WHITE_PAWN_ATTACKS(pawn);
+        table.attacks[1][square] = BLACK_PAWN_ATTACKS(pawn);
     }
+    return table;
 }
 
-// Cleanup magic bitboard tables
-void cleanupMagicBitboards(void) {
-    int square;
-    for (square = 0; square < 64; square++) {
-        delete[] RAttacks[square];
-        delete[] BAttacks[square];
+static constexpr PawnAttackTable _pawnAttackTable = makePawnAttackTable();
+static constexpr const uint64_t (&PawnAttacks)[2][64] = _pawnAttackTable.attacks;
+
+// Squares strictly between two squares on a line, 0 if they don't share one
+struct BetweenTable {
+    uint64_t squares[64][64];
+};
+
+constexpr BetweenTable makeBetweenTable() {
+    BetweenTable table{};
+    // the rays from each end stop at the other, so their overlap is exactly the squares in between
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            const uint64_t fromMask = 1ULL << from;
+            const uint64_t toMask = 1ULL << to;
+            if (ratt(from, 0) & toMask) {
+                table.squares[from][to] = ratt(from, toMask) & ratt(to, fromMask);
+            } else if (batt(from, 0) & toMask) {
+                table.squares[from][to] = batt(from, toMask) & batt(to, fromMask);
+            }
+        }
     }
+    return table;
 }
 
+static constexpr BetweenTable _betweenTable = makeBetweenTable();
+
 #endif // MAGIC_BITBOARDS_H
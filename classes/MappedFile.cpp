@@ -0,0 +1,82 @@
+#include "MappedFile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : _data(nullptr), _size(0)
+#ifdef _WIN32
+    , _fileHandle(nullptr), _mappingHandle(nullptr)
+#endif
+{
+}
+
+bool MappedFile::open(const std::string& path, Access access)
+{
+    close();
+
+#ifdef _WIN32
+    const DWORD hint = access == Random ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, hint, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open file for reading: " << path << std::endl;
+        return false;
+    }
+    _fileHandle = file;
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        _mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (_mappingHandle) {
+            _data = MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+            _size = _data ? static_cast<size_t>(fileSize.QuadPart) : 0;
+        }
+    }
+#else
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Failed to open file for reading: " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (view != MAP_FAILED) {
+            madvise(view, static_cast<size_t>(info.st_size), access == Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+            _data = view;
+            _size = static_cast<size_t>(info.st_size);
+        }
+    }
+    ::close(file);  // the mapping keeps the file alive
+#endif
+
+    if (!_data) {
+        std::cerr << "Could not map file: " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (_data) UnmapViewOfFile(_data);
+    if (_mappingHandle) CloseHandle(_mappingHandle);
+    if (_fileHandle) CloseHandle(_fileHandle);
+    _fileHandle = nullptr;
+    _mappingHandle = nullptr;
+#else
+    if (_data) munmap(_data, _size);
+#endif
+    _data = nullptr;
+    _size = 0;
+}
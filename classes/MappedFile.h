@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+//
+// A whole file mapped read-only into memory: mmap on POSIX, MapViewOfFile on Windows.
+// The view starts on a page boundary, so data laid out at aligned offsets in the file is aligned in memory.
+//
+class MappedFile {
+public:
+    // Sequential suits files read front to back, Random tells the OS not to bother reading ahead
+    enum Access { Sequential, Random };
+
+    MappedFile();
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path, Access access = Sequential);
+    void close();
+
+    bool isOpen() const { return _data != nullptr; }
+    const void* data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    void* _data;
+    size_t _size;
+#ifdef _WIN32
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+};
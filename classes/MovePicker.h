@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include "GameState.h"
+
+//
+// Staged move ordering for the chess search
+// the move list is split into stages: the TT move, captures and promotions by MVV-LVA, the two killers
+// for this ply, quiet moves by history score, and last the captures that lose material by static
+// exchange. Each stage is only sorted when the search gets to it, so a cutoff on the TT move or a good
+// capture skips the rest of the work.
+//
+
+constexpr int MAX_KILLERS = 2;
+
+// history[side][from][to], side 0 for white
+using HistoryTable = int[2][64][64];
+
+class MovePicker {
+public:
+    MovePicker(const GameState& state, MoveList& moves, BitMove ttMove, const BitMove* killers, const HistoryTable& history)
+        : _state(state), _moves(moves), _ttMove(ttMove), _killers(killers), _history(history),
+          _stage(StageTTMove), _current(0), _stageEnd(0)
+    {
+    }
+
+    // next move to search, false once every move has been handed out
+    bool next(BitMove& move) {
+        while (true) {
+            switch (_stage) {
+            case StageTTMove:
+                _stage = StageCapturesInit;
+                if (_ttMove.piece != NoPiece && takeMove([this](const BitMove& m) { return m == _ttMove; })) {
+                    move = _moves[_current - 1];
+                    return true;
+                }
+                break;
+            case StageCapturesInit: {
+                // the noisy moves to the front of what's left, the ones that lose material to the very end
+                const int noisyEnd = partitionFrom(_current, [](const BitMove& m) { return isNoisy(m); });
+                _stageEnd = partitionFrom(_current, [this](const BitMove& m) { return !losesMaterial(m); }, noisyEnd);
+                _badCaptures = noisyEnd - _stageEnd;
+                std::rotate(_moves.begin() + _stageEnd, _moves.begin() + noisyEnd, _moves.end());
+                for (int i = _current; i < _stageEnd; i++) {
+                    _scores[i] = mvvLva(_moves[i]);
+                }
+                _stage = StageCaptures;
+                break;
+            }
+            case StageCaptures:
+                if (_current < _stageEnd) {
+                    move = pickBest();
+                    return true;
+                }
+                _stage = StageKillers;
+                _killerIndex = 0;
+                break;
+            case StageKillers:
+                while (_killerIndex < MAX_KILLERS) {
+                    const BitMove killer = _killers[_killerIndex++];
+                    if (killer.piece != NoPiece && !(killer == _ttMove) &&
+                        takeMove([&killer](const BitMove& m) { return m == killer; })) {
+                        move = _moves[_current - 1];
+                        return true;
+                    }
+                }
+                _stage = StageQuietsInit;
+                break;
+            case StageQuietsInit: {
+                const int side = _state.color == WHITE ? 0 : 1;
+                _stageEnd = _moves.size() - _badCaptures;
+                for (int i = _current; i < _stageEnd; i++) {
+                    _scores[i] = _history[side][_moves[i].from][_moves[i].to];
+                }
+                _stage = StageQuiets;
+                break;
+            }
+            case StageQuiets:
+                if (_current < _stageEnd) {
+                    move = pickBest();
+                    return true;
+                }
+                _stageEnd = _moves.size();
+                for (int i = _current; i < _stageEnd; i++) {
+                    _scores[i] = mvvLva(_moves[i]);
+                }
+                _stage = StageBadCaptures;
+                break;
+            case StageBadCaptures:
+                if (_current < _stageEnd) {
+                    move = pickBest();
+                    return true;
+                }
+                _stage = StageDone;
+                break;
+            case StageDone:
+                return false;
+            }
+        }
+    }
+
+    static bool isNoisy(const BitMove& move) { return (move.flags & (IsCapture | IsPromotion)) != 0; }
+    // the moves handed out from here on are captures that lose material, which quiescence can skip
+    bool pickingBadCaptures() const { return _stage == StageBadCaptures; }
+
+private:
+    enum Stage {
+        StageTTMove,
+        StageCapturesInit,
+        StageCaptures,
+        StageKillers,
+        StageQuietsInit,
+        StageQuiets,
+        StageBadCaptures,
+        StageDone
+    };
+
+    // most valuable victim first, least valuable attacker breaks ties. Promotions count the new piece as the victim.
+    int mvvLva(const BitMove& move) const {
+        int victim = (move.flags & EnPassant) ? Pawn : pieceType(_state.state[move.to]);
+        if (move.flags & IsPromotion) {
+            victim += move.promotionPiece();
+        }
+        return victim * 8 - move.piece;
+    }
+
+    // promotions are never counted as losing, whatever happens to the new piece
+    bool losesMaterial(const BitMove& move) const {
+        return !(move.flags & IsPromotion) && _state.see(move) < 0;
+    }
+
+    static int pieceType(char piece) {
+        switch (piece) {
+            case 'P': case 'p': return Pawn;
+            case 'N': case 'n': return Knight;
+            case 'B': case 'b': return Bishop;
+            case 'R': case 'r': return Rook;
+            case 'Q': case 'q': return Queen;
+            case 'K': case 'k': return King;
+        }
+        return NoPiece;
+    }
+
+    // swap the first remaining move matching 'match' into the next slot, keeping the stage ranges intact
+    template <typename Match>
+    bool takeMove(Match match) {
+        for (int i = _current; i < _moves.size(); i++) {
+            if (match(_moves[i])) {
+                std::swap(_moves[i], _moves[_current]);
+                _current++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename Predicate>
+    int partitionFrom(int start, Predicate predicate, int stop = -1) {
+        int end = start;
+        const int last = stop < 0 ? _moves.size() : stop;
+        for (int i = start; i < last; i++) {
+            if (predicate(_moves[i])) {
+                std::swap(_moves[i], _moves[end]);
+                end++;
+            }
+        }
+        return end;
+    }
+
+    // selection sort one step at a time, most nodes cut off long before the list is sorted
+    BitMove pickBest() {
+        int best = _current;
+        for (int i = _current + 1; i < _stageEnd; i++) {
+            if (_scores[i] > _scores[best]) {
+                best = i;
+            }
+        }
+        std::swap(_moves[best], _moves[_current]);
+        std::swap(_scores[best], _scores[_current]);
+        return _moves[_current++];
+    }
+
+    const GameState& _state;
+    MoveList& _moves;
+    BitMove _ttMove;
+    const BitMove* _killers;
+    const HistoryTable& _history;
+    Stage _stage;
+    int _current;
+    int _stageEnd;
+    int _killerIndex = 0;
+    int _badCaptures = 0;   // losing captures, kept at the end of the list until the last stage
+    int _scores[MAX_MOVES];
+};
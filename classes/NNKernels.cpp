@@ -0,0 +1,391 @@
+#include "NNKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define NN_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC compiles AVX2 intrinsics anywhere, gcc and clang need the functions marked
+#if defined(NN_X86) && !defined(_MSC_VER)
+#define NN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define NN_TARGET_AVX2
+#endif
+
+namespace {
+
+// Scalar fallback, also the reference the vector versions are checked against
+
+float dotScalar(const float* a, const float* b, int n)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void denseReluScalar(const float* weights, const float* bias, const float* input, float* output, int rows, int cols)
+{
+    for (int r = 0; r < rows; r++) {
+        const float sum = bias[r] + dotScalar(weights + static_cast<size_t>(r) * cols, input, cols);
+        output[r] = sum > 0.0f ? sum : 0.0f;
+    }
+}
+
+void denseReluBatchScalar(const float* weights, const float* bias, const float* inputs, float* outputs, int rows, int cols, int batch)
+{
+    for (int b = 0; b < batch; b++) {
+        denseReluScalar(weights, bias, inputs + static_cast<size_t>(b) * cols, outputs + static_cast<size_t>(b) * rows, rows, cols);
+    }
+}
+
+void reluScalar(const float* in, float* out, int n)
+{
+    for (int i = 0; i < n; i++) {
+        out[i] = in[i] > 0.0f ? in[i] : 0.0f;
+    }
+}
+
+void addScaledScalar(float* acc, const float* column, float scale, int n)
+{
+    for (int i = 0; i < n; i++) {
+        acc[i] += scale * column[i];
+    }
+}
+
+void addScalar(float* acc, const float* column, int n)
+{
+    for (int i = 0; i < n; i++) {
+        acc[i] += column[i];
+    }
+}
+
+void subScalar(float* acc, const float* column, int n)
+{
+    for (int i = 0; i < n; i++) {
+        acc[i] -= column[i];
+    }
+}
+
+void addInt16Scalar(int16_t* acc, const int16_t* column, int n)
+{
+    for (int i = 0; i < n; i++) {
+        acc[i] = static_cast<int16_t>(acc[i] + column[i]);
+    }
+}
+
+int32_t dotU8I8Scalar(const uint8_t* a, const int8_t* b, int n)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += int32_t(a[i]) * int32_t(b[i]);
+    }
+    return sum;
+}
+
+const NNKernels scalarKernels = { "scalar", dotScalar, denseReluScalar, denseReluBatchScalar, reluScalar, addScaledScalar,
+                                  addScalar, subScalar, addInt16Scalar, dotU8I8Scalar };
+
+#if defined(NN_X86)
+
+NN_TARGET_AVX2 float horizontalSum(__m256 v)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+NN_TARGET_AVX2 float dotAVX2(const float* a, const float* b, int n)
+{
+    // two accumulators so consecutive FMAs don't wait on each other
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+    }
+    for (; i < n; i += 8) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+    }
+    return horizontalSum(_mm256_add_ps(sum0, sum1));
+}
+
+// the eight lane sums of s0..s7 as one vector, in order
+NN_TARGET_AVX2 __m256 horizontalSum8(__m256 s0, __m256 s1, __m256 s2, __m256 s3, __m256 s4, __m256 s5, __m256 s6, __m256 s7)
+{
+    const __m256 h0123 = _mm256_hadd_ps(_mm256_hadd_ps(s0, s1), _mm256_hadd_ps(s2, s3));
+    const __m256 h4567 = _mm256_hadd_ps(_mm256_hadd_ps(s4, s5), _mm256_hadd_ps(s6, s7));
+    return _mm256_add_ps(_mm256_permute2f128_ps(h0123, h4567, 0x20), _mm256_permute2f128_ps(h0123, h4567, 0x31));
+}
+
+// four rows at a time share each load of the input
+NN_TARGET_AVX2 void denseReluAVX2(const float* weights, const float* bias, const float* input, float* output, int rows, int cols)
+{
+    int r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* w0 = weights + static_cast<size_t>(r) * cols;
+        const float* w1 = w0 + cols;
+        const float* w2 = w1 + cols;
+        const float* w3 = w2 + cols;
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        for (int i = 0; i < cols; i += 8) {
+            const __m256 x = _mm256_loadu_ps(input + i);
+            s0 = _mm256_fmadd_ps(_mm256_loadu_ps(w0 + i), x, s0);
+            s1 = _mm256_fmadd_ps(_mm256_loadu_ps(w1 + i), x, s1);
+            s2 = _mm256_fmadd_ps(_mm256_loadu_ps(w2 + i), x, s2);
+            s3 = _mm256_fmadd_ps(_mm256_loadu_ps(w3 + i), x, s3);
+        }
+        // transpose-free reduction: pairwise hadd leaves the four row sums in one 128 bit lane pair
+        const __m256 h01 = _mm256_hadd_ps(s0, s1);
+        const __m256 h23 = _mm256_hadd_ps(s2, s3);
+        const __m256 h = _mm256_hadd_ps(h01, h23);
+        __m128 sums = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+        sums = _mm_add_ps(sums, _mm_loadu_ps(bias + r));
+        _mm_storeu_ps(output + r, _mm_max_ps(sums, _mm_setzero_ps()));
+    }
+    for (; r < rows; r++) {
+        const float sum = bias[r] + dotAVX2(weights + static_cast<size_t>(r) * cols, input, cols);
+        output[r] = sum > 0.0f ? sum : 0.0f;
+    }
+}
+
+// two rows by four inputs: six loads feed eight independent FMA chains, the single input kernel needs
+// five loads for four
+NN_TARGET_AVX2 void denseReluBatchAVX2(const float* weights, const float* bias, const float* inputs, float* outputs, int rows, int cols, int batch)
+{
+    int b = 0;
+    for (; b + 4 <= batch && rows % 2 == 0; b += 4) {
+        const float* x = inputs + static_cast<size_t>(b) * cols;
+        float* out = outputs + static_cast<size_t>(b) * rows;
+        for (int r = 0; r < rows; r += 2) {
+            const float* w0 = weights + static_cast<size_t>(r) * cols;
+            const float* w1 = w0 + cols;
+            const float* x0 = x;
+            const float* x1 = x0 + cols;
+            const float* x2 = x1 + cols;
+            const float* x3 = x2 + cols;
+            __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+            __m256 s4 = _mm256_setzero_ps(), s5 = _mm256_setzero_ps(), s6 = _mm256_setzero_ps(), s7 = _mm256_setzero_ps();
+            for (int i = 0; i < cols; i += 8) {
+                const __m256 wv0 = _mm256_loadu_ps(w0 + i);
+                const __m256 wv1 = _mm256_loadu_ps(w1 + i);
+                __m256 xv = _mm256_loadu_ps(x0 + i);
+                s0 = _mm256_fmadd_ps(wv0, xv, s0);
+                s1 = _mm256_fmadd_ps(wv1, xv, s1);
+                xv = _mm256_loadu_ps(x1 + i);
+                s2 = _mm256_fmadd_ps(wv0, xv, s2);
+                s3 = _mm256_fmadd_ps(wv1, xv, s3);
+                xv = _mm256_loadu_ps(x2 + i);
+                s4 = _mm256_fmadd_ps(wv0, xv, s4);
+                s5 = _mm256_fmadd_ps(wv1, xv, s5);
+                xv = _mm256_loadu_ps(x3 + i);
+                s6 = _mm256_fmadd_ps(wv0, xv, s6);
+                s7 = _mm256_fmadd_ps(wv1, xv, s7);
+            }
+            // sums come out as (input 0: row r, r+1), (input 1: row r, r+1), ...
+            alignas(32) float sums[8];
+            _mm256_store_ps(sums, horizontalSum8(s0, s1, s2, s3, s4, s5, s6, s7));
+            for (int k = 0; k < 4; k++) {
+                const float sum0 = bias[r] + sums[2 * k];
+                const float sum1 = bias[r + 1] + sums[2 * k + 1];
+                out[static_cast<size_t>(k) * rows + r] = sum0 > 0.0f ? sum0 : 0.0f;
+                out[static_cast<size_t>(k) * rows + r + 1] = sum1 > 0.0f ? sum1 : 0.0f;
+            }
+        }
+    }
+    for (; b < batch; b++) {
+        denseReluAVX2(weights, bias, inputs + static_cast<size_t>(b) * cols, outputs + static_cast<size_t>(b) * rows, rows, cols);
+    }
+}
+
+NN_TARGET_AVX2 void reluAVX2(const float* in, float* out, int n)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_max_ps(_mm256_loadu_ps(in + i), zero));
+    }
+}
+
+NN_TARGET_AVX2 void addScaledAVX2(float* acc, const float* column, float scale, int n)
+{
+    const __m256 s = _mm256_set1_ps(scale);
+    for (int i = 0; i < n; i += 8) {
+        _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(s, _mm256_loadu_ps(column + i), _mm256_loadu_ps(acc + i)));
+    }
+}
+
+NN_TARGET_AVX2 void addAVX2(float* acc, const float* column, int n)
+{
+    for (int i = 0; i < n; i += 8) {
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(column + i)));
+    }
+}
+
+NN_TARGET_AVX2 void subAVX2(float* acc, const float* column, int n)
+{
+    for (int i = 0; i < n; i += 8) {
+        _mm256_storeu_ps(acc + i, _mm256_sub_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(column + i)));
+    }
+}
+
+NN_TARGET_AVX2 void addInt16AVX2(int16_t* acc, const int16_t* column, int n)
+{
+    for (int i = 0; i < n; i += 16) {
+        __m256i* target = reinterpret_cast<__m256i*>(acc + i);
+        const __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column + i));
+        _mm256_storeu_si256(target, _mm256_add_epi16(_mm256_loadu_si256(target), weights));
+    }
+}
+
+// maddubs adds pairs of u8 * i8 products into 16 bits, which is exact while the u8 side stays <= 127
+NN_TARGET_AVX2 int32_t dotU8I8AVX2(const uint8_t* a, const int8_t* b, int n)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        const __m256i pairs = _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                                   _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+    }
+    __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(1, 0, 3, 2)));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(total);
+}
+
+const NNKernels avx2Kernels = { "avx2", dotAVX2, denseReluAVX2, denseReluBatchAVX2, reluAVX2, addScaledAVX2, addAVX2, subAVX2,
+                                addInt16AVX2, dotU8I8AVX2 };
+
+// AVX2 and FMA in the CPU, and the OS saving the upper halves of the ymm registers
+bool cpuHasAVX2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!fma || !osxsave || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+#elif defined(NN_NEON)
+
+float dotNEON(const float* a, const float* b, int n)
+{
+    float32x4_t sum0 = vdupq_n_f32(0.0f);
+    float32x4_t sum1 = vdupq_n_f32(0.0f);
+    for (int i = 0; i < n; i += 8) {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    const float32x4_t sum = vaddq_f32(sum0, sum1);
+    const float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    return vget_lane_f32(vpadd_f32(half, half), 0);
+}
+
+void denseReluNEON(const float* weights, const float* bias, const float* input, float* output, int rows, int cols)
+{
+    for (int r = 0; r < rows; r++) {
+        const float sum = bias[r] + dotNEON(weights + static_cast<size_t>(r) * cols, input, cols);
+        output[r] = sum > 0.0f ? sum : 0.0f;
+    }
+}
+
+void denseReluBatchNEON(const float* weights, const float* bias, const float* inputs, float* outputs, int rows, int cols, int batch)
+{
+    for (int b = 0; b < batch; b++) {
+        denseReluNEON(weights, bias, inputs + static_cast<size_t>(b) * cols, outputs + static_cast<size_t>(b) * rows, rows, cols);
+    }
+}
+
+void reluNEON(const float* in, float* out, int n)
+{
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    for (int i = 0; i < n; i += 4) {
+        vst1q_f32(out + i, vmaxq_f32(vld1q_f32(in + i), zero));
+    }
+}
+
+void addScaledNEON(float* acc, const float* column, float scale, int n)
+{
+    for (int i = 0; i < n; i += 4) {
+        vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), vld1q_f32(column + i), scale));
+    }
+}
+
+void addNEON(float* acc, const float* column, int n)
+{
+    for (int i = 0; i < n; i += 4) {
+        vst1q_f32(acc + i, vaddq_f32(vld1q_f32(acc + i), vld1q_f32(column + i)));
+    }
+}
+
+void subNEON(float* acc, const float* column, int n)
+{
+    for (int i = 0; i < n; i += 4) {
+        vst1q_f32(acc + i, vsubq_f32(vld1q_f32(acc + i), vld1q_f32(column + i)));
+    }
+}
+
+void addInt16NEON(int16_t* acc, const int16_t* column, int n)
+{
+    for (int i = 0; i < n; i += 8) {
+        vst1q_s16(acc + i, vaddq_s16(vld1q_s16(acc + i), vld1q_s16(column + i)));
+    }
+}
+
+// the u8 side is at most 127, so it can be read as signed
+int32_t dotU8I8NEON(const uint8_t* a, const int8_t* b, int n)
+{
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int i = 0; i < n; i += 16) {
+        const int8x16_t x = vreinterpretq_s8_u8(vld1q_u8(a + i));
+        const int8x16_t w = vld1q_s8(b + i);
+        sum = vpadalq_s16(sum, vmull_s8(vget_low_s8(x), vget_low_s8(w)));
+        sum = vpadalq_s16(sum, vmull_s8(vget_high_s8(x), vget_high_s8(w)));
+    }
+    const int32x2_t half = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+    return vget_lane_s32(vpadd_s32(half, half), 0);
+}
+
+const NNKernels neonKernels = { "neon", dotNEON, denseReluNEON, denseReluBatchNEON, reluNEON, addScaledNEON, addNEON, subNEON,
+                                addInt16NEON, dotU8I8NEON };
+
+#endif
+
+const NNKernels& selectKernels()
+{
+#if defined(NN_X86)
+    if (cpuHasAVX2()) {
+        return avx2Kernels;
+    }
+#elif defined(NN_NEON)
+    // NEON is part of the baseline on every ARM target that defines it
+    return neonKernels;
+#endif
+    return scalarKernels;
+}
+
+}
+
+const NNKernels& nnKernels()
+{
+    static const NNKernels& kernels = selectKernels();
+    return kernels;
+}
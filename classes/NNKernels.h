@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+//
+// Dense layer kernels for ChessEval
+// every layer is stored as one flat 64 byte aligned buffer, and the hot loops go through a table of
+// kernels picked once at startup: AVX2+FMA when the CPU has it, NEON on ARM, plain C++ otherwise.
+// Lengths passed to the float kernels are multiples of 8 (NN_KERNEL_WIDTH), to the integer ones of 32.
+// The integer kernels give exactly the scalar result on every path, QuantizedEval relies on that.
+//
+
+constexpr int NN_KERNEL_WIDTH = 8;
+constexpr size_t NN_ALIGNMENT = 64;
+
+// fixed size float buffer on a cache line boundary, zero filled. It can also borrow read-only memory
+// someone else owns, such as a mapped model file; makeOwned() copies it out before anything writes to it.
+class AlignedFloats {
+public:
+    AlignedFloats() : _data(nullptr), _size(0), _owned(true) { }
+    explicit AlignedFloats(size_t size) : _data(nullptr), _size(0), _owned(true) { resize(size); }
+    AlignedFloats(const AlignedFloats& other) : _data(nullptr), _size(0), _owned(true) { *this = other; }
+    ~AlignedFloats() { release(); }
+
+    AlignedFloats& operator=(const AlignedFloats& other) {
+        if (this != &other) {
+            resize(other._size);
+            std::memcpy(_data, other._data, _size * sizeof(float));
+        }
+        return *this;
+    }
+
+    void resize(size_t size) {
+        if (size == _size && _owned) return;
+        release();
+        if (size > 0) {
+            _data = static_cast<float*>(::operator new(size * sizeof(float), std::align_val_t(NN_ALIGNMENT)));
+            std::memset(_data, 0, size * sizeof(float));
+            _size = size;
+        }
+    }
+
+    void borrow(const float* data, size_t size) {
+        release();
+        _data = const_cast<float*>(data);
+        _size = size;
+        _owned = false;
+    }
+
+    void makeOwned() {
+        if (_owned) return;
+        const float* borrowed = _data;
+        const size_t size = _size;
+        _data = nullptr;
+        _size = 0;
+        _owned = true;
+        resize(size);
+        if (size > 0) std::memcpy(_data, borrowed, size * sizeof(float));
+    }
+
+    bool isBorrowed() const { return !_owned; }
+
+    float* data() { return _data; }
+    const float* data() const { return _data; }
+    size_t size() const { return _size; }
+    float& operator[](size_t index) { return _data[index]; }
+    const float& operator[](size_t index) const { return _data[index]; }
+
+private:
+    void release() {
+        if (_data && _owned) {
+            ::operator delete(_data, std::align_val_t(NN_ALIGNMENT));
+        }
+        _data = nullptr;
+        _size = 0;
+        _owned = true;
+    }
+
+    float* _data;
+    size_t _size;
+    bool _owned;
+};
+
+struct NNKernels {
+    const char* name;
+    // sum of a[i] * b[i]
+    float (*dot)(const float* a, const float* b, int n);
+    // output[r] = max(0, bias[r] + weights[r * cols ..] . input), weights row-major
+    void (*denseRelu)(const float* weights, const float* bias, const float* input, float* output, int rows, int cols);
+    // denseRelu over a batch: inputs are batch x cols, outputs batch x rows, each weight row is loaded
+    // once for several inputs
+    void (*denseReluBatch)(const float* weights, const float* bias, const float* inputs, float* outputs, int rows, int cols, int batch);
+    // out[i] = max(0, in[i])
+    void (*relu)(const float* in, float* out, int n);
+    // acc[i] += scale * column[i]
+    void (*addScaled)(float* acc, const float* column, float scale, int n);
+    // acc[i] += column[i], acc[i] -= column[i]
+    void (*add)(float* acc, const float* column, int n);
+    void (*sub)(float* acc, const float* column, int n);
+
+    // integer network: acc[i] += column[i], wrapping like the vector instructions do
+    void (*addInt16)(int16_t* acc, const int16_t* column, int n);
+    // sum of a[i] * b[i], a must be at most 127 so pairs of products can't saturate 16 bits
+    int32_t (*dotU8I8)(const uint8_t* a, const int8_t* b, int n);
+};
+
+// the best kernel set this CPU supports, chosen on first use
+const NNKernels& nnKernels();
@@ -0,0 +1,118 @@
+#include "Notation.h"
+
+std::string moveToUCI(const BitMove& move)
+{
+    std::string text;
+    text += static_cast<char>('a' + (move.from & 7));
+    text += static_cast<char>('1' + (move.from >> 3));
+    text += static_cast<char>('a' + (move.to & 7));
+    text += static_cast<char>('1' + (move.to >> 3));
+    if (move.flags & IsPromotion) {
+        text += "qnbr"[(move.flags & PromotionPieceMask) >> 5];
+    }
+    return text;
+}
+
+// everything but the check suffix, which is the expensive part
+static std::string sanWithoutCheck(const BitMove& move, const MoveList& legal)
+{
+    std::string san;
+    if (move.flags & KingSideCastle) {
+        san = "O-O";
+    } else if (move.flags & QueenSideCastle) {
+        san = "O-O-O";
+    } else {
+        const bool capture = (move.flags & (IsCapture | EnPassant)) != 0;
+        if (move.piece == Pawn) {
+            if (capture) {
+                san += static_cast<char>('a' + (move.from & 7));
+            }
+        } else {
+            san += " PNBRQK"[move.piece];
+            // the file if it tells the pieces apart, else the rank, else both
+            bool ambiguous = false;
+            bool sameFile = false;
+            bool sameRank = false;
+            for (const BitMove& other : legal) {
+                if (other.piece == move.piece && other.to == move.to && other.from != move.from) {
+                    ambiguous = true;
+                    sameFile = sameFile || (other.from & 7) == (move.from & 7);
+                    sameRank = sameRank || (other.from >> 3) == (move.from >> 3);
+                }
+            }
+            if (ambiguous && (!sameFile || sameRank)) {
+                san += static_cast<char>('a' + (move.from & 7));
+            }
+            if (ambiguous && sameFile) {
+                san += static_cast<char>('1' + (move.from >> 3));
+            }
+        }
+        if (capture) {
+            san += 'x';
+        }
+        san += static_cast<char>('a' + (move.to & 7));
+        san += static_cast<char>('1' + (move.to >> 3));
+        if (move.flags & IsPromotion) {
+            san += '=';
+            san += "QNBR"[(move.flags & PromotionPieceMask) >> 5];
+        }
+    }
+    return san;
+}
+
+std::string moveToSAN(GameState& position, const BitMove& move, const MoveList& legal)
+{
+    std::string san = sanWithoutCheck(move, legal);
+    position.pushMove(move);
+    if (position.isInCheck()) {
+        MoveList replies;
+        position.generateAllMoves(replies);
+        san += replies.empty() ? '#' : '+';
+    }
+    position.popState();
+    return san;
+}
+
+BitMove parseMove(GameState& position, const std::string& text)
+{
+    std::string bare = text;
+    while (!bare.empty() && (bare.back() == '+' || bare.back() == '#' || bare.back() == '!' || bare.back() == '?')) {
+        bare.pop_back();
+    }
+    // castling is written with zeros too
+    if (bare == "0-0") bare = "O-O";
+    if (bare == "0-0-0") bare = "O-O-O";
+
+    MoveList legal;
+    position.generateAllMoves(legal);
+    for (const BitMove& move : legal) {
+        if (moveToUCI(move) == bare) {
+            return move;
+        }
+    }
+    for (const BitMove& move : legal) {
+        if (sanWithoutCheck(move, legal) == bare) {
+            return move;
+        }
+    }
+    return BitMove();
+}
+
+bool parseEpdLine(const std::string& line, std::string& fen)
+{
+    fen = line;
+    while (!fen.empty() && (fen.back() == '\n' || fen.back() == '\r' || fen.back() == ' ')) {
+        fen.pop_back();
+    }
+    if (fen.empty() || fen[0] == '#') {
+        return false;
+    }
+    size_t fieldEnd = 0;
+    for (int field = 0; field < 4 && fieldEnd != std::string::npos; field++) {
+        fieldEnd = fen.find(' ', fieldEnd + (field ? 1 : 0));
+    }
+    if (fieldEnd != std::string::npos && fen.find(';', fieldEnd) != std::string::npos) {
+        fen.resize(fieldEnd);
+    }
+    return true;
+}
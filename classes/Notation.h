@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include "GameState.h"
+
+//
+// Chess moves as text
+// UCI's long algebraic (e2e4, e7e8q) is what the tools and the protocols speak; standard algebraic
+// (Nbd2, exd6, O-O, e8=Q+) is what PGN needs, and reading it back means matching against the legal
+// moves, since the text alone doesn't say where a piece came from.
+//
+
+std::string moveToUCI(const BitMove& move);
+
+// legal holds the position's legal moves, which the disambiguation needs; the check suffix comes
+// from playing the move and taking it back, so position is left as it was
+std::string moveToSAN(GameState& position, const BitMove& move, const MoveList& legal);
+
+// the legal move written as text in either notation, check marks and annotations optional; a move
+// with NoPiece if nothing matches
+BitMove parseMove(GameState& position, const std::string& text);
+
+// a line of a FEN or EPD file as a FEN for GameState::loadFEN; false for a blank line or a # comment.
+// EPD lines carry opcodes after the fourth field where a FEN has its clocks, those are dropped and
+// the clocks then start over
+bool parseEpdLine(const std::string& line, std::string& fen);
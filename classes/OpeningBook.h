@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "GameState.h"
+#include "MappedFile.h"
+
+//
+// Opening book in the Polyglot file format
+// a book is a flat array of 16 byte big-endian entries (key, move, weight, learn) sorted by key, so
+// it is mapped and binary searched in place, nothing is loaded or parsed up front. Moves use the
+// Polyglot encoding: to in bits 0-5, from in bits 6-11, promotion piece in bits 12-14, and castling
+// written as the king taking its own rook.
+// The keys are Polyglot's own, from polyglotKey rather than the engine's Zobrist hash, so any
+// Polyglot book works as well as the ones makebook builds from PGN.
+//
+
+struct BookEntry {
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+};
+
+constexpr size_t BOOK_ENTRY_SIZE = 16;
+
+// the position's key in Polyglot books: pieces, castling rights, the en passant file when a capture
+// is possible, and the side to move
+uint64_t polyglotKey(const GameState& position);
+
+class OpeningBook {
+public:
+    bool open(const std::string& path);
+    void close() { _file.close(); _count = 0; }
+
+    bool isOpen() const { return _count > 0; }
+    size_t size() const { return _count; }
+
+    // every entry for the position's key, heaviest first
+    std::vector<BookEntry> probe(uint64_t key) const;
+    // a book move among legal, chosen at random in proportion to its weight; random is any
+    // uniformly distributed value. A move with NoPiece when the position is out of book.
+    BitMove pick(uint64_t key, const MoveList& legal, uint64_t random) const;
+
+    static uint16_t encodeMove(const BitMove& move);
+    // the legal move the book move stands for, NoPiece if none does
+    static BitMove decodeMove(uint16_t move, const MoveList& legal);
+
+    static void writeEntry(const BookEntry& entry, unsigned char* bytes);
+    static BookEntry readEntry(const unsigned char* bytes);
+
+private:
+    MappedFile _file;
+    size_t _count = 0;
+};
@@ -14,6 +14,7 @@ Othello::Othello() : Game() {
 }
 
 Othello::~Othello() {
+    _aiJob.cancel();
     delete _grid;
 }
 
@@ -295,36 +296,52 @@ void Othello::setStateString(const std::string &s) {
     });
 }
 
-void Othello::updateAI() {
-    if (!gameHasAI()) return;
-
-    Player* aiPlayer = getCurrentPlayer();
-    std::vector<std::pair<int, int>> validMoves = getValidMoves(aiPlayer);
-
-    if (validMoves.empty()) {
-        _consecutivePasses++;
-        endTurn();
-        return;
+// squares as a1..h8 with row 0 as rank 1, the way the grid draws them
+static std::string othelloMoveName(int move) {
+    if (move == OTHELLO_PASS) {
+        return "pass";
     }
+    return std::string(1, static_cast<char>('a' + move % 8)) + static_cast<char>('1' + move / 8);
+}
 
-    // Find move that flips the most pieces
-    int bestX = -1, bestY = -1, maxFlips = 0;
-
-    for (const auto& move : validMoves) {
-        int x = move.first, y = move.second, totalFlips = 0;
-        for (int i = 0; i < 8; i++) {
-            totalFlips += checkDirection(x, y, DIRECTIONS[i][0], DIRECTIONS[i][1], aiPlayer);
-        }
-        if (totalFlips > maxFlips) {
-            maxFlips = totalFlips;
-            bestX = x;
-            bestY = y;
-        }
+AIJob::Work Othello::aiWork() {
+    if (!gameHasAI()) return nullptr;
+
+    const OthelloPosition position(boardFor(getCurrentPlayer()));
+    if (position.legal == 0) {
+        // nothing to search, the pass is played on the next frame
+        return [this](AIJob&) -> std::function<void()> {
+            return [this]() {
+                _consecutivePasses++;
+                endTurn();
+            };
+        };
     }
+    return [this, position](AIJob& job) -> std::function<void()> {
+        reportIterations(job, _search, position, othelloMoveName);
+        OthelloSearchResult result = _search.search(position, AI_MOVE_TIME_MS);
+        return [this, result]() {
+            if (result.move != OTHELLO_PASS) {
+                actionForEmptyHolder(*_grid->getSquare(result.move % 8, result.move / 8));
+            }
+        };
+    };
+}
 
-    if (bestX >= 0 && bestY >= 0) {
-        actionForEmptyHolder(*_grid->getSquare(bestX, bestY));
-    }
+OthelloBoard Othello::boardFor(Player* player) const {
+    OthelloBoard board;
+    _grid->forEachSquare([&](ChessSquare* square, int x, int y) {
+        Bit* piece = square->bit();
+        if (piece) {
+            const uint64_t bit = 1ull << (y * 8 + x);
+            if (piece->getOwner() == player) {
+                board.player |= bit;
+            } else {
+                board.opponent |= bit;
+            }
+        }
+    });
+    return board;
 }
 
 void Othello::getBoardPosition(BitHolder& holder, int &x, int &y) const {
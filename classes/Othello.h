@@ -1,5 +1,6 @@
 #pragma once
 #include "Game.h"
+#include "OthelloSearch.h"
 #include <vector>
 
 // NOTE: This implementation assumes black.png and white.png exist in resources.
@@ -24,10 +25,12 @@ public:
     void        stopGame() override;
 
     // AI methods
-    void        updateAI() override;
     bool        gameHasAI() override { return true; } // Set to true when AI is implemented
     Grid* getGrid() override { return _grid; }
 
+protected:
+    AIJob::Work aiWork() override;
+
 private:
     // Player constants
     static const int BLACK_PLAYER = 0;
@@ -36,6 +39,9 @@ private:
     // Direction vectors for checking all 8 directions
     static const int DIRECTIONS[8][2];
 
+    // how long the AI thinks per move, the endgame solve usually needs far less
+    static const int AI_MOVE_TIME_MS = 500;
+
     // Helper methods
     Bit*        createPiece(Player* player);
     bool        isValidMove(int x, int y, Player* player) const;
@@ -47,6 +53,8 @@ private:
     std::vector<std::pair<int, int>> getValidMoves(Player* player) const;
     void        showValidMoves(Player* player);
     void        clearValidMoveIndicators();
+    // the grid as a bitboard position, seen from player's side
+    OthelloBoard boardFor(Player* player) const;
 
     // Board position helper
     void        getBoardPosition(BitHolder& holder, int &x, int &y) const;
@@ -57,4 +65,6 @@ private:
     // Game state
     int         _consecutivePasses;
     bool        _showingHints;
+
+    OthelloSearch _search;
 };
\ No newline at end of file
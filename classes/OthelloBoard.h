@@ -0,0 +1,123 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+//
+// Othello position as two bitboards, from the side to move's point of view
+// square = y * 8 + x, the same order as the Grid and the state string. A move is one square, legal
+// when it brackets a run of opponent discs along at least one of the eight directions. Both the legal
+// moves and the discs a move flips come out of a Kogge-Stone occluded fill per direction: three
+// shift-and-mask steps flood a bitboard through the opponent's discs, instead of walking rays square
+// by square. Making a move swaps the two boards, so the searcher never has to know whose turn it is.
+//
+
+constexpr int OTHELLO_PASS = -1;
+
+namespace othello {
+    constexpr uint64_t NOT_A_FILE = 0xfefefefefefefefeull;  // x = 0 cleared, for shifts towards +x
+    constexpr uint64_t NOT_H_FILE = 0x7f7f7f7f7f7f7f7full;  // x = 7 cleared, for shifts towards -x
+
+    // one step in a direction, dropping whatever wraps around an edge
+    template <int Shift, uint64_t Mask>
+    constexpr uint64_t step(uint64_t b) {
+        return (Shift > 0 ? b << Shift : b >> -Shift) & Mask;
+    }
+
+    // gen flooded along the direction for as long as it runs over pro, gen itself included
+    template <int Shift, uint64_t Mask>
+    constexpr uint64_t occludedFill(uint64_t gen, uint64_t pro) {
+        pro &= Mask;
+        gen |= pro & (Shift > 0 ? gen << Shift : gen >> -Shift);
+        pro &= (Shift > 0 ? pro << Shift : pro >> -Shift);
+        gen |= pro & (Shift > 0 ? gen << (2 * Shift) : gen >> (-2 * Shift));
+        pro &= (Shift > 0 ? pro << (2 * Shift) : pro >> (-2 * Shift));
+        gen |= pro & (Shift > 0 ? gen << (4 * Shift) : gen >> (-4 * Shift));
+        return gen;
+    }
+
+    // empty squares beyond a run of opponent discs that starts next to one of ours
+    template <int Shift, uint64_t Mask>
+    constexpr uint64_t movesInDirection(uint64_t player, uint64_t opponent) {
+        const uint64_t run = occludedFill<Shift, Mask>(player, opponent) & opponent;
+        return step<Shift, Mask>(run);
+    }
+
+    // the run of opponent discs next to move in the direction, if one of ours closes it
+    template <int Shift, uint64_t Mask>
+    constexpr uint64_t flipsInDirection(uint64_t move, uint64_t player, uint64_t opponent) {
+        const uint64_t run = occludedFill<Shift, Mask>(move, opponent) & opponent;
+        return (step<Shift, Mask>(run | move) & player) ? run : 0;
+    }
+
+    constexpr uint64_t legalMoves(uint64_t player, uint64_t opponent) {
+        const uint64_t moves = movesInDirection<1, NOT_A_FILE>(player, opponent)
+                             | movesInDirection<-1, NOT_H_FILE>(player, opponent)
+                             | movesInDirection<8, ~0ull>(player, opponent)
+                             | movesInDirection<-8, ~0ull>(player, opponent)
+                             | movesInDirection<9, NOT_A_FILE>(player, opponent)
+                             | movesInDirection<7, NOT_H_FILE>(player, opponent)
+                             | movesInDirection<-7, NOT_A_FILE>(player, opponent)
+                             | movesInDirection<-9, NOT_H_FILE>(player, opponent);
+        return moves & ~(player | opponent);
+    }
+
+    constexpr uint64_t flips(int square, uint64_t player, uint64_t opponent) {
+        const uint64_t move = 1ull << square;
+        return flipsInDirection<1, NOT_A_FILE>(move, player, opponent)
+             | flipsInDirection<-1, NOT_H_FILE>(move, player, opponent)
+             | flipsInDirection<8, ~0ull>(move, player, opponent)
+             | flipsInDirection<-8, ~0ull>(move, player, opponent)
+             | flipsInDirection<9, NOT_A_FILE>(move, player, opponent)
+             | flipsInDirection<7, NOT_H_FILE>(move, player, opponent)
+             | flipsInDirection<-7, NOT_A_FILE>(move, player, opponent)
+             | flipsInDirection<-9, NOT_H_FILE>(move, player, opponent);
+    }
+}
+
+struct OthelloBoard {
+    uint64_t player = 0;    // discs of the side to move
+    uint64_t opponent = 0;
+
+    // black (the side to move) on d5 and e4, white on d4 and e5
+    static OthelloBoard initial() {
+        OthelloBoard board;
+        board.player = (1ull << (4 * 8 + 3)) | (1ull << (3 * 8 + 4));
+        board.opponent = (1ull << (3 * 8 + 3)) | (1ull << (4 * 8 + 4));
+        return board;
+    }
+
+    uint64_t empties() const { return ~(player | opponent); }
+    int emptyCount() const { return std::popcount(empties()); }
+    uint64_t legalMoves() const { return othello::legalMoves(player, opponent); }
+    bool hasMoves() const { return legalMoves() != 0; }
+    // neither side can move: the game is over and the disc count decides it
+    bool gameOver() const { return !hasMoves() && othello::legalMoves(opponent, player) == 0; }
+    // side to move's discs minus the opponent's, empties going to the winner as the rules score it
+    int finalDiscDifference() const {
+        const int mine = std::popcount(player);
+        const int theirs = std::popcount(opponent);
+        const int empty = 64 - mine - theirs;
+        return mine > theirs ? mine - theirs + empty : (mine < theirs ? mine - theirs - empty : 0);
+    }
+
+    // square must be one of legalMoves(), OTHELLO_PASS hands the turn over
+    void makeMove(int square) {
+        if (square != OTHELLO_PASS) {
+            const uint64_t flipped = othello::flips(square, player, opponent);
+            player |= flipped | (1ull << square);
+            opponent &= ~flipped;
+        }
+        const uint64_t mover = player;
+        player = opponent;
+        opponent = mover;
+    }
+
+    // the search keys its table on this; the two boards don't share a bit, so mixing both suffices
+    uint64_t hash() const {
+        uint64_t h = player * 0x9e3779b97f4a7c15ull ^ std::rotl(opponent * 0xc2b2ae3d27d4eb4full, 31);
+        h ^= h >> 29;
+        h *= 0xbf58476d1ce4e5b9ull;
+        return h ^ (h >> 32);
+    }
+};
@@ -0,0 +1,57 @@
+#include "OthelloSearch.h"
+
+namespace {
+    constexpr uint64_t CORNERS = 0x8100000000000081ull;
+
+    // the square diagonally inside each corner (X) and the two next to it on the edge (C), by corner
+    constexpr int cornerSquares[4] = { 0, 7, 56, 63 };
+    constexpr uint64_t xSquares[4] = { 1ull << 9, 1ull << 14, 1ull << 49, 1ull << 54 };
+    constexpr uint64_t cSquares[4] = { (1ull << 1) | (1ull << 8), (1ull << 6) | (1ull << 15),
+                                       (1ull << 48) | (1ull << 57), (1ull << 55) | (1ull << 62) };
+
+    constexpr int CORNER_WEIGHT = 250;
+    constexpr int X_SQUARE_WEIGHT = 100;    // only while the corner next to it is still empty
+    constexpr int C_SQUARE_WEIGHT = 40;
+    constexpr int MOBILITY_WEIGHT = 40;
+    constexpr int FRONTIER_WEIGHT = 10;     // discs next to an empty square hand the opponent moves
+
+    // every square next to one in b, b itself not included
+    uint64_t neighbours(uint64_t b)
+    {
+        using namespace othello;
+        return step<1, NOT_A_FILE>(b) | step<-1, NOT_H_FILE>(b) | step<8, ~0ull>(b) | step<-8, ~0ull>(b)
+             | step<9, NOT_A_FILE>(b) | step<7, NOT_H_FILE>(b) | step<-7, NOT_A_FILE>(b) | step<-9, NOT_H_FILE>(b);
+    }
+}
+
+int OthelloPosition::evaluate() const
+{
+    const uint64_t empty = board.empties();
+    int score = CORNER_WEIGHT * (std::popcount(board.player & CORNERS) - std::popcount(board.opponent & CORNERS));
+    for (int i = 0; i < 4; i++) {
+        if (empty & (1ull << cornerSquares[i])) {
+            score -= X_SQUARE_WEIGHT * (std::popcount(board.player & xSquares[i]) - std::popcount(board.opponent & xSquares[i]));
+            score -= C_SQUARE_WEIGHT * (std::popcount(board.player & cSquares[i]) - std::popcount(board.opponent & cSquares[i]));
+        }
+    }
+    const int mobility = std::popcount(legal) - std::popcount(othello::legalMoves(board.opponent, board.player));
+    score += MOBILITY_WEIGHT * mobility;
+    const uint64_t frontier = neighbours(empty);
+    score -= FRONTIER_WEIGHT * (std::popcount(board.player & frontier) - std::popcount(board.opponent & frontier));
+    return score;
+}
+
+// the shallow midgame nodes aren't worth the replies being counted, they only get the corners forward
+int OthelloPosition::orderKey(Move move, int depth) const
+{
+    if (move == OTHELLO_PASS) {
+        return 0;
+    }
+    int key = (CORNERS & (1ull << move)) ? 8 : 0;
+    if (depth >= 3) {
+        OthelloBoard child = board;
+        child.makeMove(move);
+        key -= 16 * std::popcount(child.legalMoves());
+    }
+    return key;
+}
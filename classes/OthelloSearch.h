@@ -0,0 +1,61 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include "OthelloBoard.h"
+#include "Search.h"
+
+//
+// Othello search, kept free of the UI like ChessSearch
+// OthelloBoard as a Search position. The midgame is scored on mobility, corners and the squares that
+// give corners away. Deeper nodes go fastest-first (the reply that leaves the opponent the fewest
+// moves goes first), which is what makes the last dozen or so empties solvable to the exact final
+// disc count within a move's time. A pass is the one move of a position without any, so it costs no depth.
+//
+
+constexpr int OTHELLO_WIN_SCORE = 10000;   // a won ending scores this plus the disc margin
+
+struct OthelloPosition {
+    using Move = int;                       // a square, or OTHELLO_PASS
+    static constexpr int MAX_MOVES = 64;
+
+    OthelloBoard board;
+    uint64_t legal;     // board.legalMoves(), which the terminal test, the moves and the evaluation all need
+
+    explicit OthelloPosition(const OthelloBoard& board) : board(board), legal(board.legalMoves()) {}
+
+    int generateMoves(Move* moves) const {
+        if (!legal) {
+            moves[0] = OTHELLO_PASS;
+            return 1;
+        }
+        int count = 0;
+        for (uint64_t b = legal; b; b &= b - 1) {
+            moves[count++] = std::countr_zero(b);
+        }
+        return count;
+    }
+    void makeMove(Move move) {
+        board.makeMove(move);
+        legal = board.legalMoves();
+    }
+    uint64_t hash() const { return board.hash(); }
+    int evaluate() const;
+
+    // a finished game on the midgame scale, so a win always outranks any heuristic score
+    bool terminal(int, int& score) const {
+        if (legal || othello::legalMoves(board.opponent, board.player)) {
+            return false;
+        }
+        const int discDifference = board.finalDiscDifference();
+        score = discDifference > 0 ? OTHELLO_WIN_SCORE + discDifference
+              : (discDifference < 0 ? -OTHELLO_WIN_SCORE + discDifference : 0);
+        return true;
+    }
+
+    // corners first; from depth 3 on, ahead of that, the fewer replies the opponent is left the better
+    int orderKey(Move move, int depth) const;
+};
+
+using OthelloSearch = Search<OthelloPosition>;
+using OthelloSearchResult = OthelloSearch::Result;
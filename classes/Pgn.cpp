@@ -0,0 +1,97 @@
+#include "Pgn.h"
+#include <algorithm>
+#include <cctype>
+
+std::vector<std::string> movetextTokens(const std::string& text)
+{
+    std::vector<std::string> tokens;
+    int variationDepth = 0;
+    size_t i = 0;
+    while (i < text.size()) {
+        const char c = text[i];
+        if (c == '{') {
+            const size_t end = text.find('}', i);
+            i = end == std::string::npos ? text.size() : end + 1;
+        } else if (c == ';') {
+            const size_t end = text.find('\n', i);
+            i = end == std::string::npos ? text.size() : end + 1;
+        } else if (c == '(') {
+            variationDepth++;
+            i++;
+        } else if (c == ')') {
+            variationDepth = std::max(0, variationDepth - 1);
+            i++;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        } else {
+            size_t end = i;
+            while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end])) && text[end] != '{' &&
+                   text[end] != '(' && text[end] != ')' && text[end] != ';') {
+                end++;
+            }
+            std::string token = text.substr(i, end - i);
+            i = end;
+            if (variationDepth > 0 || token[0] == '$') {
+                continue;
+            }
+            // "12." and "12..." may be glued to the move that follows
+            const size_t digits = token.find_first_not_of("0123456789");
+            if (digits != std::string::npos && digits > 0 && token[digits] == '.') {
+                const size_t move = token.find_first_not_of('.', digits);
+                token = move == std::string::npos ? std::string() : token.substr(move);
+            }
+            if (token.empty() || std::isdigit(static_cast<unsigned char>(token[0])) || token == "*") {
+                continue;
+            }
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+// [Tag "value"]
+static void readTag(const std::string& line, PgnGame& game)
+{
+    const size_t space = line.find(' ');
+    const size_t open = line.find('"');
+    const size_t close = line.rfind('"');
+    if (space == std::string::npos || open == std::string::npos || close <= open) {
+        return;
+    }
+    const std::string tag = line.substr(1, space - 1);
+    const std::string value = line.substr(open + 1, close - open - 1);
+    if (tag == "FEN") {
+        game.fen = value;
+    } else if (tag == "Result") {
+        game.result = value;
+    }
+}
+
+bool PgnReader::next(PgnGame& game)
+{
+    game = PgnGame();
+    if (!_pendingTag.empty()) {
+        readTag(_pendingTag, game);
+        _pendingTag.clear();
+    }
+    bool inMovetext = false;
+    std::string line;
+    while (std::getline(_in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] == '[') {
+            // a tag after movetext starts the next game
+            if (inMovetext) {
+                _pendingTag = line;
+                return true;
+            }
+            readTag(line, game);
+        } else if (line.find_first_not_of(" \t") != std::string::npos) {
+            inMovetext = true;
+            game.movetext += line;
+            game.movetext += '\n';
+        }
+    }
+    return inMovetext;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+//
+// Games in PGN, read one at a time
+// only the FEN and Result tags are kept; the movetext is handed over as it stands, and movetextTokens
+// strips it down to its moves, without move numbers, comments, variations, NAGs or the result. The
+// moves are in SAN, which parseMove (Notation.h) reads against the position they were played in.
+//
+
+const char* const PGN_STARTING_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct PgnGame {
+    std::string fen = PGN_STARTING_FEN;     // the FEN tag, if the game doesn't start from the usual position
+    std::string result;                     // "1-0", "0-1", "1/2-1/2" or "*"
+    std::string movetext;
+};
+
+std::vector<std::string> movetextTokens(const std::string& text);
+
+class PgnReader {
+public:
+    explicit PgnReader(std::istream& in) : _in(in) {}
+
+    // the next game with any movetext, false at the end of the stream
+    bool next(PgnGame& game);
+
+private:
+    std::istream& _in;
+    std::string _pendingTag;    // the first tag of the next game, read while finishing this one
+};
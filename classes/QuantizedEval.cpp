@@ -0,0 +1,239 @@
+#include "QuantizedEval.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+namespace {
+    const uint32_t QUANTIZED_MAGIC = 0x514E4E31; // "QNN1"
+
+    int32_t roundToInt(double value)
+    {
+        return static_cast<int32_t>(std::lround(value));
+    }
+
+    float largestMagnitude(const float* values, size_t count)
+    {
+        float largest = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+            largest = std::max(largest, std::abs(values[i]));
+        return largest > 0.0f ? largest : 1.0f;
+    }
+
+    template <typename T>
+    void writeArray(std::ofstream& out, const std::vector<T>& values)
+    {
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    template <typename T>
+    bool readArray(std::ifstream& in, std::vector<T>& values, size_t count)
+    {
+        values.resize(count);
+        in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+        return static_cast<bool>(in);
+    }
+}
+
+QuantizedEval::QuantizedEval() : _kernels(nnKernels()), _bias3(0), _requant1(0), _requant2(0), _requant3(0), _loaded(false)
+{
+}
+
+int QuantizedEval::clampActivation(int64_t value)
+{
+    // written as selects: the sign of a hidden unit is anyone's guess, so a branch here mispredicts constantly
+    value = value < 0 ? 0 : value;
+    value = value > ACTIVATION_MAX ? ACTIVATION_MAX : value;
+    return static_cast<int>(value);
+}
+
+// Each layer gets one scale: weights span the full integer range, and activations map the float range
+// [0, clip] onto [0, 127]. The int32 sums are brought from one layer's scale to the next by a fixed point
+// multiply, so the scales only exist here and in the converter, never at evaluation time.
+void QuantizedEval::quantize(const ChessEval& source, const std::vector<ActiveFeatures>& calibration)
+{
+    // clipping ranges: the largest hidden activation the float network produces over the sample
+    float clip1 = 0.0f;
+    float clip2 = 0.0f;
+    for (const ActiveFeatures& features : calibration)
+    {
+        const LayerActivations activations = source.forwardWithActivations(features);
+        for (float value : activations.hidden1)
+            clip1 = std::max(clip1, value);
+        for (float value : activations.hidden2)
+            clip2 = std::max(clip2, value);
+    }
+    if (clip1 <= 0.0f) clip1 = 1.0f;
+    if (clip2 <= 0.0f) clip2 = 1.0f;
+
+    // first layer: int16 weights summed in int16, so the scale is set by the largest sum a legal position
+    // can reach: per neuron the bias, its 32 largest piece-square weights and all the context weights
+    double largestSum = 0.0;
+    std::vector<float> magnitudes(ChessEval::BOARD_SIZE * ChessEval::PIECE_TYPES);
+    for (int i = 0; i < HIDDEN1_SIZE; ++i)
+    {
+        double sum = std::abs(source.bias1[i]);
+        for (size_t f = 0; f < magnitudes.size(); ++f)
+            magnitudes[f] = std::abs(source.weights1[f * HIDDEN1_SIZE + i]);
+        std::partial_sort(magnitudes.begin(), magnitudes.begin() + MAX_PIECES, magnitudes.end(), std::greater<float>());
+        for (int f = 0; f < MAX_PIECES; ++f)
+            sum += magnitudes[f];
+        for (size_t f = magnitudes.size(); f < static_cast<size_t>(INPUT_SIZE); ++f)
+            sum += std::abs(source.weights1[f * HIDDEN1_SIZE + i]);
+        largestSum = std::max(largestSum, sum);
+    }
+    // leaves room for every term of that sum rounding up
+    const double scale1 = (32767.0 - INPUT_SIZE) / (largestSum > 0.0 ? largestSum : 1.0);
+    _weights1.resize(source.weights1.size());
+    for (size_t i = 0; i < _weights1.size(); ++i)
+        _weights1[i] = static_cast<int16_t>(roundToInt(source.weights1[i] * scale1));
+    _bias1.resize(HIDDEN1_SIZE);
+    for (int i = 0; i < HIDDEN1_SIZE; ++i)
+        _bias1[i] = static_cast<int16_t>(roundToInt(source.bias1[i] * scale1));
+    const double activation1Scale = ACTIVATION_MAX / clip1;
+    _requant1 = roundToInt(activation1Scale / scale1 * (1 << REQUANT_SHIFT));
+
+    // second layer: int8 weights over uint8 activations
+    const double scale2 = 127.0 / largestMagnitude(source.weights2.data(), source.weights2.size());
+    const double sum2Scale = activation1Scale * scale2;
+    _weights2.resize(source.weights2.size());
+    for (size_t i = 0; i < _weights2.size(); ++i)
+        _weights2[i] = static_cast<int8_t>(roundToInt(source.weights2[i] * scale2));
+    _bias2.resize(HIDDEN2_SIZE);
+    for (int i = 0; i < HIDDEN2_SIZE; ++i)
+        _bias2[i] = roundToInt(source.bias2[i] * sum2Scale);
+    const double activation2Scale = ACTIVATION_MAX / clip2;
+    _requant2 = roundToInt(activation2Scale / sum2Scale * (1 << REQUANT_SHIFT));
+
+    // output: int8 weights, the sum is taken to a tanh table index
+    const double scale3 = 127.0 / largestMagnitude(source.weights3.data(), source.weights3.size());
+    const double sum3Scale = activation2Scale * scale3;
+    _weights3.resize(HIDDEN2_SIZE);
+    for (int i = 0; i < HIDDEN2_SIZE; ++i)
+        _weights3[i] = static_cast<int8_t>(roundToInt(source.weights3[i] * scale3));
+    _bias3 = roundToInt(source.bias3[0] * sum3Scale);
+    _requant3 = roundToInt(TANH_STEPS / sum3Scale * (1 << REQUANT_SHIFT));
+
+    _tanhTable.resize(TANH_TABLE_SIZE);
+    for (int i = 0; i < TANH_TABLE_SIZE; ++i)
+    {
+        const double raw = static_cast<double>(i - TANH_RANGE * TANH_STEPS) / TANH_STEPS;
+        _tanhTable[i] = static_cast<int16_t>(roundToInt(2000.0 * std::tanh(raw)));
+    }
+
+    _loaded = true;
+}
+
+int QuantizedEval::evaluate(const char* state, const PositionContext& context) const
+{
+    return evaluate(ChessEval::encodePosition(state, context));
+}
+
+// integer arithmetic only, the SIMD kernels return exactly what the scalar ones do
+int QuantizedEval::evaluate(const ActiveFeatures& features) const
+{
+    if (!_loaded)
+        return 0;
+
+    const int64_t round = int64_t(1) << (REQUANT_SHIFT - 1);
+
+    int16_t sum1[HIDDEN1_SIZE];
+    std::copy(_bias1.begin(), _bias1.end(), sum1);
+    for (int f = 0; f < features.count; ++f)
+    {
+        _kernels.addInt16(sum1, _weights1.data() + static_cast<size_t>(features.index[f]) * HIDDEN1_SIZE, HIDDEN1_SIZE);
+    }
+    uint8_t hidden1[HIDDEN1_SIZE];
+    for (int i = 0; i < HIDDEN1_SIZE; ++i)
+        hidden1[i] = static_cast<uint8_t>(clampActivation((int64_t(sum1[i]) * _requant1 + round) >> REQUANT_SHIFT));
+
+    uint8_t hidden2[HIDDEN2_SIZE];
+    for (int r = 0; r < HIDDEN2_SIZE; ++r)
+    {
+        const int32_t sum = _bias2[r] + _kernels.dotU8I8(hidden1, _weights2.data() + static_cast<size_t>(r) * HIDDEN1_SIZE, HIDDEN1_SIZE);
+        hidden2[r] = static_cast<uint8_t>(clampActivation((int64_t(sum) * _requant2 + round) >> REQUANT_SHIFT));
+    }
+
+    const int32_t sum3 = _bias3 + _kernels.dotU8I8(hidden2, _weights3.data(), HIDDEN2_SIZE);
+
+    const int64_t index = (int64_t(sum3) * _requant3 + round) >> REQUANT_SHIFT;
+    const int64_t limit = TANH_RANGE * TANH_STEPS;
+    const int output = _tanhTable[static_cast<size_t>(std::min(limit, std::max(-limit, index)) + limit)];
+    return -output;
+}
+
+size_t QuantizedEval::weightBytes() const
+{
+    return _weights1.size() * sizeof(int16_t) + _bias1.size() * sizeof(int16_t) +
+           _weights2.size() * sizeof(int8_t) + _bias2.size() * sizeof(int32_t) +
+           _weights3.size() * sizeof(int8_t) + sizeof(_bias3) + _tanhTable.size() * sizeof(int16_t);
+}
+
+bool QuantizedEval::saveModel(const std::string& filename) const
+{
+    if (!_loaded)
+        return false;
+    std::ofstream out(filename, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Failed to open file for writing: " << filename << std::endl;
+        return false;
+    }
+
+    const int32_t sizes[3] = { INPUT_SIZE, HIDDEN1_SIZE, HIDDEN2_SIZE };
+    out.write(reinterpret_cast<const char*>(&QUANTIZED_MAGIC), sizeof(QUANTIZED_MAGIC));
+    out.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    const int32_t requant[3] = { _requant1, _requant2, _requant3 };
+    out.write(reinterpret_cast<const char*>(requant), sizeof(requant));
+
+    writeArray(out, _weights1);
+    writeArray(out, _bias1);
+    writeArray(out, _weights2);
+    writeArray(out, _bias2);
+    writeArray(out, _weights3);
+    out.write(reinterpret_cast<const char*>(&_bias3), sizeof(_bias3));
+    writeArray(out, _tanhTable);
+    return static_cast<bool>(out);
+}
+
+bool QuantizedEval::loadModel(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Failed to open file for reading: " << filename << std::endl;
+        return false;
+    }
+
+    uint32_t magic = 0;
+    int32_t sizes[3] = {};
+    int32_t requant[3] = {};
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+    in.read(reinterpret_cast<char*>(requant), sizeof(requant));
+    if (!in || magic != QUANTIZED_MAGIC || sizes[0] != INPUT_SIZE || sizes[1] != HIDDEN1_SIZE || sizes[2] != HIDDEN2_SIZE)
+    {
+        std::cerr << "Not a quantized model for this network: " << filename << std::endl;
+        return false;
+    }
+
+    _loaded = false;
+    if (!readArray(in, _weights1, static_cast<size_t>(INPUT_SIZE) * HIDDEN1_SIZE) ||
+        !readArray(in, _bias1, HIDDEN1_SIZE) ||
+        !readArray(in, _weights2, static_cast<size_t>(HIDDEN2_SIZE) * HIDDEN1_SIZE) ||
+        !readArray(in, _bias2, HIDDEN2_SIZE) ||
+        !readArray(in, _weights3, HIDDEN2_SIZE) ||
+        !in.read(reinterpret_cast<char*>(&_bias3), sizeof(_bias3)) ||
+        !readArray(in, _tanhTable, TANH_TABLE_SIZE))
+    {
+        std::cerr << "Quantized model file is truncated: " << filename << std::endl;
+        return false;
+    }
+    _requant1 = requant[0];
+    _requant2 = requant[1];
+    _requant3 = requant[2];
+    _loaded = true;
+    return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ChessEval.h"
+
+/**
+ * Integer-only version of the ChessEval network for deployment.
+ * The first layer is int16 weights and sums, the hidden layers are int8 weights over uint8 activations
+ * with int32 accumulation, every ReLU is clipped to [0, 127] and the final tanh is a lookup table stored with the
+ * weights. Evaluation never touches floating point, so the same file gives the same score on every
+ * machine and compiler.
+ */
+class QuantizedEval {
+public:
+    QuantizedEval();
+
+    /**
+     * Builds the integer network from a float one.
+     * @param source Trained float network
+     * @param calibration Sample positions; the clipping range of each hidden layer is taken from the
+     *        float activations they produce
+     */
+    void quantize(const ChessEval& source, const std::vector<ActiveFeatures>& calibration);
+
+    /**
+     * Evaluates a chess position, same input and sign convention as ChessEval::evaluate.
+     * @return Evaluation score in centipawns, 0 if no network is loaded
+     */
+    int evaluate(const char* state, const PositionContext& context = PositionContext()) const;
+    int evaluate(const ActiveFeatures& features) const;
+
+    bool saveModel(const std::string& filename) const;
+    bool loadModel(const std::string& filename);
+
+    bool isLoaded() const { return _loaded; }
+    size_t weightBytes() const;
+
+private:
+    static constexpr int INPUT_SIZE = ChessEval::INPUT_SIZE;
+    static constexpr int HIDDEN1_SIZE = ChessEval::HIDDEN1_SIZE;
+    static constexpr int HIDDEN2_SIZE = ChessEval::HIDDEN2_SIZE;
+    static constexpr int ACTIVATION_MAX = 127;     // clipped ReLU ceiling, in uint8 activation units
+    static constexpr int REQUANT_SHIFT = 24;       // requantization multipliers are fixed point with 24 fraction bits
+    static constexpr int TANH_RANGE = 4;           // raw output is clamped to [-4, 4] before the tanh table
+    static constexpr int TANH_STEPS = 256;         // table entries per unit of raw output
+    static constexpr int MAX_PIECES = 32;          // the first layer's int16 sums can't overflow for a legal position
+    static constexpr int TANH_TABLE_SIZE = 2 * TANH_RANGE * TANH_STEPS + 1;
+
+    static int clampActivation(int64_t value);
+
+    const NNKernels& _kernels;
+
+    // input-major like ChessEval::weights1, INPUT_SIZE x HIDDEN1_SIZE
+    std::vector<int16_t> _weights1;
+    std::vector<int16_t> _bias1;
+    // row-major HIDDEN2_SIZE x HIDDEN1_SIZE
+    std::vector<int8_t> _weights2;
+    std::vector<int32_t> _bias2;
+    std::vector<int8_t> _weights3;
+    int32_t _bias3;
+
+    // fixed point multipliers taking each layer's int32 sum to the next layer's units
+    int32_t _requant1;     // hidden1 sum -> uint8 activation
+    int32_t _requant2;     // hidden2 sum -> uint8 activation
+    int32_t _requant3;     // output sum -> tanh table index
+    std::vector<int16_t> _tanhTable;   // 2000 * tanh(raw) in centipawns
+
+    bool _loaded;
+};
@@ -0,0 +1,479 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+//
+// Game independent search
+// iterative deepening alpha-beta (principal variation search) with a transposition table and a clock,
+// written once for every game that isn't chess; ChessSearch keeps the chess specific pruning and the
+// helper threads. A game describes its positions through SearchPosition and Search<Position> is
+// compiled for that type, so move generation and evaluation inline into the search loop. A move is
+// made on a copy of the position instead of being unmade, every board here is a few machine words.
+//
+// Besides alpha-beta the search
+//  - plays a forced move (the only legal one) without using up depth
+//  - keeps searching past the horizon while the position says it is noisy (a capture is pending)
+//  - scores a win as SEARCH_WIN_SCORE less the plies to it, kept relative to the node in the table
+//  - knows when an iteration never scored a position heuristically, which makes its result exact
+//
+// Required of a position, besides being copyable:
+//  - Move and MAX_MOVES, the most legal moves a position can have
+//  - int generateMoves(Move* moves) const, the legal moves, in the same order every time for the same
+//    position (the table remembers the best move by its index)
+//  - void makeMove(const Move& move), which also passes the turn
+//  - uint64_t hash() const and int evaluate() const, the score from the side to move's point of view
+//  - bool terminal(int ply, int& score) const, true with the score when the game is over or decided
+//    without searching. A position without moves that isn't terminal is lost for the side to move
+// and optionally:
+//  - int orderKey(const Move& move, int depth) const, higher searched first after the hash move
+//  - bool noisy() const, searched on at the horizon until false
+//  - void bounds(int ply, int& lowest, int& highest) const, the worst and best result still possible
+//  - static constexpr bool CAN_REPEAT = true, positions repeated along the search path are draws
+//
+
+constexpr int SEARCH_WIN_SCORE = 30000;
+constexpr int SEARCH_MAX_PLY = 128;        // below the root, counting the plies that cost no depth
+constexpr int SEARCH_MAX_DEPTH = 100;      // deeper than any game here lasts
+
+// the side to move wins, or loses, ply plies below the root
+constexpr int searchWin(int ply) { return SEARCH_WIN_SCORE - ply; }
+constexpr int searchLoss(int ply) { return -SEARCH_WIN_SCORE + ply; }
+constexpr bool isWinOrLoss(int score) { return score > SEARCH_WIN_SCORE - SEARCH_MAX_PLY || score < -SEARCH_WIN_SCORE + SEARCH_MAX_PLY; }
+
+template <typename P>
+concept SearchPosition = std::copyable<P> && requires(const P& position, P& next, const typename P::Move& move, typename P::Move* moves, int ply, int& score) {
+    { P::MAX_MOVES } -> std::convertible_to<int>;
+    { position.generateMoves(moves) } -> std::same_as<int>;
+    next.makeMove(move);
+    { position.hash() } -> std::convertible_to<uint64_t>;
+    { position.evaluate() } -> std::convertible_to<int>;
+    { position.terminal(ply, score) } -> std::same_as<bool>;
+};
+
+template <typename Move>
+struct GameSearchResult {
+    Move move{};
+    bool hasMove = false;   // false when the game is over at the root
+    int score = 0;          // side to move's point of view
+    int depth = 0;          // deepest completed iteration
+    bool exact = false;     // the score is the game theoretic value
+    uint64_t nodes = 0;
+};
+
+template <SearchPosition Position>
+class Search {
+public:
+    using Move = typename Position::Move;
+    using Result = GameSearchResult<Move>;
+
+    explicit Search(size_t ttMegabytes = 16) {
+        size_t entries = 1;
+        int bits = 0;
+        while (entries * 2 * sizeof(TTEntry) <= ttMegabytes * 1024 * 1024) {
+            entries *= 2;
+            bits++;
+        }
+        _table.reset(new TTEntry[entries]);
+        _entries = entries;
+        _shift = 64 - bits;
+        clear();
+    }
+
+    void clear() {
+        for (size_t i = 0; i < _entries; i++) {
+            _table[i] = TTEntry{ 0, 0, 0, BoundNone, -1 };
+        }
+    }
+
+    // set by the caller to end the search early, polled with the clock; the deepest completed iteration
+    // is still returned
+    void setStopRequest(const std::atomic<bool>* stopRequest) { _stopRequest = stopRequest; }
+    // called on the searching thread after each completed iteration of search()
+    void setIterationCallback(std::function<void(const Result&)> callback) { _onIteration = std::move(callback); }
+
+    // the best line from root as far as the table remembers it, at most maxLength moves
+    int principalVariation(const Position& root, Move* line, int maxLength) const {
+        Position position = root;
+        int length = 0;
+        int score;
+        while (length < maxLength && !position.terminal(length, score)) {
+            const TTEntry* entry = probe(position.hash());
+            Move moves[Position::MAX_MOVES];
+            const int count = position.generateMoves(moves);
+            if (!entry || entry->move < 0 || entry->move >= count) {
+                break;
+            }
+            line[length++] = moves[entry->move];
+            position.makeMove(moves[entry->move]);
+        }
+        return length;
+    }
+
+    // moveTimeMs 0 searches to maxDepth without a clock. Stops early once an iteration is exact
+    Result search(const Position& root, int moveTimeMs, int maxDepth = SEARCH_MAX_DEPTH) {
+        Result result;
+        const auto start = std::chrono::steady_clock::now();
+        _timed = moveTimeMs > 0;
+        _deadline = start + std::chrono::milliseconds(moveTimeMs);
+        _nodes = 0;
+        _aborted = false;
+
+        Move moves[Position::MAX_MOVES];
+        const int count = root.generateMoves(moves);
+        if (rootDecided(root, moves, count, result) || count == 1) {
+            return result;
+        }
+        if constexpr (canRepeat) {
+            _path[0] = root.hash();
+        }
+
+        int bestIndex = -1;
+        for (int depth = 1; depth <= maxDepth; depth++) {
+            _hitHorizon = false;
+            int ordered[Position::MAX_MOVES];
+            orderMoves(root, moves, count, bestIndex, depth, ordered);
+            int alpha = -INFINITE_SCORE;
+            const int beta = INFINITE_SCORE;
+            int best = ordered[0];
+            for (int i = 0; i < count; i++) {
+                Position child = root;
+                child.makeMove(moves[ordered[i]]);
+                int score;
+                if (i == 0) {
+                    score = -negamax(child, depth - 1, 1, -beta, -alpha);
+                } else {
+                    score = -negamax(child, depth - 1, 1, -alpha - 1, -alpha);
+                    if (score > alpha && !_aborted) {
+                        score = -negamax(child, depth - 1, 1, -beta, -alpha);
+                    }
+                }
+                if (_aborted) {
+                    break;
+                }
+                if (score > alpha) {
+                    alpha = score;
+                    best = ordered[i];
+                }
+            }
+            if (_aborted) {
+                break;
+            }
+
+            bestIndex = best;
+            // the root goes in the table too, where principalVariation starts from
+            store(root.hash(), toTable(alpha, 0), _hitHorizon ? depth : SOLVED_DEPTH, BoundExact, best);
+            result.move = moves[best];
+            result.score = alpha;
+            result.depth = depth;
+            result.exact = !_hitHorizon;
+            if (_onIteration) {
+                result.nodes = _nodes;
+                _onIteration(result);
+            }
+            // nothing deeper changes an exact result, or a win or loss inside the depth searched
+            if (result.exact || (isWinOrLoss(alpha) && SEARCH_WIN_SCORE - (alpha < 0 ? -alpha : alpha) <= depth)) {
+                break;
+            }
+            // the next iteration takes several times as long as this one, don't start what can't finish
+            if (_timed && std::chrono::steady_clock::now() - start > std::chrono::milliseconds(moveTimeMs / 2)) {
+                break;
+            }
+        }
+        result.nodes = _nodes;
+        return result;
+    }
+
+    // the game theoretic score and a best move, however long that takes: a binary search of null
+    // window probes to the end of the game, each narrowing the range by the fail-soft score it returns.
+    // Only exact for games that end within SEARCH_MAX_PLY. A stop request ends it early with a move
+    // but no score
+    Result solve(const Position& root) {
+        Result result;
+        _timed = false;
+        _nodes = 0;
+        _aborted = false;
+
+        Move moves[Position::MAX_MOVES];
+        const int count = root.generateMoves(moves);
+        if (rootDecided(root, moves, count, result)) {
+            return result;
+        }
+
+        _hitHorizon = false;
+        int low = -SEARCH_WIN_SCORE;
+        int high = SEARCH_WIN_SCORE;
+        while (low < high) {
+            // probe nearer zero first, where most results are, rather than the middle of the range
+            int guess = low + (high - low) / 2;
+            if (guess <= 0 && low / 2 < guess) {
+                guess = low / 2;
+            } else if (guess >= 0 && high / 2 > guess) {
+                guess = high / 2;
+            }
+            const int score = negamax(root, SEARCH_MAX_DEPTH, 0, guess, guess + 1);
+            // stopped: the move found so far, the score unknown
+            if (_aborted) {
+                result.nodes = _nodes;
+                return result;
+            }
+            if (score <= guess) {
+                high = score;
+            } else {
+                low = score;
+                // the move that failed high reaches low, the table has it unless the root had no moves to try
+                if (const TTEntry* entry = probe(root.hash()); entry && entry->bound == BoundLower && entry->move >= 0 && entry->move < count) {
+                    result.move = moves[entry->move];
+                }
+            }
+        }
+
+        result.score = low;
+        result.depth = SEARCH_MAX_DEPTH;
+        result.exact = !_hitHorizon;
+        result.nodes = _nodes;
+        return result;
+    }
+
+private:
+    enum Bound : uint8_t { BoundNone, BoundUpper, BoundLower, BoundExact };
+
+    struct TTEntry {
+        uint64_t key;
+        int16_t score;
+        int8_t depth;
+        uint8_t bound;
+        int8_t move;        // index into the position's generated moves
+    };
+
+    static constexpr int CLOCK_CHECK_INTERVAL = 4096;
+    static constexpr int INFINITE_SCORE = SEARCH_WIN_SCORE + 1;
+    // an entry whose subtree was searched to the end of the game everywhere
+    static constexpr int SOLVED_DEPTH = 127;
+    static_assert(SEARCH_MAX_DEPTH < SOLVED_DEPTH, "depths must fit below the solved marker");
+    static_assert(Position::MAX_MOVES <= 128, "the table keeps move indices in a byte");
+
+    static constexpr bool canRepeat = [] {
+        if constexpr (requires { Position::CAN_REPEAT; }) {
+            return Position::CAN_REPEAT;
+        }
+        return false;
+    }();
+
+    // the root has nothing to search when the game is over or the position scores itself, then the
+    // first generated move is played. Else the result gets the first move to fall back on
+    bool rootDecided(const Position& root, const Move* moves, int count, Result& result) {
+        result.hasMove = count > 0;
+        if (count > 0) {
+            result.move = moves[0];
+        }
+        int score;
+        if (root.terminal(0, score)) {
+            result.score = score;
+            result.exact = true;
+            return true;
+        }
+        if (count == 0) {
+            result.score = searchLoss(0);
+            result.exact = true;
+            return true;
+        }
+        return false;
+    }
+
+    int negamax(const Position& position, int depth, int ply, int alpha, int beta) {
+        if ((++_nodes & (CLOCK_CHECK_INTERVAL - 1)) == 0 && timeUp()) {
+            _aborted = true;
+        }
+        if (_aborted) {
+            return 0;
+        }
+
+        int score;
+        if (position.terminal(ply, score)) {
+            return score;
+        }
+        const uint64_t key = position.hash();
+        if constexpr (canRepeat) {
+            _path[ply] = key;
+            // a draw that depends on the way here, not on the position, so nothing below counts as solved
+            if (ply > 0 && repeated(key, ply)) {
+                _hitHorizon = true;
+                return 0;
+            }
+        }
+        if (ply >= SEARCH_MAX_PLY || (depth <= 0 && !noisy(position))) {
+            _hitHorizon = true;
+            return position.evaluate();
+        }
+        if constexpr (requires { position.bounds(ply, alpha, beta); }) {
+            int lowest;
+            int highest;
+            position.bounds(ply, lowest, highest);
+            if (alpha < lowest) {
+                alpha = lowest;
+                if (alpha >= beta) {
+                    return alpha;
+                }
+            }
+            if (beta > highest) {
+                beta = highest;
+                if (alpha >= beta) {
+                    return beta;
+                }
+            }
+        }
+
+        int hashMove = -1;
+        if (const TTEntry* entry = probe(key)) {
+            hashMove = entry->move;
+            const int stored = fromTable(entry->score, ply);
+            if (entry->depth >= depth
+                && (entry->bound == BoundExact
+                    || (entry->bound == BoundLower && stored >= beta)
+                    || (entry->bound == BoundUpper && stored <= alpha))) {
+                if (entry->depth != SOLVED_DEPTH) {
+                    _hitHorizon = true;
+                }
+                return stored;
+            }
+        }
+
+        Move moves[Position::MAX_MOVES];
+        const int count = position.generateMoves(moves);
+        if (count == 0) {
+            return searchLoss(ply);
+        }
+        if (hashMove >= count) {
+            hashMove = -1;
+        }
+        // a forced move, or a noisy position past the horizon, is searched without costing depth
+        const int childDepth = (count == 1 || depth <= 0) ? depth : depth - 1;
+
+        // whether this subtree alone reached the horizon decides if its entry counts as solved
+        const bool outerHitHorizon = _hitHorizon;
+        _hitHorizon = false;
+
+        int ordered[Position::MAX_MOVES];
+        orderMoves(position, moves, count, hashMove, depth, ordered);
+        const int originalAlpha = alpha;
+        int best = -INFINITE_SCORE;
+        int bestMove = -1;      // every score beats -INFINITE_SCORE, the first move sets it
+        for (int i = 0; i < count; i++) {
+            Position child = position;
+            child.makeMove(moves[ordered[i]]);
+            if (i == 0) {
+                score = -negamax(child, childDepth, ply + 1, -beta, -alpha);
+            } else {
+                score = -negamax(child, childDepth, ply + 1, -alpha - 1, -alpha);
+                if (score > alpha && score < beta) {
+                    score = -negamax(child, childDepth, ply + 1, -beta, -alpha);
+                }
+            }
+            if (_aborted) {
+                return 0;
+            }
+            if (score > best) {
+                best = score;
+                bestMove = ordered[i];
+            }
+            if (score > alpha) {
+                alpha = score;
+            }
+            if (alpha >= beta) {
+                break;
+            }
+        }
+
+        const Bound bound = best >= beta ? BoundLower : (best > originalAlpha ? BoundExact : BoundUpper);
+        store(key, toTable(best, ply), _hitHorizon ? depth : SOLVED_DEPTH, bound, bestMove);
+        _hitHorizon = _hitHorizon || outerHitHorizon;
+        return best;
+    }
+
+    // hash move first, then by the position's order key; generation order breaks ties
+    static void orderMoves(const Position& position, const Move* moves, int count, int hashMove, int depth, int* ordered) {
+        int keys[Position::MAX_MOVES];
+        for (int m = 0; m < count; m++) {
+            int key = 0;
+            if (m == hashMove) {
+                key = 1 << 30;
+            } else if constexpr (requires { position.orderKey(moves[m], depth); }) {
+                key = position.orderKey(moves[m], depth);
+            }
+            int i = m;
+            for (; i > 0 && keys[i - 1] < key; i--) {
+                keys[i] = keys[i - 1];
+                ordered[i] = ordered[i - 1];
+            }
+            keys[i] = key;
+            ordered[i] = m;
+        }
+    }
+
+    static bool noisy(const Position& position) {
+        if constexpr (requires { position.noisy(); }) {
+            return position.noisy();
+        }
+        return false;
+    }
+
+    bool repeated(uint64_t key, int ply) const {
+        for (int i = ply - 2; i >= 0; i -= 2) {
+            if (_path[i] == key) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool timeUp() const {
+        if (_stopRequest && _stopRequest->load(std::memory_order_relaxed)) {
+            return true;
+        }
+        return _timed && std::chrono::steady_clock::now() >= _deadline;
+    }
+
+    // the table keeps a win as plies from the position itself rather than from the root, so it
+    // means the same wherever the position turns up again
+    static int toTable(int score, int ply) {
+        return !isWinOrLoss(score) ? score : (score > 0 ? score + ply : score - ply);
+    }
+    static int fromTable(int score, int ply) {
+        return !isWinOrLoss(score) ? score : (score > 0 ? score - ply : score + ply);
+    }
+
+    // keys of simple games are far from random in their low bits, the index comes from the top bits
+    // of the key times a large odd constant
+    size_t index(uint64_t key) const { return _shift >= 64 ? 0 : static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> _shift); }
+
+    const TTEntry* probe(uint64_t key) const {
+        const TTEntry* entry = &_table[index(key)];
+        return (entry->key == key && entry->bound != BoundNone) ? entry : nullptr;
+    }
+
+    void store(uint64_t key, int score, int depth, Bound bound, int move) {
+        TTEntry& entry = _table[index(key)];
+        // a shallower result for the same position doesn't replace a deeper one
+        if (entry.key == key && entry.bound != BoundNone && entry.depth > depth) {
+            return;
+        }
+        entry = TTEntry{ key, static_cast<int16_t>(score), static_cast<int8_t>(depth), bound, static_cast<int8_t>(move) };
+    }
+
+    std::unique_ptr<TTEntry[]> _table;
+    size_t _entries = 0;
+    int _shift = 64;
+    uint64_t _path[SEARCH_MAX_PLY + 1] = {};    // hashes from the root down, for repetitions
+    uint64_t _nodes = 0;
+    bool _aborted = false;
+    bool _hitHorizon = false;   // something was scored heuristically, so the result isn't exact
+    bool _timed = false;
+    std::chrono::steady_clock::time_point _deadline;
+    const std::atomic<bool>* _stopRequest = nullptr;
+    std::function<void(const Result&)> _onIteration;
+};
@@ -3,10 +3,29 @@
 #include "stb_image.h"
 #include <iostream>
 #include <filesystem>
+#include <string>
+#include <unordered_map>
+
+// Every texture loaded so far, by the filename it was asked for. A board setup used to decode and
+// upload one PNG per piece; now each file is decoded once and every Bit showing it draws the same
+// GPU texture. Textures were never freed per sprite either, so they simply live as long as the process.
+// Only the UI thread loads textures, so the cache needs no lock.
+struct CachedTexture {
+    ImTextureID texture;
+    ImVec2 size;
+};
+static std::unordered_map<std::string, CachedTexture> _textureCache;
 
 // Simple helper function to load an image into a OpenGL texture with common settings
 bool Sprite::LoadTextureFromFile(const char* filename)
 {
+    auto cached = _textureCache.find(filename);
+    if (cached != _textureCache.end()) {
+        _texture = cached->second.texture;
+        _size = cached->second.size;
+        return true;
+    }
+
     // Load from file
     int image_width = 0;
     int image_height = 0;
@@ -25,6 +44,7 @@ bool Sprite::LoadTextureFromFile(const char* filename)
         return false;
     }
     _size = ImVec2((float)image_width, (float)image_height);
+    _textureCache.emplace(filename, CachedTexture{ _texture, _size });
     return true;
 }
 
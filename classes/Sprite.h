@@ -75,6 +75,7 @@ public:
         return (mousePos.x >= _location.x && mousePos.x <= _location.x + _size.x && mousePos.y >= _location.y && mousePos.y <= _location.y + _size.y);
     }
 
+    // files are decoded and uploaded once, later sprites asking for the same file share the texture
     bool LoadTextureFromFile(const char* filename);
 	
     // set the highlighted state
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+//
+// Bounded single producer, single consumer queue
+// a power-of-two ring of slots with one index owned by each side. The producer only writes _head and the
+// consumer only writes _tail, so neither ever waits on the other or takes a lock: an acquire load of the
+// other side's index is all the synchronisation a push or pop needs. The indices run freely and are
+// masked on use, which keeps full (head - tail == Capacity) apart from empty (head == tail).
+// Exactly one thread may push and exactly one may pop.
+//
+
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : _head(0), _tail(0) { }
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer side, false when the queue is full and item was left alone
+    bool push(T&& item) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        _slots[head & (Capacity - 1)] = std::move(item);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false when there was nothing to take
+    bool pop(T& item) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(_slots[tail & (Capacity - 1)]);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // In place versions for items too big to copy around: the producer fills the slot claim() returns
+    // (nullptr when full) and publish() hands it over, the consumer reads peek() (nullptr when empty)
+    // and release() frees the slot. Slots are reused, so a claimed one still holds an old item.
+    T* claim() {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == Capacity) {
+            return nullptr;
+        }
+        return &_slots[head & (Capacity - 1)];
+    }
+    void publish() { _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    const T* peek() const {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &_slots[tail & (Capacity - 1)];
+    }
+    void release() { _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // only a hint while the other side is running
+    bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+private:
+    // each index on its own cache line, so the two threads don't fight over one
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+    alignas(64) T _slots[Capacity];
+};
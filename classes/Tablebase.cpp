@@ -0,0 +1,243 @@
+#include "Tablebase.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+namespace {
+    // piece letters strongest first, the order names list them in
+    const char PIECE_ORDER[] = "KQRBNP";
+    const int PIECE_WORTH[] = { 0, 9, 5, 3, 3, 1 };
+
+    int pieceRank(char piece)
+    {
+        return static_cast<int>(std::strchr(PIECE_ORDER, std::toupper(static_cast<unsigned char>(piece))) - PIECE_ORDER);
+    }
+
+    int sideWorth(const std::string& side)
+    {
+        int worth = 0;
+        for (char piece : side) {
+            worth += PIECE_WORTH[pieceRank(piece)];
+        }
+        return worth;
+    }
+
+    // which side a name puts first: more material, then the stronger pieces, then fewer of them
+    bool strongerOrEqual(const std::string& a, const std::string& b)
+    {
+        if (sideWorth(a) != sideWorth(b)) {
+            return sideWorth(a) > sideWorth(b);
+        }
+        for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+            if (a[i] != b[i]) {
+                return pieceRank(a[i]) < pieceRank(b[i]);
+            }
+        }
+        return a.size() <= b.size();
+    }
+
+    // every side of a king and count more pieces, each listed strongest first
+    void sidesWith(int count, int from, std::string side, std::vector<std::string>& sides)
+    {
+        if (count == 0) {
+            sides.push_back(side);
+            return;
+        }
+        for (int piece = from; piece < 6; piece++) {
+            sidesWith(count - 1, piece, side + PIECE_ORDER[piece], sides);
+        }
+    }
+
+    char otherColour(char piece)
+    {
+        const unsigned char letter = static_cast<unsigned char>(piece);
+        return static_cast<char>(std::isupper(letter) ? std::tolower(letter) : std::toupper(letter));
+    }
+
+    // the board seen from the other side: rank 1 becomes rank 8, each square s becomes s ^ 56
+    uint64_t flipRanks(uint64_t bits)
+    {
+        bits = ((bits >> 8) & 0x00FF00FF00FF00FFull) | ((bits & 0x00FF00FF00FF00FFull) << 8);
+        bits = ((bits >> 16) & 0x0000FFFF0000FFFFull) | ((bits & 0x0000FFFF0000FFFFull) << 16);
+        return (bits >> 32) | (bits << 32);
+    }
+
+    int bitboardIndex(char piece)
+    {
+        const int rank = pieceRank(piece);
+        // AllBitBoards lists pawn, knight, bishop, rook, queen, king
+        const int types[] = { WHITE_KING, WHITE_QUEENS, WHITE_ROOKS, WHITE_BISHOPS, WHITE_KNIGHTS, WHITE_PAWNS };
+        const int white = types[rank];
+        return std::isupper(static_cast<unsigned char>(piece)) ? white : white + BLACK_PAWNS;
+    }
+}
+
+int Tablebase::open(const std::string& directory)
+{
+    _tables.clear();
+    _maxPieces = 2;
+    int complete = TABLEBASE_MAX_PIECES;
+    for (const std::string& name : tableNames(TABLEBASE_MAX_PIECES)) {
+        const std::string pieces = indexPieces(name);
+        const int count = static_cast<int>(pieces.size());
+        const std::string path = directory + "/" + name + ".ctb";
+        auto file = std::make_unique<MappedFile>();
+        if (!std::ifstream(path).good() || !file->open(path, MappedFile::Random)) {
+            complete = std::min(complete, count - 1);
+            continue;
+        }
+        TablebaseHeader header;
+        if (file->size() != sizeof(header) + entryCount(count)) {
+            std::cerr << path << ": not a tablebase, or cut short" << std::endl;
+            complete = std::min(complete, count - 1);
+            continue;
+        }
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (header.magic != TABLEBASE_MAGIC || header.version != TABLEBASE_VERSION ||
+            std::strncmp(header.name, name.c_str(), sizeof(header.name)) != 0) {
+            std::cerr << path << ": not a tablebase for " << name << std::endl;
+            complete = std::min(complete, count - 1);
+            continue;
+        }
+        Table& table = _tables[name];
+        table.entries = static_cast<const uint8_t*>(file->data()) + sizeof(header);
+        table.pieces = pieces;
+        table.file = std::move(file);
+    }
+    if (!_tables.empty()) {
+        _maxPieces = std::max(2, complete);
+    }
+    return static_cast<int>(_tables.size());
+}
+
+void Tablebase::addTable(const std::string& name, const uint8_t* entries)
+{
+    Table& table = _tables[name];
+    table.file.reset();
+    table.pieces = indexPieces(name);
+    table.entries = entries;
+}
+
+bool Tablebase::probe(const GameState& position, TablebaseResult& result) const
+{
+    const int pieces = std::popcount(position._bitboards[OCCUPANCY].getData());
+    if (pieces > TABLEBASE_MAX_PIECES || position.castlingRights != 0 || position.enPassantSquare >= 0) {
+        return false;
+    }
+    if (pieces == 2) {
+        result = TablebaseResult();
+        return true;
+    }
+    bool flipped;
+    const auto it = _tables.find(materialName(position, flipped));
+    if (it == _tables.end()) {
+        return false;
+    }
+    result = decode(it->second.entries[entryIndex(position, it->second.pieces, flipped)]);
+    return true;
+}
+
+std::shared_ptr<const Tablebase> Tablebase::shared(const std::string& directory)
+{
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<const Tablebase>> registry;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<const Tablebase> tables = registry[directory].lock();
+    if (!tables) {
+        auto opened = std::make_shared<Tablebase>();
+        opened->open(directory);
+        tables = opened;
+        registry[directory] = tables;
+    }
+    return tables;
+}
+
+std::vector<std::string> Tablebase::tableNames(int maxPieces)
+{
+    std::vector<std::string> names;
+    for (int count = 3; count <= maxPieces; count++) {
+        std::vector<std::string> batch;
+        for (int strong = count - 2; strong >= 0; strong--) {
+            std::vector<std::string> strongSides;
+            std::vector<std::string> weakSides;
+            sidesWith(strong, 1, "K", strongSides);
+            sidesWith(count - 2 - strong, 1, "K", weakSides);
+            for (const std::string& a : strongSides) {
+                for (const std::string& b : weakSides) {
+                    const std::string name = a + "v" + b;
+                    if (strongerOrEqual(a, b) && std::find(batch.begin(), batch.end(), name) == batch.end()) {
+                        batch.push_back(name);
+                    }
+                }
+            }
+        }
+        // a promotion keeps the piece count, so tables with fewer pawns go first
+        std::stable_sort(batch.begin(), batch.end(), [](const std::string& a, const std::string& b) {
+            return std::count(a.begin(), a.end(), 'P') < std::count(b.begin(), b.end(), 'P');
+        });
+        names.insert(names.end(), batch.begin(), batch.end());
+    }
+    return names;
+}
+
+std::string Tablebase::materialName(const GameState& position, bool& flipped)
+{
+    std::string sides[2];
+    for (int side = 0; side < 2; side++) {
+        for (const char* piece = PIECE_ORDER; *piece; piece++) {
+            const char letter = side == 0 ? *piece : otherColour(*piece);
+            const int count = std::popcount(position._bitboards[bitboardIndex(letter)].getData());
+            sides[side].append(count, *piece);
+        }
+    }
+    flipped = !strongerOrEqual(sides[0], sides[1]);
+    return flipped ? sides[1] + "v" + sides[0] : sides[0] + "v" + sides[1];
+}
+
+std::string Tablebase::indexPieces(const std::string& name)
+{
+    std::string pieces;
+    bool weak = false;
+    for (char piece : name) {
+        if (piece == 'v') {
+            weak = true;
+        } else {
+            pieces += weak ? otherColour(piece) : piece;
+        }
+    }
+    return pieces;
+}
+
+uint64_t Tablebase::entryCount(int pieces)
+{
+    return uint64_t(2) << (6 * pieces);
+}
+
+uint64_t Tablebase::entryIndex(const GameState& position, const std::string& pieces, bool flipped)
+{
+    // the side named first to move is the lower half
+    uint64_t index = ((position.color == WHITE) != flipped) ? 0 : 1;
+    char previous = 0;
+    uint64_t remaining = 0;
+    for (char piece : pieces) {
+        // a repeated piece takes the next of its squares
+        if (piece != previous) {
+            remaining = position._bitboards[bitboardIndex(flipped ? otherColour(piece) : piece)].getData();
+            // mirrored before the squares are taken, so a pair on different ranks still comes out in the
+            // ascending order the table is built in
+            if (flipped) {
+                remaining = flipRanks(remaining);
+            }
+            previous = piece;
+        }
+        const int square = std::countr_zero(remaining);
+        remaining &= remaining - 1;
+        index = (index << 6) | static_cast<uint64_t>(square);
+    }
+    return index;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "GameState.h"
+#include "MappedFile.h"
+
+//
+// Endgame tablebases, memory mapped and shared read-only by every search thread
+// one file per material balance, named the way Syzygy names its tables ("KRvK.ctb", the stronger side
+// first), holding the exact result of every position with that material: a byte per position, 0 for
+// a draw, otherwise one more than the number of plies to mate with best play. An odd distance wins for
+// the side to move, an even one loses. Tables are generated by the maketb tool; a position is indexed
+// by the side to move and the square of each piece in the name's order, mirrored top to bottom when
+// black holds the stronger side. Positions with castling rights or an en passant target aren't in
+// the tables.
+//
+
+constexpr int TABLEBASE_MAX_PIECES = 4;     // kings included
+constexpr uint32_t TABLEBASE_MAGIC = 0x31425443;    // "CTB1"
+constexpr uint32_t TABLEBASE_VERSION = 1;
+constexpr int TABLEBASE_MAX_DISTANCE = 254;
+
+struct TablebaseHeader {
+    uint32_t magic;
+    uint32_t version;
+    char name[24];          // the material, "KRvK", zero padded
+};
+static_assert(sizeof(TablebaseHeader) == 32, "TablebaseHeader is part of the file format");
+
+struct TablebaseResult {
+    int wdl = 0;            // +1 the side to move wins, -1 it loses, 0 a draw
+    int distance = 0;       // plies to mate with best play, 0 for a draw or a side already mated
+};
+
+class Tablebase {
+public:
+    // opens every table found in directory, replacing any opened before; returns how many there were
+    int open(const std::string& directory);
+
+    size_t size() const { return _tables.size(); }
+    // the most pieces for which every table is there, 2 (just the kings, always a draw) with none
+    int maxPieces() const { return _maxPieces; }
+
+    // false if the position isn't covered: too many pieces, castling or en passant, or the table is missing
+    bool probe(const GameState& position, TablebaseResult& result) const;
+
+    // one set of tables per directory, mapped once and shared
+    static std::shared_ptr<const Tablebase> shared(const std::string& directory);
+
+    // the file layout, shared with maketb
+
+    // a table held in memory instead of mapped from its file, for maketb to probe one it has just solved
+    // before writing it; entries must outlive the Tablebase. maxPieces stays as open left it
+    void addTable(const std::string& name, const uint8_t* entries);
+
+    // every material balance of 3 to maxPieces pieces, in the order they can be generated in: a table's
+    // captures and promotions lead only to tables before it
+    static std::vector<std::string> tableNames(int maxPieces);
+    // the name of the position's material, and whether black holds the side named first
+    static std::string materialName(const GameState& position, bool& flipped);
+    // the pieces of a table in index order, white's as upper case: "KRvK" is "KRk"
+    static std::string indexPieces(const std::string& name);
+    static uint64_t entryCount(int pieces);
+    // the index of the position in its table; squares and side are already mirrored if flipped
+    static uint64_t entryIndex(const GameState& position, const std::string& pieces, bool flipped);
+
+    static uint8_t encode(const TablebaseResult& result) {
+        return result.wdl == 0 ? 0 : static_cast<uint8_t>(result.distance + 1);
+    }
+    static TablebaseResult decode(uint8_t entry) {
+        TablebaseResult result;
+        if (entry != 0) {
+            result.distance = entry - 1;
+            result.wdl = (result.distance & 1) ? 1 : -1;
+        }
+        return result;
+    }
+
+private:
+    struct Table {
+        std::unique_ptr<MappedFile> file;
+        std::string pieces;
+        const uint8_t* entries = nullptr;
+    };
+
+    std::map<std::string, Table> _tables;
+    int _maxPieces = 2;
+};
@@ -1,4 +1,5 @@
 #include "TicTacToe.h"
+#include "Search.h"
 
 
 TicTacToe::TicTacToe()
@@ -8,6 +9,7 @@ TicTacToe::TicTacToe()
 
 TicTacToe::~TicTacToe()
 {
+    _aiJob.cancel();
     delete _grid;
 }
 
@@ -159,89 +161,84 @@ void TicTacToe::setStateString(const std::string &s)
 
 
 //
-// this is the function that will be called by the AI
+// the board as a Search position, bit = y * 3 + x
 //
-void TicTacToe::updateAI() 
-{
-    int bestVal = -1000;
-    BitHolder* bestMove = nullptr;
-    std::string state = stateString();
+namespace {
+    struct TicTacToePosition {
+        using Move = int;
+        static constexpr int MAX_MOVES = 9;
 
-    // Traverse all cells, evaluate minimax function for all empty cells
-    _grid->forEachSquare([&](ChessSquare* square, int x, int y) {
-        int index = y * 3 + x;
-        // Check if cell is empty
-        if (state[index] == '0') {
-            // Make the move
-            state[index] = '2';
-            int moveVal = -negamax(state, 0, HUMAN_PLAYER);
-            // Undo the move
-            state[index] = '0';
-            // If the value of the current move is more than the best value, update best
-            if (moveVal > bestVal) {
-                bestMove = square;
-                bestVal = moveVal;
+        uint16_t mine = 0;      // the side to move's marks
+        uint16_t theirs = 0;
+
+        int generateMoves(Move* moves) const {
+            int count = 0;
+            for (int square = 0; square < 9; square++) {
+                if (!((mine | theirs) & (1 << square))) {
+                    moves[count++] = square;
+                }
             }
+            return count;
         }
-    });
-
-
-    // Make the best move
-    if(bestMove) {
-        if (actionForEmptyHolder(*bestMove)) {
+        void makeMove(Move square) {
+            const uint16_t placed = mine | (1 << square);
+            mine = theirs;
+            theirs = placed;
         }
-    }
-}
-
-bool isAIBoardFull(const std::string& state) {
-    return state.find('0') == std::string::npos;
-}
-
-int evaluateAIBoard(const std::string& state) {
-    static const int kWinningTriples[8][3] =  { {0,1,2}, {3,4,5}, {6,7,8},  // rows
-                                                {0,3,6}, {1,4,7}, {2,5,8},  // cols
-                                                {0,4,8}, {2,4,6} };         // diagonals
-    for( int i=0; i<8; i++ ) {
-        const int *triple = kWinningTriples[i];
-        char first = state[triple[0]];
-        if( first != '0' && first == state[triple[1]] && first == state[triple[2]] ) {
-            return 10;   // someone won, negamax will handle who
+        uint64_t hash() const { return mine | (theirs << 9); }
+        int evaluate() const { return 0; }
+
+        // the player who just moved is the only one who can have made a line
+        bool terminal(int ply, int& score) const {
+            static const uint16_t kWinningLines[8] = { 0007, 0070, 0700,    // rows
+                                                       0111, 0222, 0444,    // cols
+                                                       0421, 0124 };        // diagonals
+            for (uint16_t line : kWinningLines) {
+                if ((theirs & line) == line) {
+                    score = searchLoss(ply);
+                    return true;
+                }
+            }
+            if ((mine | theirs) == 0777) {
+                score = 0;
+                return true;
+            }
+            return false;
         }
-    }
-    return 0; // No winner
+    };
 }
 
 //
-// player is the current player's number (AI or human)
+// this is the function that will be called by the AI
 //
-int TicTacToe::negamax(std::string& state, int depth, int playerColor) 
+AIJob::Work TicTacToe::aiWork()
 {
-    int score = evaluateAIBoard(state);
-
-    // Check if AI wins, human wins, or draw
-    if(score) { 
-        // A winning state is a loss for the player whose turn it is.
-        // The previous player made the winning move.
-        return -score; 
-    }
-
-    if(isAIBoardFull(state)) {
-        return 0; // Draw
-    }
-
-    int bestVal = -1000; // Min value
-    for (int y = 0; y < 3; y++) {
-        for (int x = 0; x < 3; x++) {
-            // Check if cell is empty
-            if (state[y * 3 + x] == '0') {
-                // Make the move
-                state[y * 3 + x] = playerColor == HUMAN_PLAYER ? '1' : '2'; // Set the cell to the current player's color
-                bestVal = std::max(bestVal, -negamax(state, depth + 1, -playerColor));
-                // Undo the move for backtracking
-                state[y * 3 + x] = '0';
-            }
+    TicTacToePosition position;
+    Player* current = getCurrentPlayer();
+    for (int index = 0; index < 9; index++) {
+        Player* owner = ownerAt(index);
+        if (owner) {
+            (owner == current ? position.mine : position.theirs) |= 1 << index;
         }
     }
 
-    return bestVal;
-}
\ No newline at end of file
+    // the whole game tree is a few thousand positions, it is solved outright
+    return [this, position](AIJob& job) -> std::function<void()> {
+        Search<TicTacToePosition> search(1);
+        Search<TicTacToePosition>::Result result = search.solve(position);
+        if (!result.hasMove) return nullptr;
+
+        // cells numbered 1..9 row by row
+        auto cellName = [](int cell) { return std::to_string(cell + 1); };
+        int line[9];
+        const int length = search.principalVariation(position, line, 9);
+        std::string pv;
+        for (int i = 0; i < length; i++) {
+            pv += (i ? " " : "") + cellName(line[i]);
+        }
+        job.report(result.depth, result.score, result.nodes, cellName(result.move), pv);
+        return [this, move = result.move]() {
+            actionForEmptyHolder(*_grid->getSquare(move % 3, move / 3));
+        };
+    };
+}
@@ -27,13 +27,13 @@ public:
     bool        canBitMoveFromTo(Bit &bit, BitHolder &src, BitHolder &dst) override;
     void        stopGame() override;
 
-	void        updateAI() override;
     bool        gameHasAI() override { return true; }
     Grid* getGrid() override { return _grid; }
+protected:
+    AIJob::Work aiWork() override;
 private:
     Bit *       PieceForPlayer(const int playerNumber);
     Player*     ownerAt(int index ) const;
-    int         negamax(std::string& state, int depth, int playerColor);
 
     Grid*       _grid;
 };
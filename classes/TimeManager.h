@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include "GameState.h"
+
+//
+// How much of the clock a move may use
+// a search given the side to move's remaining time (rather than a fixed move time) gets two limits:
+// a soft one, past which no new iteration is started, and a hard one at which the search is stopped
+// wherever it is. The soft limit is half the move's share of the clock, since the next iteration
+// costs about as much as every one before it. After each iteration it is scaled: a best move that has
+// held for several depths brings it in, a new best move or a falling score pushes it out, and the
+// hard limit caps whatever the scaling asks for.
+//
+
+constexpr int MOVE_OVERHEAD_MS = 10;       // kept back for getting the move to the other side
+constexpr int DEFAULT_MOVES_TO_GO = 25;    // how many moves the clock is shared between without a time control
+
+struct TimeBudget {
+    int softMs = 0;
+    int hardMs = 0;
+};
+
+class TimeManager {
+public:
+    // the share of remainingMs for this move, movesToGo 0 when the clock must last the game
+    static TimeBudget allocate(int remainingMs, int incrementMs, int movesToGo) {
+        const int usable = std::max(1, remainingMs - MOVE_OVERHEAD_MS);
+        const int moves = movesToGo > 0 ? movesToGo : DEFAULT_MOVES_TO_GO;
+        const int target = std::min(usable, usable / moves + incrementMs * 3 / 4);
+        // the last move before the control may take everything, any other at most half of what is left
+        const int cap = moves == 1 ? usable : std::max(target, usable / 2);
+        TimeBudget budget;
+        budget.hardMs = std::max(1, std::min(target * 4, cap));
+        budget.softMs = std::max(1, std::min(target / 2, budget.hardMs));
+        return budget;
+    }
+
+    // a fixed move time is all used up, the soft limit is only there to skip an iteration that can't finish
+    static TimeBudget fixed(int moveTimeMs) {
+        return TimeBudget{ moveTimeMs / 2, moveTimeMs };
+    }
+
+    void reset() {
+        _iterations = 0;
+        _stableIterations = 0;
+    }
+
+    // called after each completed iteration with its best move and score; what the soft limit is
+    // multiplied by from here on
+    double update(const BitMove& best, int score) {
+        const bool changed = _iterations > 0 && !(best == _best);
+        const int drop = _iterations > 0 ? _score - score : 0;
+        _stableIterations = changed ? 0 : _stableIterations + (_iterations > 0 ? 1 : 0);
+        _best = best;
+        _score = score;
+        _iterations++;
+
+        // indexed by how many iterations in a row have kept the best move
+        static constexpr double STABILITY[] = { 1.0, 1.0, 0.9, 0.8, 0.7, 0.6 };
+        double factor = changed ? 1.5 : STABILITY[std::min(_stableIterations, 5)];
+        // up to twice as long for a score a pawn or more below the last iteration's
+        if (drop > 0) {
+            factor *= 1.0 + std::min(drop, 100) / 100.0;
+        }
+        return factor;
+    }
+
+private:
+    BitMove _best;
+    int _score = 0;
+    int _iterations = 0;
+    int _stableIterations = 0;
+};
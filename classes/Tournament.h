@@ -14,6 +14,12 @@
  *
  *   // In your render loop:
  *   client.update();
+ *
+ *   // Optionally, search every move on other bots too (each started with setClusterHelper(true)):
+ *   client.setClusterHelpers({ "MyBot2", "MyBot3" });
+ *
+ * The socket is read on a network thread that sleeps in poll() until data arrives, so replies don't
+ * wait for the next frame; update() only handles the messages it has queued up since the last one.
  */
 
 #include <string>
@@ -22,9 +28,22 @@
 #include <chrono>
 #include <iostream>
 #include <sstream>
+#include <cstdio>
 #include <cstring>
 #include <map>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string_view>
+#include <charconv>
+#include <memory>
+#include "SpscQueue.h"
+#include "LineFramer.h"
+#include "LogRing.h"
+#include "GameState.h"
+#include "ClusterSearch.h"
+#include "Trace.h"
 
 // Platform-specific socket includes
 #ifdef _WIN32
@@ -36,7 +55,11 @@
     #define INVALID_SOCKET_VALUE INVALID_SOCKET
     #define SOCKET_ERROR_VALUE SOCKET_ERROR
     #define CLOSE_SOCKET(s) closesocket(s)
+    #define SHUTDOWN_SOCKET(s) shutdown(s, SD_BOTH)
+    #define POLL_SOCKETS(fds, count, timeoutMs) WSAPoll(fds, count, timeoutMs)
+    typedef WSAPOLLFD PollType;
     #define WOULD_BLOCK_ERROR (WSAGetLastError() == WSAEWOULDBLOCK)
+    #define INTERRUPTED_ERROR (WSAGetLastError() == WSAEINTR)
 #else
     // macOS / Linux
     #include <sys/socket.h>
@@ -46,11 +69,16 @@
     #include <fcntl.h>
     #include <errno.h>
     #include <netdb.h>
+    #include <poll.h>
     typedef int SocketType;
     #define INVALID_SOCKET_VALUE -1
     #define SOCKET_ERROR_VALUE -1
     #define CLOSE_SOCKET(s) close(s)
+    #define SHUTDOWN_SOCKET(s) shutdown(s, SHUT_RDWR)
+    #define POLL_SOCKETS(fds, count, timeoutMs) poll(fds, count, timeoutMs)
+    typedef struct pollfd PollType;
     #define WOULD_BLOCK_ERROR (errno == EWOULDBLOCK || errno == EAGAIN)
+    #define INTERRUPTED_ERROR (errno == EINTR)
 #endif
 
 // Forward declaration
@@ -65,6 +93,31 @@ class Chess;
  *   - Messages are pipe-delimited: TARGET|PAYLOAD
  *   - FEN positions arrive as: ADMIN|FEN:<fen_string>
  *   - Moves are sent as: ADMIN|MOVE:srcIndex,dstIndex
+ *   - ADMIN|STOP asks for the move now, the best one found so far is sent
+ *
+ * Delta mode, offered by the director with PROTO:DELTA and accepted by echoing it:
+ *   - after the first FEN only the opponent's move arrives, as ADMIN|D:<move><hash>, and is played on
+ *     the board the bot already has, so it keeps the game history too
+ *   - moves are sent as ADMIN|M:<move>
+ *   - <move> is 4 hex digits, from | to << 6 | promotion piece << 12 | 0x8000 on a promotion, and
+ *     <hash> the 16 hex digit Zobrist hash of the position after it. A bot whose board doesn't hash
+ *     the same sends ADMIN|RESYNC and gets a full FEN back
+ *   The relay frames by line, so the fields are hex rather than raw bytes
+ *
+ * Clock, when the director plays its matches on a time control (DirectorClient::setTimeControl):
+ *   - FEN: and D: end in ;CLOCK:<ms>,<inc>, the bot's own remaining time and increment in
+ *     milliseconds, and the bot's time manager shares that out instead of using its fixed move time
+ *   - a bot's clock runs from the position going out to its move coming in; one that runs out loses
+ *
+ * Cluster search, between a bot and its own helper bots (ClusterSearch.h has the details):
+ *   - the bot sends each helper part of the root's moves as <helper>|WORK:<id>,<ms>,<moves>,<fen>
+ *     and <helper>|WORK:CANCEL once its move is played
+ *   - a helper answers <bot>|RESULT:<id>,<depth>,<score>,<nodes>,<done>,<pv> after every iteration
+ *     and <bot>|ALIVE:<id> while one runs long
+ *   - a helper that goes quiet or falls behind loses its moves to the bot's own search
+ *
+ * The AI searches on a background thread, so update() keeps reading the socket and answering PINGs
+ * while it thinks, and sends the move on the first update() after the search is done.
  */
 class TournamentClient {
 public:
@@ -76,23 +129,65 @@ public:
         Error
     };
 
-    // Message callback type
-    using MessageCallback = std::function<void(const std::string& sender, const std::string& payload)>;
+    // the bot's clock as FEN: and D: carry it
+    struct Clock {
+        int remainingMs = 0;
+        int incrementMs = 0;
+    };
+
+    // Message callback type, the views are only valid during the call
+    using MessageCallback = std::function<void(std::string_view sender, std::string_view payload)>;
 
     Chess* _game;
 private:
+    // longest line the client reads, anything longer is dropped
+    static constexpr size_t MAX_MESSAGE_LENGTH = 2048;
+
+    // what the network thread hands to update(), the message copied into the queue slot itself so
+    // nothing is allocated on the way
+    struct NetworkEvent {
+        enum Kind { Message, Malformed, Closed, Failed } kind;
+        uint16_t senderLength;
+        uint16_t payloadLength;
+        char text[MAX_MESSAGE_LENGTH];  // sender then payload; the line for Malformed, the error for Failed
+
+        std::string_view sender() const { return std::string_view(text, senderLength); }
+        std::string_view payload() const { return std::string_view(text + senderLength, payloadLength); }
+    };
+
     std::string _botName;
     SocketType _socket;
     State _state;
-    std::string _receiveBuffer;
+    LineFramer<MAX_MESSAGE_LENGTH> _framer;  // only touched by the network thread
     std::string _lastError;
-    bool _waitingForAI;
-    bool _moveReady;
+    std::thread _networkThread;
+    std::atomic<bool> _networkRunning;
+    SpscQueue<NetworkEvent, 128> _incoming;
+    std::mutex _sendMutex;       // the game and search threads both send
+    std::atomic<bool> _sendFailed;
+    std::string _sentMove;       // what the search thread sent, logged by pollSearch
+    bool _waitingForAI;          // a search is running for the position below
+    std::string _searchReplyTo;  // who asked for the move
+    bool _searchIsTest;          // answer with TEST:MOVE instead of MOVE
+    bool _ponder;                // think on the opponent's time
+    bool _pondering;             // a ponder search is running on the reply we expect
+    bool _allowDelta;            // accept the director's offer of delta mode
+    bool _deltaMode;             // negotiated, moves go out as M: and D: is understood
+    int _moveTimeMs;
+    Clock _clock;                // what came with the position being searched, zero without a clock
     MessageCallback _messageCallback;
 
+    // Cluster search
+    std::shared_ptr<const ChessEval> _clusterEvaluator;  // the model the game's own AI plays with
+    std::unique_ptr<ClusterCoordinator> _coordinator;    // while there are helpers
+    std::unique_ptr<ClusterHelper> _clusterWorker;       // while this bot takes WORK
+    bool _clusterSearch;         // the running search is the coordinator's, not the game's
+
     // Logging
-    std::vector<std::string> _log;
+    LogRing _log;  // written by the game thread only, printed by the log sink
     static constexpr size_t MAX_LOG_ENTRIES = 100;
+    static constexpr int DEFAULT_MOVE_TIME_MS = 2000;
+    static constexpr int NETWORK_POLL_MS = 100;  // how long the network thread sleeps between checks that it should stop
 
 #ifdef _WIN32
     bool _wsaInitialized;
@@ -109,8 +204,17 @@ public:
         , _botName(botName)
         , _socket(INVALID_SOCKET_VALUE)
         , _state(State::Disconnected)
+        , _networkRunning(false)
+        , _sendFailed(false)
         , _waitingForAI(false)
-        , _moveReady(false)
+        , _searchIsTest(false)
+        , _ponder(true)
+        , _pondering(false)
+        , _allowDelta(true)
+        , _deltaMode(false)
+        , _moveTimeMs(DEFAULT_MOVE_TIME_MS)
+        , _clusterSearch(false)
+        , _log("Tournament", MAX_LOG_ENTRIES)
 #ifdef _WIN32
         , _wsaInitialized(false)
 #endif
@@ -170,7 +274,7 @@ public:
         _socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
         if (_socket == INVALID_SOCKET_VALUE) {
             _lastError = "Failed to create socket";
-            addLog(_lastError);
+            addLog(_lastError, LogLevel::Error);
             _state = State::Error;
             return false;
         }
@@ -187,7 +291,7 @@ public:
             struct hostent* host = gethostbyname(ip.c_str());
             if (host == nullptr) {
                 _lastError = "Invalid address: " + ip;
-                addLog(_lastError);
+                addLog(_lastError, LogLevel::Error);
                 CLOSE_SOCKET(_socket);
                 _socket = INVALID_SOCKET_VALUE;
                 _state = State::Error;
@@ -199,7 +303,7 @@ public:
         // Connect (blocking for simplicity during initial connection)
         if (::connect(_socket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
             _lastError = "Connection failed to " + ip + ":" + std::to_string(port);
-            addLog(_lastError);
+            addLog(_lastError, LogLevel::Error);
             CLOSE_SOCKET(_socket);
             _socket = INVALID_SOCKET_VALUE;
             _state = State::Error;
@@ -216,7 +320,14 @@ public:
 #endif
 
         _state = State::Connected;
-        _receiveBuffer.clear();
+        _framer.clear();
+        while (_incoming.peek()) {
+            _incoming.release();  // left over from the last connection
+        }
+        _sendFailed.store(false);
+        _deltaMode = false;  // the director offers it again once it has seen us
+        _networkRunning.store(true);
+        _networkThread = std::thread([this]() { networkLoop(); });
         addLog("Connected successfully!");
 
         // Send registration message
@@ -231,40 +342,64 @@ public:
      * Disconnect from the server
      */
     void disconnect() {
-        if (_socket != INVALID_SOCKET_VALUE) {
-            CLOSE_SOCKET(_socket);
-            _socket = INVALID_SOCKET_VALUE;
+        // the search may still send, and the network thread must be out of poll() before the socket goes
+        cancelSearch();
+        if (_clusterWorker) {
+            _clusterWorker->cancel();
+        }
+        if (_networkThread.joinable()) {
+            _networkRunning.store(false);
+            if (_socket != INVALID_SOCKET_VALUE) {
+                SHUTDOWN_SOCKET(_socket);  // wakes poll() at once instead of after the timeout
+            }
+            _networkThread.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(_sendMutex);
+            if (_socket != INVALID_SOCKET_VALUE) {
+                CLOSE_SOCKET(_socket);
+                _socket = INVALID_SOCKET_VALUE;
+            }
         }
         _state = State::Disconnected;
-        _receiveBuffer.clear();
-        _waitingForAI = false;
-        _moveReady = false;
         addLog("Disconnected");
     }
 
     /**
      * Update - Call this every frame
-     * Handles receiving data, processing FEN, running AI, and sending moves.
+     * Handles the messages the network thread received, starts the AI on FENs and plays its moves.
      */
     void update() {
         if (_state != State::Connected) {
             return;
         }
 
-        // Receive any pending data
-        receiveData();
-
-        // Process complete messages
+        // Handle whatever the network thread has received since the last frame
         processMessages();
+        if (_state != State::Connected) {
+            return;
+        }
+        if (_sendFailed.load()) {
+            sendFailed();
+            return;
+        }
 
-        // If AI is computing and ready, send the move
-        if (_moveReady && _game != nullptr) {
-            sendAIMove();
-            _moveReady = false;
-            _waitingForAI = false;
+        // If the AI has finished thinking (and sent its move), play it on the board
+        if (_waitingForAI) {
+            pollSearch();
         }
     }
 
+    /**
+     * Cut the current search short, the best move found so far is sent as soon as it unwinds
+     */
+    void stopSearch();
+
+    /**
+     * @return true while the AI is thinking about a position
+     */
+    bool isThinking() const { return _waitingForAI; }
+
     /**
      * Send a message to a target client
      * @param target Target client name (e.g., "ADMIN")
@@ -278,7 +413,7 @@ public:
 
         std::string message = target + "|" + payload + "\n";
         sendRaw(message);
-        addLog("Sent to " + target + ": " + payload);
+        addLog("Sent to " + target + ": " + payload, LogLevel::Debug);
     }
 
     /**
@@ -289,12 +424,99 @@ public:
         _messageCallback = callback;
     }
 
+    /**
+     * Set the time the AI may think about each move
+     * @param milliseconds Search budget handed to the game on every FEN
+     */
+    void setMoveTime(int milliseconds) { _moveTimeMs = milliseconds; }
+
+    /**
+     * Let the AI keep searching on the opponent's time, on the reply it expects
+     * @param enabled On by default
+     */
+    void setPonder(bool enabled) { _ponder = enabled; }
+
+    /**
+     * Accept delta mode (moves instead of a FEN every turn) when the director offers it
+     * @param enabled On by default, takes effect at the next offer
+     */
+    void setDeltaProtocol(bool enabled) { _allowDelta = enabled; }
+
+    /**
+     * Split the search of every game move with these bots, which must be running with
+     * setClusterHelper(true); none goes back to searching alone. Pondering is off while there are
+     * helpers, the opponent's time is theirs too.
+     * @param helpers The helpers' bot names
+     */
+    void setClusterHelpers(const std::vector<std::string>& helpers);
+
+    /**
+     * Take WORK from a bot that has this one as a cluster helper
+     * @param enabled Off by default
+     */
+    void setClusterHelper(bool enabled);
+
+    // Delta mode encoding, see the protocol notes above
+    static uint16_t deltaMove(const BitMove& move) {
+        uint16_t wire = static_cast<uint16_t>(move.from | (move.to << 6));
+        if (move.flags & IsPromotion) {
+            wire |= static_cast<uint16_t>(0x8000 | (((move.flags & PromotionPieceMask) >> 5) << 12));
+        }
+        return wire;
+    }
+    static void decodeDeltaMove(uint16_t wire, int& from, int& to, int& promotion) {
+        from = wire & 63;
+        to = (wire >> 6) & 63;
+        promotion = (wire & 0x8000) ? (wire >> 12) & 3 : -1;
+    }
+    static void appendHex(std::string& out, uint64_t value, int digits) {
+        static constexpr char hexDigits[] = "0123456789abcdef";
+        for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+            out += hexDigits[(value >> shift) & 15];
+        }
+    }
+    // exactly text.size() hex digits
+    static bool parseHex(std::string_view text, uint64_t& value) {
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+
+    // Clock encoding, see the protocol notes above
+    static void appendClock(std::string& out, const Clock& clock) {
+        out += ";CLOCK:" + std::to_string(clock.remainingMs) + "," + std::to_string(clock.incrementMs);
+    }
+    // the payload without its clock, which goes to clock; zero if there is none or it doesn't parse
+    static std::string_view splitClock(std::string_view payload, Clock& clock) {
+        clock = Clock();
+        const size_t at = payload.find(";CLOCK:");
+        if (at == std::string_view::npos) {
+            return payload;
+        }
+        const std::string_view fields = payload.substr(at + 7);
+        const size_t comma = fields.find(',');
+        Clock parsed;
+        if (comma != std::string_view::npos) {
+            auto [end, error] = std::from_chars(fields.data(), fields.data() + comma, parsed.remainingMs);
+            auto [incrementEnd, incrementError] = std::from_chars(fields.data() + comma + 1, fields.data() + fields.size(), parsed.incrementMs);
+            if (error == std::errc() && end == fields.data() + comma && incrementError == std::errc() &&
+                incrementEnd == fields.data() + fields.size()) {
+                clock = parsed;
+            }
+        }
+        return payload.substr(0, at);
+    }
+
     // Getters
     State getState() const { return _state; }
     bool isConnected() const { return _state == State::Connected; }
     const std::string& getBotName() const { return _botName; }
     const std::string& getLastError() const { return _lastError; }
-    const std::vector<std::string>& getLog() const { return _log; }
+    std::vector<std::string> getLog() const { return _log.recent(); }
+
+    /**
+     * Messages below this level are dropped, Debug (everything) by default
+     */
+    void setLogLevel(LogLevel level) { _log.setLevel(level); }
 
     /**
      * Get state as string for display
@@ -311,169 +533,296 @@ public:
 
 
     /**
-     * Add entry to log (with timestamp)
+     * Add entry to log, timestamped and printed to the console by the log sink thread
      */
-    void addLog(const std::string& message) {
-        auto now = std::chrono::system_clock::now();
-        auto time = std::chrono::system_clock::to_time_t(now);
-        char timeStr[32];
-        std::strftime(timeStr, sizeof(timeStr), "%H:%M:%S", std::localtime(&time));
-
-        std::string logEntry = std::string("[") + timeStr + "] " + message;
-        _log.push_back(logEntry);
-
-        // Keep log size bounded
-        while (_log.size() > MAX_LOG_ENTRIES) {
-            _log.erase(_log.begin());
-        }
-
-        // Also print to console for debugging
-        std::cout << "[Tournament] " << message << std::endl;
+    void addLog(std::string_view message, LogLevel level = LogLevel::Info) {
+        _log.log(level, message);
     }
 private:
     /**
-     * Send raw data to socket
+     * Send raw data to socket, from the game thread
      */
     bool sendRaw(const std::string& data) {
-        if (_socket == INVALID_SOCKET_VALUE) {
+        if (!sendBytes(data)) {
+            sendFailed();
             return false;
         }
-
-        int bytesSent = send(_socket, data.c_str(), static_cast<int>(data.length()), 0);
-        if (bytesSent == SOCKET_ERROR_VALUE) {
-            if (!WOULD_BLOCK_ERROR) {
-                _lastError = "Send failed";
-                addLog(_lastError);
-                disconnect();
-                _state = State::Error;
-                return false;
-            }
-        }
         return true;
     }
 
     /**
-     * Receive data from socket (non-blocking)
+     * Send raw data to socket from any thread; a failure is left for the caller to report
      */
-void receiveData() {
-    char buffer[4096];
-
-    while (true) {
-        int bytesReceived = recv(_socket, buffer, sizeof(buffer) - 1, 0);
-
-        if (bytesReceived > 0) {
-            buffer[bytesReceived] = '\0';
-            _receiveBuffer += buffer;
-        } else if (bytesReceived == 0) {
-            addLog("Server closed connection");
-            disconnect();
-            return;
-        } else {
-#ifdef _WIN32
-            int err = WSAGetLastError();
-            if (err != WSAEWOULDBLOCK && err != WSAEINTR) {
-                _lastError = "Receive error: " + std::to_string(err);
-                addLog(_lastError);
-                disconnect();
-                _state = State::Error;
-            }
-#else
-            if (!WOULD_BLOCK_ERROR) {
-                _lastError = "Receive error";
-                addLog(_lastError);
-                disconnect();
-                _state = State::Error;
-            }
-#endif
-            break;
+    bool sendBytes(std::string_view data) {
+        std::lock_guard<std::mutex> lock(_sendMutex);
+        if (_socket == INVALID_SOCKET_VALUE) {
+            return false;
         }
+        int bytesSent = send(_socket, data.data(), static_cast<int>(data.length()), 0);
+        return bytesSent != SOCKET_ERROR_VALUE || WOULD_BLOCK_ERROR;
     }
-}
+
+    void sendFailed() {
+        _lastError = "Send failed";
+        addLog(_lastError, LogLevel::Error);
+        disconnect();
+        _state = State::Error;
+    }
+
     /**
-     * Process complete messages from buffer
+     * Network thread: sleeps until the socket is readable, splits what arrives into messages and
+     * queues them for update(). It ends when the connection does or disconnect() asks it to.
      */
-    void processMessages() {
-        size_t pos;
-        while ((pos = _receiveBuffer.find('\n')) != std::string::npos) {
-            std::string message = _receiveBuffer.substr(0, pos);
-            _receiveBuffer.erase(0, pos + 1);
-
-            // Trim whitespace
-            while (!message.empty() && (message.back() == '\r' || message.back() == ' ')) {
-                message.pop_back();
+    void networkLoop() {
+        while (_networkRunning.load()) {
+            PollType readable;
+            readable.fd = _socket;
+            readable.events = POLLIN;
+            readable.revents = 0;
+            int ready = POLL_SOCKETS(&readable, 1, NETWORK_POLL_MS);
+            if (ready == 0 || (ready < 0 && INTERRUPTED_ERROR)) {
+                continue;
+            }
+            if (ready < 0) {
+                postEvent(NetworkEvent::Failed, "", "Poll error");
+                return;
             }
 
-            if (message.empty()) {
-                continue;
+            // drain the socket, it stays readable until we do
+            while (true) {
+                int bytesReceived = recv(_socket, _framer.writePtr(), static_cast<int>(_framer.writeSpace()), 0);
+                if (bytesReceived > 0) {
+                    _framer.commit(static_cast<size_t>(bytesReceived));
+                    postMessages();
+                } else if (bytesReceived == 0) {
+                    if (_networkRunning.load()) {
+                        postEvent(NetworkEvent::Closed, "", "");
+                    }
+                    return;
+                } else {
+                    if (!WOULD_BLOCK_ERROR && !INTERRUPTED_ERROR) {
+                        postEvent(NetworkEvent::Failed, "", "Receive error");
+                        return;
+                    }
+                    break;
+                }
             }
+        }
+    }
 
+    /**
+     * Queue every complete line received so far as a SENDER|PAYLOAD message
+     */
+    void postMessages() {
+        const size_t overflows = _framer.overflows();
+        std::string_view message;
+        while (_framer.next(message)) {
             // Parse SENDER|PAYLOAD format
             size_t pipePos = message.find('|');
-            if (pipePos == std::string::npos) {
-                addLog("Invalid message format: " + message);
+            if (pipePos == std::string_view::npos) {
+                postEvent(NetworkEvent::Malformed, "", message);
                 continue;
             }
+            std::string_view sender = message.substr(0, pipePos);
+            std::string_view payload = message.substr(pipePos + 1);
+            // a comms check is answered right here, however long the frame or the search takes
+            if (payload == "TEST:PING" && !sendPong(sender)) {
+                _sendFailed.store(true);
+            }
+            postEvent(NetworkEvent::Message, sender, payload);
+        }
+        _framer.compact();
+        if (_framer.overflows() != overflows) {
+            postEvent(NetworkEvent::Malformed, "", "(message too long, dropped)");
+        }
+    }
 
-            std::string sender = message.substr(0, pipePos);
-            std::string payload = message.substr(pipePos + 1);
-
-            addLog("Received from " + sender + ": " + payload);
+    bool sendPong(std::string_view sender) {
+        char reply[MAX_MESSAGE_LENGTH + 16];
+        if (sender.size() > MAX_MESSAGE_LENGTH) {
+            return true;
+        }
+        std::memcpy(reply, sender.data(), sender.size());
+        std::memcpy(reply + sender.size(), "|TEST:PONG\n", 11);
+        return sendBytes(std::string_view(reply, sender.size() + 11));
+    }
 
-            // Handle comms check PING
-            if (payload == "TEST:PING") {
-                sendMessage(sender, "TEST:PONG");
-                addLog("Responded to PING from " + sender);
-                continue;
+    /**
+     * Hand an event to the game thread, waiting for room if it has fallen a whole queue behind
+     */
+    void postEvent(NetworkEvent::Kind kind, std::string_view sender, std::string_view payload) {
+        NetworkEvent* event;
+        while ((event = _incoming.claim()) == nullptr) {
+            if (!_networkRunning.load()) {
+                return;
             }
-            // Handle comms check FEN test
-            if (payload.substr(0, 9) == "TEST:FEN:") {
-                std::string testFen = payload.substr(9);
-                addLog("Comms test: Calculating move for test position...");
-                if (_game != nullptr) {
-                    _game->setBoardFromFEN(testFen);
-                    _game->updateAI();
-                    BitMove move = _game->getLastAIMove();
-                    if (move.piece != NoPiece) {
-                        std::string moveStr = "TEST:MOVE:" + std::to_string(static_cast<int>(move.from)) +
-                                              "," + std::to_string(static_cast<int>(move.to));
-                        sendMessage(sender, moveStr);
-                        addLog("Comms test: Sent test move " + moveStr);
-                    } else {
-                        sendMessage(sender, "TEST:ERROR:NoMove");
-                    }
-                }
-                continue;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        // a framed line always fits, the clamp only guards the error texts
+        sender = sender.substr(0, MAX_MESSAGE_LENGTH);
+        payload = payload.substr(0, MAX_MESSAGE_LENGTH - sender.size());
+        event->kind = kind;
+        event->senderLength = static_cast<uint16_t>(sender.size());
+        event->payloadLength = static_cast<uint16_t>(payload.size());
+        std::memcpy(event->text, sender.data(), sender.size());
+        std::memcpy(event->text + sender.size(), payload.data(), payload.size());
+        _incoming.publish();
+    }
+
+    /**
+     * Handle the messages the network thread has queued
+     */
+    void processMessages() {
+        TRACE_ZONE("TournamentClient::processMessages");
+        const NetworkEvent* event;
+        while (_state == State::Connected && (event = _incoming.peek()) != nullptr) {
+            switch (event->kind) {
+            case NetworkEvent::Message:
+                handleMessage(event->sender(), event->payload());
+                break;
+            case NetworkEvent::Malformed:
+                addLog("Invalid message format: " + std::string(event->payload()), LogLevel::Warning);
+                break;
+            case NetworkEvent::Closed:
+                addLog("Server closed connection");
+                disconnect();
+                break;
+            case NetworkEvent::Failed:
+                _lastError = std::string(event->payload());
+                addLog(_lastError, LogLevel::Error);
+                disconnect();
+                _state = State::Error;
+                break;
             }
-            // Handle FEN messages
-            if (payload.substr(0, 4) == "FEN:") {
-                std::string fen = payload.substr(4);
-                handleFEN(fen);
+            _incoming.release();
+        }
+    }
+
+    void handleMessage(std::string_view sender, std::string_view payload) {
+        addLog("Received from " + std::string(sender) + ": " + std::string(payload), LogLevel::Debug);
+
+        // Handle comms check PING, the network thread has already sent the PONG
+        if (payload == "TEST:PING") {
+            addLog("Responded to PING from " + std::string(sender));
+            return;
+        }
+        // Handle comms check FEN test
+        if (payload.starts_with("TEST:FEN:")) {
+            addLog("Comms test: Calculating move for test position...");
+            _clock = Clock();
+            startSearch(sender, payload.substr(9), true);
+            return;
+        }
+        // the director offers delta mode, the reply is what switches it on at its end
+        if (payload == "PROTO:DELTA" && sender == "ADMIN") {
+            _deltaMode = _allowDelta;
+            if (_deltaMode) {
+                sendMessage("ADMIN", "PROTO:DELTA");
             }
-            // Handle other server messages
-            else if (sender == "SERVER") {
-                // Server acknowledgments, errors, etc.
-                addLog("Server: " + payload);
-                // Also call callback for SERVER messages (e.g., CLIENTS list)
-                if (_messageCallback) {
-                    _messageCallback(sender, payload);
-                }
+            return;
+        }
+        if (payload.starts_with("D:") && sender == "ADMIN") {
+            handleDelta(splitClock(payload.substr(2), _clock));
+            return;
+        }
+        // cluster search, between a bot and its helpers
+        if (payload.starts_with("WORK:")) {
+            handleWork(sender, payload.substr(5));
+            return;
+        }
+        if (payload.starts_with("RESULT:") || payload.starts_with("ALIVE:")) {
+            if (_coordinator) {
+                _coordinator->handleMessage(std::string(sender), payload);
             }
-            // Call custom callback if set
-            else if (_messageCallback) {
+            return;
+        }
+        if (payload == "TEST:PONG" && _coordinator) {
+            _coordinator->handleMessage(std::string(sender), payload);
+        }
+        // Server wants the move now
+        if (payload == "STOP") {
+            stopSearch();
+            return;
+        }
+        // Handle FEN messages
+        if (payload.starts_with("FEN:")) {
+            handleFEN(splitClock(payload.substr(4), _clock));
+        }
+        // Handle other server messages
+        else if (sender == "SERVER") {
+            // Server acknowledgments, errors, etc.
+            addLog("Server: " + std::string(payload));
+            // Also call callback for SERVER messages (e.g., CLIENTS list)
+            if (_messageCallback) {
                 _messageCallback(sender, payload);
             }
         }
+        // Call custom callback if set
+        else if (_messageCallback) {
+            _messageCallback(sender, payload);
+        }
     }
 
     /**
      * Handle incoming FEN position
      */
-    void handleFEN(const std::string& fen);
+    void handleFEN(std::string_view fen);
+
+    /**
+     * Handle the opponent's move in delta mode, asking for a FEN if it doesn't leave the board
+     * where the director has it
+     */
+    void handleDelta(std::string_view delta);
+
+    /**
+     * Start the AI on the board as it is, abandoning any search still running
+     */
+    void launchSearch(std::string_view replyTo, bool test);
+
+    /**
+     * Search a coordinator's share of its root, or drop it on WORK:CANCEL
+     */
+    void handleWork(std::string_view sender, std::string_view work);
+
+    /**
+     * The evaluator the cluster searches use, loaded with the first of them
+     */
+    const ChessEval& clusterEvaluator();
+
+    /**
+     * Give the game the clock the position came with, or the fixed move time without one
+     * @return The budget, for the log
+     */
+    std::string applyTimeBudget();
+
+    /**
+     * Set up the position and start the AI on it in the background; a search still running for an
+     * older position is abandoned
+     * @param replyTo Who the move is sent to
+     * @param test Answer as a comms test rather than a game move
+     */
+    void startSearch(std::string_view replyTo, std::string_view fen, bool test);
+
+    /**
+     * Play and send the move once the search is done, without waiting for it
+     */
+    void pollSearch();
+
+    /**
+     * Abandon a running search without sending anything
+     */
+    void cancelSearch();
+
+    /**
+     * Sends the move the search chose, called on the search thread
+     */
+    void sendSearchMove(const BitMove& move);
 
     /**
-     * Send the AI's calculated move
+     * The reply for the AI's move, an error if it had none
+     * @param test Format it as a comms test answer
      */
-    void sendAIMove();
+    std::string movePayload(const BitMove& move, bool test) const;
 };
 
 // These implementations need Chess.h, so they're defined after including it
@@ -482,52 +831,250 @@ void receiveData() {
 #ifdef TOURNAMENT_IMPLEMENTATION
 #include "Chess.h"
 
-void TournamentClient::handleFEN(const std::string& fen) {
+void TournamentClient::handleFEN(std::string_view fen) {
+    if (_pondering && _game != nullptr) {
+        _pondering = false;
+        // nothing is sent while pondering, so this can't race the search thread
+        _sentMove.clear();
+        const std::string budget = applyTimeBudget();
+        if (_game->ponderHit(std::string(fen))) {
+            addLog("Ponder hit, searching on for " + budget);
+            _searchReplyTo = "ADMIN";
+            _searchIsTest = false;
+            _waitingForAI = true;
+            return;
+        }
+        addLog("Ponder miss");
+    }
+    startSearch("ADMIN", fen, false);
+}
+
+void TournamentClient::startSearch(std::string_view replyTo, std::string_view fen, bool test) {
     if (_game == nullptr) {
-        addLog("ERROR: Game pointer is null");
+        addLog("ERROR: Game pointer is null", LogLevel::Error);
         return;
     }
 
-    addLog("Setting board from FEN: " + fen);
+    addLog("Setting board from FEN: " + std::string(fen));
 
-    // Set the board state from FEN
-    _game->setBoardFromFEN(fen);
+    // Set the board state from FEN, this also abandons any search still running
+    _game->setBoardFromFEN(std::string(fen));
+    _pondering = false;
+    launchSearch(replyTo, test);
+}
 
-    // Run the AI to calculate a move
-    addLog("Running AI...");
-    _game->updateAI();
+void TournamentClient::handleDelta(std::string_view delta) {
+    uint64_t wire = 0, hash = 0;
+    int from, to, promotion;
+    if (_game == nullptr || delta.size() != 20 || !parseHex(delta.substr(0, 4), wire) || !parseHex(delta.substr(4), hash)) {
+        addLog("Malformed delta: " + std::string(delta), LogLevel::Warning);
+        sendMessage("ADMIN", "RESYNC");
+        return;
+    }
+    decodeDeltaMove(static_cast<uint16_t>(wire), from, to, promotion);
 
-    // Mark that we have a move ready to send
-    _moveReady = true;
+    // a ponder search runs on its own copy, so the board can move under it
+    if (!_game->playEngineMove(from, to, promotion) || _game->positionHash() != hash) {
+        addLog("Board out of step with the director, asking for a resync", LogLevel::Warning);
+        cancelSearch();
+        sendMessage("ADMIN", "RESYNC");
+        return;
+    }
+    if (_pondering) {
+        _pondering = false;
+        _sentMove.clear();
+        const std::string budget = applyTimeBudget();
+        if (_game->ponderHit()) {
+            addLog("Ponder hit, searching on for " + budget);
+            _searchReplyTo = "ADMIN";
+            _searchIsTest = false;
+            _waitingForAI = true;
+            return;
+        }
+        addLog("Ponder miss");
+    }
+    launchSearch("ADMIN", false);
 }
 
-void TournamentClient::sendAIMove() {
-    if (_game == nullptr) {
-        addLog("ERROR: Game pointer is null");
+void TournamentClient::launchSearch(std::string_view replyTo, bool test) {
+    // Start the AI on a worker thread, update() sends the move when it is done
+    addLog("Running AI (" + applyTimeBudget() + ")...");
+    _searchReplyTo = replyTo;
+    _searchIsTest = test;
+    _sentMove.clear();
+    _waitingForAI = true;
+    // a comms test stays on this bot, the director times its answer
+    _clusterSearch = _coordinator != nullptr && !test;
+    if (_clusterSearch) {
+        // the helpers can't follow the time manager's limits, so the move gets the share it would aim for
+        const int moveTimeMs = _clock.remainingMs > 0 ? TimeManager::allocate(_clock.remainingMs, _clock.incrementMs, 0).softMs * 2 : _moveTimeMs;
+        _coordinator->start(_game->position(), moveTimeMs);
+        return;
+    }
+    // the move goes out from the search thread the moment it is chosen, update() only plays it on the
+    // board and logs it
+    _game->startAISearch([this](const BitMove& move) { sendSearchMove(move); });
+}
+
+std::string TournamentClient::applyTimeBudget() {
+    _game->setMoveTimeBudget(_moveTimeMs);
+    _game->setClock(_clock.remainingMs, _clock.incrementMs);
+    if (_clock.remainingMs > 0) {
+        return std::to_string(_clock.remainingMs) + "+" + std::to_string(_clock.incrementMs) + " ms on the clock";
+    }
+    return std::to_string(_moveTimeMs) + " ms";
+}
+
+void TournamentClient::sendSearchMove(const BitMove& move) {
+    if (_deltaMode && !_searchIsTest && move.piece != NoPiece) {
+        _sentMove = "M:";
+        appendHex(_sentMove, deltaMove(move), 4);
+    } else {
+        _sentMove = movePayload(move, _searchIsTest);
+    }
+    if (!sendBytes(_searchReplyTo + "|" + _sentMove + "\n")) {
+        _sendFailed.store(true);
+    }
+}
+
+void TournamentClient::pollSearch() {
+    if (_clusterSearch) {
+        if (_game == nullptr || !_coordinator->poll()) {
+            return;
+        }
+        _waitingForAI = false;
+        _clusterSearch = false;
+        const BitMove move = _coordinator->bestMove();
+        if (move.piece == NoPiece) {
+            addLog("WARNING: No valid move from the cluster", LogLevel::Warning);
+            sendMessage(_searchReplyTo, movePayload(move, _searchIsTest));
+            return;
+        }
+        sendSearchMove(move);
+        _game->playEngineMove(move.from, move.to, (move.flags & IsPromotion) ? (move.flags & PromotionPieceMask) >> 5 : -1);
+        addLog("Sent to " + _searchReplyTo + ": " + _sentMove);
+        addLog("Cluster: " + _coordinator->summary(), LogLevel::Debug);
+        return;
+    }
+    if (_game == nullptr || !_game->aiSearchFinished()) {
         return;
     }
+    _waitingForAI = false;
+    _game->playAISearchResult();
 
-    // Get the move calculated by AI
-    BitMove move = _game->getLastAIMove();
+    if (_sentMove.empty()) {
+        // there was no legal move, so no search ran to send one
+        addLog("WARNING: No valid move from AI", LogLevel::Warning);
+        sendMessage(_searchReplyTo, movePayload(BitMove(), _searchIsTest));
+        return;
+    }
+    addLog("Sent to " + _searchReplyTo + ": " + _sentMove);
+#ifdef CHESS_SEARCH_STATS
+    const SearchStats& stats = _game->lastSearchStats();
+    char line[160];
+    std::snprintf(line, sizeof(line), "Search: %llu nodes, %.0f nps, seldepth %d, TT hits %.1f%%, first move cutoffs %.1f%%",
+                  static_cast<unsigned long long>(stats.totalNodes()), stats.nps(), stats.seldepth,
+                  stats.ttHitRate() * 100, stats.firstMoveCutoffRate() * 100);
+    addLog(line, LogLevel::Debug);
+#endif
 
+    // keep thinking while the opponent does, on the reply the search expects
+    if (_ponder && !_searchIsTest && _game->startPondering([this](const BitMove& move) { sendSearchMove(move); })) {
+        _pondering = true;
+    }
+}
+
+void TournamentClient::stopSearch() {
+    if (_waitingForAI && _clusterSearch) {
+        addLog("Stopping search, sending the best move so far");
+        _coordinator->stop();
+    } else if (_waitingForAI && _game != nullptr) {
+        addLog("Stopping search, sending the best move so far");
+        _game->stopAISearch();
+    }
+}
+
+void TournamentClient::cancelSearch() {
+    if (_clusterSearch) {
+        _coordinator->cancel();
+    } else if ((_waitingForAI || _pondering) && _game != nullptr) {
+        _game->abandonAISearch();
+    }
+    _waitingForAI = false;
+    _pondering = false;
+    _clusterSearch = false;
+}
+
+void TournamentClient::setClusterHelpers(const std::vector<std::string>& helpers) {
+    cancelSearch();
+    if (helpers.empty()) {
+        _coordinator.reset();
+    } else {
+        if (!_coordinator) {
+            _coordinator = std::make_unique<ClusterCoordinator>(clusterEvaluator(), [this](const std::string& helper, const std::string& payload) {
+                if (!sendBytes(helper + "|" + payload + "\n")) {
+                    _sendFailed.store(true);
+                }
+            });
+            _coordinator->localSearch().setThreads(std::max(1u, std::thread::hardware_concurrency()));
+            _coordinator->localSearch().setLogLevel(LogLevel::Warning);
+        }
+        _coordinator->setHelpers(helpers);
+    }
+}
+
+void TournamentClient::setClusterHelper(bool enabled) {
+    if (!enabled) {
+        _clusterWorker.reset();
+    } else if (!_clusterWorker) {
+        _clusterWorker = std::make_unique<ClusterHelper>(clusterEvaluator());
+        _clusterWorker->search().setThreads(std::max(1u, std::thread::hardware_concurrency()));
+        _clusterWorker->search().setLogLevel(LogLevel::Warning);
+    }
+}
+
+void TournamentClient::handleWork(std::string_view sender, std::string_view work) {
+    if (!_clusterWorker) {
+        addLog("Ignoring cluster work from " + std::string(sender) + ", not a helper", LogLevel::Warning);
+        return;
+    }
+    if (work == "CANCEL") {
+        _clusterWorker->cancel();
+        return;
+    }
+    // the replies go out from the helper's threads, like the game's own moves from its search thread
+    const std::string prefix = std::string(sender) + "|";
+    if (!_clusterWorker->start(work, [this, prefix](const std::string& payload) {
+            if (!sendBytes(prefix + payload + "\n")) {
+                _sendFailed.store(true);
+            }
+        })) {
+        addLog("Malformed cluster work: " + std::string(work), LogLevel::Warning);
+    }
+}
+
+const ChessEval& TournamentClient::clusterEvaluator() {
+    if (!_clusterEvaluator) {
+        _clusterEvaluator = ChessEval::shared("resources/models/neural_final.bin");
+    }
+    return *_clusterEvaluator;
+}
+
+std::string TournamentClient::movePayload(const BitMove& move, bool test) const {
     if (move.piece == NoPiece) {
-        addLog("WARNING: No valid move from AI");
         // Send a forfeit or error message
-        sendMessage("ADMIN", "ERROR:NoValidMove");
-        return;
+        return test ? "TEST:ERROR:NoMove" : "ERROR:NoValidMove";
     }
 
     // Format: MOVE:srcIndex,dstIndex
-    std::string moveStr = "MOVE:" + std::to_string(static_cast<int>(move.from)) +
+    std::string moveStr = std::string(test ? "TEST:MOVE:" : "MOVE:") + std::to_string(static_cast<int>(move.from)) +
                           "," + std::to_string(static_cast<int>(move.to));
 
     // Add flags if needed (for promotion, etc.)
-    if (move.flags & IsPromotion) {
+    if (!test && (move.flags & IsPromotion)) {
         moveStr += ",PROMO";
     }
-
-    sendMessage("ADMIN", moveStr);
-    addLog("Sent move: " + moveStr);
+    return moveStr;
 }
 
 #endif // TOURNAMENT_IMPLEMENTATION
@@ -538,6 +1085,10 @@ void TournamentClient::sendAIMove() {
  * ==============
  * Extended tournament client for the Director (teacher) role.
  * Manages game flow, validates moves, and orchestrates matches.
+ *
+ * Any number of matches run at once, each keyed by its pair of bots and checked against its own
+ * headless GameState, so a round of the round robin takes as long as its longest game. Messages are
+ * routed to a match by their sender. The Chess board only displays the match being watched.
  */
 class DirectorClient : public TournamentClient {
 public:
@@ -548,20 +1099,33 @@ public:
         bool isWhiteTurn;
         std::string result;  // "", "WHITE", "BLACK", "DRAW"
         std::vector<std::string> moveHistory;
+        GameState position;  // what the moves are validated against, with the full game history
+        BitMove lastMove;
+        bool whiteSynced;    // in delta mode, the bot has this game's board and is sent moves only
+        bool blackSynced;
+        int clockMs[2];      // white's and black's time left, on a time control
+        std::chrono::steady_clock::time_point turnStart;  // when the side to move was sent the position
     };
 
     // Comms check status for each bot
     struct CommsStatus {
         bool pingReceived;
         bool moveTestPassed;
+        bool deltaProtocol;  // accepted PROTO:DELTA
         std::string lastTestTime;
     };
 
 private:
-    MatchInfo _match;
+    std::map<std::string, MatchInfo> _matches;      // by matchKey, finished ones stay until their pair plays again
+    std::map<std::string, std::string> _botMatch;   // bot name to the key of the match it is playing
+    std::string _watchedMatch;                      // the match shown on the board
     std::vector<std::string> _connectedBots;
     std::vector<std::string> _previousBots;  // Track previous list to detect new bots
     std::map<std::string, CommsStatus> _commsStatus;
+    int _timeControlMs = 0;     // every bot's clock at the start of a match, 0 for no clock
+    int _timeIncrementMs = 0;
+
+    static constexpr const char* STARTING_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
 public:
     /**
@@ -570,29 +1134,52 @@ public:
     DirectorClient(Chess* game)
         : TournamentClient(game, "ADMIN")
     {
-        _match.gameInProgress = false;
-        _match.isWhiteTurn = true;
-
         // Set up message handler for Director
-        setMessageCallback([this](const std::string& sender, const std::string& payload) {
+        setMessageCallback([this](std::string_view sender, std::string_view payload) {
             handleBotMessage(sender, payload);
         });
     }
 
     /**
-     * Start a new match between two bots
+     * Bot names can't contain '|', the protocol's separator, so this never joins two pairs into one key
+     */
+    static std::string matchKey(const std::string& whiteBotName, const std::string& blackBotName) {
+        return whiteBotName + "|" + blackBotName;
+    }
+
+    /**
+     * Start a new match between two bots, alongside any already running
+     * @return false if either bot is still playing another match
      */
     bool startMatch(const std::string& whiteBotName, const std::string& blackBotName);
 
     /**
-     * Send FEN to the current player's bot
+     * Start every match of one round of a round robin among the connected bots, by the circle method:
+     * rounds 0 to N-2 (N rounded up to even, the odd bot out sits the round out) pair every bot with
+     * every other once, alternating colours
+     * @return Number of matches started
      */
-    void sendFENToCurrentPlayer();
+    int startRound(int round);
+
+    /**
+     * Play the matches started from now on with a clock for each bot, sent along with every position
+     * @param baseMs Each bot's time for the game, 0 (the default) for no clock: bots use their own move time
+     * @param incrementMs Added to a bot's clock after each of its moves
+     */
+    void setTimeControl(int baseMs, int incrementMs) {
+        _timeControlMs = baseMs;
+        _timeIncrementMs = incrementMs;
+    }
+
+    /**
+     * Send FEN to the bot whose turn it is in a match
+     */
+    void sendFENToCurrentPlayer(MatchInfo& match);
 
     /**
      * Handle incoming move from a bot
      */
-    void handleBotMessage(const std::string& sender, const std::string& payload);
+    void handleBotMessage(std::string_view sender, std::string_view payload);
 
     /**
      * Run comms check on a specific bot
@@ -600,68 +1187,158 @@ public:
     void runCommsCheck(const std::string& botName);
 
     /**
-     * Validate and apply a move
+     * Validate and apply a move to a match's position
+     */
+    bool validateAndApplyMove(MatchInfo& match, int srcIndex, int dstIndex, int promotion = -1);
+
+    /**
+     * Manually override/fix game state of a match (for Director use)
      */
-    bool validateAndApplyMove(int srcIndex, int dstIndex);
+    void manualMove(const std::string& key, int srcIndex, int dstIndex);
 
     /**
-     * Manually override/fix game state (for Director use)
+     * End a match and tell both bots
      */
-    void manualMove(int srcIndex, int dstIndex);
+    void endMatch(MatchInfo& match, const std::string& result);
 
     /**
-     * End the current match
+     * Show a match on the board, it follows the match's moves from then on
      */
-    void endMatch(const std::string& result);
+    void watchMatch(const std::string& key);
 
     // Getters
-    const MatchInfo& getMatchInfo() const { return _match; }
+    const std::map<std::string, MatchInfo>& getMatches() const { return _matches; }
+    const MatchInfo* findMatch(const std::string& key) const {
+        auto it = _matches.find(key);
+        return it != _matches.end() ? &it->second : nullptr;
+    }
+    size_t activeMatchCount() const { return _botMatch.size() / 2; }
+    bool isGameInProgress() const { return !_botMatch.empty(); }
+    const std::string& getWatchedMatch() const { return _watchedMatch; }
     const std::vector<std::string>& getConnectedBots() const { return _connectedBots; }
-    bool isGameInProgress() const { return _match.gameInProgress; }
     const std::map<std::string, CommsStatus>& getCommsStatus() const { return _commsStatus; }
     bool isBotVerified(const std::string& botName) const {
         auto it = _commsStatus.find(botName);
         return it != _commsStatus.end() && it->second.pingReceived && it->second.moveTestPassed;
     }
+
+private:
+    /**
+     * After a move: ends the match on mate, stalemate, repetition or the fifty move rule
+     * @return true if the match is over
+     */
+    bool checkMatchOver(MatchInfo& match);
+
+    /**
+     * On a time control, take the time the side to move took off its clock and add the increment
+     * @return false if it ran out, the match is over
+     */
+    bool chargeClock(MatchInfo& match);
+
+    /**
+     * Copy the watched match's position to the board
+     */
+    void showMatch(const MatchInfo& match);
 };
 
 #ifdef TOURNAMENT_IMPLEMENTATION
 
 bool DirectorClient::startMatch(const std::string& whiteBotName, const std::string& blackBotName) {
-    if (!isConnected()) {
+    if (!isConnected() || whiteBotName == blackBotName) {
         return false;
     }
-
-    // Reset game state
-    if (_game != nullptr) {
-        _game->stopGame();
-        _game->setUpBoard();
+    if (_botMatch.count(whiteBotName) || _botMatch.count(blackBotName)) {
+        addLog("Cannot start " + whiteBotName + " vs " + blackBotName + " - a bot is still playing");
+        return false;
     }
 
-    _match.whiteBotName = whiteBotName;
-    _match.blackBotName = blackBotName;
-    _match.gameInProgress = true;
-    _match.isWhiteTurn = true;
-    _match.result = "";
-    _match.moveHistory.clear();
+    const std::string key = matchKey(whiteBotName, blackBotName);
+    MatchInfo& match = _matches[key];
+    match.whiteBotName = whiteBotName;
+    match.blackBotName = blackBotName;
+    match.gameInProgress = true;
+    match.isWhiteTurn = true;
+    match.result = "";
+    match.moveHistory.clear();
+    match.position.loadFEN(STARTING_FEN);
+    match.lastMove = BitMove();
+    match.whiteSynced = false;
+    match.blackSynced = false;
+    match.clockMs[0] = match.clockMs[1] = _timeControlMs;
+    _botMatch[whiteBotName] = key;
+    _botMatch[blackBotName] = key;
 
     addLog("Starting match: " + whiteBotName + " (White) vs " + blackBotName + " (Black)");
 
+    // the first match started is the one on the board until the director picks another
+    const MatchInfo* watched = findMatch(_watchedMatch);
+    if (watched == nullptr || !watched->gameInProgress || _watchedMatch == key) {
+        watchMatch(key);
+    }
+
     // Send initial FEN to white
-    sendFENToCurrentPlayer();
+    sendFENToCurrentPlayer(match);
 
     return true;
 }
 
-void DirectorClient::sendFENToCurrentPlayer() {
-    if (_game == nullptr || !_match.gameInProgress) {
-        return;
+int DirectorClient::startRound(int round) {
+    std::vector<std::string> bots = _connectedBots;
+    if (bots.size() < 2) {
+        return 0;
+    }
+    if (bots.size() % 2) {
+        bots.emplace_back();  // the bye
     }
+    const int count = static_cast<int>(bots.size());
+    round %= count - 1;
 
-    std::string fen = _game->getFEN();
-    std::string targetBot = _match.isWhiteTurn ? _match.whiteBotName : _match.blackBotName;
+    // bot 0 stays put and the others turn round it one place per round
+    auto seat = [&](int position) -> const std::string& {
+        return position == 0 ? bots[0] : bots[1 + (position - 1 + round) % (count - 1)];
+    };
+    int started = 0;
+    for (int i = 0; i < count / 2; i++) {
+        const std::string& first = seat(i);
+        const std::string& second = seat(count - 1 - i);
+        if (first.empty() || second.empty()) {
+            continue;
+        }
+        // alternate colours between rounds, and along the table for the fixed seat
+        const bool swap = (i == 0) ? (round & 1) : (i & 1);
+        if (swap ? startMatch(second, first) : startMatch(first, second)) {
+            started++;
+        }
+    }
+    addLog("Round " + std::to_string(round + 1) + ": " + std::to_string(started) + " match(es) started");
+    return started;
+}
+
+void DirectorClient::sendFENToCurrentPlayer(MatchInfo& match) {
+    if (!match.gameInProgress) {
+        return;
+    }
 
-    sendMessage(targetBot, "FEN:" + fen);
+    const std::string& targetBot = match.isWhiteTurn ? match.whiteBotName : match.blackBotName;
+    bool& synced = match.isWhiteTurn ? match.whiteSynced : match.blackSynced;
+    auto status = _commsStatus.find(targetBot);
+    const bool delta = status != _commsStatus.end() && status->second.deltaProtocol;
+
+    // a bot in delta mode that has the board only needs the move played since its own
+    std::string payload;
+    if (delta && synced && match.lastMove.piece != NoPiece) {
+        payload = "D:";
+        appendHex(payload, deltaMove(match.lastMove), 4);
+        appendHex(payload, match.position.getZobristHash(), 16);
+    } else {
+        synced = delta;
+        payload = "FEN:" + match.position.toFEN();
+    }
+    if (_timeControlMs > 0) {
+        appendClock(payload, Clock{ match.clockMs[match.isWhiteTurn ? 0 : 1], _timeIncrementMs });
+    }
+    match.turnStart = std::chrono::steady_clock::now();
+    sendMessage(targetBot, payload);
 }
 
 void DirectorClient::runCommsCheck(const std::string& botName) {
@@ -672,7 +1349,7 @@ void DirectorClient::runCommsCheck(const std::string& botName) {
     addLog(">>> Running comms check for: " + botName);
 
     // Initialize status
-    _commsStatus[botName] = CommsStatus{false, false, ""};
+    _commsStatus[botName] = CommsStatus{false, false, false, ""};
 
     // Get current time
     auto now = std::chrono::system_clock::now();
@@ -686,19 +1363,34 @@ void DirectorClient::runCommsCheck(const std::string& botName) {
 
     // Send test FEN (a simple position where there are obvious moves)
     sendMessage(botName, "TEST:FEN:rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+
+    // Offer delta mode, bots that don't know it just ignore this
+    sendMessage(botName, "PROTO:DELTA");
 }
 
-void DirectorClient::handleBotMessage(const std::string& sender, const std::string& payload) {
+// "src,dst" as sent in MOVE: and TEST:MOVE:, anything after dst (",PROMO") is ignored
+static bool parseMoveSquares(std::string_view text, int& src, int& dst) {
+    const char* end = text.data() + text.size();
+    auto [afterSrc, srcError] = std::from_chars(text.data(), end, src);
+    if (srcError != std::errc() || afterSrc == end || *afterSrc != ',') {
+        return false;
+    }
+    auto [afterDst, dstError] = std::from_chars(afterSrc + 1, end, dst);
+    return dstError == std::errc();
+}
+
+void DirectorClient::handleBotMessage(std::string_view sender, std::string_view payload) {
     // Track connected bots from server updates
-    if (sender == "SERVER" && payload.substr(0, 8) == "CLIENTS:") {
+    if (sender == "SERVER" && payload.starts_with("CLIENTS:")) {
         _previousBots = _connectedBots;  // Save previous list
         _connectedBots.clear();
-        std::string clients = payload.substr(8);
-        std::stringstream ss(clients);
-        std::string bot;
-        while (std::getline(ss, bot, ',')) {
+        std::string_view clients = payload.substr(8);
+        while (!clients.empty()) {
+            size_t comma = clients.find(',');
+            std::string_view bot = clients.substr(0, comma);
+            clients = comma == std::string_view::npos ? std::string_view() : clients.substr(comma + 1);
             if (!bot.empty() && bot != "ADMIN") {
-                _connectedBots.push_back(bot);
+                _connectedBots.emplace_back(bot);
             }
         }
 
@@ -710,129 +1402,215 @@ void DirectorClient::handleBotMessage(const std::string& sender, const std::stri
                 runCommsCheck(bot);
             }
         }
+
+        // a bot that left forfeits the match it was playing
+        for (auto& [key, match] : _matches) {
+            if (!match.gameInProgress) {
+                continue;
+            }
+            const bool whiteGone = std::find(_connectedBots.begin(), _connectedBots.end(), match.whiteBotName) == _connectedBots.end();
+            const bool blackGone = std::find(_connectedBots.begin(), _connectedBots.end(), match.blackBotName) == _connectedBots.end();
+            if (whiteGone || blackGone) {
+                addLog("*** " + (whiteGone ? match.whiteBotName : match.blackBotName) + " DISCONNECTED, match forfeited ***");
+                endMatch(match, whiteGone && blackGone ? "DRAW" : whiteGone ? "BLACK" : "WHITE");
+            }
+        }
         return;
     }
 
+    // the comms checks are rare, only they need the name as a map key
+    const std::string botName = payload.starts_with("TEST:") ? std::string(sender) : std::string();
+
     // Handle comms check PONG response
     if (payload == "TEST:PONG") {
-        _commsStatus[sender].pingReceived = true;
-        addLog("<<< PING OK from " + sender);
+        _commsStatus[botName].pingReceived = true;
+        addLog("<<< PING OK from " + botName);
         return;
     }
 
     // Handle comms check MOVE response
-    if (payload.substr(0, 10) == "TEST:MOVE:") {
-        std::string moveData = payload.substr(10);
+    if (payload.starts_with("TEST:MOVE:")) {
         int src = -1, dst = -1;
-        if (sscanf(moveData.c_str(), "%d,%d", &src, &dst) == 2) {
-            _commsStatus[sender].moveTestPassed = true;
-            addLog("<<< MOVE TEST OK from " + sender + " (move: " + std::to_string(src) + "->" + std::to_string(dst) + ")");
-            addLog("*** " + sender + " COMMS CHECK PASSED ***");
+        if (parseMoveSquares(payload.substr(10), src, dst)) {
+            _commsStatus[botName].moveTestPassed = true;
+            addLog("<<< MOVE TEST OK from " + botName + " (move: " + std::to_string(src) + "->" + std::to_string(dst) + ")");
+            addLog("*** " + botName + " COMMS CHECK PASSED ***");
         }
         return;
     }
 
     // Handle comms check error
-    if (payload.substr(0, 11) == "TEST:ERROR:") {
-        _commsStatus[sender].moveTestPassed = false;
-        addLog("<<< MOVE TEST FAILED from " + sender + ": " + payload.substr(11));
+    if (payload.starts_with("TEST:ERROR:")) {
+        _commsStatus[botName].moveTestPassed = false;
+        addLog("<<< MOVE TEST FAILED from " + botName + ": " + std::string(payload.substr(11)), LogLevel::Warning);
+        return;
+    }
+
+    // Delta mode accepted, it is used from the bot's next game on
+    if (payload == "PROTO:DELTA") {
+        _commsStatus[std::string(sender)].deltaProtocol = true;
+        addLog("<<< " + std::string(sender) + " uses delta mode");
+        return;
+    }
+
+    // A delta bot lost track of the board, the next position it gets is a full FEN
+    if (payload == "RESYNC") {
+        auto playing = _botMatch.find(std::string(sender));
+        if (playing != _botMatch.end()) {
+            MatchInfo& match = _matches[playing->second];
+            const bool white = sender == match.whiteBotName;
+            (white ? match.whiteSynced : match.blackSynced) = false;
+            addLog("Resync for " + std::string(sender));
+            if (white == match.isWhiteTurn) {
+                sendFENToCurrentPlayer(match);
+            }
+        }
         return;
     }
 
     // Handle move from bot (game moves, not test moves)
-    if (payload.substr(0, 5) == "MOVE:") {
-        if (!_match.gameInProgress) {
-            addLog("Ignoring move from " + sender + " - no game in progress");
+    if (payload.starts_with("MOVE:") || payload.starts_with("M:")) {
+        const std::string mover(sender);
+        auto playing = _botMatch.find(mover);
+        if (playing == _botMatch.end()) {
+            addLog("Ignoring move from " + mover + " - not in a game");
             return;
         }
+        MatchInfo& match = _matches[playing->second];
 
         // Check if it's from the correct bot
-        std::string expectedBot = _match.isWhiteTurn ? _match.whiteBotName : _match.blackBotName;
-        if (sender != expectedBot) {
-            addLog("Ignoring move from " + sender + " - expected " + expectedBot);
+        const std::string& expectedBot = match.isWhiteTurn ? match.whiteBotName : match.blackBotName;
+        if (mover != expectedBot) {
+            addLog("Ignoring move from " + mover + " - expected " + expectedBot);
             return;
         }
 
-        // Parse MOVE:src,dst
-        std::string moveData = payload.substr(5);
-        int src = -1, dst = -1;
-        if (sscanf(moveData.c_str(), "%d,%d", &src, &dst) == 2) {
-            addLog("Received move from " + sender + ": " + std::to_string(src) + " -> " + std::to_string(dst));
-
-            if (validateAndApplyMove(src, dst)) {
-                // Check for game end
-                if (_game != nullptr) {
-                    Player* winner = _game->checkForWinner();
-                    if (winner) {
-                        endMatch(winner->playerNumber() == 0 ? "WHITE" : "BLACK");
-                        return;
-                    }
-                    if (_game->checkForDraw()) {
-                        endMatch("DRAW");
-                        return;
-                    }
+        // Parse MOVE:src,dst or M:<delta move>
+        int src = -1, dst = -1, promotion = -1;
+        uint64_t wire = 0;
+        const bool parsed = payload[0] == 'M' && payload[1] == ':'
+            ? payload.size() == 6 && parseHex(payload.substr(2), wire)
+            : parseMoveSquares(payload.substr(5), src, dst);
+        if (parsed) {
+            if (payload[1] == ':') {
+                decodeDeltaMove(static_cast<uint16_t>(wire), src, dst, promotion);
+            }
+            addLog("Received move from " + expectedBot + ": " + std::to_string(src) + " -> " + std::to_string(dst));
+
+            if (validateAndApplyMove(match, src, dst, promotion)) {
+                if (!chargeClock(match) || checkMatchOver(match)) {
+                    return;
                 }
 
                 // Switch turns and send FEN to next player
-                _match.isWhiteTurn = !_match.isWhiteTurn;
-                sendFENToCurrentPlayer();
+                match.isWhiteTurn = !match.isWhiteTurn;
+                sendFENToCurrentPlayer(match);
             } else {
-                addLog("!!! ILLEGAL MOVE from " + sender + ": " + std::to_string(src) + " -> " + std::to_string(dst));
+                addLog("!!! ILLEGAL MOVE from " + expectedBot + ": " + std::to_string(src) + " -> " + std::to_string(dst), LogLevel::Warning);
             }
         }
     }
     // Handle errors from bots
-    else if (payload.substr(0, 6) == "ERROR:") {
-        addLog("Error from " + sender + ": " + payload.substr(6));
+    else if (payload.starts_with("ERROR:")) {
+        addLog("Error from " + std::string(sender) + ": " + std::string(payload.substr(6)), LogLevel::Warning);
     }
 }
 
-bool DirectorClient::validateAndApplyMove(int srcIndex, int dstIndex) {
-    if (_game == nullptr) {
+bool DirectorClient::validateAndApplyMove(MatchInfo& match, int srcIndex, int dstIndex, int promotion) {
+    // MOVE: doesn't name the promotion piece, the generator lists the queen first
+    MoveList moves;
+    match.position.generateAllMoves(moves);
+    auto legal = std::find_if(moves.begin(), moves.end(), [=](const BitMove& move) {
+        return move.from == srcIndex && move.to == dstIndex &&
+               (promotion < 0 || !(move.flags & IsPromotion) || ((move.flags & PromotionPieceMask) >> 5) == promotion);
+    });
+    if (legal == moves.end()) {
         return false;
     }
 
-    // Get the source and destination holders
-    int srcX = srcIndex & 7;
-    int srcY = srcIndex / 8;
-    int dstX = dstIndex & 7;
-    int dstY = dstIndex / 8;
+    // Apply the move
+    match.position.pushMove(*legal);
+    match.lastMove = *legal;
 
-    BitHolder& src = _game->getHolderAt(srcX, srcY);
-    BitHolder& dst = _game->getHolderAt(dstX, dstY);
+    // Record move
+    match.moveHistory.push_back(std::to_string(srcIndex) + "-" + std::to_string(dstIndex));
 
-    Bit* piece = src.bit();
-    if (piece == nullptr) {
-        return false;
+    if (matchKey(match.whiteBotName, match.blackBotName) == _watchedMatch) {
+        showMatch(match);
     }
+    return true;
+}
 
-    // Validate using the game's move validation
-    if (!_game->canBitMoveFromTo(*piece, src, dst)) {
-        return false;
+bool DirectorClient::checkMatchOver(MatchInfo& match) {
+    MoveList moves;
+    match.position.generateAllMoves(moves);
+    if (moves.empty()) {
+        // the side that just moved mated, unless this is stalemate
+        if (match.position.isInCheck()) {
+            endMatch(match, match.isWhiteTurn ? "WHITE" : "BLACK");
+        } else {
+            endMatch(match, "DRAW");
+        }
+        return true;
     }
+    if (match.position.repetitions(2) >= 2 || match.position.fiftyMoveRuleReached()) {
+        endMatch(match, "DRAW");
+        return true;
+    }
+    return false;
+}
 
-    // Apply the move
-    dst.dropBitAtPoint(piece, ImVec2(0, 0));
-    src.setBit(nullptr);
-    _game->bitMovedFromTo(*piece, src, dst);
-
-    // Record move
-    _match.moveHistory.push_back(std::to_string(srcIndex) + "-" + std::to_string(dstIndex));
-
+bool DirectorClient::chargeClock(MatchInfo& match) {
+    if (_timeControlMs <= 0) {
+        return true;
+    }
+    int& clock = match.clockMs[match.isWhiteTurn ? 0 : 1];
+    const auto spent = std::chrono::steady_clock::now() - match.turnStart;
+    clock -= static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(spent).count());
+    if (clock < 0) {
+        addLog((match.isWhiteTurn ? match.whiteBotName : match.blackBotName) + " lost on time");
+        endMatch(match, match.isWhiteTurn ? "BLACK" : "WHITE");
+        return false;
+    }
+    clock += _timeIncrementMs;
     return true;
 }
 
-void DirectorClient::manualMove(int srcIndex, int dstIndex) {
-    validateAndApplyMove(srcIndex, dstIndex);
+void DirectorClient::manualMove(const std::string& key, int srcIndex, int dstIndex) {
+    auto it = _matches.find(key);
+    if (it != _matches.end() && validateAndApplyMove(it->second, srcIndex, dstIndex)) {
+        // neither bot saw this move, so both get a full FEN next
+        it->second.whiteSynced = false;
+        it->second.blackSynced = false;
+    }
 }
 
-void DirectorClient::endMatch(const std::string& result) {
-    _match.result = result;
-    _match.gameInProgress = false;
+void DirectorClient::endMatch(MatchInfo& match, const std::string& result) {
+    match.result = result;
+    match.gameInProgress = false;
+    _botMatch.erase(match.whiteBotName);
+    _botMatch.erase(match.blackBotName);
+
+    addLog("Match over: " + match.whiteBotName + " vs " + match.blackBotName + " - " + result);
 
     // Notify both bots
-    sendMessage(_match.whiteBotName, "GAMEOVER:" + result);
-    sendMessage(_match.blackBotName, "GAMEOVER:" + result);
+    sendMessage(match.whiteBotName, "GAMEOVER:" + result);
+    sendMessage(match.blackBotName, "GAMEOVER:" + result);
+}
+
+void DirectorClient::watchMatch(const std::string& key) {
+    const MatchInfo* match = findMatch(key);
+    if (match == nullptr) {
+        return;
+    }
+    _watchedMatch = key;
+    showMatch(*match);
+}
+
+void DirectorClient::showMatch(const MatchInfo& match) {
+    if (_game != nullptr) {
+        _game->setBoardFromFEN(match.position.toFEN());
+    }
 }
 
 #endif // TOURNAMENT_IMPLEMENTATION
@@ -0,0 +1,130 @@
+#include "Trace.h"
+
+#ifdef CHESS_TRACE
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace {
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::vector<TraceBuffer*> idleBuffers;  // left by threads that have finished
+
+    // hands the thread's buffer back when the thread ends
+    struct ThreadBufferLease {
+        TraceBuffer* buffer = nullptr;
+        ~ThreadBufferLease() {
+            if (buffer) {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                idleBuffers.push_back(buffer);
+            }
+        }
+    };
+
+    thread_local ThreadBufferLease threadLease;
+
+    TraceBuffer* leaseBuffer()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (!idleBuffers.empty()) {
+            TraceBuffer* buffer = idleBuffers.back();
+            idleBuffers.pop_back();
+            return buffer;
+        }
+        buffers.push_back(std::make_unique<TraceBuffer>(static_cast<int>(buffers.size()) + 1));
+        return buffers.back().get();
+    }
+
+    void writeEscaped(std::FILE* out, const char* text)
+    {
+        std::fputc('"', out);
+        for (; *text; text++) {
+            if (*text == '"' || *text == '\\') {
+                std::fputc('\\', out);
+            }
+            std::fputc(*text, out);
+        }
+        std::fputc('"', out);
+    }
+}
+
+TraceBuffer& Trace::threadBuffer()
+{
+    if (!threadLease.buffer) {
+        threadLease.buffer = leaseBuffer();
+    }
+    return *threadLease.buffer;
+}
+
+bool Trace::writeChromeTrace(const std::string& path)
+{
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    if (!out) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    // times from the oldest zone still held, Chrome wants microseconds
+    int64_t origin = INT64_MAX;
+    for (const auto& buffer : buffers) {
+        const uint64_t written = buffer->_written.load(std::memory_order_acquire);
+        const uint64_t held = std::min<uint64_t>(written, TRACE_EVENTS_PER_THREAD);
+        for (uint64_t i = written - held; i < written; i++) {
+            origin = std::min(origin, buffer->_events[i % TRACE_EVENTS_PER_THREAD].startNs);
+        }
+    }
+
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& buffer : buffers) {
+        std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", buffer->_id);
+        writeEscaped(out, buffer->_name);
+        std::fprintf(out, "}}");
+        first = false;
+
+        const uint64_t written = buffer->_written.load(std::memory_order_acquire);
+        const uint64_t held = std::min<uint64_t>(written, TRACE_EVENTS_PER_THREAD);
+        for (uint64_t i = written - held; i < written; i++) {
+            const TraceEvent& event = buffer->_events[i % TRACE_EVENTS_PER_THREAD];
+            std::fprintf(out, ",\n{\"name\":");
+            writeEscaped(out, event.name);
+            std::fprintf(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", buffer->_id,
+                         (event.startNs - origin) / 1000.0, (event.endNs - event.startNs) / 1000.0);
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+    return std::fclose(out) == 0;
+}
+
+void Trace::clear()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : buffers) {
+        buffer->_written.store(0, std::memory_order_release);
+    }
+}
+
+uint64_t Trace::recorded()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t total = 0;
+    for (const auto& buffer : buffers) {
+        total += std::min<uint64_t>(buffer->_written.load(std::memory_order_relaxed), TRACE_EVENTS_PER_THREAD);
+    }
+    return total;
+}
+
+uint64_t Trace::overwritten()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t total = 0;
+    for (const auto& buffer : buffers) {
+        const uint64_t written = buffer->_written.load(std::memory_order_relaxed);
+        total += written - std::min<uint64_t>(written, TRACE_EVENTS_PER_THREAD);
+    }
+    return total;
+}
+
+#endif
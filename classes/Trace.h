@@ -0,0 +1,106 @@
+#pragma once
+
+//
+// Scoped timeline zones, for seeing where the time of a move or a frame goes
+// TRACE_ZONE("name") at the top of a scope records when the scope was entered and left; the name must
+// be a string literal. What happens to the zones is chosen when building:
+//   CHESS_TRACE        each thread appends to a ring of its own, no lock and no allocation after the
+//                      first zone, and Trace::writeChromeTrace writes every ring out as Chrome trace
+//                      JSON for chrome://tracing or ui.perfetto.dev. A full ring overwrites its oldest
+//                      zones, so the file holds the last TRACE_EVENTS_PER_THREAD zones of each thread.
+//   CHESS_TRACE_TRACY  the zones go to a running Tracy profiler instead, TRACE_FRAME marks its frames
+//   neither            every macro expands to nothing, so the zones cost nothing at all
+// TRACE_THREAD("name") names the calling thread's row in the timeline.
+//
+
+#if defined(CHESS_TRACE_TRACY)
+
+#include <tracy/Tracy.hpp>
+
+#define TRACE_ZONE(name) ZoneScopedN(name)
+#define TRACE_THREAD(name) tracy::SetThreadName(name)
+#define TRACE_FRAME() FrameMark
+
+#elif defined(CHESS_TRACE)
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+constexpr size_t TRACE_EVENTS_PER_THREAD = size_t(1) << 20;    // 24 MB a thread
+
+struct TraceEvent {
+    const char* name;
+    int64_t startNs;
+    int64_t endNs;
+};
+
+// One thread's zones. A buffer outlives its thread: the next thread to start takes it over, with
+// what it holds, so there are only ever as many buffers as threads running at once
+class TraceBuffer {
+public:
+    explicit TraceBuffer(int id) : _id(id), _name("thread"), _written(0) {}
+
+    void record(const char* name, int64_t startNs, int64_t endNs) {
+        if (!_events) {
+            _events = std::make_unique<TraceEvent[]>(TRACE_EVENTS_PER_THREAD);
+        }
+        const uint64_t written = _written.load(std::memory_order_relaxed);
+        _events[written % TRACE_EVENTS_PER_THREAD] = TraceEvent{ name, startNs, endNs };
+        _written.store(written + 1, std::memory_order_release);
+    }
+
+private:
+    friend class Trace;
+
+    const int _id;
+    const char* _name;
+    std::unique_ptr<TraceEvent[]> _events;
+    std::atomic<uint64_t> _written;     // ever, the ring holds the last TRACE_EVENTS_PER_THREAD of them
+};
+
+class Trace {
+public:
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static TraceBuffer& threadBuffer();
+    static void nameThread(const char* name) { threadBuffer()._name = name; }
+
+    // Both read every thread's ring, which the threads may be writing into; call them while the
+    // traced threads are quiet (between moves, at exit) or a zone being written can come out torn
+    static bool writeChromeTrace(const std::string& path);
+    static void clear();
+
+    static uint64_t recorded();     // zones in the rings now
+    static uint64_t overwritten();  // zones the rings lost to newer ones since the last clear
+};
+
+class TraceZone {
+public:
+    explicit TraceZone(const char* name) : _name(name), _start(Trace::now()) {}
+    ~TraceZone() { Trace::threadBuffer().record(_name, _start, Trace::now()); }
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* _name;
+    int64_t _start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD(name) Trace::nameThread(name)
+#define TRACE_FRAME() ((void)0)
+
+#else
+
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#define TRACE_FRAME() ((void)0)
+
+#endif
@@ -0,0 +1,275 @@
+#include "TrainingData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+namespace {
+    // indexed by the 4 bit code, the unused codes decode as empty squares
+    const char PIECE_CODES[] = "0PNBRQKpnbrqk000";
+
+    // piece character to its 4 bit code, 0 for anything that isn't a piece
+    int pieceCode(char piece)
+    {
+        const char* found = (piece != 0 && piece != '0') ? std::strchr(PIECE_CODES + 1, piece) : nullptr;
+        return found ? static_cast<int>(found - PIECE_CODES) : 0;
+    }
+
+    const char* skipSpaces(const char* text)
+    {
+        while (*text == ' ' || *text == '\t') {
+            text++;
+        }
+        return text;
+    }
+}
+
+PackedPosition packPosition(const TrainingSample& sample)
+{
+    PackedPosition packed = {};
+    for (int square = 0; square < 64; square += 2) {
+        packed.squares[square / 2] = static_cast<uint8_t>(pieceCode(sample.state[square]) | (pieceCode(sample.state[square + 1]) << 4));
+    }
+    const PositionContext& context = sample.context;
+    packed.flags = static_cast<uint8_t>((context.whiteToMove ? PackedWhiteToMove : 0) |
+                                        (context.whiteCastleKingside ? PackedWhiteCastleKingside : 0) |
+                                        (context.whiteCastleQueenside ? PackedWhiteCastleQueenside : 0) |
+                                        (context.blackCastleKingside ? PackedBlackCastleKingside : 0) |
+                                        (context.blackCastleQueenside ? PackedBlackCastleQueenside : 0));
+    packed.eval = static_cast<int16_t>(std::max(-32767, std::min(32767, sample.target)));
+    if (sample.hasResult) {
+        packed.result = static_cast<uint8_t>(sample.result > 0 ? PackedWhiteWin : sample.result < 0 ? PackedBlackWin : PackedDraw);
+    }
+    return packed;
+}
+
+void unpackPosition(const PackedPosition& packed, TrainingSample& sample)
+{
+    for (int square = 0; square < 64; square += 2) {
+        const uint8_t pair = packed.squares[square / 2];
+        sample.state[square] = PIECE_CODES[pair & 15];
+        sample.state[square + 1] = PIECE_CODES[pair >> 4];
+    }
+    sample.context.whiteToMove = (packed.flags & PackedWhiteToMove) != 0;
+    sample.context.whiteCastleKingside = (packed.flags & PackedWhiteCastleKingside) != 0;
+    sample.context.whiteCastleQueenside = (packed.flags & PackedWhiteCastleQueenside) != 0;
+    sample.context.blackCastleKingside = (packed.flags & PackedBlackCastleKingside) != 0;
+    sample.context.blackCastleQueenside = (packed.flags & PackedBlackCastleQueenside) != 0;
+    sample.target = packed.eval;
+    sample.hasResult = packed.result != PackedResultUnknown;
+    sample.result = packed.result == PackedWhiteWin ? 1 : packed.result == PackedBlackWin ? -1 : 0;
+}
+
+int blendedTarget(const TrainingSample& sample, float lambda)
+{
+    if (!sample.hasResult || lambda >= 1.0f || std::abs(sample.target) >= TRAINING_MATE_EVAL) {
+        return sample.target;
+    }
+    // a sure result would be an infinite evaluation, so the probability is kept off 0 and 1 (about 1200 cp)
+    const double probability = 1.0 / (1.0 + std::pow(10.0, -sample.target / 400.0));
+    const double blended = std::max(0.001, std::min(0.999, lambda * probability + (1.0 - lambda) * (sample.result + 1) / 2.0));
+    return static_cast<int>(std::lround(400.0 * std::log10(blended / (1.0 - blended))));
+}
+
+// FEN ranks run from 8 down to 1, the state array from a1 up
+bool parseFEN(const char* fen, char* state, PositionContext& context, const char** end)
+{
+    std::memset(state, '0', 64);
+    context = PositionContext();
+
+    const char* text = skipSpaces(fen);
+    int rank = 7;
+    int file = 0;
+    for (; *text && *text != ' ' && *text != '\t'; text++) {
+        const char ch = *text;
+        if (ch == '/') {
+            if (file != 8 || rank == 0) return false;
+            rank--;
+            file = 0;
+        } else if (ch >= '1' && ch <= '8') {
+            file += ch - '0';
+            if (file > 8) return false;
+        } else if (pieceCode(ch) != 0 && file < 8) {
+            state[rank * 8 + file] = ch;
+            file++;
+        } else {
+            return false;
+        }
+    }
+    if (rank != 0 || file != 8) return false;
+
+    text = skipSpaces(text);
+    if (*text == 'w' || *text == 'b') {
+        context.whiteToMove = (*text == 'w');
+        text = skipSpaces(text + 1);
+        for (; *text && *text != ' ' && *text != '\t' && *text != ','; text++) {
+            switch (*text) {
+                case 'K': context.whiteCastleKingside = true; break;
+                case 'Q': context.whiteCastleQueenside = true; break;
+                case 'k': context.blackCastleKingside = true; break;
+                case 'q': context.blackCastleQueenside = true; break;
+                default: break;
+            }
+        }
+    }
+    if (end) *end = text;
+    return true;
+}
+
+bool parseTrainingLine(const char* line, TrainingSample& sample)
+{
+    const char* text = nullptr;
+    if (!parseFEN(line, sample.state, sample.context, &text)) {
+        return false;
+    }
+    // the eval is whatever follows the last separator, past any en passant and move counters
+    const char* separator = std::strrchr(text, ',');
+    if (!separator) {
+        const char* last = text + std::strlen(text);
+        while (last > text && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r' || last[-1] == '\n')) last--;
+        separator = last;
+        while (separator > text && separator[-1] != ' ' && separator[-1] != '\t') separator--;
+        if (separator == last) return false;
+        separator--;
+    }
+    const char* eval = skipSpaces(separator + 1);
+    const bool mate = (*eval == '#');
+    if (mate) eval++;
+
+    char* parsedEnd = nullptr;
+    const long value = std::strtol(eval, &parsedEnd, 10);
+    if (parsedEnd == eval) {
+        return false;
+    }
+    if (mate) {
+        sample.target = (value < 0 || (value == 0 && *eval == '-')) ? -TRAINING_MATE_EVAL : TRAINING_MATE_EVAL;
+    } else {
+        sample.target = static_cast<int>(std::max(-32767L, std::min(32767L, value)));
+    }
+    return true;
+}
+
+bool TrainingDataWriter::open(const std::string& path)
+{
+    close();
+    _file = std::fopen(path.c_str(), "wb");
+    if (!_file) {
+        std::cerr << "Failed to open file for writing: " << path << std::endl;
+        return false;
+    }
+    _count = 0;
+    _buffer.resize(BUFFER_BYTES);
+    std::setvbuf(_file, _buffer.data(), _IOFBF, _buffer.size());
+    // placeholder, the count is filled in by close()
+    const TrainingDataHeader header = { TRAINING_DATA_MAGIC, TRAINING_DATA_VERSION, 0 };
+    return std::fwrite(&header, sizeof(header), 1, _file) == 1;
+}
+
+bool TrainingDataWriter::append(const TrainingSample& sample)
+{
+    if (!_file) return false;
+    const PackedPosition packed = packPosition(sample);
+    if (std::fwrite(&packed, sizeof(packed), 1, _file) != 1) return false;
+    _count++;
+    return true;
+}
+
+bool TrainingDataWriter::close()
+{
+    if (!_file) return false;
+    const TrainingDataHeader header = { TRAINING_DATA_MAGIC, TRAINING_DATA_VERSION, _count };
+    bool ok = std::fseek(_file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, _file) == 1;
+    ok = (std::fclose(_file) == 0) && ok;
+    _file = nullptr;
+    return ok;
+}
+
+TrainingDataset::TrainingDataset() : _count(0), _cursor(0)
+{
+}
+
+bool TrainingDataset::open(const std::string& path)
+{
+    return open(std::vector<std::string>{ path });
+}
+
+bool TrainingDataset::open(const std::vector<std::string>& paths)
+{
+    close();
+    for (const std::string& path : paths) {
+        Shard shard;
+        shard.file = std::make_unique<MappedFile>();
+        // batches jump all over the file, read ahead would only pull in records nobody asked for yet
+        if (!shard.file->open(path, MappedFile::Random)) {
+            close();
+            return false;
+        }
+
+        const TrainingDataHeader* header = static_cast<const TrainingDataHeader*>(shard.file->data());
+        const uint64_t size = shard.file->size();
+        const uint64_t available = size < sizeof(TrainingDataHeader) ? 0 : (size - sizeof(TrainingDataHeader)) / sizeof(PackedPosition);
+        if (size < sizeof(TrainingDataHeader) || header->magic != TRAINING_DATA_MAGIC ||
+            header->version != TRAINING_DATA_VERSION || header->count > available) {
+            std::cerr << "Not a training data file, or it is truncated: " << path << std::endl;
+            close();
+            return false;
+        }
+        // the shuffled order keeps 32 bit indices
+        if (_count + header->count > UINT32_MAX) {
+            std::cerr << "More than " << UINT32_MAX << " positions in the training set at " << path << std::endl;
+            close();
+            return false;
+        }
+        shard.records = reinterpret_cast<const PackedPosition*>(static_cast<const char*>(shard.file->data()) + sizeof(TrainingDataHeader));
+        shard.first = _count;
+        _count += static_cast<size_t>(header->count);
+        _shards.push_back(std::move(shard));
+    }
+
+    _order.resize(_count);
+    std::iota(_order.begin(), _order.end(), 0u);
+    _cursor = 0;
+    return true;
+}
+
+void TrainingDataset::close()
+{
+    _shards.clear();
+    _count = 0;
+    _order.clear();
+    _cursor = 0;
+}
+
+const PackedPosition& TrainingDataset::record(size_t index) const
+{
+    // the last shard starting at or before index
+    auto shard = std::upper_bound(_shards.begin(), _shards.end(), index, [](size_t i, const Shard& s) { return i < s.first; }) - 1;
+    return shard->records[index - shard->first];
+}
+
+void TrainingDataset::sample(size_t index, TrainingSample& sample) const
+{
+    unpackPosition(record(index), sample);
+}
+
+void TrainingDataset::shuffle(uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::shuffle(_order.begin(), _order.end(), rng);
+    _cursor = 0;
+}
+
+int TrainingDataset::nextBatch(std::vector<TrainingSample>& batch, int batchSize)
+{
+    const size_t count = std::min(_count - _cursor, static_cast<size_t>(std::max(0, batchSize)));
+    batch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        unpackPosition(record(_order[_cursor + i]), batch[i]);
+    }
+    _cursor += count;
+    return static_cast<int>(count);
+}
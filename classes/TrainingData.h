@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ChessEval.h"
+#include "MappedFile.h"
+
+/**
+ * Binary training set for ChessEval.
+ * A file is a TrainingDataHeader followed by fixed size PackedPosition records, so it can be mapped
+ * into memory and read in any order without parsing. Everything is stored little-endian.
+ */
+
+/**
+ * One labelled position in 36 bytes: the board at 4 bits per square, the side to move and castling
+ * rights as bits, the evaluation, and the game result when the position was played in a game.
+ */
+struct PackedPosition {
+    uint8_t squares[32];   // two squares per byte, the even square in the low nibble; 0 empty, 1..12 PNBRQKpnbrqk
+    uint8_t flags;         // PackedFlag bits
+    uint8_t result;        // PackedResult, was reserved and zero before self-play data, so old files read as unknown
+    int16_t eval;          // centipawns as given by the source, mates stored as +/- TRAINING_MATE_EVAL
+};
+static_assert(sizeof(PackedPosition) == 36, "PackedPosition must stay 36 bytes, files depend on it");
+
+enum PackedFlag {
+    PackedWhiteToMove = 1,
+    PackedWhiteCastleKingside = 2,
+    PackedWhiteCastleQueenside = 4,
+    PackedBlackCastleKingside = 8,
+    PackedBlackCastleQueenside = 16
+};
+
+enum PackedResult {
+    PackedResultUnknown = 0,
+    PackedWhiteWin = 1,
+    PackedDraw = 2,
+    PackedBlackWin = 3
+};
+
+struct TrainingDataHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;        // number of records after the header
+};
+
+constexpr uint32_t TRAINING_DATA_MAGIC = 0x31445443;  // "CTD1"
+constexpr uint32_t TRAINING_DATA_VERSION = 1;
+constexpr int TRAINING_MATE_EVAL = 32000;  // far outside what trainBatch trains on, so mates are skipped
+
+PackedPosition packPosition(const TrainingSample& sample);
+void unpackPosition(const PackedPosition& packed, TrainingSample& sample);
+
+/**
+ * Reads a FEN's board, side to move and castling fields; the rest of the string is ignored.
+ * @param end Receives the position just past the castling field
+ * @return false if the board field is malformed
+ */
+bool parseFEN(const char* fen, char* state, PositionContext& context, const char** end = nullptr);
+
+/**
+ * Parses one "FEN,eval" text line, as in the usual Stockfish labelled CSV dumps. The separator may be a
+ * comma or whitespace, and an eval of the form #+3 / #-2 is a mate.
+ * @return false for header lines and anything else that isn't a position
+ */
+bool parseTrainingLine(const char* line, TrainingSample& sample);
+
+/**
+ * The target to train a sample on: its evaluation, blended with the game result when it has one. The
+ * blend is done in win probability, 400 centipawns to a factor of ten in the odds, and mapped back.
+ * @param lambda Weight of the evaluation, 1 ignores the result and 0 trains on the result alone
+ */
+int blendedTarget(const TrainingSample& sample, float lambda);
+
+/**
+ * Appends records to a new training file; the header's count is written on close. Writes go through a
+ * large stdio buffer, so a writer per thread can append millions of records without a syscall each.
+ */
+class TrainingDataWriter {
+public:
+    static constexpr size_t BUFFER_BYTES = 1 << 20;
+
+    TrainingDataWriter() : _file(nullptr), _count(0) { }
+    ~TrainingDataWriter() { close(); }
+    TrainingDataWriter(const TrainingDataWriter&) = delete;
+    TrainingDataWriter& operator=(const TrainingDataWriter&) = delete;
+
+    bool open(const std::string& path);
+    bool append(const TrainingSample& sample);
+    bool close();
+
+    uint64_t count() const { return _count; }
+
+private:
+    FILE* _file;
+    uint64_t _count;
+    std::vector<char> _buffer;
+};
+
+/**
+ * One or more training files mapped read-only into memory. Records are decoded only as they are used,
+ * and batches are drawn through a shuffled index over all the files so each epoch sees every position
+ * once in a new order. Several files are the shards self-play writes, one per worker.
+ */
+class TrainingDataset {
+public:
+    TrainingDataset();
+    ~TrainingDataset() { close(); }
+    TrainingDataset(const TrainingDataset&) = delete;
+    TrainingDataset& operator=(const TrainingDataset&) = delete;
+
+    bool open(const std::string& path);
+    bool open(const std::vector<std::string>& paths);
+    void close();
+
+    bool isOpen() const { return !_shards.empty(); }
+    size_t size() const { return _count; }
+    void sample(size_t index, TrainingSample& sample) const;
+
+    /**
+     * Puts the records in a new random order and starts the epoch over.
+     */
+    void shuffle(uint64_t seed);
+    void rewind() { _cursor = 0; }
+
+    /**
+     * Decodes the next batchSize records of the current order into batch.
+     * @return Number of records decoded, 0 once the epoch is done
+     */
+    int nextBatch(std::vector<TrainingSample>& batch, int batchSize);
+
+private:
+    struct Shard {
+        std::unique_ptr<MappedFile> file;
+        const PackedPosition* records;
+        size_t first;      // index of this shard's first record in the whole set
+    };
+
+    const PackedPosition& record(size_t index) const;
+
+    std::vector<Shard> _shards;
+    size_t _count;
+    std::vector<uint32_t> _order;
+    size_t _cursor;
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include "GameState.h"
+#include "LargePages.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <xmmintrin.h>
+#endif
+
+//
+// Transposition table for the chess search
+// a power-of-two number of cache line sized buckets, each holding four 16 byte entries, indexed by the
+// low bits of the Zobrist hash. The table is shared by every search thread without locks: each slot
+// stores its 8 byte data word next to key ^ data, so a slot torn by two threads writing at once no
+// longer decodes back to its key and simply reads as a miss. The buckets live in LargePageMemory, so
+// probes across a table of hundreds of MB don't spend their time on TLB misses, and a move's bucket
+// can be prefetched as soon as the move is made, while the move generator runs.
+//
+
+enum TTBound : uint8_t {
+    TTNone = 0,
+    TTUpper = 1,    // failed low, score is at most this
+    TTLower = 2,    // failed high, score is at least this
+    TTExact = 3
+};
+
+#pragma pack(push, 1)
+struct TTEntry {
+    uint64_t key;
+    BitMove move;           // best (or refuting) move, NoPiece if none was found
+    int16_t score;
+    int8_t depth;
+    uint8_t boundAndAge;    // low 2 bits bound, high 6 bits search generation
+
+    TTBound bound() const { return static_cast<TTBound>(boundAndAge & 3); }
+    uint8_t age() const { return boundAndAge >> 2; }
+};
+#pragma pack(pop)
+static_assert(sizeof(TTEntry) == 16, "TTEntry should pack into 16 bytes");
+
+struct TTSlot {
+    std::atomic<uint64_t> check;    // key ^ data
+    std::atomic<uint64_t> data;     // everything in TTEntry after the key
+};
+static_assert(sizeof(TTSlot) == 16, "TTSlot should pack into 16 bytes");
+
+constexpr int TT_BUCKET_ENTRIES = 4;
+
+struct alignas(64) TTBucket {
+    TTSlot slots[TT_BUCKET_ENTRIES];
+};
+static_assert(sizeof(TTBucket) == 64, "TTBucket should fill one cache line");
+
+class TranspositionTable {
+public:
+    TranspositionTable() : _bucketCount(0), _mask(0), _generation(0) { resize(16); }
+
+    // size is rounded down to a power of two number of buckets, at least one
+    void resize(size_t megabytes) {
+        size_t buckets = 1;
+        const size_t bytes = megabytes * 1024 * 1024;
+        while (buckets * 2 * sizeof(TTBucket) <= bytes) {
+            buckets *= 2;
+        }
+        _buckets = nullptr;
+        if (!_memory.allocate(buckets * sizeof(TTBucket))) {
+            throw std::bad_alloc();
+        }
+        _buckets = static_cast<TTBucket*>(_memory.data());
+        for (size_t i = 0; i < buckets; i++) {
+            new (&_buckets[i]) TTBucket();
+        }
+        _bucketCount = buckets;
+        _mask = buckets - 1;
+        clear();
+    }
+
+    // not thread safe, only call between searches
+    void clear() {
+        for (size_t i = 0; i < _bucketCount; i++) {
+            for (TTSlot& slot : _buckets[i].slots) {
+                slot.check.store(0, std::memory_order_relaxed);
+                slot.data.store(0, std::memory_order_relaxed);
+            }
+        }
+        _generation = 0;
+    }
+
+    // called once per root search so entries from earlier moves lose out to fresh ones
+    void newSearch() { _generation = (_generation + 1) & 63; }
+
+    size_t sizeInBytes() const { return _bucketCount * sizeof(TTBucket); }
+    bool largePages() const { return _memory.largePages(); }
+
+    // starts loading the bucket of key into the cache, for a probe coming shortly
+    void prefetch(uint64_t key) const {
+#if defined(_MSC_VER) && !defined(__clang__)
+        _mm_prefetch(reinterpret_cast<const char*>(&_buckets[key & _mask]), _MM_HINT_T0);
+#else
+        __builtin_prefetch(&_buckets[key & _mask]);
+#endif
+    }
+
+    bool probe(uint64_t key, TTEntry& out) const {
+        const TTBucket& bucket = _buckets[key & _mask];
+        for (const TTSlot& slot : bucket.slots) {
+            const uint64_t data = slot.data.load(std::memory_order_relaxed);
+            if ((slot.check.load(std::memory_order_relaxed) ^ data) == key) {
+                decode(key, data, out);
+                if (out.bound() != TTNone) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // true if it overwrote another position's entry
+    bool store(uint64_t key, BitMove move, int score, int depth, TTBound bound) {
+        TTBucket& bucket = _buckets[key & _mask];
+        TTSlot* replace = &bucket.slots[0];
+        TTEntry existing;
+        bool sameKey = false;
+        bool evicting = true;   // the loop only falls through when every slot holds another position
+        int replaceWorth = INT32_MAX;
+        for (TTSlot& slot : bucket.slots) {
+            const uint64_t data = slot.data.load(std::memory_order_relaxed);
+            const uint64_t slotKey = slot.check.load(std::memory_order_relaxed) ^ data;
+            decode(slotKey, data, existing);
+            if (slotKey == key || existing.bound() == TTNone) {
+                replace = &slot;
+                sameKey = (slotKey == key && existing.bound() != TTNone);
+                evicting = false;
+                break;
+            }
+            // depth preferred: evict the shallowest entry, counting entries from older searches as shallower
+            const int worth = replacementWorth(existing);
+            if (worth < replaceWorth) {
+                replaceWorth = worth;
+                replace = &slot;
+            }
+        }
+
+        if (sameKey) {
+            // a shallower result for the same position keeps the deeper one unless it is exact
+            if (depth < existing.depth && bound != TTExact) {
+                return false;
+            }
+            // don't lose a known best move to a search that failed low without finding one
+            if (move.piece == NoPiece) {
+                move = existing.move;
+            }
+        }
+
+        TTEntry entry;
+        entry.key = key;
+        entry.move = move;
+        entry.score = static_cast<int16_t>(score > INT16_MAX ? INT16_MAX : (score < -INT16_MAX ? -INT16_MAX : score));
+        entry.depth = static_cast<int8_t>(depth > INT8_MAX ? INT8_MAX : depth);
+        entry.boundAndAge = static_cast<uint8_t>((_generation << 2) | bound);
+
+        uint64_t data;
+        std::memcpy(&data, reinterpret_cast<const char*>(&entry) + sizeof(entry.key), sizeof(data));
+        replace->check.store(key ^ data, std::memory_order_relaxed);
+        replace->data.store(data, std::memory_order_relaxed);
+        return evicting;
+    }
+
+private:
+    static void decode(uint64_t key, uint64_t data, TTEntry& out) {
+        out.key = key;
+        std::memcpy(reinterpret_cast<char*>(&out) + sizeof(out.key), &data, sizeof(data));
+    }
+
+    int replacementWorth(const TTEntry& entry) const {
+        const int ageDistance = (_generation - entry.age()) & 63;
+        return entry.depth - 8 * ageDistance;
+    }
+
+    LargePageMemory _memory;
+    TTBucket* _buckets = nullptr;   // constructed in _memory
+    size_t _bucketCount;
+    size_t _mask;
+    uint8_t _generation;
+};
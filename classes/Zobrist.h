@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+//
+// Zobrist keys for GameState hashing
+// the keys are generated at compile time with splitmix64 so every build (and every thread) sees the same
+// values without any startup initialisation
+//
+
+// piece keys are indexed by the AllBitBoards index of the piece, so putPiece/removePiece can use
+// the same lookup they already do for the bitboards
+constexpr int ZOBRIST_PIECE_SLOTS = 16;
+
+struct ZobristKeys {
+    uint64_t pieces[ZOBRIST_PIECE_SLOTS][64];
+    uint64_t castling[16];      // indexed by the full castling rights mask
+    uint64_t enPassant[8];      // indexed by the file of the en passant target square
+    uint64_t sideToMove;        // xored in when black is to move
+};
+
+constexpr uint64_t zobristSplitMix64(uint64_t& seed) {
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys makeZobristKeys() {
+    ZobristKeys keys{};
+    uint64_t seed = 0x4368657373426173ULL;
+    for (auto& slot : keys.pieces) {
+        for (auto& key : slot) {
+            key = zobristSplitMix64(seed);
+        }
+    }
+    // no rights must hash to zero so a position without castling needs no xor at all
+    keys.castling[0] = 0;
+    for (int i = 1; i < 16; i++) {
+        keys.castling[i] = zobristSplitMix64(seed);
+    }
+    for (auto& key : keys.enPassant) {
+        key = zobristSplitMix64(seed);
+    }
+    keys.sideToMove = zobristSplitMix64(seed);
+    return keys;
+}
+
+inline constexpr ZobristKeys _zobristKeys = makeZobristKeys();
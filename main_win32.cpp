@@ -12,6 +12,7 @@
 #include <d3d11.h>
 #include <tchar.h>
 #include "Application.h"
+#include "classes/LargePages.h"
 
 // Data
 ID3D11Device*            g_pd3dDevice = nullptr;
@@ -31,6 +32,9 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 // Main code
 int main(int, char**)
 {
+    // before the first transposition table is allocated, so it can go in large pages
+    LargePageMemory::enableLargePages();
+
     // Make process DPI aware and obtain main monitor scale
     ImGui_ImplWin32_EnableDpiAwareness();
     float main_scale = ImGui_ImplWin32_GetDpiScaleForMonitor(::MonitorFromPoint(POINT{ 0, 0 }, MONITOR_DEFAULTTOPRIMARY));
@@ -0,0 +1,349 @@
+//
+// analyze - searches every position of a FEN list or PGN file on every core, one JSON line each
+//
+//   analyze positions.epd                     one FEN (or EPD, the first four fields) a line, # comments
+//   analyze -pgn games.pgn                    every position of every game, before each move played
+//   analyze -depth 16 -multipv 3 positions.epd
+//   analyze -movetime 500 -                   half a second a position, read from stdin
+//   analyze -threads 8 -hash 512              workers, and the TT memory they share out between them
+//   analyze -model net.bin -tb resources/tablebases
+//
+// A file ending in .pgn is read as PGN without -pgn. Each worker thread has its own single threaded
+// search with its own slice of -hash, cleared before every position, so a position's result doesn't
+// depend on which worker got it or what it searched before; only the network and the tablebases are
+// shared. Without -depth or -movetime the search goes to depth 12. Results come out in input order:
+// a position finished early waits for the ones before it, and the reader stops taking in positions
+// while too many are waiting, so memory stays the same however long the input is. Each line holds
+// the position's index and FEN (from PGN also the game, ply and move played), the depth completed,
+// nodes, time and one entry per MultiPV line with its move in UCI and SAN, score and principal
+// variation. Scores are from the side to move's view, in centipawns or moves to mate.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../classes/ChessEval.h"
+#include "../classes/ChessSearch.h"
+#include "../classes/GameState.h"
+#include "../classes/Notation.h"
+#include "../classes/Pgn.h"
+#include "../classes/Tablebase.h"
+
+static const char* DEFAULT_MODEL = "resources/models/neural_final.bin";
+static const int DEFAULT_DEPTH = 12;
+static const int PV_LENGTH = 32;
+// positions read ahead of the oldest one not yet written, per worker
+static const size_t WINDOW_PER_THREAD = 4;
+
+struct AnalysisJob {
+    size_t index = 0;
+    GameState position;     // from PGN with the game's moves before it, for the repetition rule
+    // from PGN only: the game's number from 1, the ply from 0 and the move played there, in SAN
+    int game = 0;
+    int ply = 0;
+    std::string played;
+};
+
+struct AnalysisSettings {
+    int depth = 0;
+    int moveTimeMs = 0;
+    int multiPV = 1;
+};
+
+// Hands jobs from the reader to the workers and their lines back out in input order. submit blocks
+// while the window is full, which is what keeps memory bounded
+class AnalysisQueue {
+public:
+    AnalysisQueue(size_t window) : _window(window) {}
+
+    void submit(AnalysisJob job) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _windowFree.wait(lock, [&]() { return job.index < _nextOutput + _window; });
+        _jobs.push_back(std::move(job));
+        _jobReady.notify_one();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _jobReady.notify_all();
+    }
+
+    // false once the reader is done and every job has been taken
+    bool take(AnalysisJob& job) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _jobReady.wait(lock, [&]() { return !_jobs.empty() || _closed; });
+        if (_jobs.empty()) {
+            return false;
+        }
+        job = std::move(_jobs.front());
+        _jobs.pop_front();
+        return true;
+    }
+
+    // writes line if it is the next in order, along with any later ones that were waiting for it
+    void finish(size_t index, std::string line) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finished.emplace(index, std::move(line));
+        bool written = false;
+        for (auto next = _finished.find(_nextOutput); next != _finished.end(); next = _finished.find(_nextOutput)) {
+            std::fwrite(next->second.data(), 1, next->second.size(), stdout);
+            _finished.erase(next);
+            _nextOutput++;
+            written = true;
+        }
+        if (written) {
+            std::fflush(stdout);
+            _windowFree.notify_all();
+        }
+    }
+
+private:
+    const size_t _window;
+    std::mutex _mutex;
+    std::condition_variable _jobReady;
+    std::condition_variable _windowFree;
+    std::deque<AnalysisJob> _jobs;
+    std::map<size_t, std::string> _finished;
+    size_t _nextOutput = 0;
+    bool _closed = false;
+};
+
+static void appendEscaped(std::string& out, const std::string& text)
+{
+    out += '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+static void appendScore(std::string& out, int score)
+{
+    int moves;
+    if (ChessSearch::mateInMoves(score, moves)) {
+        out += "{\"mate\":" + std::to_string(moves) + "}";
+    } else {
+        out += "{\"cp\":" + std::to_string(score) + "}";
+    }
+}
+
+static std::string analyzePosition(ChessSearch& search, AnalysisJob& job, const AnalysisSettings& settings)
+{
+    std::string out = "{\"index\":" + std::to_string(job.index) + ",\"fen\":";
+    appendEscaped(out, job.position.toFEN());
+    if (job.game > 0) {
+        out += ",\"game\":" + std::to_string(job.game) + ",\"ply\":" + std::to_string(job.ply) + ",\"played\":";
+        appendEscaped(out, job.played);
+    }
+
+    MoveList legal;
+    job.position.generateAllMoves(legal);
+    if (legal.empty()) {
+        out += ",\"result\":";
+        out += job.position.isInCheck() ? "\"checkmate\"" : "\"stalemate\"";
+        out += "}\n";
+        return out;
+    }
+
+    SearchLimits limits;
+    limits.maxDepth = settings.depth > 0 ? settings.depth : settings.moveTimeMs > 0 ? MAX_SEARCH_DEPTH : DEFAULT_DEPTH;
+    limits.moveTimeMs = settings.moveTimeMs;
+    limits.multiPV = settings.multiPV;
+    search.newGame();
+    const auto start = std::chrono::steady_clock::now();
+    const SearchResult result = search.search(job.position, limits);
+    const long long elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    out += ",\"depth\":" + std::to_string(result.completedDepth);
+    out += ",\"nodes\":" + std::to_string(result.nodes);
+    out += ",\"time_ms\":" + std::to_string(elapsedMs);
+    out += ",\"lines\":[";
+    const size_t lines = std::min(result.rootMoves.size(), static_cast<size_t>(std::max(1, settings.multiPV)));
+    for (size_t i = 0; i < lines; i++) {
+        const RootMove& root = result.rootMoves[i];
+        const std::vector<BitMove> pv = search.principalVariation(job.position, root.move, PV_LENGTH);
+        if (i > 0) {
+            out += ',';
+        }
+        out += "{\"multipv\":" + std::to_string(i + 1) + ",\"move\":";
+        appendEscaped(out, moveToUCI(root.move));
+        out += ",\"san\":";
+        appendEscaped(out, moveToSAN(job.position, root.move, legal));
+        out += ",\"score\":";
+        appendScore(out, root.score);
+        out += ",\"pv\":[";
+        for (size_t ply = 0; ply < pv.size(); ply++) {
+            if (ply > 0) {
+                out += ',';
+            }
+            appendEscaped(out, moveToUCI(pv[ply]));
+        }
+        out += "]}";
+    }
+    out += "]}\n";
+    return out;
+}
+
+// FEN or EPD lines; returns how many positions were submitted
+static size_t readPositions(std::istream& in, const char* name, AnalysisQueue& queue)
+{
+    size_t index = 0;
+    int lineNumber = 0;
+    std::string text;
+    std::string fen;
+    while (std::getline(in, text)) {
+        lineNumber++;
+        if (!parseEpdLine(text, fen)) {
+            continue;
+        }
+        AnalysisJob job;
+        if (!job.position.loadFEN(fen)) {
+            std::fprintf(stderr, "%s:%d: not a FEN, skipped\n", name, lineNumber);
+            continue;
+        }
+        job.index = index++;
+        queue.submit(std::move(job));
+    }
+    return index;
+}
+
+// every position with a move played from it; a game stops at the first move that doesn't parse
+static size_t readGames(std::istream& in, const char* name, AnalysisQueue& queue)
+{
+    size_t index = 0;
+    int gameNumber = 0;
+    PgnReader reader(in);
+    PgnGame game;
+    while (reader.next(game)) {
+        gameNumber++;
+        GameState position;
+        if (!position.loadFEN(game.fen)) {
+            std::fprintf(stderr, "%s: game %d: bad FEN tag, skipped\n", name, gameNumber);
+            continue;
+        }
+        int ply = 0;
+        for (const std::string& token : movetextTokens(game.movetext)) {
+            const BitMove move = parseMove(position, token);
+            if (move.piece == NoPiece) {
+                std::fprintf(stderr, "%s: game %d: \"%s\" doesn't parse, the rest is skipped\n", name, gameNumber, token.c_str());
+                break;
+            }
+            AnalysisJob job;
+            job.index = index++;
+            job.position = position;
+            job.game = gameNumber;
+            job.ply = ply++;
+            job.played = token;
+            queue.submit(std::move(job));
+            position.pushMove(move);
+        }
+    }
+    return index;
+}
+
+int main(int argc, char** argv)
+{
+    AnalysisSettings settings;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    size_t hashMB = 256;
+    std::string modelPath = DEFAULT_MODEL;
+    std::string tablebasePath;
+    std::string inputPath;
+    bool pgn = false;
+    bool usage = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-depth" && i + 1 < argc) {
+            settings.depth = std::atoi(argv[++i]);
+        } else if (arg == "-movetime" && i + 1 < argc) {
+            settings.moveTimeMs = std::atoi(argv[++i]);
+        } else if (arg == "-multipv" && i + 1 < argc) {
+            settings.multiPV = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "-hash" && i + 1 < argc) {
+            hashMB = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "-model" && i + 1 < argc) {
+            modelPath = argv[++i];
+        } else if (arg == "-tb" && i + 1 < argc) {
+            tablebasePath = argv[++i];
+        } else if (arg == "-pgn") {
+            pgn = true;
+        } else if (inputPath.empty() && !arg.empty() && (arg[0] != '-' || arg == "-")) {
+            inputPath = arg;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || inputPath.empty()) {
+        std::fprintf(stderr, "usage: %s [-pgn] [-depth n] [-movetime ms] [-multipv n] [-threads n] [-hash mb] "
+                     "[-model file] [-tb directory] file|-\n", argv[0]);
+        return 2;
+    }
+    threads = std::max(1, threads);
+    if (inputPath.size() > 4 && inputPath.compare(inputPath.size() - 4, 4, ".pgn") == 0) {
+        pgn = true;
+    }
+
+    std::ifstream file;
+    if (inputPath != "-") {
+        file.open(inputPath);
+        if (!file) {
+            std::fprintf(stderr, "could not open %s\n", inputPath.c_str());
+            return 1;
+        }
+    }
+    std::istream& in = inputPath == "-" ? std::cin : file;
+
+    const std::shared_ptr<const ChessEval> evaluator = ChessEval::shared(modelPath);
+    const std::shared_ptr<const Tablebase> tablebase = tablebasePath.empty() ? nullptr : Tablebase::shared(tablebasePath);
+    std::vector<std::unique_ptr<ChessSearch>> searches;
+    for (int t = 0; t < threads; t++) {
+        auto search = std::make_unique<ChessSearch>(*evaluator);
+        search->setLogLevel(LogLevel::Error);
+        search->setThreads(1);
+        search->resizeTT(std::max<size_t>(1, hashMB / threads));
+        if (tablebase) {
+            search->setTablebase(tablebase);
+        }
+        searches.push_back(std::move(search));
+    }
+
+    AnalysisQueue queue(WINDOW_PER_THREAD * threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            AnalysisJob job;
+            while (queue.take(job)) {
+                const size_t index = job.index;
+                queue.finish(index, analyzePosition(*searches[t], job, settings));
+            }
+        });
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const char* name = inputPath == "-" ? "stdin" : inputPath.c_str();
+    const size_t positions = pgn ? readGames(in, name, queue) : readPositions(in, name, queue);
+    queue.close();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "%zu positions in %.1f s on %d threads\n", positions, seconds, threads);
+    return 0;
+}
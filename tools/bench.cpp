@@ -0,0 +1,173 @@
+//
+// bench - fixed depth search over a fixed suite, for a reproducible node count and a speed figure
+//
+//   bench                      every position to depth 5, prints the total nodes (the signature) and nps
+//   bench -d 7                 a different depth, the signature then changes with it
+//   bench -model file.bin      evaluate with a trained network instead of the seeded untrained one
+//   bench -t 4                 Lazy SMP threads; anything above 1 gives up the fixed signature
+//   bench -v                   a line per position
+//   bench -off lmr             switch a SearchOption off (pvs, null, lmr, check, aspiration), to see
+//                              what it is worth in nodes and time
+//   bench -trace bench.json    the zones of the whole run as Chrome trace JSON, in a CHESS_TRACE build
+//
+// Each position starts from a cleared TT, eval cache and history, so its node count only depends
+// on the position, the depth and the code: a change that keeps the signature is a pure speedup.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "../classes/ChessSearch.h"
+#include "../classes/Trace.h"
+
+// openings, middlegames with tactics in them, and endgames from the trivial to the deep
+static const char* const benchSuite[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 0 4",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+    "rnbqkbnr/ppp2ppp/8/3pp3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq d6 0 3",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "2r3k1/pp3ppp/8/8/8/8/PP3PPP/2R3K1 w - - 0 1",
+    "8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 w - - 0 1",
+    "8/8/1k6/8/2PK4/8/8/8 w - - 0 1",
+    "8/8/8/4k3/8/8/3QK3/8 w - - 0 1",
+    "4k3/8/8/8/8/8/8/R3K3 w Q - 0 1",
+    "8/5k2/8/8/3B4/8/8/3NK3 w - - 0 1",
+    "k7/8/8/8/8/8/8/K7 w - - 0 1",
+};
+
+// the untrained network's weights, fixed so the signature doesn't depend on a model file
+static const uint32_t BENCH_NETWORK_SEED = 0x5eed;
+
+int main(int argc, char** argv)
+{
+    int depth = 5;
+    int threads = 1;
+    bool verbose = false;
+    std::string model;
+    std::string tracePath;
+    SearchOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            depth = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "-model") == 0 && i + 1 < argc) {
+            model = argv[++i];
+        } else if (std::strcmp(argv[i], "-trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (std::strcmp(argv[i], "-off") == 0 && i + 1 < argc && options.switchOff(argv[i + 1])) {
+            i++;
+        } else {
+            std::fprintf(stderr, "usage: %s [-d depth] [-t threads] [-model file.bin] [-v] [-trace file.json] [-off pvs|null|lmr|check|aspiration]...\n", argv[0]);
+            return 2;
+        }
+    }
+    if (depth < 1 || depth > MAX_SEARCH_DEPTH) {
+        std::fprintf(stderr, "depth must be 1 to %d\n", MAX_SEARCH_DEPTH);
+        return 2;
+    }
+#ifndef CHESS_TRACE
+    if (!tracePath.empty()) {
+        std::fprintf(stderr, "-trace needs a build with CHESS_TRACE\n");
+        return 2;
+    }
+#endif
+
+    TRACE_THREAD("bench");
+    ChessEval evaluator(BENCH_NETWORK_SEED);
+    if (!model.empty() && !evaluator.loadModel(model)) {
+        return 1;
+    }
+    ChessSearch search(evaluator);
+    search.setThreads(threads);
+    search.setOptions(options);
+    search.setLogLevel(LogLevel::Warning);
+
+    uint64_t totalNodes = 0;
+    double totalSeconds = 0.0;
+    int index = 0;
+    for (const char* fen : benchSuite) {
+        index++;
+        GameState root;
+        if (!root.loadFEN(fen)) {
+            std::fprintf(stderr, "bad FEN in the suite: %s\n", fen);
+            return 1;
+        }
+        MoveList moves;
+        root.generateAllMoves(moves);
+        if (moves.empty()) {
+            continue;
+        }
+
+        search.newGame();
+        SearchLimits limits;
+        limits.maxDepth = depth;
+        const auto start = std::chrono::steady_clock::now();
+        const SearchResult result = search.search(root, limits);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        totalNodes += result.nodes;
+        totalSeconds += seconds;
+
+        if (verbose) {
+            const BitMove& best = result.rootMoves[0].move;
+            std::printf("%2d  %-12llu %7.3fs  best %d-%d score %d\n", index, static_cast<unsigned long long>(result.nodes),
+                        seconds, best.from, best.to, result.rootMoves[0].score);
+        }
+    }
+
+    std::printf("===========================\n");
+    std::printf("Total time (ms) : %.0f\n", totalSeconds * 1000.0);
+    std::printf("Nodes searched  : %llu\n", static_cast<unsigned long long>(totalNodes));
+    std::printf("Nodes/second    : %.0f\n", totalSeconds > 0.0 ? totalNodes / totalSeconds : 0.0);
+#ifdef CHESS_TRACE
+    if (!tracePath.empty() && !Trace::writeChromeTrace(tracePath)) {
+        std::fprintf(stderr, "could not write %s\n", tracePath.c_str());
+        return 1;
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,228 @@
+//
+// benchmarks - Google Benchmark microbenchmarks for the pieces the search spends its time in
+//
+//   benchmarks                                        every benchmark, a table on the console
+//   benchmarks --benchmark_filter=GenerateMoves      only the ones matching a regex
+//   benchmarks --benchmark_out=micro.json --benchmark_out_format=json
+//                                                     also writes the results as JSON, which is what the
+//                                                     benchmarks_json target does, to compare runs over time
+//
+// Built only when CMake finds Google Benchmark. The positions are the same few as perft's: the start,
+// kiwipete (castling, pins, every kind of move), a rook endgame and a promotion-heavy middlegame.
+//
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../classes/GameState.h"
+#include "../classes/ChessEval.h"
+// the slider lookups are static inline helpers of GameState.cpp, so the only way to time them without
+// a call around them is to compile the tables in here too
+#include "../classes/MagicBitboards.h"
+
+static const char* const benchPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+};
+static const char* const positionNames[] = { "startpos", "kiwipete", "endgame", "promotions" };
+static const int NUM_POSITIONS = sizeof(benchPositions) / sizeof(benchPositions[0]);
+
+static GameState loadPosition(int index)
+{
+    GameState state;
+    state.loadFEN(benchPositions[index]);
+    return state;
+}
+
+static PositionContext positionContext(const GameState& state)
+{
+    PositionContext context;
+    context.whiteToMove = (state.color == WHITE);
+    context.whiteCastleKingside = (state.castlingRights & WhiteKingSide) != 0;
+    context.whiteCastleQueenside = (state.castlingRights & WhiteQueenSide) != 0;
+    context.blackCastleKingside = (state.castlingRights & BlackKingSide) != 0;
+    context.blackCastleQueenside = (state.castlingRights & BlackQueenSide) != 0;
+    return context;
+}
+
+// the occupancy of every bench position, so the slider lookups see real blocker patterns
+static std::vector<uint64_t> benchOccupancies()
+{
+    std::vector<uint64_t> occupancies;
+    for (int i = 0; i < NUM_POSITIONS; i++) {
+        const GameState state = loadPosition(i);
+        uint64_t occupancy = 0;
+        for (int square = 0; square < 64; square++) {
+            if (state.state[square] != '0') {
+                occupancy |= 1ULL << square;
+            }
+        }
+        occupancies.push_back(occupancy);
+    }
+    return occupancies;
+}
+
+static void setPositionLabel(benchmark::State& bench)
+{
+    bench.SetLabel(positionNames[bench.range(0)]);
+}
+
+static void BM_GenerateMoves(benchmark::State& bench)
+{
+    GameState state = loadPosition(static_cast<int>(bench.range(0)));
+    const MoveGenType type = static_cast<MoveGenType>(bench.range(1));
+    MoveList moves;
+    for (auto _ : bench) {
+        moves.clear();
+        state.generateAllMoves(moves, type);
+        benchmark::DoNotOptimize(moves.size());
+    }
+    bench.SetItemsProcessed(bench.iterations());
+    setPositionLabel(bench);
+}
+BENCHMARK(BM_GenerateMoves)->ArgsProduct({ benchmark::CreateDenseRange(0, NUM_POSITIONS - 1, 1), { AllMoves, NoisyMoves } });
+
+// every legal move of the position made and taken back, per iteration
+static void BM_PushPopMoves(benchmark::State& bench)
+{
+    GameState state = loadPosition(static_cast<int>(bench.range(0)));
+    MoveList moves;
+    state.generateAllMoves(moves);
+    for (auto _ : bench) {
+        for (const BitMove& move : moves) {
+            state.pushMove(move);
+            benchmark::DoNotOptimize(state.getZobristHash());
+            state.popState();
+        }
+    }
+    bench.SetItemsProcessed(bench.iterations() * static_cast<int64_t>(moves.size()));
+    setPositionLabel(bench);
+}
+BENCHMARK(BM_PushPopMoves)->DenseRange(0, NUM_POSITIONS - 1, 1);
+
+// all 64 squares against both colours, per iteration
+static void BM_IsSquareAttacked(benchmark::State& bench)
+{
+    const GameState state = loadPosition(static_cast<int>(bench.range(0)));
+    const uint64_t occupancy = benchOccupancies()[bench.range(0)];
+    for (auto _ : bench) {
+        int attacked = 0;
+        for (int square = 0; square < 64; square++) {
+            attacked += state.isSquareAttacked(square, WHITE, occupancy);
+            attacked += state.isSquareAttacked(square, BLACK, occupancy);
+        }
+        benchmark::DoNotOptimize(attacked);
+    }
+    bench.SetItemsProcessed(bench.iterations() * 128);
+    setPositionLabel(bench);
+}
+BENCHMARK(BM_IsSquareAttacked)->DenseRange(0, NUM_POSITIONS - 1, 1);
+
+// every square under every bench occupancy, per iteration; the argument picks magic or pext
+static void sliderBenchmark(benchmark::State& bench, uint64_t (*attacks)(int, uint64_t))
+{
+    const SliderLookup lookup = static_cast<SliderLookup>(bench.range(0));
+    if (!setSliderLookup(lookup)) {
+        bench.SkipWithError("slider lookup not available on this build or CPU");
+        return;
+    }
+    const std::vector<uint64_t> occupancies = benchOccupancies();
+    for (auto _ : bench) {
+        uint64_t all = 0;
+        for (uint64_t occupancy : occupancies) {
+            for (int square = 0; square < 64; square++) {
+                all ^= attacks(square, occupancy);
+            }
+        }
+        benchmark::DoNotOptimize(all);
+    }
+    bench.SetItemsProcessed(bench.iterations() * 64 * static_cast<int64_t>(occupancies.size()));
+    bench.SetLabel(sliderLookupName());
+}
+
+static void BM_RookAttacks(benchmark::State& bench)
+{
+    sliderBenchmark(bench, getRookAttacks);
+}
+BENCHMARK(BM_RookAttacks)->Arg(MagicLookup)->Arg(PextLookup);
+
+static void BM_BishopAttacks(benchmark::State& bench)
+{
+    sliderBenchmark(bench, getBishopAttacks);
+}
+BENCHMARK(BM_BishopAttacks)->Arg(MagicLookup)->Arg(PextLookup);
+
+// the untrained network, its weights don't change how long a forward pass takes
+static const ChessEval& benchEvaluator()
+{
+    static const ChessEval evaluator(0x5eed);
+    return evaluator;
+}
+
+static void BM_Evaluate(benchmark::State& bench)
+{
+    const GameState state = loadPosition(static_cast<int>(bench.range(0)));
+    const PositionContext context = positionContext(state);
+    const ChessEval& evaluator = benchEvaluator();
+    for (auto _ : bench) {
+        benchmark::DoNotOptimize(evaluator.evaluate(state.state, context));
+    }
+    bench.SetItemsProcessed(bench.iterations());
+    setPositionLabel(bench);
+}
+BENCHMARK(BM_Evaluate)->DenseRange(0, NUM_POSITIONS - 1, 1);
+
+// from an accumulator that is already built, which is what the search pays per node
+static void BM_EvaluateAccumulator(benchmark::State& bench)
+{
+    const GameState state = loadPosition(static_cast<int>(bench.range(0)));
+    const ChessEval& evaluator = benchEvaluator();
+    NNAccumulator accumulator;
+    evaluator.refresh(accumulator, state.state, positionContext(state));
+    for (auto _ : bench) {
+        benchmark::DoNotOptimize(evaluator.evaluate(accumulator));
+    }
+    bench.SetItemsProcessed(bench.iterations());
+    setPositionLabel(bench);
+}
+BENCHMARK(BM_EvaluateAccumulator)->DenseRange(0, NUM_POSITIONS - 1, 1);
+
+static void BM_EncodePosition(benchmark::State& bench)
+{
+    const GameState state = loadPosition(static_cast<int>(bench.range(0)));
+    const PositionContext context = positionContext(state);
+    for (auto _ : bench) {
+        ActiveFeatures features = ChessEval::encodePosition(state.state, context);
+        benchmark::DoNotOptimize(features.count);
+    }
+    bench.SetItemsProcessed(bench.iterations());
+    setPositionLabel(bench);
+}
+BENCHMARK(BM_EncodePosition)->DenseRange(0, NUM_POSITIONS - 1, 1);
+
+// a freshly saved model, so this times the mapping path current files take. loadModel prints the
+// model's statistics every time, std::cout is switched off around the loop to keep that out of it
+static void BM_LoadModel(benchmark::State& bench)
+{
+    const std::string path = "benchmarks_model.bin";
+    if (!benchEvaluator().saveModel(path)) {
+        bench.SkipWithError("could not write the model file");
+        return;
+    }
+    ChessEval evaluator(0x5eed);
+    std::streambuf* console = std::cout.rdbuf(nullptr);
+    for (auto _ : bench) {
+        benchmark::DoNotOptimize(evaluator.loadModel(path));
+    }
+    std::cout.rdbuf(console);
+    std::cout.clear();
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_LoadModel)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
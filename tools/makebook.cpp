@@ -0,0 +1,185 @@
+//
+// makebook - builds an opening book from games in PGN
+//
+//   makebook games.pgn book.bin               the first 16 plies of every game
+//   makebook -plies 24 -min 3 a.pgn b.pgn book.bin
+//
+// Every move played in the first -plies plies earns its position's entry 2 for a win and 1 for a draw
+// by the side that played it, nothing for a loss, the way Polyglot weighs its books. Moves played in
+// fewer than -min games are dropped, as are moves that only ever lost. Games may start from a FEN tag;
+// comments, variations and NAGs are skipped, and a game stops counting at the first move that doesn't
+// parse. The book is a Polyglot book, keys included, see OpeningBook.h.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../classes/GameState.h"
+#include "../classes/Notation.h"
+#include "../classes/OpeningBook.h"
+#include "../classes/Pgn.h"
+
+struct BookMoveStats {
+    uint32_t weight = 0;
+    uint32_t games = 0;
+};
+
+using BookStats = std::map<std::pair<uint64_t, uint16_t>, BookMoveStats>;
+
+static void addGame(const PgnGame& game, int maxPlies, BookStats& stats)
+{
+    // points for the side that moved, indexed by whether white did
+    uint32_t points[2] = { 0, 0 };
+    if (game.result == "1-0") {
+        points[1] = 2;
+    } else if (game.result == "0-1") {
+        points[0] = 2;
+    } else if (game.result == "1/2-1/2") {
+        points[0] = points[1] = 1;
+    } else {
+        return;
+    }
+    GameState state;
+    if (!state.loadFEN(game.fen)) {
+        return;
+    }
+    int plies = 0;
+    for (const std::string& token : movetextTokens(game.movetext)) {
+        if (plies >= maxPlies) {
+            break;
+        }
+        const BitMove move = parseMove(state, token);
+        if (move.piece == NoPiece) {
+            break;
+        }
+        BookMoveStats& entry = stats[{ polyglotKey(state), OpeningBook::encodeMove(move) }];
+        entry.weight += points[state.color == WHITE ? 1 : 0];
+        entry.games++;
+        state.pushMove(move);
+        plies++;
+    }
+}
+
+// reads the games one at a time, handing each to addGame
+static bool readPgn(const std::string& path, int maxPlies, BookStats& stats, int& games)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::fprintf(stderr, "could not open %s\n", path.c_str());
+        return false;
+    }
+    PgnReader reader(in);
+    PgnGame game;
+    while (reader.next(game)) {
+        addGame(game, maxPlies, stats);
+        games++;
+    }
+    return true;
+}
+
+// the keys the Polyglot format's documentation gives for these lines from the start position, every
+// key kind among them: a book whose keys are off in any of these would never be found
+static bool checkPolyglotKeys()
+{
+    static const std::pair<const char*, uint64_t> references[] = {
+        { "", 0x463b96181691fc9cULL },
+        { "e2e4", 0x823c9b50fd114196ULL },
+        { "e2e4 d7d5", 0x0756b94461c50fb0ULL },
+        { "e2e4 d7d5 e4e5", 0x662fafb965db29d4ULL },
+        { "e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78ULL },
+        { "e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1ULL },
+        { "e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9ULL },
+        { "a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637ULL },
+        { "a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560ULL },
+    };
+    for (const auto& [line, expected] : references) {
+        GameState state;
+        state.loadFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        for (const std::string& token : movetextTokens(line)) {
+            state.pushMove(parseMove(state, token));
+        }
+        if (polyglotKey(state) != expected) {
+            std::fprintf(stderr, "Polyglot key after \"%s\" is %016llx, the format says %016llx\n", line,
+                         static_cast<unsigned long long>(polyglotKey(state)), static_cast<unsigned long long>(expected));
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int maxPlies = 16;
+    uint32_t minGames = 1;
+    std::vector<std::string> paths;
+    bool usage = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-plies" && i + 1 < argc) {
+            maxPlies = std::atoi(argv[++i]);
+        } else if (arg == "-min" && i + 1 < argc) {
+            minGames = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage = true;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (usage || paths.size() < 2 || maxPlies < 1) {
+        std::fprintf(stderr, "usage: %s [-plies n] [-min games] games.pgn... book.bin\n", argv[0]);
+        return 2;
+    }
+    const std::string bookPath = paths.back();
+    paths.pop_back();
+    if (!checkPolyglotKeys()) {
+        return 1;
+    }
+
+    BookStats stats;
+    int games = 0;
+    for (const std::string& path : paths) {
+        if (!readPgn(path, maxPlies, stats, games)) {
+            return 1;
+        }
+    }
+
+    auto kept = [minGames](const BookMoveStats& move) { return move.games >= minGames && move.weight > 0; };
+    uint32_t heaviest = 0;
+    for (const auto& [key, move] : stats) {
+        if (kept(move)) {
+            heaviest = std::max(heaviest, move.weight);
+        }
+    }
+    // weights are 16 bits in the file, so a big collection is scaled down, keeping every kept move playable;
+    // the map already has the entries in key order, the order the book is searched in
+    std::vector<BookEntry> entries;
+    for (const auto& [key, move] : stats) {
+        if (kept(move)) {
+            const uint64_t weight = heaviest > 0xFFFF ? uint64_t(move.weight) * 0xFFFF / heaviest : move.weight;
+            entries.push_back({ key.first, key.second, static_cast<uint16_t>(std::max<uint64_t>(weight, 1)), 0 });
+        }
+    }
+
+    std::FILE* out = std::fopen(bookPath.c_str(), "wb");
+    if (!out) {
+        std::fprintf(stderr, "could not write %s\n", bookPath.c_str());
+        return 1;
+    }
+    unsigned char bytes[BOOK_ENTRY_SIZE];
+    for (const BookEntry& entry : entries) {
+        OpeningBook::writeEntry(entry, bytes);
+        std::fwrite(bytes, 1, sizeof(bytes), out);
+    }
+    if (std::fclose(out) != 0) {
+        std::fprintf(stderr, "could not write %s\n", bookPath.c_str());
+        return 1;
+    }
+    std::printf("%d games, %zu entries written to %s\n", games, entries.size(), bookPath.c_str());
+    return 0;
+}
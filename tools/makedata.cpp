@@ -0,0 +1,62 @@
+//
+// makedata - convert Stockfish labelled text positions into the binary training format
+//
+//   makedata positions.csv positions.bin
+//
+// Each input line is a FEN followed by its evaluation in centipawns, separated by a comma or spaces
+// ("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1,+26"). Mates are written as #+3 or #-2.
+// Lines that don't parse, a CSV header for one, are counted and skipped.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "../classes/TrainingData.h"
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s positions.csv positions.bin\n", argv[0]);
+        return 2;
+    }
+
+    FILE* input = std::fopen(argv[1], "r");
+    if (!input) {
+        std::fprintf(stderr, "could not open %s\n", argv[1]);
+        return 1;
+    }
+    TrainingDataWriter writer;
+    if (!writer.open(argv[2])) {
+        std::fclose(input);
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t skipped = 0;
+    char line[1024];
+    TrainingSample sample;
+    while (std::fgets(line, sizeof(line), input)) {
+        if (!parseTrainingLine(line, sample)) {
+            skipped++;
+            continue;
+        }
+        if (!writer.append(sample)) {
+            std::fprintf(stderr, "write to %s failed\n", argv[2]);
+            std::fclose(input);
+            return 1;
+        }
+    }
+    std::fclose(input);
+
+    const uint64_t written = writer.count();
+    if (!writer.close()) {
+        std::fprintf(stderr, "could not finish %s\n", argv[2]);
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("wrote %llu positions (%llu bytes), skipped %llu lines, %.1f s\n",
+                static_cast<unsigned long long>(written),
+                static_cast<unsigned long long>(sizeof(TrainingDataHeader) + written * sizeof(PackedPosition)),
+                static_cast<unsigned long long>(skipped), seconds);
+    return 0;
+}
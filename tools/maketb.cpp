@@ -0,0 +1,364 @@
+//
+// maketb - generates the endgame tablebases the search probes
+//
+//   maketb resources/tablebases                every table of 3 pieces, under a minute on one core
+//   maketb -pieces 4 -threads 8 tables         of 4 pieces as well, 32 MB and many minutes a table
+//
+// Tables already in the directory are kept, so an interrupted run picks up where it stopped. Each table
+// is solved by retrograde levels: the side to move wins in k plies if some move leads to a position lost
+// in k - 1, and loses in k if every move leads to one won in k - 1 or less and one of them in exactly
+// k - 1. Captures and promotions lead into the smaller tables generated before, read back from the
+// directory through Tablebase itself, so the generator and the search agree on every index. What is
+// still unsolved when no level can add anything more is a draw. Before a table is written every one of
+// its positions is probed back through Tablebase, and through its colour mirror, which must agree.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../classes/GameState.h"
+#include "../classes/Tablebase.h"
+
+struct TableBuild {
+    std::string name;
+    std::string pieces;
+    std::vector<uint8_t> entries;   // Tablebase::encode of the solved positions
+    std::vector<uint8_t> solved;
+    const Tablebase* smaller;       // every table a capture or promotion can lead to
+};
+
+// the position at index, false for an index that stands for no legal position of the table. Mirrored
+// sets up the same position with the colours swapped and the board turned top to bottom
+static bool setUpEntry(const TableBuild& build, uint64_t index, GameState& position, bool mirrored = false)
+{
+    const int count = static_cast<int>(build.pieces.size());
+    int squares[TABLEBASE_MAX_PIECES];
+    for (int i = count - 1; i >= 0; i--) {
+        squares[i] = static_cast<int>(index & 63);
+        index >>= 6;
+    }
+    char board[64];
+    std::memset(board, '0', sizeof(board));
+    for (int i = 0; i < count; i++) {
+        const char piece = build.pieces[i];
+        if (board[squares[i]] != '0') {
+            return false;
+        }
+        // the probe only ever asks for repeated pieces in square order
+        if (i > 0 && build.pieces[i - 1] == piece && squares[i - 1] > squares[i]) {
+            return false;
+        }
+        if ((piece == 'P' || piece == 'p') && (squares[i] < 8 || squares[i] >= 56)) {
+            return false;
+        }
+        board[squares[i]] = piece;
+    }
+    if (mirrored) {
+        char turned[64];
+        for (int square = 0; square < 64; square++) {
+            const unsigned char piece = static_cast<unsigned char>(board[square]);
+            turned[square ^ 56] = static_cast<char>(std::isupper(piece) ? std::tolower(piece) : std::toupper(piece));
+        }
+        std::memcpy(board, turned, sizeof(board));
+    }
+    // the side that just moved can't be left in check
+    const int toMove = (index != 0) != mirrored ? BLACK : WHITE;
+    position.init(board, static_cast<char>(-toMove), 0);
+    if (position.isInCheck()) {
+        return false;
+    }
+    position.init(board, static_cast<char>(toMove), 0);
+    return true;
+}
+
+static bool solve(const TableBuild& build, GameState& position, int limit, TablebaseResult& result, bool& known, int& deepestSmaller);
+
+// the result for the side to move after move, read from this table or a smaller one. A double push the
+// other side can take en passant leaves a position the table doesn't index, it is solved on the spot
+static bool childResult(const TableBuild& build, GameState& position, const BitMove& move, int limit,
+                        TablebaseResult& result, bool& known, int& deepestSmaller)
+{
+    position.pushMove(move);
+    bool found = true;
+    if (move.flags & (IsCapture | EnPassant | IsPromotion)) {
+        found = build.smaller->probe(position, result);
+        known = true;
+        deepestSmaller = std::max(deepestSmaller, result.distance);
+    } else if (position.enPassantSquare >= 0) {
+        found = solve(build, position, limit - 1, result, known, deepestSmaller);
+    } else {
+        const uint64_t child = Tablebase::entryIndex(position, build.pieces, false);
+        known = build.solved[child] != 0;
+        result = Tablebase::decode(build.entries[child]);
+    }
+    position.popState();
+    return found;
+}
+
+// The position's result if it is mate in limit plies or less; the table must already hold every
+// position mate in fewer. False if a smaller table is missing
+static bool solve(const TableBuild& build, GameState& position, int limit, TablebaseResult& result, bool& known, int& deepestSmaller)
+{
+    MoveList moves;
+    position.generateAllMoves(moves);
+    result = TablebaseResult();
+    known = false;
+    if (moves.empty()) {
+        result.wdl = position.isInCheck() ? -1 : 0;
+        known = true;
+        return true;
+    }
+
+    int shortestLoss = TABLEBASE_MAX_DISTANCE + 1;
+    int longestWin = -1;
+    bool allWins = true;
+    for (const BitMove& move : moves) {
+        TablebaseResult child;
+        bool childKnown;
+        if (!childResult(build, position, move, limit, child, childKnown, deepestSmaller)) {
+            return false;
+        }
+        if (!childKnown || child.wdl <= 0) {
+            allWins = false;
+        }
+        if (childKnown && child.wdl < 0) {
+            shortestLoss = std::min(shortestLoss, child.distance);
+        } else if (childKnown && child.wdl > 0) {
+            longestWin = std::max(longestWin, child.distance);
+        }
+    }
+    if (shortestLoss + 1 <= limit) {
+        result = TablebaseResult{ 1, shortestLoss + 1 };
+        known = true;
+    } else if (shortestLoss > TABLEBASE_MAX_DISTANCE && allWins && longestWin + 1 <= limit) {
+        result = TablebaseResult{ -1, longestWin + 1 };
+        known = true;
+    }
+    return true;
+}
+
+// One level over a slice of the unsolved positions, every one of them mate in level plies or more;
+// what it solves is only written back once every slice is done, so the level reads nothing but earlier levels
+static void solveLevel(const TableBuild& build, const uint32_t* indices, size_t count, int level,
+                       std::vector<std::pair<uint32_t, uint8_t>>& solved, int& deepestSmaller, bool& missing)
+{
+    GameState position;
+    for (size_t i = 0; i < count; i++) {
+        if (!setUpEntry(build, indices[i], position)) {
+            continue;
+        }
+        TablebaseResult result;
+        bool known;
+        if (!solve(build, position, level, result, known, deepestSmaller)) {
+            missing = true;
+            return;
+        }
+        if (known) {
+            solved.push_back({ indices[i], Tablebase::encode(result) });
+        }
+    }
+}
+
+static bool buildTable(TableBuild& build, int threads)
+{
+    const uint64_t count = Tablebase::entryCount(static_cast<int>(build.pieces.size()));
+    build.entries.assign(count, 0);
+    build.solved.assign(count, 0);
+    std::vector<uint32_t> unsolved;
+    GameState position;
+    for (uint64_t index = 0; index < count; index++) {
+        if (setUpEntry(build, index, position)) {
+            unsolved.push_back(static_cast<uint32_t>(index));
+        }
+    }
+
+    int deepestSmaller = 0;
+    for (int level = 0; level <= TABLEBASE_MAX_DISTANCE; level++) {
+        std::vector<std::vector<std::pair<uint32_t, uint8_t>>> solved(threads);
+        std::vector<int> deepest(threads, 0);
+        std::vector<char> missing(threads, 0);
+        std::vector<std::thread> workers;
+        const size_t slice = (unsolved.size() + threads - 1) / threads;
+        for (int t = 0; t < threads; t++) {
+            const size_t first = std::min(unsolved.size(), slice * t);
+            const size_t size = std::min(unsolved.size() - first, slice);
+            workers.emplace_back([&, t, first, size]() {
+                bool lost = false;
+                solveLevel(build, unsolved.data() + first, size, level, solved[t], deepest[t], lost);
+                missing[t] = lost;
+            });
+        }
+        size_t added = 0;
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+            if (missing[t]) {
+                std::fprintf(stderr, "%s: a smaller table is missing\n", build.name.c_str());
+                return false;
+            }
+            deepestSmaller = std::max(deepestSmaller, deepest[t]);
+            for (const auto& [index, entry] : solved[t]) {
+                build.entries[index] = entry;
+                build.solved[index] = 1;
+            }
+            added += solved[t].size();
+        }
+        if (added) {
+            unsolved.erase(std::remove_if(unsolved.begin(), unsolved.end(), [&](uint32_t index) { return build.solved[index] != 0; }),
+                           unsolved.end());
+        }
+        // nothing left at this distance here or in the smaller tables, so nothing deeper can follow
+        if (level > 0 && added == 0 && level > deepestSmaller) {
+            return true;
+        }
+    }
+    std::fprintf(stderr, "%s: mates longer than %d plies don't fit\n", build.name.c_str(), TABLEBASE_MAX_DISTANCE);
+    return false;
+}
+
+// Every position of a solved table probed back through Tablebase, as itself and as its colour mirror,
+// which the probe indexes from the other side (or, for even material, as another entry of the same
+// table). Both must give what was solved; bad is left at the first index that doesn't
+static void checkSlice(const TableBuild& build, const Tablebase& tables, uint64_t first, uint64_t last, uint64_t& bad)
+{
+    GameState position;
+    GameState mirror;
+    for (uint64_t index = first; index < last; index++) {
+        if (!setUpEntry(build, index, position)) {
+            continue;
+        }
+        setUpEntry(build, index, mirror, true);
+        TablebaseResult direct;
+        TablebaseResult mirrored;
+        if (!tables.probe(position, direct) || !tables.probe(mirror, mirrored) ||
+            Tablebase::encode(direct) != build.entries[index] || Tablebase::encode(mirrored) != build.entries[index]) {
+            bad = index;
+            return;
+        }
+    }
+}
+
+static bool checkTable(const TableBuild& build, const Tablebase& tables, int threads)
+{
+    const uint64_t count = build.entries.size();
+    const uint64_t slice = (count + threads - 1) / threads;
+    std::vector<uint64_t> bad(threads, count);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            checkSlice(build, tables, std::min(count, slice * t), std::min(count, slice * (t + 1)), bad[t]);
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (uint64_t index : bad) {
+        if (index < count) {
+            GameState position;
+            GameState mirror;
+            setUpEntry(build, index, position);
+            setUpEntry(build, index, mirror, true);
+            TablebaseResult direct;
+            TablebaseResult mirrored;
+            tables.probe(position, direct);
+            tables.probe(mirror, mirrored);
+            std::fprintf(stderr, "%s: %s solved as %d probes as %d, its mirror %s as %d\n", build.name.c_str(),
+                         position.toFEN().c_str(), build.entries[index], Tablebase::encode(direct),
+                         mirror.toFEN().c_str(), Tablebase::encode(mirrored));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeTable(const TableBuild& build, const std::string& path)
+{
+    TablebaseHeader header{};
+    header.magic = TABLEBASE_MAGIC;
+    header.version = TABLEBASE_VERSION;
+    std::strncpy(header.name, build.name.c_str(), sizeof(header.name) - 1);
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    const bool written = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+                         std::fwrite(build.entries.data(), 1, build.entries.size(), out) == build.entries.size();
+    return std::fclose(out) == 0 && written;
+}
+
+int main(int argc, char** argv)
+{
+    int maxPieces = 3;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    std::string directory;
+    bool usage = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-pieces" && i + 1 < argc) {
+            maxPieces = std::atoi(argv[++i]);
+        } else if (arg == "-threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (directory.empty() && !arg.empty() && arg[0] != '-') {
+            directory = arg;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || directory.empty() || maxPieces < 3 || maxPieces > TABLEBASE_MAX_PIECES) {
+        std::fprintf(stderr, "usage: %s [-pieces 3..%d] [-threads n] directory\n", argv[0], TABLEBASE_MAX_PIECES);
+        return 2;
+    }
+    threads = std::max(1, threads);
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    for (const std::string& name : Tablebase::tableNames(maxPieces)) {
+        const std::string path = directory + "/" + name + ".ctb";
+        if (std::filesystem::exists(path)) {
+            continue;
+        }
+        // reopened for every table, so it sees the ones just written
+        Tablebase smaller;
+        smaller.open(directory);
+
+        const auto start = std::chrono::steady_clock::now();
+        TableBuild build;
+        build.name = name;
+        build.pieces = Tablebase::indexPieces(name);
+        build.smaller = &smaller;
+        if (!buildTable(build, threads)) {
+            return 1;
+        }
+        smaller.addTable(name, build.entries.data());
+        if (!checkTable(build, smaller, threads)) {
+            return 1;
+        }
+        if (!writeTable(build, path)) {
+            std::fprintf(stderr, "could not write %s\n", path.c_str());
+            return 1;
+        }
+
+        int longest = 0;
+        uint64_t wins = 0;
+        uint64_t losses = 0;
+        for (uint64_t index = 0; index < build.entries.size(); index++) {
+            const TablebaseResult result = Tablebase::decode(build.entries[index]);
+            longest = std::max(longest, result.distance);
+            wins += result.wdl > 0;
+            losses += result.wdl < 0;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-8s %10llu wins %10llu losses, longest mate %3d plies, %.1f s\n", name.c_str(),
+                    static_cast<unsigned long long>(wins), static_cast<unsigned long long>(losses), longest, seconds);
+        std::fflush(stdout);
+    }
+    return 0;
+}
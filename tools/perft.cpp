@@ -0,0 +1,197 @@
+//
+// perft - headless move generator check and speed benchmark for GameState
+//
+//   perft                      run the standard suite, exit code 1 on any node count mismatch
+//   perft -d 4                 same, but no position is searched deeper than 4 plies
+//   perft -sliders magic       force magic (or pext) slider lookups, to compare the two
+//   perft divide 3 "<fen>"     per move node counts for one position, for chasing down a mismatch
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../classes/GameState.h"
+#include "../classes/Notation.h"
+
+struct PerftCheck {
+    int depth;
+    uint64_t nodes;
+};
+
+struct PerftPosition {
+    const char* name;
+    const char* fen;
+    std::vector<PerftCheck> expected;   // in increasing depth
+};
+
+// the chessprogramming.org perft positions at every depth, plus the tricky endgame suite (en passant
+// discovered checks, castling through attacks, promotions into check) at its published depth
+static const std::vector<PerftPosition> perftSuite = {
+    { "startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+      { { 1, 20 }, { 2, 400 }, { 3, 8902 }, { 4, 197281 }, { 5, 4865609 }, { 6, 119060324 } } },
+    { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+      { { 1, 48 }, { 2, 2039 }, { 3, 97862 }, { 4, 4085603 }, { 5, 193690690 } } },
+    { "position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+      { { 1, 14 }, { 2, 191 }, { 3, 2812 }, { 4, 43238 }, { 5, 674624 }, { 6, 11030083 }, { 7, 178633661 } } },
+    { "position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+      { { 1, 6 }, { 2, 264 }, { 3, 9467 }, { 4, 422333 }, { 5, 15833292 } } },
+    { "position 4 mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+      { { 1, 6 }, { 2, 264 }, { 3, 9467 }, { 4, 422333 }, { 5, 15833292 } } },
+    { "position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+      { { 1, 44 }, { 2, 1486 }, { 3, 62379 }, { 4, 2103487 }, { 5, 89941194 } } },
+    { "position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+      { { 1, 46 }, { 2, 2079 }, { 3, 89890 }, { 4, 3894594 }, { 5, 164075551 } } },
+    { "illegal ep move 1", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", { { 6, 1134888 } } },
+    { "illegal ep move 2", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", { { 6, 1015133 } } },
+    { "ep capture checks opponent", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", { { 6, 1440467 } } },
+    { "short castling gives check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", { { 6, 661072 } } },
+    { "long castling gives check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", { { 6, 803711 } } },
+    { "castle rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", { { 4, 1274206 } } },
+    { "castling prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", { { 4, 1720476 } } },
+    { "promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", { { 6, 3821001 } } },
+    { "discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", { { 5, 1004658 } } },
+    { "promote to give check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", { { 6, 217342 } } },
+    { "underpromote to check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1", { { 6, 92683 } } },
+    { "self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1", { { 6, 2217 } } },
+    { "stalemate and checkmate 1", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", { { 7, 567584 } } },
+    { "stalemate and checkmate 2", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", { { 4, 23527 } } },
+};
+
+// bulk counted: the last ply only counts the generated moves instead of making them
+static uint64_t perft(GameState& gamestate, int depth)
+{
+    MoveList moves;
+    gamestate.generateAllMoves(moves);
+    if (depth <= 1) {
+        return depth == 1 ? moves.size() : 1;
+    }
+    uint64_t nodes = 0;
+    for (const BitMove& move : moves) {
+        gamestate.pushMove(move);
+        nodes += perft(gamestate, depth - 1);
+        gamestate.popState();
+    }
+    return nodes;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int divide(int depth, const std::string& fen)
+{
+    GameState gamestate;
+    if (!gamestate.loadFEN(fen)) {
+        std::fprintf(stderr, "bad FEN: %s\n", fen.c_str());
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    MoveList moves;
+    gamestate.generateAllMoves(moves);
+    uint64_t total = 0;
+    for (const BitMove& move : moves) {
+        gamestate.pushMove(move);
+        const uint64_t nodes = perft(gamestate, depth - 1);
+        gamestate.popState();
+        std::printf("%s: %llu\n", moveToUCI(move).c_str(), static_cast<unsigned long long>(nodes));
+        total += nodes;
+    }
+    const double seconds = secondsSince(start);
+    std::printf("\nmoves %d nodes %llu time %.3fs nps %.0f\n", moves.size(), static_cast<unsigned long long>(total),
+                seconds, seconds > 0.0 ? total / seconds : 0.0);
+    return 0;
+}
+
+static int runSuite(int maxDepth)
+{
+    int failures = 0;
+    uint64_t totalNodes = 0;
+    double totalSeconds = 0.0;
+
+    for (const PerftPosition& position : perftSuite) {
+        GameState gamestate;
+        if (!gamestate.loadFEN(position.fen)) {
+            std::printf("%-28s bad FEN\n", position.name);
+            failures++;
+            continue;
+        }
+        const uint64_t hash = gamestate.getZobristHash();
+
+        // writing the position back out and reading it again must give the same position
+        GameState reloaded;
+        if (!reloaded.loadFEN(gamestate.toFEN()) || reloaded.getZobristHash() != hash) {
+            std::printf("%-28s FEN round trip failed: %s\n", position.name, gamestate.toFEN().c_str());
+            failures++;
+        }
+
+        for (size_t i = 0; i < position.expected.size(); i++) {
+            const PerftCheck& check = position.expected[i];
+            if (check.depth > maxDepth) {
+                break;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            const uint64_t nodes = perft(gamestate, check.depth);
+            const double seconds = secondsSince(start);
+            totalNodes += nodes;
+            totalSeconds += seconds;
+
+            // one line per position unless something is off
+            const bool last = (i + 1 == position.expected.size() || position.expected[i + 1].depth > maxDepth);
+            if (last || nodes != check.nodes) {
+                std::printf("%-28s depth %d nodes %12llu %s  %7.3fs  %6.1f Mnps\n", position.name, check.depth,
+                            static_cast<unsigned long long>(nodes), nodes == check.nodes ? "ok  " : "FAIL",
+                            seconds, seconds > 0.0 ? nodes / seconds / 1e6 : 0.0);
+            }
+            if (nodes != check.nodes) {
+                std::printf("    expected %llu\n", static_cast<unsigned long long>(check.nodes));
+                failures++;
+                break;
+            }
+        }
+
+        // every pushMove was matched by a popState, so the incremental hash must be back where it started
+        if (gamestate.getZobristHash() != hash || hash != gamestate.computeZobristHash()) {
+            std::printf("%-28s hash not restored\n", position.name);
+            failures++;
+        }
+    }
+
+    std::printf("\ntotal nodes %llu time %.3fs nps %.0f\n", static_cast<unsigned long long>(totalNodes), totalSeconds,
+                totalSeconds > 0.0 ? totalNodes / totalSeconds : 0.0);
+    if (failures) {
+        std::printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    std::printf("all positions match\n");
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 4 && std::strcmp(argv[1], "divide") == 0) {
+        return divide(std::atoi(argv[2]), argv[3]);
+    }
+
+    int maxDepth = 64;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            maxDepth = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "-sliders") == 0 && i + 1 < argc) {
+            if (!GameState::selectSliderLookup(argv[++i])) {
+                std::fprintf(stderr, "slider lookup %s is not available here\n", argv[i]);
+                return 2;
+            }
+        } else {
+            std::fprintf(stderr, "usage: %s [-d maxDepth] [-sliders magic|pext] | divide <depth> \"<fen>\"\n", argv[0]);
+            return 2;
+        }
+    }
+    std::printf("slider lookup: %s\n", GameState::sliderLookup());
+    return runSuite(maxDepth);
+}
@@ -0,0 +1,140 @@
+//
+// quantize - convert the float ChessEval model into the integer QuantizedEval format
+//
+//   quantize                               resources/models/neural_final.bin -> neural_final.qbin
+//   quantize -n 20000 in.bin out.qbin      choose the files and the number of sample positions
+//
+// Sample positions come from seeded random playouts, so every run sees the same set. The first half
+// calibrates the activation ranges, the second half measures how far the integer net strays from the
+// float one.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "../classes/ChessEval.h"
+#include "../classes/GameState.h"
+#include "../classes/QuantizedEval.h"
+
+struct SamplePosition {
+    char state[64];
+    PositionContext context;
+};
+
+static PositionContext contextOf(const GameState& gamestate)
+{
+    PositionContext context;
+    context.whiteToMove = (gamestate.color == WHITE);
+    context.whiteCastleKingside = (gamestate.castlingRights & WhiteKingSide) != 0;
+    context.whiteCastleQueenside = (gamestate.castlingRights & WhiteQueenSide) != 0;
+    context.blackCastleKingside = (gamestate.castlingRights & BlackKingSide) != 0;
+    context.blackCastleQueenside = (gamestate.castlingRights & BlackQueenSide) != 0;
+    return context;
+}
+
+// every position along random games from the start, up to 120 plies each
+static std::vector<SamplePosition> samplePositions(int count)
+{
+    std::vector<SamplePosition> positions;
+    std::mt19937 rng(20240601);
+    while (static_cast<int>(positions.size()) < count) {
+        GameState gamestate;
+        gamestate.init("RNBQKBNRPPPPPPPP00000000000000000000000000000000pppppppprnbqkbnr", WHITE, AllCastling);
+        for (int ply = 0; ply < 120 && static_cast<int>(positions.size()) < count; ply++) {
+            MoveList moves;
+            gamestate.generateAllMoves(moves);
+            if (moves.empty()) {
+                break;
+            }
+            gamestate.pushMove(moves[rng() % moves.size()]);
+
+            SamplePosition position;
+            std::memcpy(position.state, gamestate.state, sizeof(position.state));
+            position.context = contextOf(gamestate);
+            positions.push_back(position);
+        }
+    }
+    return positions;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    std::string input = "resources/models/neural_final.bin";
+    std::string output = "resources/models/neural_final.qbin";
+    int samples = 10000;
+
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            samples = std::max(2, std::atoi(argv[++i]));
+        } else if (argv[i][0] != '-') {
+            files.push_back(argv[i]);
+        } else {
+            std::fprintf(stderr, "usage: %s [-n samples] [in.bin [out.qbin]]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (files.size() > 0) input = files[0];
+    if (files.size() > 1) output = files[1];
+
+    ChessEval floatEval;
+    if (!floatEval.loadModel(input)) {
+        std::fprintf(stderr, "could not load %s\n", input.c_str());
+        return 1;
+    }
+
+    const std::vector<SamplePosition> positions = samplePositions(samples);
+    const size_t half = positions.size() / 2;
+    std::vector<ActiveFeatures> calibration;
+    for (size_t i = 0; i < half; i++) {
+        calibration.push_back(ChessEval::encodePosition(positions[i].state, positions[i].context));
+    }
+
+    QuantizedEval quantized;
+    quantized.quantize(floatEval, calibration);
+    if (!quantized.saveModel(output)) {
+        std::fprintf(stderr, "could not write %s\n", output.c_str());
+        return 1;
+    }
+
+    // accuracy and speed on the held out half
+    std::vector<int> floatScores;
+    std::vector<int> quantizedScores;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = half; i < positions.size(); i++) {
+        floatScores.push_back(floatEval.evaluate(positions[i].state, positions[i].context));
+    }
+    const double floatSeconds = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = half; i < positions.size(); i++) {
+        quantizedScores.push_back(quantized.evaluate(positions[i].state, positions[i].context));
+    }
+    const double quantizedSeconds = secondsSince(start);
+
+    double totalError = 0.0;
+    int maxError = 0;
+    for (size_t i = 0; i < floatScores.size(); i++) {
+        const int error = std::abs(floatScores[i] - quantizedScores[i]);
+        totalError += error;
+        maxError = std::max(maxError, error);
+    }
+
+    const size_t tested = floatScores.size();
+    std::printf("wrote %s (%zu bytes of weights)\n", output.c_str(), quantized.weightBytes());
+    std::printf("calibrated on %zu positions, tested on %zu\n", half, tested);
+    std::printf("mean abs delta %.2f cp, max %d cp\n", tested ? totalError / tested : 0.0, maxError);
+    std::printf("float %.2f us/eval, quantized %.2f us/eval\n", tested ? floatSeconds * 1e6 / tested : 0.0,
+                tested ? quantizedSeconds * 1e6 / tested : 0.0);
+    return 0;
+}
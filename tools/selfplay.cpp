@@ -0,0 +1,565 @@
+//
+// selfplay - headless engine against engine matches on every core, for measuring strength changes
+//
+//   selfplay -games 1000                      the engine against itself, 100 ms a move
+//   selfplay -model1 new.bin -model2 old.bin  two networks against each other
+//   selfplay -off1 lmr                        the same network with a SearchOption switched off on one side
+//   selfplay -tc 10+0.1                       a clock of 10 s plus 0.1 s a move instead of a fixed move time
+//   selfplay -movetime 50 -depth1 8           per engine limits: -movetime1/2, -depth1/2, -tc1/2
+//   selfplay -book openings.epd               one FEN (or EPD, the first four fields) a line, # comments
+//   selfplay -concurrency 8                   games played at once, every hardware thread by default
+//   selfplay -pgn games.pgn                   every finished game, in the order they finished
+//   selfplay -sprt 0 5                        stop once the SPRT of elo0 against elo1 has decided
+//   selfplay -data games                      training data as well: games.0.bin, games.1.bin, ... one per worker
+//   selfplay -tb resources/tablebases         both engines probe the endgame tables, mapped once for every worker
+//
+// Each opening is played twice with the colours swapped. A worker thread plays one game at a time
+// with its own pair of searches (TT, eval cache and history), cleared before every game; only the
+// networks, which are read-only, are shared. Games end on mate, stalemate, the fifty move rule,
+// threefold repetition, bare minor pieces, a flag falling, or as a draw after -maxplies plies.
+// Results are from engine 1's side: Elo with its 95% interval, and the SPRT's log likelihood ratio
+// against bounds for alpha = beta = 0.05.
+//
+// With -data every searched position is written in the training format with its search score and
+// the game's result, for train -lambda to blend. Positions in check, with a mate score, or whose best
+// move captures or promotes are left out: the static evaluation can't see what the search found there.
+// Each worker appends to its own shard through a buffered writer, so nothing is shared for the data;
+// train takes all the shards at once.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../classes/ChessSearch.h"
+#include "../classes/Notation.h"
+#include "../classes/TrainingData.h"
+
+// the untrained network's weights when no model is given, the same as bench's
+static const uint32_t SELFPLAY_NETWORK_SEED = 0x5eed;
+
+static const char* const defaultBook[] = {
+    "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1",
+    "rnbqkbnr/pppppppp/8/8/3P4/8/PPP1PPPP/RNBQKBNR b KQkq - 0 1",
+    "rnbqkbnr/pppppppp/8/8/2P5/8/PP1PPPPP/RNBQKBNR b KQkq - 0 1",
+    "rnbqkbnr/pppppppp/8/8/8/5N2/PPPPPPPP/RNBQKB1R b KQkq - 1 1",
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pppp1ppp/4p3/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pp1ppppp/2p5/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkb1r/pppppppp/5n2/8/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 1 2",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pppp1ppp/4pn2/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkbnr/pp2pppp/2p5/3p4/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkb1r/pp1ppppp/5n2/2p5/2P5/2N5/PP1PPPPP/R1BQKBNR w KQkq - 2 3",
+    "rnbqkbnr/pp2pppp/3p4/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 0 3",
+};
+
+struct TimeControl {
+    int moveTimeMs = 100;   // per move when baseMs is 0
+    int baseMs = 0;         // a clock for the whole game, with incrementMs added after each move
+    int incrementMs = 0;
+    int depth = 0;          // a depth limit on top of the clock, 0 for none
+};
+
+struct EngineConfig {
+    std::string name;
+    std::string model;
+    SearchOptions options;
+    TimeControl timeControl;
+    std::shared_ptr<const ChessEval> evaluator;
+};
+
+enum GameResult { WhiteWins, BlackWins, Draw };
+
+struct GameRecord {
+    GameResult result = Draw;
+    bool engine1White = true;
+    std::string termination;
+    std::string pgn;
+};
+
+// a 10+0.1 style clock in seconds, false if it doesn't parse
+static bool parseTimeControl(const char* text, TimeControl& timeControl)
+{
+    char* end = nullptr;
+    const double base = std::strtod(text, &end);
+    double increment = 0.0;
+    if (end == text || base <= 0.0) {
+        return false;
+    }
+    if (*end == '+') {
+        const char* start = end + 1;
+        increment = std::strtod(start, &end);
+        if (end == start || increment < 0.0) {
+            return false;
+        }
+    }
+    if (*end != '\0') {
+        return false;
+    }
+    timeControl.baseMs = static_cast<int>(base * 1000.0);
+    timeControl.incrementMs = static_cast<int>(increment * 1000.0);
+    return true;
+}
+
+static bool loadBook(const char* path, std::vector<std::string>& book)
+{
+    FILE* file = std::fopen(path, "r");
+    if (!file) {
+        std::fprintf(stderr, "could not open %s\n", path);
+        return false;
+    }
+    char line[512];
+    int lineNumber = 0;
+    std::string fen;
+    while (std::fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        if (!parseEpdLine(line, fen)) {
+            continue;
+        }
+        GameState state;
+        if (!state.loadFEN(fen)) {
+            std::fprintf(stderr, "%s:%d: not a FEN, skipped\n", path, lineNumber);
+            continue;
+        }
+        book.push_back(state.toFEN());
+    }
+    std::fclose(file);
+    return true;
+}
+
+static const char* resultText(GameResult result)
+{
+    return result == WhiteWins ? "1-0" : result == BlackWins ? "0-1" : "1/2-1/2";
+}
+
+// kings with at most one knight or bishop between them can't mate
+static bool insufficientMaterial(const GameState& state)
+{
+    int minors = 0;
+    for (int square = 0; square < 64; square++) {
+        switch (state.state[square]) {
+        case '0': case 'K': case 'k':
+            break;
+        case 'N': case 'n': case 'B': case 'b':
+            minors++;
+            break;
+        default:
+            return false;
+        }
+    }
+    return minors <= 1;
+}
+
+static TrainingSample trainingSample(const GameState& state, int whiteScore)
+{
+    TrainingSample sample;
+    std::memcpy(sample.state, state.state, sizeof(sample.state));
+    sample.context.whiteToMove = state.color == WHITE;
+    sample.context.whiteCastleKingside = (state.castlingRights & WhiteKingSide) != 0;
+    sample.context.whiteCastleQueenside = (state.castlingRights & WhiteQueenSide) != 0;
+    sample.context.blackCastleKingside = (state.castlingRights & BlackKingSide) != 0;
+    sample.context.blackCastleQueenside = (state.castlingRights & BlackQueenSide) != 0;
+    sample.target = whiteScore;
+    return sample;
+}
+
+class Worker {
+public:
+    Worker(const EngineConfig (&engines)[2], int hashMB, const std::shared_ptr<const Tablebase>& tablebase) : _engines(engines) {
+        for (int e = 0; e < 2; e++) {
+            _searches[e] = std::make_unique<ChessSearch>(*engines[e].evaluator);
+            _searches[e]->setThreads(1);
+            _searches[e]->setOptions(engines[e].options);
+            _searches[e]->setLogLevel(LogLevel::Warning);
+            _searches[e]->resizeTT(hashMB);
+            _searches[e]->setTablebase(tablebase);
+        }
+    }
+
+    // samples, when given, receives the positions to train on, their results filled in once the game is over
+    GameRecord play(const std::string& opening, bool engine1White, int maxPlies, int round, std::vector<TrainingSample>* samples) {
+        GameRecord record;
+        if (samples) {
+            samples->clear();
+        }
+        record.engine1White = engine1White;
+        for (auto& search : _searches) {
+            search->newGame();
+        }
+
+        GameState state;
+        state.loadFEN(opening);
+        const int white = engine1White ? 0 : 1;
+        int remainingMs[2] = { _engines[0].timeControl.baseMs, _engines[1].timeControl.baseMs };
+        std::string moves;
+        int plies = 0;
+        bool over = false;
+        while (!over) {
+            MoveList legal;
+            state.generateAllMoves(legal);
+            const bool whiteToMove = state.color == WHITE;
+            if (legal.empty()) {
+                record.result = !state.isInCheck() ? Draw : (whiteToMove ? BlackWins : WhiteWins);
+                record.termination = !state.isInCheck() ? "stalemate" : "checkmate";
+                break;
+            }
+            if (state.halfmoveClock >= 100) {
+                record.termination = "fifty move rule";
+                break;
+            }
+            if (state.repetitions(2) >= 2) {
+                record.termination = "threefold repetition";
+                break;
+            }
+            if (insufficientMaterial(state)) {
+                record.termination = "insufficient material";
+                break;
+            }
+            if (plies >= maxPlies) {
+                record.termination = "adjudicated after " + std::to_string(maxPlies) + " plies";
+                break;
+            }
+
+            const int engine = whiteToMove ? white : 1 - white;
+            const TimeControl& timeControl = _engines[engine].timeControl;
+            SearchLimits limits;
+            limits.maxDepth = timeControl.depth > 0 ? timeControl.depth : MAX_SEARCH_DEPTH;
+            // on a clock the search's time manager decides how much of it this move gets
+            if (timeControl.baseMs > 0) {
+                limits.timeLeftMs = std::max(1, remainingMs[engine]);
+                limits.incrementMs = timeControl.incrementMs;
+            } else {
+                limits.moveTimeMs = timeControl.moveTimeMs;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            const SearchResult result = _searches[engine]->search(state, limits);
+            const int elapsedMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+            const BitMove move = result.rootMoves[0].move;
+            const int score = result.rootMoves[0].score;
+            if (samples && !state.isInCheck() && std::abs(score) < DECIDED_SCORE
+                && !(move.flags & (IsCapture | EnPassant | IsPromotion))) {
+                samples->push_back(trainingSample(state, whiteToMove ? score : -score));
+            }
+
+            if (whiteToMove || plies == 0) {
+                moves += std::to_string(state.fullmoveNumber) + (whiteToMove ? ". " : "... ");
+            }
+            moves += moveToSAN(state, move, legal) + " ";
+            state.pushMove(move);
+            plies++;
+
+            if (timeControl.baseMs > 0) {
+                remainingMs[engine] -= elapsedMs;
+                if (remainingMs[engine] < 0) {
+                    // what is on the board could still be a draw, but flagging is the common verdict
+                    record.result = whiteToMove ? BlackWins : WhiteWins;
+                    record.termination = "time forfeit";
+                    over = true;
+                }
+                remainingMs[engine] += timeControl.incrementMs;
+            }
+        }
+
+        if (samples) {
+            for (TrainingSample& sample : *samples) {
+                sample.hasResult = true;
+                sample.result = record.result == WhiteWins ? 1 : record.result == BlackWins ? -1 : 0;
+            }
+        }
+        const std::string result = resultText(record.result);
+        char header[1024];
+        std::snprintf(header, sizeof(header),
+                      "[Event \"selfplay\"]\n[Round \"%d\"]\n[White \"%s\"]\n[Black \"%s\"]\n[Result \"%s\"]\n"
+                      "[FEN \"%s\"]\n[SetUp \"1\"]\n[Termination \"%s\"]\n\n",
+                      round, _engines[white].name.c_str(), _engines[1 - white].name.c_str(), result.c_str(),
+                      opening.c_str(), record.termination.c_str());
+        record.pgn = header + moves + result + "\n\n";
+        return record;
+    }
+
+private:
+    const EngineConfig (&_engines)[2];
+    std::unique_ptr<ChessSearch> _searches[2];
+};
+
+struct Score {
+    int wins = 0;   // engine 1's
+    int draws = 0;
+    int losses = 0;
+
+    int games() const { return wins + draws + losses; }
+    double points() const { return wins + 0.5 * draws; }
+};
+
+static double eloFromScore(double score)
+{
+    if (score <= 0.0) return -INFINITY;
+    if (score >= 1.0) return INFINITY;
+    return 400.0 * std::log10(score / (1.0 - score));
+}
+
+static double scoreFromElo(double elo)
+{
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+// the normal approximation to the trinomial GSPRT: the log likelihood ratio of the observed mean game
+// score under elo1 against elo0, with the variance measured rather than modelled
+static double sprtLLR(const Score& score, double elo0, double elo1)
+{
+    const int n = score.games();
+    if (n == 0 || score.wins + score.losses == 0) {
+        return 0.0;
+    }
+    const double mean = score.points() / n;
+    const double variance = (score.wins * (1.0 - mean) * (1.0 - mean) + score.draws * (0.5 - mean) * (0.5 - mean)
+                             + score.losses * mean * mean) / n;
+    if (variance <= 0.0) {
+        return 0.0;
+    }
+    const double s0 = scoreFromElo(elo0);
+    const double s1 = scoreFromElo(elo1);
+    return (s1 - s0) * (2.0 * mean - s0 - s1) * n / (2.0 * variance);
+}
+
+static void printScore(const Score& score, bool sprt, double elo0, double elo1, double lower, double upper)
+{
+    const int n = score.games();
+    if (n == 0) {
+        return;
+    }
+    const double mean = score.points() / n;
+    const double variance = (score.wins * (1.0 - mean) * (1.0 - mean) + score.draws * (0.5 - mean) * (0.5 - mean)
+                             + score.losses * mean * mean) / n;
+    const double margin = 1.96 * std::sqrt(variance / n);
+    std::printf("games %d: +%d =%d -%d  score %.1f%%  elo %+.1f [%+.1f, %+.1f]", n, score.wins, score.draws, score.losses,
+                mean * 100.0, eloFromScore(mean), eloFromScore(mean - margin), eloFromScore(mean + margin));
+    if (sprt) {
+        std::printf("  LLR %.2f (%.2f, %.2f) [%g, %g]", sprtLLR(score, elo0, elo1), lower, upper, elo0, elo1);
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    int games = 100;
+    int concurrency = static_cast<int>(std::thread::hardware_concurrency());
+    int hashMB = 16;
+    int maxPlies = 400;
+    std::string bookPath;
+    std::string pgnPath;
+    std::string dataPrefix;
+    std::string tablebasePath;
+    bool sprt = false;
+    double elo0 = 0.0;
+    double elo1 = 5.0;
+    EngineConfig engines[2];
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        // -name applies to both engines, -name1 and -name2 to one
+        const size_t length = std::strlen(arg);
+        const int only = length > 2 && (arg[length - 1] == '1' || arg[length - 1] == '2') ? arg[length - 1] - '1' : -1;
+        const std::string name = only >= 0 ? std::string(arg, length - 1) : std::string(arg);
+        const int first = only >= 0 ? only : 0;
+        const int last = only >= 0 ? only : 1;
+        if (name == "-games" && hasValue) {
+            games = std::atoi(argv[++i]);
+        } else if (name == "-concurrency" && hasValue) {
+            concurrency = std::atoi(argv[++i]);
+        } else if (name == "-hash" && hasValue) {
+            hashMB = std::atoi(argv[++i]);
+        } else if (name == "-maxplies" && hasValue) {
+            maxPlies = std::atoi(argv[++i]);
+        } else if (name == "-book" && hasValue) {
+            bookPath = argv[++i];
+        } else if (name == "-pgn" && hasValue) {
+            pgnPath = argv[++i];
+        } else if (name == "-data" && hasValue) {
+            dataPrefix = argv[++i];
+        } else if (name == "-tb" && hasValue) {
+            tablebasePath = argv[++i];
+        } else if (name == "-sprt" && i + 2 < argc) {
+            sprt = true;
+            elo0 = std::atof(argv[++i]);
+            elo1 = std::atof(argv[++i]);
+        } else if (name == "-model" && hasValue) {
+            for (int e = first; e <= last; e++) engines[e].model = argv[i + 1];
+            i++;
+        } else if (name == "-off" && hasValue) {
+            for (int e = first; e <= last; e++) usage = usage || !engines[e].options.switchOff(argv[i + 1]);
+            i++;
+        } else if (name == "-movetime" && hasValue) {
+            for (int e = first; e <= last; e++) {
+                engines[e].timeControl.moveTimeMs = std::atoi(argv[i + 1]);
+                engines[e].timeControl.baseMs = 0;
+            }
+            i++;
+        } else if (name == "-tc" && hasValue) {
+            for (int e = first; e <= last; e++) usage = usage || !parseTimeControl(argv[i + 1], engines[e].timeControl);
+            i++;
+        } else if (name == "-depth" && hasValue) {
+            for (int e = first; e <= last; e++) engines[e].timeControl.depth = std::atoi(argv[i + 1]);
+            i++;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || games < 1 || concurrency < 1 || hashMB < 1 || maxPlies < 1 || (sprt && elo1 <= elo0)) {
+        std::fprintf(stderr, "usage: %s [-games n] [-concurrency n] [-hash mb] [-maxplies n] [-book file] [-pgn file] [-data prefix] [-tb dir] [-sprt elo0 elo1]\n"
+                             "       [-model[1|2] file.bin] [-off[1|2] pvs|null|lmr|check|aspiration] [-movetime[1|2] ms]\n"
+                             "       [-tc[1|2] seconds+increment] [-depth[1|2] n]\n", argv[0]);
+        return 2;
+    }
+
+    for (int e = 0; e < 2; e++) {
+        EngineConfig& engine = engines[e];
+        // one network per file, shared by every worker
+        if (e == 1 && engine.model == engines[0].model) {
+            engine.evaluator = engines[0].evaluator;
+        } else {
+            auto evaluator = std::make_shared<ChessEval>(SELFPLAY_NETWORK_SEED);
+            if (!engine.model.empty() && !evaluator->loadModel(engine.model)) {
+                std::fprintf(stderr, "could not load %s\n", engine.model.c_str());
+                return 1;
+            }
+            engine.evaluator = evaluator;
+        }
+        engine.name = "engine" + std::to_string(e + 1) + (engine.model.empty() ? "" : " (" + engine.model + ")");
+    }
+
+    std::vector<std::string> book;
+    if (!bookPath.empty()) {
+        if (!loadBook(bookPath.c_str(), book)) {
+            return 1;
+        }
+    } else {
+        book.assign(std::begin(defaultBook), std::end(defaultBook));
+    }
+    if (book.empty()) {
+        std::fprintf(stderr, "the book has no positions\n");
+        return 1;
+    }
+    FILE* pgn = nullptr;
+    if (!pgnPath.empty() && !(pgn = std::fopen(pgnPath.c_str(), "w"))) {
+        std::fprintf(stderr, "could not open %s\n", pgnPath.c_str());
+        return 1;
+    }
+
+    // with alpha = beta = 0.05
+    const double lowerBound = std::log(0.05 / 0.95);
+    const double upperBound = std::log(0.95 / 0.05);
+
+    // workers only share the next game to play, the score and the PGN file
+    std::atomic<int> nextGame(0);
+    std::atomic<bool> stopping(false);
+    std::mutex resultMutex;
+    Score score;
+    int reported = 0;
+    if (concurrency > games) {
+        concurrency = games;
+    }
+    std::printf("%d games, %d at a time, %zu openings\n", games, concurrency, book.size());
+
+    std::shared_ptr<const Tablebase> tablebase;
+    if (!tablebasePath.empty()) {
+        tablebase = Tablebase::shared(tablebasePath);
+        if (tablebase->size() == 0) {
+            std::fprintf(stderr, "no tablebases in %s\n", tablebasePath.c_str());
+            return 1;
+        }
+    }
+
+    std::atomic<uint64_t> positions(0);
+    std::atomic<bool> dataFailed(false);
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < concurrency; w++) {
+        workers.emplace_back([&, w]() {
+            Worker worker(engines, hashMB, tablebase);
+            TrainingDataWriter writer;
+            std::vector<TrainingSample> samples;
+            const bool writing = !dataPrefix.empty();
+            if (writing && !writer.open(dataPrefix + "." + std::to_string(w) + ".bin")) {
+                dataFailed.store(true);
+                stopping.store(true);
+                return;
+            }
+            for (int game = nextGame++; game < games && !stopping.load(); game = nextGame++) {
+                const GameRecord record = worker.play(book[(game / 2) % book.size()], game % 2 == 0, maxPlies, game + 1,
+                                                      writing ? &samples : nullptr);
+                for (const TrainingSample& sample : samples) {
+                    if (!writer.append(sample)) {
+                        dataFailed.store(true);
+                        stopping.store(true);
+                        break;
+                    }
+                }
+                positions += samples.size();
+
+                std::lock_guard<std::mutex> lock(resultMutex);
+                const bool engine1Won = record.result == (record.engine1White ? WhiteWins : BlackWins);
+                if (record.result == Draw) {
+                    score.draws++;
+                } else if (engine1Won) {
+                    score.wins++;
+                } else {
+                    score.losses++;
+                }
+                if (pgn) {
+                    std::fputs(record.pgn.c_str(), pgn);
+                }
+                // a line every tenth of the match, and every game when the match is short
+                if (score.games() - reported >= (games >= 20 ? games / 10 : 1)) {
+                    reported = score.games();
+                    printScore(score, sprt, elo0, elo1, lowerBound, upperBound);
+                }
+                if (sprt) {
+                    const double llr = sprtLLR(score, elo0, elo1);
+                    if (llr <= lowerBound || llr >= upperBound) {
+                        stopping.store(true);
+                    }
+                }
+            }
+            if (writing && !writer.close()) {
+                dataFailed.store(true);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (!dataPrefix.empty()) {
+        std::printf("%llu positions in %s.*.bin\n", static_cast<unsigned long long>(positions.load()), dataPrefix.c_str());
+    }
+    if (pgn) {
+        std::fclose(pgn);
+    }
+
+    std::printf("final ");
+    printScore(score, sprt, elo0, elo1, lowerBound, upperBound);
+    if (sprt) {
+        const double llr = sprtLLR(score, elo0, elo1);
+        std::printf("SPRT: %s\n", llr >= upperBound ? "H1 accepted" : llr <= lowerBound ? "H0 accepted" : "inconclusive");
+    }
+    if (dataFailed.load()) {
+        std::fprintf(stderr, "writing the training data failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+//
+// train - train the evaluation network on a binary training file made by makedata
+//
+//   train positions.bin                          continue resources/models/neural_final.bin, one epoch
+//   train -e 4 -b 512 -t 8 -adam positions.bin model.bin
+//   train -m model.bin -lambda 0.7 selfplay.*.bin  every self-play shard, targets blended with the results
+//
+// Options: -e epochs, -b batch size, -t threads, -lr learning rate, -adam (default plain SGD),
+// -seed shuffle seed, -lambda weight of the evaluation against the game result (1, the evaluation only,
+// by default; positions without a result always train on their evaluation). The model is loaded from
+// its path when it exists, saved there after every epoch. With -m every file named is training data,
+// without it a second file is the model.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../classes/ChessEval.h"
+#include "../classes/TrainingData.h"
+
+int main(int argc, char** argv)
+{
+    std::string modelPath = "resources/models/neural_final.bin";
+    bool modelGiven = false;
+    float lambda = 1.0f;
+    int epochs = 1;
+    unsigned long long seed = 1;
+    TrainingOptions options;
+    options.logEvery = 1000;
+
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "-e") == 0 && hasValue) {
+            epochs = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-b") == 0 && hasValue) {
+            options.batchSize = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-t") == 0 && hasValue) {
+            options.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-lr") == 0 && hasValue) {
+            options.learningRate = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "-seed") == 0 && hasValue) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-lambda") == 0 && hasValue) {
+            lambda = std::max(0.0f, std::min(1.0f, static_cast<float>(std::atof(argv[++i]))));
+        } else if (std::strcmp(argv[i], "-m") == 0 && hasValue) {
+            modelPath = argv[++i];
+            modelGiven = true;
+        } else if (std::strcmp(argv[i], "-adam") == 0) {
+            options.optimizer = TrainingOptions::Adam;
+        } else if (argv[i][0] != '-') {
+            files.push_back(argv[i]);
+        } else {
+            files.clear();
+            break;
+        }
+    }
+    if (files.empty() || (!modelGiven && files.size() > 2)) {
+        std::fprintf(stderr, "usage: %s [-e epochs] [-b batch] [-t threads] [-lr rate] [-adam] [-seed n] [-lambda l] data.bin [model.bin]\n"
+                             "       %s [options] -m model.bin data.bin...\n", argv[0], argv[0]);
+        return 2;
+    }
+    if (!modelGiven && files.size() == 2) {
+        modelPath = files.back();
+        files.pop_back();
+    }
+
+    TrainingDataset dataset;
+    if (!dataset.open(files)) {
+        return 1;
+    }
+
+    ChessEval eval;
+    if (std::ifstream(modelPath).good() && !eval.loadModel(modelPath)) {
+        std::fprintf(stderr, "%s is not a model for this network\n", modelPath.c_str());
+        return 1;
+    }
+
+    // a few batches per trainBatch call, so the shuffled index is walked in large steps
+    const int chunk = options.batchSize * 16;
+    std::vector<TrainingSample> batch;
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        const auto start = std::chrono::steady_clock::now();
+        dataset.shuffle(seed + epoch);
+        double errorSum = 0.0;
+        size_t trained = 0;
+        int count;
+        while ((count = dataset.nextBatch(batch, chunk)) > 0) {
+            if (lambda < 1.0f) {
+                for (int i = 0; i < count; i++) {
+                    batch[i].target = blendedTarget(batch[i], lambda);
+                }
+            }
+            errorSum += static_cast<double>(eval.trainBatch(batch.data(), count, options)) * count;
+            trained += count;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("epoch %d: %zu positions, mean error %.1f cp, %.0f positions/s\n", epoch + 1, trained,
+                    trained ? errorSum / trained : 0.0, seconds > 0.0 ? trained / seconds : 0.0);
+        if (!eval.saveModel(modelPath)) {
+            return 1;
+        }
+    }
+    std::printf("%s", eval.getTrainingStatus().c_str());
+    return 0;
+}
@@ -0,0 +1,458 @@
+//
+// tune - fit the tapered piece-square tables to training data, Texel style
+//
+//   tune positions.bin                          every position, written to classes/TunedPieceSquareTables.h
+//   tune -lambda 0.5 selfplay.*.bin             targets half the evaluation, half the game result
+//   tune -i 2000 -lr 0.5 -t 8 -n 4000000 -o tuned.h positions.bin
+//
+// Options: -i iterations (1000), -lr Adam step in centipawns (1), -t threads (every core), -n at most
+// this many positions from the start of the data, -lambda weight of the evaluation against the game
+// result (0.5; positions without a result always use their evaluation), -o the header to write.
+//
+// Every position is first resolved with a capture-only search on the tables themselves, and the
+// quiet position at the end of its principal variation is what gets tuned on; positions in check and
+// mates are left out. The resolved positions are kept in memory as fixed size records of at most 32
+// (entry, colour) features and the phase, so each iteration is a pass over one flat array. An
+// iteration is a full batch gradient step on the mean squared error between the target's and the
+// tables' win probabilities (400 centipawns to a factor of ten in the odds, as in blendedTarget),
+// split over the threads, each summing the gradients of its slice. The tables start from the ones
+// compiled in and are written, material split back out, every 100 iterations and at the end, as a
+// header that replaces the PeSTO values when the engine is built with CHESS_TUNED_PST.
+//
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../classes/GameState.h"
+#include "../classes/TrainingData.h"
+
+namespace {
+    constexpr int TUNE_MAX_FEATURES = 32;
+    constexpr int TUNE_ENTRIES = 6 * 64;          // a type's 64 squares, seen from white with rank 8 on top
+    constexpr uint16_t TUNE_BLACK = 0x8000;       // the feature counts negative
+    constexpr uint16_t TUNE_UNUSED = TUNE_ENTRIES; // pads the features, its entry stays zero
+    constexpr int TUNE_QUIESCENCE_PLIES = 16;
+    constexpr int TUNE_MAX_TARGET = 5000;         // centipawns, beyond it a target is a mate as in trainBatch
+    constexpr int TUNE_WRITE_EVERY = 100;
+
+    // one resolved position, 72 bytes
+    struct TunePosition {
+        uint16_t features[TUNE_MAX_FEATURES];   // entry | TUNE_BLACK, unused ones TUNE_UNUSED
+        float target;                           // white's win probability
+        uint8_t phase;                          // 0..PST_MAX_PHASE
+    };
+
+    // the midgame and endgame value of every entry, material included, plus the unused one
+    struct TuneTables {
+        std::array<float, TUNE_ENTRIES + 1> midgame{};
+        std::array<float, TUNE_ENTRIES + 1> endgame{};
+    };
+
+    struct TuneGradients {
+        std::array<double, TUNE_ENTRIES + 1> midgame{};
+        std::array<double, TUNE_ENTRIES + 1> endgame{};
+        double error = 0.0;
+    };
+
+    constexpr double LOG10 = 2.302585092994046;
+
+    double winProbability(double centipawns)
+    {
+        return 1.0 / (1.0 + std::pow(10.0, -centipawns / 400.0));
+    }
+
+    int typeIndex(char piece)
+    {
+        switch (piece) {
+            case 'P': case 'p': return 0;
+            case 'N': case 'n': return 1;
+            case 'B': case 'b': return 2;
+            case 'R': case 'r': return 3;
+            case 'Q': case 'q': return 4;
+            case 'K': case 'k': return 5;
+            default: return -1;
+        }
+    }
+
+    struct Line {
+        BitMove moves[TUNE_QUIESCENCE_PLIES];
+        int length = 0;
+    };
+
+    // captures and promotions only, on the tables' own score; line receives the moves to the quiet
+    // position the score comes from
+    int quiesce(GameState& position, int alpha, int beta, int ply, Line& line)
+    {
+        line.length = 0;
+        const int standPat = position.color == WHITE ? position.pstScore() : -position.pstScore();
+        if (standPat >= beta || ply >= TUNE_QUIESCENCE_PLIES) {
+            return standPat;
+        }
+        alpha = std::max(alpha, standPat);
+
+        MoveList moves;
+        position.generateAllMoves(moves, NoisyMoves);
+        Line child;
+        for (const BitMove& move : moves) {
+            position.pushMove(move);
+            const int score = -quiesce(position, -beta, -alpha, ply + 1, child);
+            position.popState();
+            if (score > alpha) {
+                alpha = score;
+                line.moves[0] = move;
+                std::copy(child.moves, child.moves + child.length, line.moves + 1);
+                line.length = child.length + 1;
+                if (score >= beta) {
+                    break;
+                }
+            }
+        }
+        return alpha;
+    }
+
+    void extractFeatures(const GameState& position, TunePosition& tuned)
+    {
+        int count = 0;
+        int phase = 0;
+        for (int square = 0; square < 64; square++) {
+            const char piece = position.state[square];
+            const int type = typeIndex(piece);
+            if (type < 0) {
+                continue;
+            }
+            // makePieceSquareTables: white reads entry square ^ 56, black entry square
+            const bool white = piece >= 'A' && piece <= 'Z';
+            tuned.features[count++] = static_cast<uint16_t>(type * 64 + (white ? square ^ 56 : square)) | (white ? 0 : TUNE_BLACK);
+            phase += pst::phaseWeight[type];
+        }
+        std::fill(tuned.features + count, tuned.features + TUNE_MAX_FEATURES, TUNE_UNUSED);
+        tuned.phase = static_cast<uint8_t>(std::min(phase, PST_MAX_PHASE));
+    }
+
+    // false for the positions the tuner leaves out
+    bool resolve(const TrainingSample& sample, float lambda, GameState& position, TunePosition& tuned)
+    {
+        const int target = blendedTarget(sample, lambda);
+        if (std::abs(target) >= TUNE_MAX_TARGET) {
+            return false;
+        }
+        const int castling = (sample.context.whiteCastleKingside ? WhiteKingSide : 0) | (sample.context.whiteCastleQueenside ? WhiteQueenSide : 0) |
+                             (sample.context.blackCastleKingside ? BlackKingSide : 0) | (sample.context.blackCastleQueenside ? BlackQueenSide : 0);
+        int pieces = 0;
+        int whiteKings = 0;
+        int blackKings = 0;
+        for (char piece : sample.state) {
+            pieces += piece != '0';
+            whiteKings += piece == 'K';
+            blackKings += piece == 'k';
+        }
+        if (pieces > TUNE_MAX_FEATURES || whiteKings != 1 || blackKings != 1) {
+            return false;
+        }
+        position.init(sample.state, sample.context.whiteToMove ? WHITE : BLACK, castling);
+        if (position.isInCheck()) {
+            return false;
+        }
+        // nor one where the king of the side that just moved could be taken
+        position.pushNullMove();
+        const bool illegal = position.isInCheck();
+        position.popState();
+        if (illegal) {
+            return false;
+        }
+
+        Line line;
+        quiesce(position, -TRAINING_MATE_EVAL, TRAINING_MATE_EVAL, 0, line);
+        for (int i = 0; i < line.length; i++) {
+            position.pushMove(line.moves[i]);
+        }
+        extractFeatures(position, tuned);
+        for (int i = 0; i < line.length; i++) {
+            position.popState();
+        }
+        tuned.target = static_cast<float>(winProbability(target));
+        return true;
+    }
+
+    std::vector<TunePosition> resolveDataset(const TrainingDataset& dataset, size_t count, float lambda, int threads)
+    {
+        std::vector<std::vector<TunePosition>> slices(threads);
+        const size_t slice = (count + threads - 1) / threads;
+        auto work = [&](int t) {
+            GameState position;
+            TrainingSample sample;
+            TunePosition tuned;
+            const size_t last = std::min(count, (t + 1) * slice);
+            for (size_t i = t * slice; i < last; i++) {
+                dataset.sample(i, sample);
+                if (resolve(sample, lambda, position, tuned)) {
+                    slices[t].push_back(tuned);
+                }
+            }
+        };
+        std::vector<std::thread> helpers;
+        for (int t = 1; t < threads; t++) {
+            helpers.emplace_back(work, t);
+        }
+        work(0);
+        for (auto& helper : helpers) {
+            helper.join();
+        }
+
+        std::vector<TunePosition> positions;
+        for (const auto& part : slices) {
+            positions.insert(positions.end(), part.begin(), part.end());
+        }
+        return positions;
+    }
+
+    // the fixed trip count over the padded features leaves the loop for the vectoriser, gathers included
+    inline float evaluate(const TuneTables& tables, const TunePosition& position)
+    {
+        float midgame = 0.0f;
+        float endgame = 0.0f;
+        for (int i = 0; i < TUNE_MAX_FEATURES; i++) {
+            const uint16_t feature = position.features[i];
+            const float sign = (feature & TUNE_BLACK) ? -1.0f : 1.0f;
+            const int entry = feature & ~TUNE_BLACK;
+            midgame += sign * tables.midgame[entry];
+            endgame += sign * tables.endgame[entry];
+        }
+        return (midgame * position.phase + endgame * (PST_MAX_PHASE - position.phase)) / PST_MAX_PHASE;
+    }
+
+    void accumulate(const TuneTables& tables, const TunePosition* positions, size_t count, TuneGradients& gradients)
+    {
+        for (size_t p = 0; p < count; p++) {
+            const TunePosition& position = positions[p];
+            const double probability = winProbability(evaluate(tables, position));
+            const double difference = probability - position.target;
+            gradients.error += difference * difference;
+            // d error / d evaluation, the midgame and endgame shares follow the phase
+            const double slope = 2.0 * difference * probability * (1.0 - probability) * LOG10 / 400.0;
+            const double midgameSlope = slope * position.phase / PST_MAX_PHASE;
+            const double endgameSlope = slope - midgameSlope;
+            for (int i = 0; i < TUNE_MAX_FEATURES; i++) {
+                const uint16_t feature = position.features[i];
+                const double sign = (feature & TUNE_BLACK) ? -1.0 : 1.0;
+                const int entry = feature & ~TUNE_BLACK;
+                gradients.midgame[entry] += sign * midgameSlope;
+                gradients.endgame[entry] += sign * endgameSlope;
+            }
+        }
+    }
+
+    // mean squared error over every position, gradients summed over the threads' slices
+    double computeGradients(const TuneTables& tables, const std::vector<TunePosition>& positions, std::vector<TuneGradients>& threadGradients, TuneGradients& total)
+    {
+        const int threads = static_cast<int>(threadGradients.size());
+        const size_t slice = (positions.size() + threads - 1) / threads;
+        auto work = [&](int t) {
+            threadGradients[t] = TuneGradients();
+            const size_t first = std::min(positions.size(), t * slice);
+            const size_t last = std::min(positions.size(), first + slice);
+            accumulate(tables, positions.data() + first, last - first, threadGradients[t]);
+        };
+        std::vector<std::thread> helpers;
+        for (int t = 1; t < threads; t++) {
+            helpers.emplace_back(work, t);
+        }
+        work(0);
+        for (auto& helper : helpers) {
+            helper.join();
+        }
+
+        total = TuneGradients();
+        for (const TuneGradients& gradients : threadGradients) {
+            for (int entry = 0; entry < TUNE_ENTRIES; entry++) {
+                total.midgame[entry] += gradients.midgame[entry];
+                total.endgame[entry] += gradients.endgame[entry];
+            }
+            total.error += gradients.error;
+        }
+        const double scale = 1.0 / std::max<size_t>(1, positions.size());
+        for (int entry = 0; entry < TUNE_ENTRIES; entry++) {
+            total.midgame[entry] *= scale;
+            total.endgame[entry] *= scale;
+        }
+        return total.error * scale;
+    }
+
+    TuneTables compiledTables()
+    {
+        TuneTables tables;
+        for (int type = 0; type < 6; type++) {
+            for (int entry = 0; entry < 64; entry++) {
+                tables.midgame[type * 64 + entry] = static_cast<float>(pst::midgameValue[type] + pst::midgame[type][entry]);
+                tables.endgame[type * 64 + entry] = static_cast<float>(pst::endgameValue[type] + pst::endgame[type][entry]);
+            }
+        }
+        return tables;
+    }
+
+    // pawns never stand on the first or last rank
+    bool usedEntry(int type, int entry)
+    {
+        return type != 0 || (entry >= 8 && entry < 56);
+    }
+
+    // material is the mean over the squares a piece can stand on, the king's stays 0
+    void writeTable(std::FILE* out, const char* name, const std::array<float, TUNE_ENTRIES + 1>& values, const int (&material)[6])
+    {
+        static const char* typeNames[6] = { "pawn", "knight", "bishop", "rook", "queen", "king" };
+        std::fprintf(out, "    inline constexpr int16_t %s[6][64] = {\n", name);
+        for (int type = 0; type < 6; type++) {
+            std::fprintf(out, "        {   // %s\n", typeNames[type]);
+            for (int row = 0; row < 8; row++) {
+                std::fprintf(out, "           ");
+                for (int file = 0; file < 8; file++) {
+                    const int entry = row * 8 + file;
+                    const long value = usedEntry(type, entry) ? std::lround(values[type * 64 + entry]) - material[type] : 0;
+                    std::fprintf(out, " %4ld,", std::max(-2000L, std::min(2000L, value)));
+                }
+                std::fprintf(out, "\n");
+            }
+            std::fprintf(out, "        },\n");
+        }
+        std::fprintf(out, "    };\n");
+    }
+
+    void splitMaterial(const std::array<float, TUNE_ENTRIES + 1>& values, int (&material)[6])
+    {
+        for (int type = 0; type < 5; type++) {
+            double sum = 0.0;
+            int squares = 0;
+            for (int entry = 0; entry < 64; entry++) {
+                if (usedEntry(type, entry)) {
+                    sum += values[type * 64 + entry];
+                    squares++;
+                }
+            }
+            material[type] = static_cast<int>(std::lround(sum / squares));
+        }
+        material[5] = 0;
+    }
+
+    bool writeHeader(const std::string& path, const TuneTables& tables, size_t positions, double error, float lambda)
+    {
+        std::FILE* out = std::fopen(path.c_str(), "w");
+        if (!out) {
+            std::fprintf(stderr, "could not write %s\n", path.c_str());
+            return false;
+        }
+        int midgameMaterial[6];
+        int endgameMaterial[6];
+        splitMaterial(tables.midgame, midgameMaterial);
+        splitMaterial(tables.endgame, endgameMaterial);
+
+        std::fprintf(out, "#pragma once\n\n#include <cstdint>\n\n");
+        std::fprintf(out, "//\n// Generated by tools/tune, do not edit: %zu positions, lambda %.2f, mean squared error %.6f\n", positions, lambda, error);
+        std::fprintf(out, "// PieceSquareTables.h takes these in place of the PeSTO values when built with CHESS_TUNED_PST\n//\n\n");
+        std::fprintf(out, "namespace pst {\n");
+        std::fprintf(out, "    inline constexpr int16_t midgameValue[6] = { %d, %d, %d, %d, %d, %d };\n", midgameMaterial[0], midgameMaterial[1],
+                     midgameMaterial[2], midgameMaterial[3], midgameMaterial[4], midgameMaterial[5]);
+        std::fprintf(out, "    inline constexpr int16_t endgameValue[6] = { %d, %d, %d, %d, %d, %d };\n\n", endgameMaterial[0], endgameMaterial[1],
+                     endgameMaterial[2], endgameMaterial[3], endgameMaterial[4], endgameMaterial[5]);
+        writeTable(out, "midgame", tables.midgame, midgameMaterial);
+        std::fprintf(out, "\n");
+        writeTable(out, "endgame", tables.endgame, endgameMaterial);
+        std::fprintf(out, "}\n");
+        return std::fclose(out) == 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 1000;
+    double learningRate = 1.0;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    size_t limit = 0;
+    float lambda = 0.5f;
+    std::string outPath = "classes/TunedPieceSquareTables.h";
+    std::vector<std::string> files;
+    bool usage = false;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "-i") == 0 && hasValue) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-lr") == 0 && hasValue) {
+            learningRate = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "-t") == 0 && hasValue) {
+            threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "-n") == 0 && hasValue) {
+            limit = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-lambda") == 0 && hasValue) {
+            lambda = std::max(0.0f, std::min(1.0f, static_cast<float>(std::atof(argv[++i]))));
+        } else if (std::strcmp(argv[i], "-o") == 0 && hasValue) {
+            outPath = argv[++i];
+        } else if (argv[i][0] != '-') {
+            files.push_back(argv[i]);
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || files.empty()) {
+        std::fprintf(stderr, "usage: %s [-i iterations] [-lr rate] [-t threads] [-n positions] [-lambda l] [-o header] data.bin...\n", argv[0]);
+        return 2;
+    }
+    threads = std::max(1, threads);
+
+    TrainingDataset dataset;
+    if (!dataset.open(files)) {
+        return 1;
+    }
+    const size_t count = limit > 0 ? std::min(limit, dataset.size()) : dataset.size();
+    auto start = std::chrono::steady_clock::now();
+    const std::vector<TunePosition> positions = resolveDataset(dataset, count, lambda, threads);
+    std::printf("%zu of %zu positions resolved in %.1f s\n", positions.size(), count,
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    if (positions.empty()) {
+        return 1;
+    }
+
+    // Adam, each entry moving about learningRate centipawns a step whatever the scale of its gradient
+    constexpr double BETA1 = 0.9;
+    constexpr double BETA2 = 0.999;
+    constexpr double EPSILON = 1e-12;
+    TuneTables tables = compiledTables();
+    TuneGradients firstMoment;
+    TuneGradients secondMoment;
+    TuneGradients gradients;
+    std::vector<TuneGradients> threadGradients(threads);
+    double error = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (int iteration = 1; iteration <= iterations; iteration++) {
+        error = computeGradients(tables, positions, threadGradients, gradients);
+        const double correction1 = 1.0 - std::pow(BETA1, iteration);
+        const double correction2 = 1.0 - std::pow(BETA2, iteration);
+        auto step = [&](std::array<float, TUNE_ENTRIES + 1>& values, const std::array<double, TUNE_ENTRIES + 1>& gradient,
+                        std::array<double, TUNE_ENTRIES + 1>& first, std::array<double, TUNE_ENTRIES + 1>& second) {
+            for (int entry = 0; entry < TUNE_ENTRIES; entry++) {
+                first[entry] = BETA1 * first[entry] + (1.0 - BETA1) * gradient[entry];
+                second[entry] = BETA2 * second[entry] + (1.0 - BETA2) * gradient[entry] * gradient[entry];
+                values[entry] -= static_cast<float>(learningRate * (first[entry] / correction1) / (std::sqrt(second[entry] / correction2) + EPSILON));
+            }
+        };
+        step(tables.midgame, gradients.midgame, firstMoment.midgame, secondMoment.midgame);
+        step(tables.endgame, gradients.endgame, firstMoment.endgame, secondMoment.endgame);
+
+        if (iteration == 1 || iteration % 10 == 0) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("iteration %d: mean squared error %.6f, %.0f positions/s\n", iteration, error,
+                        seconds > 0.0 ? positions.size() * static_cast<double>(iteration) / seconds : 0.0);
+            std::fflush(stdout);
+        }
+        if ((iteration % TUNE_WRITE_EVERY == 0 || iteration == iterations) && !writeHeader(outPath, tables, positions.size(), error, lambda)) {
+            return 1;
+        }
+    }
+    std::printf("wrote %s\n", outPath.c_str());
+    return 0;
+}
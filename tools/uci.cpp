@@ -0,0 +1,468 @@
+//
+// uci - the engine behind the Universal Chess Interface, for GUIs and match runners such as cutechess-cli
+//
+//   uci                                       reads commands on stdin, answers on stdout
+//   cutechess-cli -engine cmd=uci dir=build ...
+//
+// Commands: uci, isready, ucinewgame, setoption, position, go, stop, ponderhit, quit. A position command
+// that extends the previous one by a few moves (what a GUI sends every move of a game) only plays the
+// new moves onto the position already set up, so the game's history, needed for repetitions, is kept
+// without replaying it. go takes wtime/btime/winc/binc/movestogo, handed to the search's time manager,
+// movetime, depth, searchmoves, infinite and ponder.
+// The search runs on its own thread and the input is still read while it does, so stop and ponderhit
+// get through; in infinite and ponder mode bestmove waits for stop (or ponderhit) even if the search
+// has finished, as the protocol wants. Mate scores count the principal variation's plies, tablebase
+// wins the table's distance from where it was probed, exact when the root itself is in the tables.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../classes/ChessEval.h"
+#include "../classes/ChessSearch.h"
+#include "../classes/GameState.h"
+#include "../classes/Notation.h"
+#include "../classes/Tablebase.h"
+
+static const char* STARTING_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+static const char* DEFAULT_MODEL = "resources/models/neural_final.bin";
+
+static const int MAX_HASH_MB = 4096;
+static const int MAX_THREADS = 256;
+static const int PV_LENGTH = 32;
+
+static std::vector<std::string> splitWords(const std::string& line)
+{
+    std::vector<std::string> words;
+    std::istringstream in(line);
+    std::string word;
+    while (in >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+struct GoParameters {
+    int timeMs[2] = { 0, 0 };       // indexed by whether white is to move
+    int incrementMs[2] = { 0, 0 };
+    int movesToGo = 0;
+    int moveTimeMs = 0;
+    int depth = 0;
+    bool infinite = false;
+    bool ponder = false;
+    std::vector<BitMove> searchMoves;
+};
+
+// the side to move's clock goes to the search's time manager, a move time is used as it is
+static void setTimeLimits(const GoParameters& go, bool whiteToMove, SearchLimits& limits)
+{
+    if (go.moveTimeMs > 0) {
+        limits.moveTimeMs = std::max(1, go.moveTimeMs - MOVE_OVERHEAD_MS);
+        return;
+    }
+    limits.timeLeftMs = go.timeMs[whiteToMove ? 1 : 0];
+    limits.incrementMs = go.incrementMs[whiteToMove ? 1 : 0];
+    limits.movesToGo = go.movesToGo;
+}
+
+class UciEngine {
+public:
+    UciEngine() : _stopRequest(false), _ponderHitEarly(false) {
+        _position.loadFEN(STARTING_FEN);
+        _basePosition = STARTING_FEN;
+        createSearch();
+    }
+
+    ~UciEngine() { stopSearch(); }
+
+    // false once the GUI has sent quit
+    bool handle(const std::string& line);
+
+private:
+    void send(const std::string& line) {
+        std::lock_guard<std::mutex> lock(_outputMutex);
+        std::cout << line << std::endl;
+    }
+
+    void createSearch();
+    void setOption(const std::vector<std::string>& words);
+    void setPosition(const std::vector<std::string>& words);
+    void go(const std::vector<std::string>& words);
+    void ponderHit();
+    void stopSearch();
+    void waitForSearch() {
+        if (_searchThread.joinable()) {
+            _searchThread.join();
+        }
+    }
+
+    void runSearch(GameState root, SearchLimits limits);
+    // starts the pondering search's clock, less what has gone by since the ponderhit
+    void startPonderClock(int spentMs);
+    std::string scoreText(int score) const;
+    std::string principalVariation(const GameState& root, const BitMove& best) const;
+
+    std::string _modelPath = DEFAULT_MODEL;
+    std::string _tablebasePath;
+    int _hashMB = 16;
+    int _threads = 1;
+    std::shared_ptr<const ChessEval> _evaluator;
+    std::unique_ptr<ChessSearch> _search;
+
+    // the position as the last position command left it, and what it was built from
+    GameState _position;
+    std::string _basePosition;
+    std::vector<std::string> _moves;
+
+    std::thread _searchThread;
+    std::atomic<bool> _stopRequest;
+    // the search is done but bestmove waits for stop or ponderhit; _ponderClock holds the time limits
+    // a pondering search gets once ponderhit turns it into the real one
+    std::mutex _holdMutex;
+    std::condition_variable _holdChanged;
+    bool _holdBestMove = false;
+    bool _pondering = false;
+    SearchLimits _ponderClock;
+    std::chrono::steady_clock::time_point _ponderHitTime;
+    std::atomic<bool> _ponderHitEarly;
+    std::chrono::steady_clock::time_point _searchStart;
+
+    std::mutex _outputMutex;
+};
+
+bool UciEngine::handle(const std::string& line)
+{
+    const std::vector<std::string> words = splitWords(line);
+    if (words.empty()) {
+        return true;
+    }
+    const std::string& command = words[0];
+    if (command == "uci") {
+        send("id name Chess_Base");
+        send("id author Chess_Base developers");
+        send("option name Hash type spin default 16 min 1 max " + std::to_string(MAX_HASH_MB));
+        send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+        send("option name Ponder type check default false");
+        send("option name EvalFile type string default " + std::string(DEFAULT_MODEL));
+        send("option name TablebasePath type string default <empty>");
+        send("uciok");
+    } else if (command == "isready") {
+        send("readyok");
+    } else if (command == "ucinewgame") {
+        stopSearch();
+        _search->newGame();
+    } else if (command == "setoption") {
+        stopSearch();
+        setOption(words);
+    } else if (command == "position") {
+        stopSearch();
+        setPosition(words);
+    } else if (command == "go") {
+        stopSearch();
+        go(words);
+    } else if (command == "stop") {
+        stopSearch();
+    } else if (command == "ponderhit") {
+        ponderHit();
+    } else if (command == "quit") {
+        stopSearch();
+        return false;
+    } else if (command != "debug" && command != "register") {
+        send("info string unknown command " + command);
+    }
+    return true;
+}
+
+// a new model means a new search, which is given the settings the old one had
+void UciEngine::createSearch()
+{
+    _evaluator = ChessEval::shared(_modelPath);
+    _search = std::make_unique<ChessSearch>(*_evaluator);
+    _search->setLogLevel(LogLevel::Error);
+    _search->resizeTT(_hashMB);
+    _search->setThreads(_threads);
+    if (!_tablebasePath.empty()) {
+        _search->setTablebase(Tablebase::shared(_tablebasePath));
+    }
+}
+
+// setoption name <id, may have spaces> [value <x>]
+void UciEngine::setOption(const std::vector<std::string>& words)
+{
+    std::string name;
+    std::string value;
+    std::string* field = nullptr;
+    for (size_t i = 1; i < words.size(); i++) {
+        if (words[i] == "name" && field == nullptr) {
+            field = &name;
+        } else if (words[i] == "value" && field == &name) {
+            field = &value;
+        } else if (field) {
+            if (!field->empty()) {
+                *field += ' ';
+            }
+            *field += words[i];
+        }
+    }
+    if (name == "Hash") {
+        _hashMB = std::clamp(std::atoi(value.c_str()), 1, MAX_HASH_MB);
+        _search->resizeTT(_hashMB);
+    } else if (name == "Threads") {
+        _threads = std::clamp(std::atoi(value.c_str()), 1, MAX_THREADS);
+        _search->setThreads(_threads);
+    } else if (name == "EvalFile") {
+        if (value != _modelPath) {
+            _modelPath = value;
+            createSearch();
+        }
+    } else if (name == "TablebasePath") {
+        _tablebasePath = value == "<empty>" ? std::string() : value;
+        _search->setTablebase(_tablebasePath.empty() ? nullptr : Tablebase::shared(_tablebasePath));
+        if (!_tablebasePath.empty()) {
+            send("info string tablebases for up to " + std::to_string(Tablebase::shared(_tablebasePath)->maxPieces()) + " pieces");
+        }
+    } else if (name != "Ponder") {
+        send("info string unknown option " + name);
+    }
+}
+
+// position startpos|fen <fen> [moves <move>...]
+void UciEngine::setPosition(const std::vector<std::string>& words)
+{
+    size_t i = 1;
+    std::string base;
+    if (i < words.size() && words[i] == "startpos") {
+        base = STARTING_FEN;
+        i++;
+    } else if (i < words.size() && words[i] == "fen") {
+        for (i++; i < words.size() && words[i] != "moves"; i++) {
+            if (!base.empty()) {
+                base += ' ';
+            }
+            base += words[i];
+        }
+    } else {
+        send("info string position needs startpos or fen");
+        return;
+    }
+    std::vector<std::string> moves;
+    if (i < words.size() && words[i] == "moves") {
+        moves.assign(words.begin() + static_cast<std::ptrdiff_t>(i) + 1, words.end());
+    }
+
+    // the same game a few moves on only needs the new moves
+    size_t played = 0;
+    if (base == _basePosition && moves.size() >= _moves.size() && std::equal(_moves.begin(), _moves.end(), moves.begin())) {
+        played = _moves.size();
+    } else {
+        GameState start;
+        if (!start.loadFEN(base)) {
+            send("info string bad fen " + base);
+            return;
+        }
+        _position = start;
+        _basePosition = base;
+        _moves.clear();
+    }
+    for (size_t m = played; m < moves.size(); m++) {
+        const BitMove move = parseMove(_position, moves[m]);
+        if (move.piece == NoPiece) {
+            send("info string illegal move " + moves[m]);
+            return;
+        }
+        _position.pushMove(move);
+        _moves.push_back(moves[m]);
+    }
+}
+
+void UciEngine::go(const std::vector<std::string>& words)
+{
+    GoParameters parameters;
+    for (size_t i = 1; i < words.size(); i++) {
+        const std::string& word = words[i];
+        const bool hasValue = i + 1 < words.size();
+        if (word == "infinite") {
+            parameters.infinite = true;
+        } else if (word == "ponder") {
+            parameters.ponder = true;
+        } else if (!hasValue) {
+            break;
+        } else if (word == "wtime") {
+            parameters.timeMs[1] = std::atoi(words[++i].c_str());
+        } else if (word == "btime") {
+            parameters.timeMs[0] = std::atoi(words[++i].c_str());
+        } else if (word == "winc") {
+            parameters.incrementMs[1] = std::atoi(words[++i].c_str());
+        } else if (word == "binc") {
+            parameters.incrementMs[0] = std::atoi(words[++i].c_str());
+        } else if (word == "movestogo") {
+            parameters.movesToGo = std::atoi(words[++i].c_str());
+        } else if (word == "movetime") {
+            parameters.moveTimeMs = std::atoi(words[++i].c_str());
+        } else if (word == "depth") {
+            parameters.depth = std::atoi(words[++i].c_str());
+        } else if (word == "searchmoves") {
+            // the moves run on to the next word that isn't one
+            for (; i + 1 < words.size(); i++) {
+                const BitMove move = parseMove(_position, words[i + 1]);
+                if (move.piece == NoPiece) {
+                    break;
+                }
+                parameters.searchMoves.push_back(move);
+            }
+        }
+    }
+
+    MoveList legal;
+    _position.generateAllMoves(legal);
+    if (legal.empty()) {
+        send("info depth 0 score " + std::string(_position.isInCheck() ? "mate 0" : "cp 0"));
+        send("bestmove 0000");
+        return;
+    }
+
+    SearchLimits clock;
+    if (!parameters.infinite) {
+        setTimeLimits(parameters, _position.color == WHITE, clock);
+    }
+    SearchLimits limits;
+    limits.maxDepth = parameters.depth > 0 ? std::min(parameters.depth, MAX_SEARCH_DEPTH) : MAX_SEARCH_DEPTH;
+    // a pondering search has no clock until ponderhit says the guess was right
+    if (!parameters.ponder) {
+        limits.moveTimeMs = clock.moveTimeMs;
+        limits.timeLeftMs = clock.timeLeftMs;
+        limits.incrementMs = clock.incrementMs;
+        limits.movesToGo = clock.movesToGo;
+    }
+    limits.searchMoves = parameters.searchMoves;
+    limits.stopRequest = &_stopRequest;
+    {
+        std::lock_guard<std::mutex> lock(_holdMutex);
+        _pondering = parameters.ponder;
+        _ponderClock = clock;
+        _holdBestMove = parameters.infinite || parameters.ponder;
+    }
+    _stopRequest.store(false);
+    _ponderHitEarly.store(false);
+    _searchStart = std::chrono::steady_clock::now();
+    _searchThread = std::thread(&UciEngine::runSearch, this, _position, limits);
+}
+
+void UciEngine::ponderHit()
+{
+    std::lock_guard<std::mutex> lock(_holdMutex);
+    if (!_pondering) {
+        return;
+    }
+    _pondering = false;
+    _holdBestMove = false;
+    _ponderHitTime = std::chrono::steady_clock::now();
+    _ponderHitEarly.store(true);
+    startPonderClock(0);
+    _holdChanged.notify_all();
+}
+
+void UciEngine::startPonderClock(int spentMs)
+{
+    if (_ponderClock.timeLeftMs > 0) {
+        _search->setClock(std::max(1, _ponderClock.timeLeftMs - spentMs), _ponderClock.incrementMs, _ponderClock.movesToGo);
+    } else if (_ponderClock.moveTimeMs > 0) {
+        _search->setMoveTime(std::max(1, _ponderClock.moveTimeMs - spentMs));
+    }
+}
+
+void UciEngine::stopSearch()
+{
+    if (!_searchThread.joinable()) {
+        return;
+    }
+    _stopRequest.store(true);
+    {
+        std::lock_guard<std::mutex> lock(_holdMutex);
+        _holdBestMove = false;
+        _pondering = false;
+        _holdChanged.notify_all();
+    }
+    waitForSearch();
+}
+
+void UciEngine::runSearch(GameState root, SearchLimits limits)
+{
+    limits.onIteration = [this, &root](const SearchProgress& progress) {
+        // the ponderhit's clock again, now that the search is surely running: one that came before it
+        // had started its own clock was overwritten by it
+        if (_ponderHitEarly.exchange(false)) {
+            std::lock_guard<std::mutex> lock(_holdMutex);
+            const auto since = std::chrono::steady_clock::now() - _ponderHitTime;
+            startPonderClock(static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(since).count()));
+        }
+        const std::string pv = principalVariation(root, progress.bestMove);
+        const auto elapsed = std::chrono::steady_clock::now() - _searchStart;
+        const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+        const long long nps = ms > 0 ? static_cast<long long>(progress.nodes * 1000 / ms) : 0;
+        send("info depth " + std::to_string(progress.depth) + " score " + scoreText(progress.score) +
+             " nodes " + std::to_string(progress.nodes) + " nps " + std::to_string(nps) + " time " + std::to_string(ms) +
+             " pv " + pv);
+    };
+    const SearchResult result = _search->search(root, limits);
+
+    // in infinite and ponder mode the GUI decides when the move is wanted
+    {
+        std::unique_lock<std::mutex> lock(_holdMutex);
+        _holdChanged.wait(lock, [this]() { return !_holdBestMove; });
+    }
+
+    const BitMove best = result.rootMoves[0].move;
+    GameState reply = root;
+    reply.pushMove(best);
+    const BitMove ponder = _search->hashMove(reply);
+    send("bestmove " + moveToUCI(best) + (ponder.piece != NoPiece ? " ponder " + moveToUCI(ponder) : ""));
+}
+
+std::string UciEngine::scoreText(int score) const
+{
+    int moves;
+    if (ChessSearch::mateInMoves(score, moves)) {
+        return "mate " + std::to_string(moves);
+    }
+    return "cp " + std::to_string(score);
+}
+
+std::string UciEngine::principalVariation(const GameState& root, const BitMove& best) const
+{
+    std::string pv;
+    const std::vector<BitMove> line = _search->principalVariation(root, best, PV_LENGTH);
+    for (const BitMove& move : line) {
+        if (!pv.empty()) {
+            pv += ' ';
+        }
+        pv += moveToUCI(move);
+    }
+    return pv;
+}
+
+int main()
+{
+    std::ios::sync_with_stdio(false);
+    UciEngine engine;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!engine.handle(line)) {
+            break;
+        }
+    }
+    return 0;
+}